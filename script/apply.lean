@@ -73,20 +73,17 @@ if (arity == fixed + {n}) \{
     lean_assert(arity > {max});
     obj * as[{n}] = \{ {args} };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) \{ lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < {n}; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + {n}) \{\n"
   if n ≥ 2 then do
     emit  s!"  obj * as[{n}] = \{ {args} };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) \{ lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, {n}+fixed-arity, &as[arity-fixed]);\n"
   else emit s!"  lean_assert(fixed < arity);
   lean_unreachable();\n"
@@ -105,7 +102,7 @@ case 0: lean_unreachable();\n"
   emit "default: return reinterpret_cast<fnn>(f)(as);
 }
 }
-static obj* curry(obj* f, unsigned n, obj** as) { return curry(lean_closure_fun(f), n, as); }\n"
+"
 
 def mkApplyN (max : Nat) : M Unit := do
   emit "extern \"C\" LEAN_EXPORT obj* lean_apply_n(obj* f, unsigned n, obj** as) {
@@ -126,17 +123,14 @@ unsigned arity = lean_closure_arity(f);
 unsigned fixed = lean_closure_num_fixed(f);
 if (arity == fixed + n) \{
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) \{ lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < n; i++) args[fixed+i] = as[i];
-  obj * r = FNN(f)(args);
-  lean_dec_ref(f);
-  return r;
+  return reinterpret_cast<fnn>(fun)(args);
 } else if (arity < fixed + n) \{
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) \{ lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = FNN(f)(args);
-  lean_dec_ref(f);
+  obj * new_f = reinterpret_cast<fnn>(fun)(args);
   return lean_apply_n(new_f, n+fixed-arity, &as[arity-fixed]);
 } else \{
   return fix_args(f, n, as);
@@ -144,25 +138,51 @@ if (arity == fixed + n) \{
 }\n"
 
 def mkFixArgs : M Unit := emit "
+/* Number of fixed arguments that fit in the memory cell of the closure `f`. */
+static inline unsigned closure_capacity(obj* f) {
+    return (lean_small_object_size(f) - sizeof(lean_closure_object)) / sizeof(void*);
+}
+
+/* Partial applications are often extended again, e.g. by curried functions and monad transformer stacks
+   that receive their arguments one at a time. Thus, we reserve room for the remaining arguments of
+   closures that do not use the boxed calling convention, and `fix_args` updates them in place. */
+static obj* alloc_partial_closure(void* fun, unsigned arity, unsigned num_fixed) {
+    unsigned capacity = arity <= LEAN_CLOSURE_MAX_ARGS ? arity - 1 : num_fixed;
+    lean_closure_object * o = reinterpret_cast<lean_closure_object*>(lean_alloc_small_object(sizeof(lean_closure_object) + sizeof(void*)*capacity));
+    lean_set_st_header(reinterpret_cast<obj*>(o), LeanClosure, 0);
+    o->m_fun = fun;
+    o->m_arity = arity;
+    o->m_num_fixed = num_fixed;
+    return reinterpret_cast<obj*>(o);
+}
+
 static obj* fix_args(obj* f, unsigned n, obj*const* as) {
     unsigned arity = lean_closure_arity(f);
     unsigned fixed = lean_closure_num_fixed(f);
     unsigned new_fixed = fixed + n;
     lean_assert(new_fixed < arity);
-    obj * r = lean_alloc_closure(lean_closure_fun(f), arity, new_fixed);
-    obj ** source = lean_closure_arg_cptr(f);
-    obj ** target = lean_closure_arg_cptr(r);
-    if (!lean_is_exclusive(f)) {
-      for (unsigned i = 0; i < fixed; i++, source++, target++) {
-          *target = *source;
-          lean_inc(*target);
-      }
-      lean_dec_ref(f);
+    obj * r;
+    obj ** target;
+    if (lean_is_exclusive(f) && closure_capacity(f) >= new_fixed) {
+      r = f;
+      lean_to_closure(r)->m_num_fixed = new_fixed;
+      target = lean_closure_arg_cptr(r) + fixed;
     } else {
-      for (unsigned i = 0; i < fixed; i++, source++, target++) {
-          *target = *source;
+      r = alloc_partial_closure(lean_closure_fun(f), arity, new_fixed);
+      obj ** source = lean_closure_arg_cptr(f);
+      target = lean_closure_arg_cptr(r);
+      if (!lean_is_exclusive(f)) {
+        for (unsigned i = 0; i < fixed; i++, source++, target++) {
+            *target = *source;
+            lean_inc(*target);
+        }
+        lean_dec_ref(f);
+      } else {
+        for (unsigned i = 0; i < fixed; i++, source++, target++) {
+            *target = *source;
+        }
+        lean_free_small_object(f);
       }
-      lean_free_small_object(f);
     }
     for (unsigned i = 0; i < n; i++, as++, target++) {
         *target = *as;
@@ -173,6 +193,28 @@ static obj* fix_args(obj* f, unsigned n, obj*const* as) {
 static inline obj* fix_args(obj* f, std::initializer_list<obj*> const & l) {
     return fix_args(f, l.size(), l.begin());
 }
+
+/* Store the fixed arguments of `f` at `args`, consume `f`, and return its code pointer.
+   If `f` is not shared, we move the arguments instead of incrementing their reference counters
+   here and decrementing them again when `f` is deleted. */
+static inline void* take_fixed_args(obj* f, obj** args) {
+    void * fun = lean_closure_fun(f);
+    unsigned fixed = lean_closure_num_fixed(f);
+    obj ** source = lean_closure_arg_cptr(f);
+    if (!lean_is_exclusive(f)) {
+      for (unsigned i = 0; i < fixed; i++) {
+          args[i] = source[i];
+          lean_inc(args[i]);
+      }
+      lean_dec_ref(f);
+    } else {
+      for (unsigned i = 0; i < fixed; i++) {
+          args[i] = source[i];
+      }
+      lean_free_small_object(f);
+    }
+    return fun;
+}
 "
 
 def mkCopyright : M Unit := emit "/*
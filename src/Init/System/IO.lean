@@ -264,6 +264,15 @@ local macro "nonempty_list" : tactic =>
 /-- Helper method for implementing "deterministic" timeouts. It is the number of "small" memory allocations performed by the current execution thread. -/
 @[extern "lean_io_get_num_heartbeats"] opaque getNumHeartbeats : BaseIO Nat
 
+/--
+Enables or disables deferred deallocation. When enabled, a thread that drops the last reference to
+a large object graph shared between threads frees only a bounded part of it, and a background thread
+frees the rest. This bounds the pause caused by dropping, e.g., an old environment, at the cost of the
+memory being reclaimed later. Finalizers of external objects in such a graph, such as closing a file
+handle, then also run on the background thread.
+-/
+@[extern "lean_io_set_deferred_dealloc"] opaque setDeferredDealloc (enable : Bool) : BaseIO Unit
+
 /--
 The mode of a file handle (i.e., a set of `open` flags and an `fdopen` mode).
 
@@ -429,6 +438,33 @@ Note that EOF does not actually close a handle, so further reads may block and r
 @[extern "lean_io_prim_handle_get_line"] opaque getLine (h : @& Handle) : IO String
 @[extern "lean_io_prim_handle_put_str"] opaque putStr (h : @& Handle) (s : @& String) : IO Unit
 
+/-!
+Asynchronous operations. On Linux, these are serviced by a single runtime reactor thread, so
+any number of outstanding operations on pipes and similar handles does not occupy any worker
+threads. On other platforms, each operation is run on a dedicated thread instead.
+
+The operations act directly on the handle's file descriptor: they must not be mixed with
+buffered reads (`read`, `getLine`) on the same handle, while buffered writes are flushed
+before an asynchronous write is started.
+-/
+
+/--
+Reads up to the given number of bytes from the handle once data is available.
+Unlike `read`, the returned array may be shorter than requested even before the end of the
+file; it is empty only if an end-of-file marker has been reached.
+-/
+@[extern "lean_io_prim_handle_read_async"]
+opaque readAsync (h : @& Handle) (bytes : USize) : IO (Task (Except IO.Error ByteArray))
+/-- Writes the entire buffer to the handle. -/
+@[extern "lean_io_prim_handle_write_async"]
+opaque writeAsync (h : @& Handle) (buffer : ByteArray) : IO (Task (Except IO.Error Unit))
+/-- Returns a task that finishes once the handle can be read from without blocking. -/
+@[extern "lean_io_prim_handle_wait_readable"]
+opaque waitReadable (h : @& Handle) : IO (Task (Except IO.Error Unit))
+/-- Returns a task that finishes once the handle can be written to without blocking. -/
+@[extern "lean_io_prim_handle_wait_writable"]
+opaque waitWritable (h : @& Handle) : IO (Task (Except IO.Error Unit))
+
 end Handle
 
 @[extern "lean_io_realpath"] opaque realPath (fname : FilePath) : IO FilePath
@@ -486,6 +522,14 @@ def readFile (fname : FilePath) : IO String := do
   let h ← Handle.mk fname Mode.read
   h.readToEnd
 
+/--
+Hashes the contents of the file `fname` without reading it into memory as a whole. The result is the same as
+`hash (← readBinFile fname)`. If `normalizeEol` is true, every `\r\n` is treated as `\n`; for a UTF-8 file, the
+result then is the same as `hash ((← readFile fname).replace "\r\n" "\n")`.
+-/
+@[extern "lean_io_hash_file"]
+opaque hashFile (fname : @& FilePath) (normalizeEol : Bool := false) : IO UInt64
+
 partial def lines (fname : FilePath) : IO (Array String) := do
   let h ← Handle.mk fname Mode.read
   let rec read (lines : Array String) := do
@@ -542,6 +586,36 @@ structure Metadata where
   type     : FileType
   deriving Repr
 
+/-- Options for `System.FilePath.walkDirEntries`. -/
+structure WalkConfig where
+  /--
+  If nonempty, only files whose extension (as in `FilePath.extension`) is in the array are reported.
+  Directories are not affected by this filter.
+  -/
+  extensions     : Array String := #[]
+  /--
+  If set, only files whose name matches the glob pattern (supporting `*` and `?`) are reported.
+  Directories are not affected by this filter.
+  -/
+  pattern?       : Option String := none
+  /-- Names of directories that are neither reported nor entered, e.g. `".git"`. -/
+  skipDirs       : Array String := #[]
+  /-- Whether to retrieve `Metadata` for every reported entry. -/
+  metadata       : Bool := false
+  /-- Whether to enter symbolic links to directories. Cycles are entered only once. -/
+  followSymlinks : Bool := true
+  /-- Whether directories are reported as entries as well. -/
+  includeDirs    : Bool := true
+
+/-- An entry reported by `System.FilePath.walkDirEntries`. -/
+structure WalkEntry where
+  path     : FilePath
+  /-- Type of the entry itself, i.e. `symlink` for symbolic links. Determined without a `stat` call where possible. -/
+  type     : FileType
+  /-- Metadata of the entry, following symbolic links; present if `WalkConfig.metadata` is set. -/
+  metadata : Option Metadata
+  deriving Repr
+
 end FS
 end IO
 
@@ -586,6 +660,14 @@ where
       | .error (.noFileOrDirectory ..) => pure ()
       | .error e => throw e
 
+/--
+Returns all entries below the directory `p` matching `cfg`, sorted by path. Unlike `walkDir`, the
+traversal is done natively without a `metadata` call per entry, reading subdirectories in
+parallel on the task manager.
+-/
+@[extern "lean_io_walk_dir"]
+opaque walkDirEntries (p : @& FilePath) (cfg : @& IO.FS.WalkConfig := {}) : IO (Array IO.FS.WalkEntry)
+
 end System.FilePath
 
 namespace IO
@@ -714,6 +796,13 @@ structure Child (cfg : StdioConfig) where
     If the process was started using `SpawnArgs.setsid`, terminates the entire process group instead. -/
 @[extern "lean_io_process_child_kill"] opaque Child.kill {cfg : @& StdioConfig} : @& Child cfg → IO Unit
 
+/--
+Returns a task that finishes with the exit code of the child process once it terminates, like
+`Child.wait`. On Linux, waiting does not occupy a thread; see `IO.FS.Handle.readAsync`.
+-/
+@[extern "lean_io_process_child_wait_async"]
+opaque Child.waitAsync {cfg : @& StdioConfig} : @& Child cfg → IO (Task (Except IO.Error UInt32))
+
 /--
 Extract the `stdin` field from a `Child` object, allowing them to be freed independently.
 This operation is necessary for closing the child process' stdin while still holding on to a process handle,
@@ -147,6 +147,7 @@ def registerTagAttribute (name : Name) (descr : String)
       let r : Array Name := es.fold (fun a e => a.push e) #[]
       r.qsort Name.quickLt
     statsFn         := fun s => "tag attribute" ++ Format.line ++ "number of local entries: " ++ format s.size
+    replay?         := some fun old new s => new.fold (init := s) fun s n => if old.contains n then s else s.insert n
   }
   let attrImpl : AttributeImpl := {
     ref, name, descr, applicationTime
@@ -197,6 +198,7 @@ def registerParametricAttribute [Inhabited α] (impl : ParametricAttributeImpl 
       let r : Array (Name × α) := m.fold (fun a n p => a.push (n, p)) #[]
       r.qsort (fun a b => Name.quickLt a.1 b.1)
     statsFn         := fun s => "parametric attribute" ++ Format.line ++ "number of local entries: " ++ format s.size
+    replay?         := some fun old new s => new.fold (init := s) fun s n p => if old.contains n then s else s.insert n p
   }
   let attrImpl : AttributeImpl := {
     impl.toAttributeImplCore with
@@ -254,6 +256,7 @@ def registerEnumAttributes [Inhabited α] (attrDescrs : List (Name × String ×
       let r : Array (Name × α) := m.fold (fun a n p => a.push (n, p)) #[]
       r.qsort (fun a b => Name.quickLt a.1 b.1)
     statsFn         := fun s => "enumeration attribute extension" ++ Format.line ++ "number of local entries: " ++ format s.size
+    replay?         := some fun old new s => new.fold (init := s) fun s n p => if old.contains n then s else s.insert n p
   }
   let attrs := attrDescrs.map fun (name, descr, val) => {
     ref             := ref
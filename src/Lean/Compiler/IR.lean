@@ -15,6 +15,7 @@ import Lean.Compiler.IR.NormIds
 import Lean.Compiler.IR.Checker
 import Lean.Compiler.IR.Borrow
 import Lean.Compiler.IR.Boxing
+import Lean.Compiler.IR.ExportWrapper
 import Lean.Compiler.IR.RC
 import Lean.Compiler.IR.ExpandResetReuse
 import Lean.Compiler.IR.UnboxResult
@@ -45,10 +46,12 @@ private def compileAux (decls : Array Decl) : CompilerM Unit := do
   decls := decls.map Decl.simpCase
   logDecls `simp_case decls
   decls := decls.map Decl.normalizeIds
+  let declaredDecls := decls
   decls ← inferBorrow decls
   logDecls `borrow decls
   decls ← explicitBoxing decls
   logDecls `boxing decls
+  decls ← addExportWrappers declaredDecls decls
   decls ← explicitRC decls
   logDecls `rc decls
   if compiler.reuse.get (← read) then
@@ -5,6 +5,7 @@ Authors: Leonardo de Moura
 -/
 prelude
 import Lean.Compiler.ExportAttr
+import Lean.Compiler.IR.ExportWrapper
 import Lean.Compiler.IR.CompilerM
 import Lean.Compiler.IR.NormIds
 
@@ -68,13 +69,9 @@ namespace InitParamMap
 def initBorrow (ps : Array Param) : Array Param :=
   ps.map fun p => { p with borrow := p.ty.isObj }
 
-/-- We do perform borrow inference for constants marked as `export`.
-   Reason: we current write wrappers in C++ for using exported functions.
-   These wrappers use smart pointers such as `object_ref`.
-   When writing a new wrapper we need to know whether an argument is a borrow
-   inference or not.
-   We can revise this decision when we implement code for generating
-   the wrappers automatically. -/
+/-- We do not perform borrow inference for constants marked as `export` that keep their declared signature,
+   i.e. `main`. Reason: they are called from C code, which relies on the annotations in the declaration.
+   Other exported functions are called through a wrapper with the declared signature, see `ExportWrapper.lean`. -/
 def initBorrowIfNotExported (exported : Bool) (ps : Array Param) : Array Param :=
   if exported then ps else initBorrow ps
 
@@ -92,7 +89,7 @@ partial def visitFnBody (fnid : FunId) : FnBody → StateM ParamMap Unit
 def visitDecls (env : Environment) (decls : Array Decl) : StateM ParamMap Unit :=
   decls.forM fun decl => match decl with
     | .fdecl (f := f) (xs := xs) (body := b) .. => do
-      let exported := isExport env f
+      let exported := isExport env f && !needsExportWrapper env decl
       modify fun m => m.insert (ParamMap.Key.decl f) (initBorrowIfNotExported exported xs)
       visitFnBody f b
     | _ => pure ()
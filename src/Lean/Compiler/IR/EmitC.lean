@@ -10,12 +10,20 @@ import Lean.Compiler.ExportAttr
 import Lean.Compiler.InitAttr
 import Lean.Compiler.IR.CompilerM
 import Lean.Compiler.IR.EmitUtil
+import Lean.Compiler.IR.ExportWrapper
 import Lean.Compiler.IR.NormIds
 import Lean.Compiler.IR.SimpCase
 import Lean.Compiler.IR.Boxing
+import Lean.Compiler.IR.UnboxResult
 
 namespace Lean.IR.EmitC
 open ExplicitBoxing (requiresBoxedVersion mkBoxedName isBoxedName)
+open UnboxResult
+
+register_builtin_option compiler.lazyClosedTerms : Bool := {
+  defValue := false
+  descr    := "initialize extracted closed terms on first use instead of at module initialization"
+}
 
 def leanMainFn := "_lean_main"
 
@@ -25,6 +33,8 @@ structure Context where
   jpMap      : JPParamsMap := {}
   mainFn     : FunId := default
   mainParams : Array Param := #[]
+  lazyClosedTerms : Bool := false
+  unboxedVars : UnboxedVars := {}
 
 abbrev M := ReaderT Context (EStateM String String)
 
@@ -53,6 +63,17 @@ def argToCString (x : Arg) : String :=
 def emitArg (x : Arg) : M Unit :=
   emit (argToCString x)
 
+/-- Name of the C struct used for unboxed results with fields of the given types, see `UnboxResult.lean`. -/
+def toCStructName (tys : Array IRType) : String :=
+  tys.foldl (init := "lean_unboxed") fun s t => s ++ "_" ++ match t with
+    | IRType.float  => "f64"
+    | IRType.uint8  => "u8"
+    | IRType.uint16 => "u16"
+    | IRType.uint32 => "u32"
+    | IRType.uint64 => "u64"
+    | IRType.usize  => "usize"
+    | _             => "obj"
+
 def toCType : IRType → String
   | IRType.float      => "double"
   | IRType.uint8      => "uint8_t"
@@ -63,16 +84,27 @@ def toCType : IRType → String
   | IRType.object     => "lean_object*"
   | IRType.tobject    => "lean_object*"
   | IRType.irrelevant => "lean_object*"
-  | IRType.struct _ _ => panic! "not implemented yet"
+  | IRType.struct _ tys => "struct " ++ toCStructName tys
   | IRType.union _ _  => panic! "not implemented yet"
 
+/--
+Returns `true` if `d` is an extracted closed term that is initialized on first use.
+Closed terms are private to their module, so all accesses are emitted by `emitFullApp`. -/
+def isLazyClosedTerm (d : Decl) : M Bool := do
+  return (← read).lazyClosedTerms && d.params.isEmpty && d.resultType.isObj && isClosedTermName (← getEnv) d.name
+
 def throwInvalidExportName {α : Type} (n : Name) : M α :=
   throw s!"invalid export name '{n}'"
 
 def toCName (n : Name) : M String := do
-  let env ← getEnv;
+  let env ← getEnv
+  -- exported functions with a wrapper are emitted under their mangled name, and the wrapper under the export name,
+  -- see `ExportWrapper.lean`
+  let exportName? := match getExportNameFor? env n with
+    | some s => if hasExportWrapper env n then none else some s
+    | none   => getExportWrapperExportName? env n
   -- TODO: we should support simple export names only
-  match getExportNameFor? env n with
+  match exportName? with
   | some (.str .anonymous s) => pure s
   | some _                   => throwInvalidExportName n
   | none                     => if n == `main then pure leanMainFn else pure n.mangle
@@ -99,6 +131,10 @@ def shouldExport (n : Name) : Bool :=
 def emitFnDeclAux (decl : Decl) (cppBaseName : String) (isExternal : Bool) : M Unit := do
   let ps := decl.params
   let env ← getEnv
+  if (← isLazyClosedTerm decl) then
+    emitLn ("static lean_object* _init_" ++ cppBaseName ++ "(void);")
+    emitLn ("static _Atomic(lean_object*) " ++ cppBaseName ++ ";")
+    return
   if ps.isEmpty then
     if isClosedTermName env decl.name then emit "static "
     else if isExternal then emit "extern "
@@ -128,17 +164,32 @@ def emitExternDeclAux (decl : Decl) (cNameStr : String) : M Unit := do
   let extC := isExternC env decl.name
   emitFnDeclAux decl cNameStr extC
 
+/-- Emit the struct types and prototypes of the workers of `decls`, see `UnboxResult.lean`. -/
+def emitWorkerDecls (decls : List Decl) (modDecls : NameSet) : M Unit := do
+  let workers := decls.filterMap fun d => (d, ·) <$> getUnboxedResult? d
+  let mut structs : Array String := #[]
+  for (_, res) in workers do
+    let n := toCStructName res.types
+    unless structs.contains n do
+      structs := structs.push n
+      emit "struct "; emit n; emit " {"
+      res.types.size.forM fun i => do
+        emit " "; emit (toCType res.types[i]!); emit " f"; emit i; emit ";"
+      emitLn " };"
+  for (d, res) in workers do
+    emitFnDecl (mkWorkerDecl d res) (!modDecls.contains d.name)
+
 def emitFnDecls : M Unit := do
   let env ← getEnv
   let decls := getDecls env
   let modDecls  : NameSet := decls.foldl (fun s d => s.insert d.name) {}
   let usedDecls : NameSet := decls.foldl (fun s d => collectUsedDecls env d (s.insert d.name)) {}
-  let usedDecls := usedDecls.toList
-  usedDecls.forM fun n => do
-    let decl ← getDecl n;
+  let usedDecls ← usedDecls.toList.mapM getDecl
+  usedDecls.forM fun decl => do
     match getExternNameFor env `c decl.name with
     | some cName => emitExternDeclAux decl cName
-    | none       => emitFnDecl decl (!modDecls.contains n)
+    | none       => emitFnDecl decl (!modDecls.contains decl.name)
+  emitWorkerDecls usedDecls modDecls
 
 def emitMainFn : M Unit := do
   let d ← getDecl `main
@@ -262,10 +313,14 @@ def declareParams (ps : Array Param) : M Unit :=
 partial def declareVars : FnBody → Bool → M Bool
   | e@(FnBody.vdecl x t _ b), d => do
     let ctx ← read
-    if isTailCallTo ctx.mainFn e then
-      pure d
+    let vars := ctx.unboxedVars
+    if isTailCallTo ctx.mainFn e || vars.projVars.contains x || vars.boxVars.contains x then
+      declareVars b d
     else
-      declareVar x t; declareVars b true
+      match vars.structVars.find? x with
+      | some tys => declareVar x (IRType.struct none tys)
+      | none     => declareVar x t
+      declareVars b true
   | FnBody.jdecl _ xs _ b,    d => do declareParams xs; declareVars b (d || xs.size > 0)
   | e,                        d => if e.isTerminal then pure d else declareVars e.body d
 
@@ -428,9 +483,12 @@ def emitFullApp (z : VarId) (f : FunId) (ys : Array Arg) : M Unit := do
   match decl with
   | Decl.extern _ ps _ extData => emitExternCall f ps extData ys
   | _ =>
-    emitCName f
-    if ys.size > 0 then emit "("; emitArgs ys; emit ")"
-    emitLn ";"
+    if (← isLazyClosedTerm decl) then
+      emit "lean_lazy_get(&"; emitCName f; emit ", "; emitCInitName f; emitLn ");"
+    else
+      emitCName f
+      if ys.size > 0 then emit "("; emitArgs ys; emit ")"
+      emitLn ";"
 
 def emitPartialApp (z : VarId) (f : FunId) (ys : Array Arg) : M Unit := do
   let decl ← getDecl f
@@ -460,8 +518,9 @@ def emitBox (z : VarId) (x : VarId) (xType : IRType) : M Unit := do
 
 def emitUnbox (z : VarId) (t : IRType) (x : VarId) : M Unit := do
   emitLhs z
-  emit (getUnboxOpName t)
-  emit "("; emit x; emitLn ");"
+  match (← read).unboxedVars.projVars.find? x with
+  | some (r, i) => emit r; emit ".f"; emit i; emitLn ";"
+  | none        => emit (getUnboxOpName t); emit "("; emit x; emitLn ");"
 
 def emitIsShared (z : VarId) (x : VarId) : M Unit := do
   emitLhs z; emit "!lean_is_exclusive("; emit x; emitLn ");"
@@ -501,7 +560,25 @@ def emitLit (z : VarId) (t : IRType) (v : LitVal) : M Unit := do
   | LitVal.num v => emitNumLit t v; emitLn ";"
   | LitVal.str v => emit "lean_mk_string_from_bytes("; emit (quoteString v); emit ", "; emit v.utf8ByteSize; emitLn ");"
 
-def emitVDecl (z : VarId) (t : IRType) (v : Expr) : M Unit :=
+/-- Emit the declaration of a variable holding an unboxed result, see `UnboxResult.lean`. -/
+def emitUnboxedVDecl (z : VarId) (v : Expr) : M Unit := do
+  match v with
+  | Expr.ctor _ ys =>
+    let boxVars := (← read).unboxedVars.boxVars
+    ys.size.forM fun i => do
+      let some y := (match ys[i]! with | Arg.var b => boxVars.find? b | _ => none)
+        | throw "invalid unboxed result"
+      emit z; emit ".f"; emit i; emit " = "; emit y; emitLn ";"
+  | Expr.fap f ys =>
+    emitLhs z; emitCName (mkUnboxedName f); emit "("; emitArgs ys; emitLn ");"
+  | _ => throw "invalid unboxed result"
+
+def emitVDecl (z : VarId) (t : IRType) (v : Expr) : M Unit := do
+  let vars := (← read).unboxedVars
+  if vars.projVars.contains z || vars.boxVars.contains z then
+    return
+  if vars.structVars.contains z then
+    return (← emitUnboxedVDecl z v)
   match v with
   | Expr.ctor c ys      => emitCtor z c ys
   | Expr.reset n x      => emitReset z n x
@@ -517,6 +594,11 @@ def emitVDecl (z : VarId) (t : IRType) (v : Expr) : M Unit :=
   | Expr.isShared x     => emitIsShared z x
   | Expr.lit v          => emitLit z t v
 
+/-- Return true iff `x` is not materialized as an object because of unboxed results. -/
+def isUnboxedVar (x : VarId) : M Bool := do
+  let vars := (← read).unboxedVars
+  return vars.structVars.contains x || vars.projVars.contains x
+
 def isTailCall (x : VarId) (v : Expr) (b : FnBody) : M Bool := do
   let ctx ← read;
   match v, b with
@@ -606,10 +688,10 @@ partial def emitBlock (b : FnBody) : M Unit := do
       emitVDecl x t v
       emitBlock b
   | FnBody.inc x n c p b       =>
-    unless p do emitInc x n c
+    unless p || (← isUnboxedVar x) do emitInc x n c
     emitBlock b
   | FnBody.dec x n c p b       =>
-    unless p do emitDec x n c
+    unless p || (← isUnboxedVar x) do emitDec x n c
     emitBlock b
   | FnBody.del x b             => emitDel x; emitBlock b
   | FnBody.setTag x i b        => emitSetTag x i; emitBlock b
@@ -636,6 +718,47 @@ partial def emitFnBody (b : FnBody) : M Unit := do
 
 end
 
+def emitFnDef (f : FunId) (xs : Array Param) (t : IRType) (emitBody : M Unit) : M Unit := do
+  let baseName ← toCName f;
+  if xs.size == 0 then
+    emit "static "
+  else if shouldExport f then
+    emit "LEAN_EXPORT "  -- make symbol visible to the interpreter
+  emit (toCType t); emit " ";
+  if xs.size > 0 then
+    emit baseName;
+    emit "(";
+    if xs.size > closureMaxArgs && isBoxedName f then
+      emit "lean_object** _args"
+    else
+      xs.size.forM fun i => do
+        if i > 0 then emit ", "
+        let x := xs[i]!
+        emit (toCType x.ty); emit " "; emit x.x
+    emit ")"
+  else
+    emit ("_init_" ++ baseName ++ "()")
+  emitLn " {";
+  if xs.size > closureMaxArgs && isBoxedName f then
+    xs.size.forM fun i => do
+      let x := xs[i]!
+      emit "lean_object* "; emit x.x; emit " = _args["; emit i; emitLn "];"
+  emitLn "_start:";
+  emitBody
+  emitLn "}"
+
+/-- Emit the body of a function with a worker, which boxes the worker's result. -/
+def emitWorkerWrapperBody (f : FunId) (xs : Array Param) (res : UnboxedResult) : M Unit := do
+  emit (toCType (IRType.struct none res.types)); emit " _r = "; emitCName (mkUnboxedName f); emit "("
+  xs.size.forM fun i => do
+    if i > 0 then emit ", "
+    emit xs[i]!.x
+  emitLn ");"
+  emit "lean_object* _x = "; emitAllocCtor res.ctor
+  res.types.size.forM fun i => do
+    emit "lean_ctor_set(_x, "; emit i; emit ", "; emitBoxFn res.types[i]!; emit "(_r.f"; emit i; emitLn "));"
+  emitLn "return _x;"
+
 def emitDeclAux (d : Decl) : M Unit := do
   let env ← getEnv
   let (_, jpMap) := mkVarJPMaps d
@@ -643,33 +766,17 @@ def emitDeclAux (d : Decl) : M Unit := do
   unless hasInitAttr env d.name do
     match d with
     | .fdecl (f := f) (xs := xs) (type := t) (body := b) .. =>
-      let baseName ← toCName f;
-      if xs.size == 0 then
-        emit "static "
-      else if shouldExport f then
-        emit "LEAN_EXPORT "  -- make symbol visible to the interpreter
-      emit (toCType t); emit " ";
-      if xs.size > 0 then
-        emit baseName;
-        emit "(";
-        if xs.size > closureMaxArgs && isBoxedName d.name then
-          emit "lean_object** _args"
-        else
-          xs.size.forM fun i => do
-            if i > 0 then emit ", "
-            let x := xs[i]!
-            emit (toCType x.ty); emit " "; emit x.x
-        emit ")"
-      else
-        emit ("_init_" ++ baseName ++ "()")
-      emitLn " {";
-      if xs.size > closureMaxArgs && isBoxedName d.name then
-        xs.size.forM fun i => do
-          let x := xs[i]!
-          emit "lean_object* "; emit x.x; emit " = _args["; emit i; emitLn "];"
-      emitLn "_start:";
-      withReader (fun ctx => { ctx with mainFn := f, mainParams := xs }) (emitFnBody b);
-      emitLn "}"
+      let getResult? := fun g => (findEnvDecl env g).bind getUnboxedResult?
+      match analyzeWorker? d with
+      | some (res, vars) =>
+        let vars := collectUnboxedCalls getResult? b vars
+        emitFnDef (mkUnboxedName f) xs (IRType.struct none res.types) do
+          withReader (fun ctx => { ctx with mainFn := f, mainParams := xs, unboxedVars := vars }) (emitFnBody b)
+        emitFnDef f xs t (emitWorkerWrapperBody f xs res)
+      | none =>
+        let vars := collectUnboxedCalls getResult? b {}
+        emitFnDef f xs t do
+          withReader (fun ctx => { ctx with mainFn := f, mainParams := xs, unboxedVars := vars }) (emitFnBody b)
     | _ => pure ()
 
 def emitDecl (d : Decl) : M Unit := do
@@ -718,7 +825,8 @@ def emitDeclInit (d : Decl) : M Unit := do
       if getBuiltinInitFnNameFor? env d.name |>.isSome then
         emit "}"
     | _ =>
-      emitCName n; emit " = "; emitCInitName n; emitLn "();"; emitMarkPersistent d n
+      unless (← isLazyClosedTerm d) do
+        emitCName n; emit " = "; emitCInitName n; emitLn "();"; emitMarkPersistent d n
 
 def emitInitFn : M Unit := do
   let env ← getEnv
@@ -750,8 +858,9 @@ def main : M Unit := do
 end EmitC
 
 @[export lean_ir_emit_c]
-def emitC (env : Environment) (modName : Name) : Except String String :=
-  match (EmitC.main { env := env, modName := modName }).run "" with
+def emitC (env : Environment) (modName : Name) (opts : Options) : Except String String :=
+  let lazyClosedTerms := EmitC.compiler.lazyClosedTerms.get opts
+  match (EmitC.main { env, modName, lazyClosedTerms }).run "" with
   | EStateM.Result.ok    _   s => Except.ok s
   | EStateM.Result.error err _ => Except.error err
 
@@ -11,13 +11,16 @@ import Lean.Compiler.ExportAttr
 import Lean.Compiler.InitAttr
 import Lean.Compiler.IR.CompilerM
 import Lean.Compiler.IR.EmitUtil
+import Lean.Compiler.IR.ExportWrapper
 import Lean.Compiler.IR.NormIds
 import Lean.Compiler.IR.SimpCase
 import Lean.Compiler.IR.Boxing
 import Lean.Compiler.IR.ResetReuse
 import Lean.Compiler.IR.LLVMBindings
+import Lean.Compiler.IR.UnboxResult
 
 open Lean.IR.ExplicitBoxing (isBoxedName)
+open Lean.IR.UnboxResult
 
 namespace Lean.IR
 
@@ -63,6 +66,7 @@ structure Context (llvmctx : LLVM.Context) where
   mainFn     : FunId := default
   mainParams : Array Param := #[]
   llvmmodule : LLVM.Module llvmctx
+  unboxedVars : UnboxedVars := {}
 
 structure State (llvmctx : LLVM.Context) where
   var2val : HashMap VarId (LLVM.LLVMType llvmctx × LLVM.Value llvmctx)
@@ -312,7 +316,7 @@ def callLeanCtorSetTag (builder : LLVM.Builder llvmctx)
   let fnty ← LLVM.functionType retty argtys
   let _ ← LLVM.buildCall2 builder fnty fn  #[closure, i] retName
 
-def toLLVMType (t : IRType) : M llvmctx (LLVM.LLVMType llvmctx) := do
+partial def toLLVMType (t : IRType) : M llvmctx (LLVM.LLVMType llvmctx) := do
   match t with
   | IRType.float      => LLVM.doubleTypeInContext llvmctx
   | IRType.uint8      => LLVM.intTypeInContext llvmctx 8
@@ -324,14 +328,20 @@ def toLLVMType (t : IRType) : M llvmctx (LLVM.LLVMType llvmctx) := do
   | IRType.object     => do LLVM.pointerType (← LLVM.i8Type llvmctx)
   | IRType.tobject    => do LLVM.pointerType (← LLVM.i8Type llvmctx)
   | IRType.irrelevant => do LLVM.pointerType (← LLVM.i8Type llvmctx)
-  | IRType.struct _ _ => panic! "not implemented yet"
+  | IRType.struct _ tys => do LLVM.structTypeInContext llvmctx (← tys.mapM toLLVMType)
   | IRType.union _ _  => panic! "not implemented yet"
 
 def throwInvalidExportName {α : Type} (n : Name) : M llvmctx α := do
   throw s!"invalid export name {n.toString}"
 
 def toCName (n : Name) : M llvmctx String := do
-  match getExportNameFor? (← getEnv) n with
+  let env ← getEnv
+  -- exported functions with a wrapper are emitted under their mangled name, and the wrapper under the export name,
+  -- see `ExportWrapper.lean`
+  let exportName? := match getExportNameFor? env n with
+    | some s => if hasExportWrapper env n then none else some s
+    | none   => getExportWrapperExportName? env n
+  match exportName? with
   | some (.str .anonymous s) => pure s
   | some _                   => throwInvalidExportName n
   | none                     => if n == `main then pure leanMainFn else pure n.mangle
@@ -516,9 +526,9 @@ def emitExternDeclAux (decl : Decl) (cNameStr : String) : M llvmctx Unit := do
   let extC := isExternC env decl.name
   let _ ← emitFnDeclAux (← getLLVMModule) decl cNameStr extC
 
-def emitFnDecls : M llvmctx Unit := do
+/-- Emit prototypes for `decls` and all declarations they use. -/
+def emitFnDeclsFor (decls : List Decl) : M llvmctx Unit := do
   let env ← getEnv
-  let decls := getDecls env
   let modDecls  : NameSet := decls.foldl (fun s d => s.insert d.name) {}
   let usedDecls : NameSet := decls.foldl (fun s d => collectUsedDecls env d (s.insert d.name)) {}
   let usedDecls := usedDecls.toList
@@ -527,8 +537,13 @@ def emitFnDecls : M llvmctx Unit := do
     match getExternNameFor env `c decl.name with
     | some cName => emitExternDeclAux decl cName
     | none       => emitFnDecl decl (!modDecls.contains n)
+    if let some res := getUnboxedResult? decl then
+      emitFnDecl (mkWorkerDecl decl res) (!modDecls.contains n)
   return ()
 
+def emitFnDecls : M llvmctx Unit := do
+  emitFnDeclsFor (getDecls (← getEnv))
+
 def emitLhsSlot_ (x : VarId) : M llvmctx (LLVM.LLVMType llvmctx × LLVM.Value llvmctx) := do
   let state ← get
   match state.var2val.find? x with
@@ -674,6 +689,19 @@ def getFunIdTy (f : FunId) : M llvmctx (LLVM.LLVMType llvmctx) := do
   let argtys ← decl.params.mapM (fun p => do toLLVMType p.ty)
   LLVM.functionType retty argtys
 
+/-- The type of the worker of `f` returning `res` unboxed, see `UnboxResult.lean`. -/
+def getWorkerTy (f : FunId) (res : UnboxedResult) : M llvmctx (LLVM.LLVMType llvmctx) := do
+  let decl ← getDecl f
+  let retty ← toLLVMType (IRType.struct none res.types)
+  let argtys ← decl.params.mapM (fun p => do toLLVMType p.ty)
+  LLVM.functionType retty argtys
+
+/-- Call the worker of `f` returning `res` unboxed. -/
+def callWorker (builder : LLVM.Builder llvmctx) (f : FunId) (res : UnboxedResult) (ys : Array (LLVM.Value llvmctx)) : M llvmctx (LLVM.Value llvmctx) := do
+  let fnty ← getWorkerTy f res
+  let fv ← LLVM.getOrAddFunction (← getLLVMModule) (← toCName (mkUnboxedName f)) fnty
+  LLVM.buildCall2 builder fnty fv ys
+
 /--
 Create a function declaration and return a pointer to the function.
 If the function actually takes arguments, then we must have a function pointer in scope.
@@ -857,10 +885,12 @@ def emitIsShared (builder : LLVM.Builder llvmctx) (z : VarId) (x : VarId) : M ll
     let shared? ← LLVM.buildSext builder shared? (← LLVM.i8Type llvmctx)
     emitLhsSlotStore builder z shared?
 
-def emitBox (builder : LLVM.Builder llvmctx) (z : VarId) (x : VarId) (xType : IRType) : M llvmctx Unit := do
-  let xv ← emitLhsVal builder x
+def callBoxForType (builder : LLVM.Builder llvmctx)
+    (t : IRType)
+    (xv : LLVM.Value llvmctx)
+    (retName : String := "") : M llvmctx (LLVM.Value llvmctx) := do
   let (fnName, argTy, xv) ←
-    match xType with
+    match t with
     | IRType.usize  => pure ("lean_box_usize", ← LLVM.size_tType llvmctx, xv)
     | IRType.uint32 => pure ("lean_box_uint32", ← LLVM.i32Type llvmctx, xv)
     | IRType.uint64 => pure ("lean_box_uint64", ← LLVM.size_tType llvmctx, xv)
@@ -873,7 +903,10 @@ def emitBox (builder : LLVM.Builder llvmctx) (z : VarId) (x : VarId) (xType : IR
   let argtys := #[argTy]
   let fn ← getOrCreateFunctionPrototype (← getLLVMModule) retty fnName argtys
   let fnty ← LLVM.functionType retty argtys
-  let zv ← LLVM.buildCall2 builder fnty fn  #[xv]
+  LLVM.buildCall2 builder fnty fn #[xv] retName
+
+def emitBox (builder : LLVM.Builder llvmctx) (z : VarId) (x : VarId) (xType : IRType) : M llvmctx Unit := do
+  let zv ← callBoxForType builder xType (← emitLhsVal builder x)
   emitLhsSlotStore builder z zv
 
 def IRType.isIntegerType (t : IRType) : Bool :=
@@ -905,6 +938,9 @@ def callUnboxForType (builder : LLVM.Builder llvmctx)
 
 def emitUnbox (builder : LLVM.Builder llvmctx)
     (z : VarId) (t : IRType) (x : VarId) (retName : String := "") : M llvmctx Unit := do
+  if let some (r, i) := (← read).unboxedVars.projVars.find? x then
+    let zval ← LLVM.buildExtractValue builder (← emitLhsVal builder r) (UInt64.ofNat i) retName
+    return (← emitLhsSlotStore builder z zval)
   let zval ← callUnboxForType builder t (← emitLhsVal builder x) retName
   -- NOTE(bollu) : note that lean_unbox only returns an i64, but we may need to truncate to
   -- smaller widths. see `phashmap` for an example of this occurring at calls to `lean_unbox`
@@ -955,7 +991,30 @@ def emitReuse (builder : LLVM.Builder llvmctx)
    )
   emitCtorSetArgs builder z ys
 
+/-- Emit the declaration of a variable holding an unboxed result, see `UnboxResult.lean`. -/
+def emitUnboxedVDecl (builder : LLVM.Builder llvmctx) (z : VarId) (v : Expr) : M llvmctx Unit := do
+  match v with
+  | Expr.ctor _ ys =>
+    let boxVars := (← read).unboxedVars.boxVars
+    let (zty, _) ← emitLhsSlot_ z
+    let mut zv ← LLVM.getUndef zty
+    for i in [:ys.size] do
+      let some y := (match ys[i]! with | Arg.var b => boxVars.find? b | _ => none)
+        | throw "invalid unboxed result"
+      zv ← LLVM.buildInsertValue builder zv (← emitLhsVal builder y) (UInt64.ofNat i)
+    emitLhsSlotStore builder z zv
+  | Expr.fap f ys =>
+    let some res := getUnboxedResult? (← getDecl f) | throw s!"missing worker of '{f}'"
+    let ys ← ys.mapM (fun y => Prod.snd <$> emitArgVal builder y)
+    emitLhsSlotStore builder z (← callWorker builder f res ys)
+  | _ => throw "invalid unboxed result"
+
 def emitVDecl (builder : LLVM.Builder llvmctx) (z : VarId) (t : IRType) (v : Expr) : M llvmctx Unit := do
+  let vars := (← read).unboxedVars
+  if vars.projVars.contains z || vars.boxVars.contains z then
+    return
+  if vars.structVars.contains z then
+    return (← emitUnboxedVDecl builder z v)
   match v with
   | Expr.ctor c ys      => emitCtor builder z c ys
   | Expr.reset n x      => emitReset builder z n x
@@ -979,7 +1038,11 @@ def declareVar (builder : LLVM.Builder llvmctx) (x : VarId) (t : IRType) : M llv
 partial def declareVars (builder : LLVM.Builder llvmctx) (f : FnBody) : M llvmctx Unit := do
   match f with
   | FnBody.vdecl x t _ b => do
-      declareVar builder x t
+      let vars := (← read).unboxedVars
+      unless vars.projVars.contains x || vars.boxVars.contains x do
+        match vars.structVars.find? x with
+        | some tys => declareVar builder x (IRType.struct none tys)
+        | none     => declareVar builder x t
       declareVars builder b
   | FnBody.jdecl _ xs _ b => do
       for param in xs do declareVar builder param.x param.ty
@@ -987,6 +1050,11 @@ partial def declareVars (builder : LLVM.Builder llvmctx) (f : FnBody) : M llvmct
   | e => do
       if e.isTerminal then pure () else declareVars builder e.body
 
+/-- Return true iff `x` is not materialized as an object because of unboxed results. -/
+def isUnboxedVar (x : VarId) : M llvmctx Bool := do
+  let vars := (← read).unboxedVars
+  return vars.structVars.contains x || vars.projVars.contains x
+
 def emitTag (builder : LLVM.Builder llvmctx) (x : VarId) (xType : IRType) : M llvmctx (LLVM.Value llvmctx) := do
   if xType.isObj then do
     let xval ← emitLhsVal builder x
@@ -1020,7 +1088,11 @@ def emitTailCall (builder : LLVM.Builder llvmctx) (f : FunId) (v : Expr) : M llv
     unless ps.size == ys.size do throw s!"Invalid tail call. f:'{f}' v:'{v}'"
     let args ← ys.mapM (fun y => Prod.snd <$> emitArgVal builder y)
     let fn ← builderGetInsertionFn builder
-    let call ← LLVM.buildCall2 builder (← getFunIdTy f) fn args
+    -- a function with a worker only contains tail calls to itself in the body of the worker
+    let fnty ← match getUnboxedResult? (← getDecl f) with
+      | some res => getWorkerTy f res
+      | none     => getFunIdTy f
+    let call ← LLVM.buildCall2 builder fnty fn args
     -- TODO (bollu) : add 'musttail' attribute using the C API.
     LLVM.setTailCall call true -- mark as tail call
     let _ ← LLVM.buildRet builder call
@@ -1141,10 +1213,10 @@ partial def emitBlock (builder : LLVM.Builder llvmctx) (b : FnBody) : M llvmctx
       emitVDecl builder x t v
       emitBlock builder b
   | FnBody.inc x n c p b       =>
-    unless p do emitInc builder x n c
+    unless p || (← isUnboxedVar x) do emitInc builder x n c
     emitBlock builder b
   | FnBody.dec x n c p b       =>
-    unless p do emitDec builder x n c
+    unless p || (← isUnboxedVar x) do emitDec builder x n c
     emitBlock builder b
   | FnBody.del x b             =>  emitDel builder x; emitBlock builder b
   | FnBody.setTag x i b        =>  emitSetTag builder x i; emitBlock builder b
@@ -1191,6 +1263,44 @@ def emitFnArgs (builder : LLVM.Builder llvmctx)
         let _ ← LLVM.buildStore builder arg alloca
         addVartoState params[i]!.x alloca llvmty
 
+def emitFnDef (mod : LLVM.Module llvmctx) (builder : LLVM.Builder llvmctx)
+    (f : FunId) (baseName : String) (xs : Array Param) (t : IRType) (emitBody : M llvmctx Unit) : M llvmctx Unit := do
+  let name := if xs.size > 0 then baseName else "_init_" ++ baseName
+  let retty ← toLLVMType t
+  let mut argtys := #[]
+  let needsPackedArgs? := xs.size > closureMaxArgs && isBoxedName f
+  if needsPackedArgs? then
+      argtys := #[← LLVM.pointerType (← LLVM.voidPtrType llvmctx)]
+  else
+    for x in xs do
+      argtys := argtys.push (← toLLVMType x.ty)
+  let fnty ← LLVM.functionType retty argtys (isVarArg := false)
+  let llvmfn ← LLVM.getOrAddFunction mod name fnty
+  -- set linkage and visibility
+  -- TODO: consider refactoring these into a separate concept (e.g. 'setLinkageAndVisibility')
+  --       Find the spots where this refactor needs to happen by grepping for 'LEAN_EXPORT'
+  --       in the C backend
+  if xs.size == 0 then
+    LLVM.setVisibility llvmfn LLVM.Visibility.hidden -- "static "
+  else
+    LLVM.setDLLStorageClass llvmfn LLVM.DLLStorageClass.export  -- LEAN_EXPORT: make symbol visible to the interpreter
+  withReader (fun llvmctx => { llvmctx with mainFn := f, mainParams := xs }) do
+    set { var2val := default, jp2bb := default : EmitLLVM.State llvmctx } -- flush variable map
+    let bb ← LLVM.appendBasicBlockInContext llvmctx llvmfn "entry"
+    LLVM.positionBuilderAtEnd builder bb
+    emitFnArgs builder needsPackedArgs? llvmfn xs
+    emitBody
+
+/-- Emit the body of a function with a worker, which boxes the worker's result. -/
+def emitWorkerWrapperBody (builder : LLVM.Builder llvmctx) (f : FunId) (xs : Array Param) (res : UnboxedResult) : M llvmctx Unit := do
+  let args ← xs.mapM (fun x => emitLhsVal builder x.x)
+  let r ← callWorker builder f res args
+  let o ← emitAllocCtor builder res.ctor
+  for i in [:res.types.size] do
+    let v ← LLVM.buildExtractValue builder r (UInt64.ofNat i)
+    callLeanCtorSet builder o (← constIntUnsigned i) (← callBoxForType builder res.types[i]! v)
+  let _ ← LLVM.buildRet builder o
+
 def emitDeclAux (mod : LLVM.Module llvmctx) (builder : LLVM.Builder llvmctx) (d : Decl) : M llvmctx Unit := do
   let env ← getEnv
   let (_, jpMap) := mkVarJPMaps d
@@ -1198,33 +1308,17 @@ def emitDeclAux (mod : LLVM.Module llvmctx) (builder : LLVM.Builder llvmctx) (d
   unless hasInitAttr env d.name do
     match d with
     | .fdecl (f := f) (xs := xs) (type := t) (body := b) .. =>
-      let baseName ← toCName f
-      let name := if xs.size > 0 then baseName else "_init_" ++ baseName
-      let retty ← toLLVMType t
-      let mut argtys := #[]
-      let needsPackedArgs? := xs.size > closureMaxArgs && isBoxedName d.name
-      if needsPackedArgs? then
-          argtys := #[← LLVM.pointerType (← LLVM.voidPtrType llvmctx)]
-      else
-        for x in xs do
-          argtys := argtys.push (← toLLVMType x.ty)
-      let fnty ← LLVM.functionType retty argtys (isVarArg := false)
-      let llvmfn ← LLVM.getOrAddFunction mod name fnty
-      -- set linkage and visibility
-      -- TODO: consider refactoring these into a separate concept (e.g. 'setLinkageAndVisibility')
-      --       Find the spots where this refactor needs to happen by grepping for 'LEAN_EXPORT'
-      --       in the C backend
-      if xs.size == 0 then
-        LLVM.setVisibility llvmfn LLVM.Visibility.hidden -- "static "
-      else
-        LLVM.setDLLStorageClass llvmfn LLVM.DLLStorageClass.export  -- LEAN_EXPORT: make symbol visible to the interpreter
-      withReader (fun llvmctx => { llvmctx with mainFn := f, mainParams := xs }) do
-        set { var2val := default, jp2bb := default : EmitLLVM.State llvmctx } -- flush variable map
-        let bb ← LLVM.appendBasicBlockInContext llvmctx llvmfn "entry"
-        LLVM.positionBuilderAtEnd builder bb
-        emitFnArgs builder needsPackedArgs? llvmfn xs
-        emitFnBody builder b
-      pure ()
+      let getResult? := fun g => (findEnvDecl env g).bind getUnboxedResult?
+      match analyzeWorker? d with
+      | some (res, vars) =>
+        let vars := collectUnboxedCalls getResult? b vars
+        emitFnDef mod builder f (← toCName (mkUnboxedName f)) xs (IRType.struct none res.types) do
+          withReader (fun llvmctx => { llvmctx with unboxedVars := vars }) (emitFnBody builder b)
+        emitFnDef mod builder f (← toCName f) xs t (emitWorkerWrapperBody builder f xs res)
+      | none =>
+        let vars := collectUnboxedCalls getResult? b {}
+        emitFnDef mod builder f (← toCName f) xs t do
+          withReader (fun llvmctx => { llvmctx with unboxedVars := vars }) (emitFnBody builder b)
     | _ => pure ()
 
 def emitDecl (mod : LLVM.Module llvmctx) (builder : LLVM.Builder llvmctx) (d : Decl) : M llvmctx Unit := do
@@ -1574,6 +1668,12 @@ def main : M llvmctx Unit := do
   emitFns (← getLLVMModule) builder
   emitInitFn (← getLLVMModule) builder
   emitMainFnIfNeeded (← getLLVMModule) builder
+
+/-- Emit the given function declarations without any module initialization code, see `emitLLVMForJIT`. -/
+def emitJITFns (decls : Array Decl) : M llvmctx Unit := do
+  emitFnDeclsFor decls.toList
+  let builder ← LLVM.createBuilderInContext llvmctx
+  decls.forM (emitDecl (← getLLVMModule) builder)
 end EmitLLVM
 
 def getLeanHBcPath : IO System.FilePath := do
@@ -1593,6 +1693,33 @@ partial def getModuleFunctions (mod : LLVM.Module llvmctx) : IO (Array (LLVM.Val
     else go (← LLVM.getNextFunction v) (acc.push v)
   go (← LLVM.getFirstFunction mod) #[]
 
+/-- Link the runtime functions of `lean.h` into `mod` as internal definitions. -/
+def linkRuntime (mod : LLVM.Module llvmctx) : IO Unit := do
+  let membuf ← LLVM.createMemoryBufferWithContentsOfFile (← getLeanHBcPath).toString
+  let modruntime ← LLVM.parseBitcode llvmctx membuf
+  /- It is important that we extract the names here because
+     pointers into modruntime get invalidated by linkModules -/
+  let runtimeGlobals ← (← getModuleGlobals modruntime).mapM (·.getName)
+  let filter func := do
+    -- | Do not insert internal linkage for
+    -- intrinsics such as `@llvm.umul.with.overflow.i64` which clang generates, and also
+    -- for declarations such as `lean_inc_ref_cold` which are externally defined.
+    if (← LLVM.isDeclaration func) then
+      return none
+    else
+      return some (← func.getName)
+  let runtimeFunctions ← (← getModuleFunctions modruntime).filterMapM filter
+  LLVM.linkModules (dest := mod) (src := modruntime)
+  -- Mark every global and function as having internal linkage.
+  for name in runtimeGlobals do
+    let some global ← LLVM.getNamedGlobal mod name
+       | throw <| IO.Error.userError s!"ERROR: linked module must have global from runtime module: '{name}'"
+    LLVM.setLinkage global LLVM.Linkage.internal
+  for name in runtimeFunctions do
+    let some fn ← LLVM.getNamedFunction mod name
+       | throw <| IO.Error.userError s!"ERROR: linked module must have function from runtime module: '{name}'"
+    LLVM.setLinkage fn LLVM.Linkage.internal
+
 /--
 `emitLLVM` is the entrypoint for the lean shell to code generate LLVM.
 -/
@@ -1606,33 +1733,59 @@ def emitLLVM (env : Environment) (modName : Name) (filepath : String) : IO Unit
   let out? ← ((EmitLLVM.main (llvmctx := llvmctx)).run initState).run emitLLVMCtx
   match out? with
   | .ok _ => do
-         let membuf ← LLVM.createMemoryBufferWithContentsOfFile (← getLeanHBcPath).toString
-         let modruntime ← LLVM.parseBitcode llvmctx membuf
-         /- It is important that we extract the names here because
-            pointers into modruntime get invalidated by linkModules -/
-         let runtimeGlobals ← (← getModuleGlobals modruntime).mapM (·.getName)
-         let filter func := do
-           -- | Do not insert internal linkage for
-           -- intrinsics such as `@llvm.umul.with.overflow.i64` which clang generates, and also
-           -- for declarations such as `lean_inc_ref_cold` which are externally defined.
-           if (← LLVM.isDeclaration func) then
-             return none
-           else
-             return some (← func.getName)
-         let runtimeFunctions ← (← getModuleFunctions modruntime).filterMapM filter
-         LLVM.linkModules (dest := emitLLVMCtx.llvmmodule) (src := modruntime)
-         -- Mark every global and function as having internal linkage.
-         for name in runtimeGlobals do
-           let some global ← LLVM.getNamedGlobal emitLLVMCtx.llvmmodule name
-              | throw <| IO.Error.userError s!"ERROR: linked module must have global from runtime module: '{name}'"
-           LLVM.setLinkage global LLVM.Linkage.internal
-         for name in runtimeFunctions do
-           let some fn ← LLVM.getNamedFunction emitLLVMCtx.llvmmodule name
-              | throw <| IO.Error.userError s!"ERROR: linked module must have function from runtime module: '{name}'"
-           LLVM.setLinkage fn LLVM.Linkage.internal
+         linkRuntime emitLLVMCtx.llvmmodule
          if let some err ← LLVM.verifyModule emitLLVMCtx.llvmmodule then
            throw <| .userError err
          LLVM.writeBitcodeToFile emitLLVMCtx.llvmmodule filepath
          LLVM.disposeModule emitLLVMCtx.llvmmodule
   | .error err => throw (IO.Error.userError err)
+
+/--
+Emit `fn`, its boxed version, and all functions of the current module they transitively use into a fresh module of
+`llvmctx`. This is used by the interpreter to compile hot functions at run time. Returns `none` if the functions
+depend on values that are only set up by module initialization, i.e. constants or `[init]` declarations of the
+current module, which are never executed for JIT-compiled code.
+-/
+@[export lean_ir_emit_llvm_jit]
+def emitLLVMForJIT (env : Environment) (fn : Name) (llvmctx : LLVM.Context) : IO (Option (LLVM.Module llvmctx)) := do
+  let modDecls : NameMap Decl := (getDecls env).foldl (fun m d => m.insert d.name d) {}
+  let mut todo := #[fn, ExplicitBoxing.mkBoxedName fn]
+  let mut visited : NameSet := {}
+  let mut decls := #[]
+  while !todo.isEmpty do
+    let n := todo.back
+    todo := todo.pop
+    if visited.contains n then continue
+    visited := visited.insert n
+    -- declarations of imported modules are resolved to their native code
+    let some decl := modDecls.find? n | continue
+    if let .fdecl (xs := xs) .. := decl then
+      if xs.isEmpty || hasInitAttr env n then
+        return none
+      decls := decls.push decl
+      todo := todo ++ (collectUsedDecls env decl).toList
+  let module ← LLVM.createModule llvmctx fn.toString
+  let emitLLVMCtx : EmitLLVM.Context llvmctx := {env := env, modName := env.mainModule, llvmmodule := module}
+  let initState := { var2val := default, jp2bb := default : EmitLLVM.State llvmctx}
+  match (← ((EmitLLVM.emitJITFns decls).run initState).run emitLLVMCtx) with
+  | .ok _ =>
+    linkRuntime module
+    if let some err ← LLVM.verifyModule module then
+      LLVM.disposeModule module
+      throw <| .userError err
+    return some module
+  | .error err =>
+    LLVM.disposeModule module
+    throw (IO.Error.userError err)
+
+/-- Returns whether the interpreter can compile hot functions using `emitLLVMForJIT` (option `interpreter.jit`),
+which requires Lean to be built with LLVM support. -/
+@[extern "lean_ir_jit_is_available"]
+opaque isJitAvailable : BaseIO Bool
+
+/-- Returns whether the function `fn` of the current module has been compiled by the interpreter's JIT in this
+process. -/
+@[extern "lean_ir_jit_is_compiled"]
+opaque isJitCompiled (fn : @& Name) : BaseIO Bool
+
 end Lean.IR
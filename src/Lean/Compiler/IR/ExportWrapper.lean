@@ -0,0 +1,62 @@
+/-
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Compiler.ExportAttr
+import Lean.Compiler.IR.CompilerM
+import Lean.Compiler.IR.FreeVars
+
+namespace Lean.IR
+/-!
+Wrappers for functions marked as `export`.
+
+The C code calling an exported function (e.g. the C++ parts of Lean) relies on the signature in its declaration:
+all parameters are owned unless annotated with `@&`. In order to still perform borrow inference for these functions,
+and to allow callers in other modules to benefit from the inferred annotations stored with their IR declarations,
+the function itself is compiled under its mangled name, and a wrapper `f._export` with the declared signature is
+emitted under the export name. The wrapper only calls `f`; the necessary `inc`/`dec` instructions are added by
+`ExplicitRC`.
+-/
+
+def mkExportWrapperName (n : Name) : Name :=
+  Name.mkStr n "_export"
+
+/-- Return `true` if `decl` is compiled together with an export wrapper. `main` is called by the C `main` function
+   and keeps its declared signature. -/
+def needsExportWrapper (env : Environment) (decl : Decl) : Bool :=
+  match decl, getExportNameFor? env decl.name with
+  | .fdecl (xs := xs) .., some n => !xs.isEmpty && n != `main && decl.name != `main
+  | _, _                         => false
+
+def hasExportWrapper (env : Environment) (n : Name) : Bool :=
+  (findEnvDecl env (mkExportWrapperName n)).isSome
+
+/-- If `n` is the name of the export wrapper of a function, return the export name of that function. -/
+def getExportWrapperExportName? (env : Environment) (n : Name) : Option Name := do
+  let .str f "_export" := n | none
+  let decl ← findEnvDecl env f
+  guard (needsExportWrapper env decl)
+  getExportNameFor? env f
+
+/-- Create the export wrapper for `decl` using the parameters `ps` it was declared with. -/
+def mkExportWrapper (decl : Decl) (ps : Array Param) : Decl :=
+  let r : VarId := { idx := decl.maxIndex + 1 }
+  let ys := ps.map (Arg.var ·.x)
+  let body := FnBody.vdecl r decl.resultType (Expr.fap decl.name ys) (FnBody.ret (Arg.var r))
+  Decl.fdecl (mkExportWrapperName decl.name) ps decl.resultType body decl.getInfo
+
+/-- Add export wrappers for the declarations in `decls` that need one. `origDecls` are the declarations before borrow
+   inference. -/
+def addExportWrappers (origDecls decls : Array Decl) : CompilerM (Array Decl) := do
+  let env ← getEnv
+  let wrappers := origDecls.foldl (init := #[]) fun wrappers orig =>
+    if needsExportWrapper env orig then
+      match decls.find? (·.name == orig.name) with
+      | some decl => wrappers.push (mkExportWrapper decl orig.params)
+      | none      => wrappers
+    else
+      wrappers
+  return decls ++ wrappers
+
+end Lean.IR
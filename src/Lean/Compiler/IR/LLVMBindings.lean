@@ -165,6 +165,9 @@ opaque pointerType (elemty : LLVMType ctx) : BaseIO (LLVMType ctx)
 @[extern "lean_llvm_array_type"]
 opaque arrayType (elemty : LLVMType ctx) (nelem : UInt64) : BaseIO (LLVMType ctx)
 
+@[extern "lean_llvm_struct_type_in_context"]
+opaque structTypeInContext (ctx : Context) (elemtys : @&Array (LLVMType ctx)) (packed : Bool := false) : BaseIO (LLVMType ctx)
+
 @[extern "lean_llvm_const_array"]
 opaque constArray (elemty : LLVMType ctx) (vals : @&Array (Value ctx)) : BaseIO (LLVMType ctx)
 
@@ -232,6 +235,12 @@ opaque buildGEP2 (builder : Builder ctx) (ty: LLVMType ctx) (base : Value ctx) (
 @[extern "lean_llvm_build_inbounds_gep2"]
 opaque buildInBoundsGEP2 (builder : Builder ctx) (ty: LLVMType ctx) (base : Value ctx) (ixs : @&Array (Value ctx)) (name : @&String := "") : BaseIO (Value ctx)
 
+@[extern "lean_llvm_build_extract_value"]
+opaque buildExtractValue (builder : Builder ctx) (agg : Value ctx) (idx : UInt64) (name : @&String := "") : BaseIO (Value ctx)
+
+@[extern "lean_llvm_build_insert_value"]
+opaque buildInsertValue (builder : Builder ctx) (agg : Value ctx) (val : Value ctx) (idx : UInt64) (name : @&String := "") : BaseIO (Value ctx)
+
 @[extern "lean_llvm_build_sext"]
 opaque buildSext (builder : Builder ctx) (val : Value ctx) (destTy : LLVMType ctx) (name : @&String := "") : BaseIO (Value ctx)
 
@@ -149,8 +149,9 @@ private def addDecForDeadParams (ctx : Context) (ps : Array Param) (b : FnBody)
   ps.foldl (init := b) fun b p =>
     if !p.borrow && p.ty.isObj && !bLiveVars.contains p.x then addDec ctx p.x b else b
 
-private def isPersistent : Expr → Bool
-  | Expr.fap _ xs => xs.isEmpty -- all global constants are persistent objects
+private def isPersistent (ctx : Context) : Expr → Bool
+  | Expr.fap f xs => xs.isEmpty && (getDecl ctx f matches .fdecl ..) -- all global constants are persistent objects
+  | Expr.proj _ x => (getVarInfo ctx x).persistent -- `lean_mark_persistent` also marks all objects reachable from `x`
   | _             => false
 
 /-- We do not need to consume the projection of a variable that is not consumed -/
@@ -166,13 +167,16 @@ private def isScalarBoxedInTaggedPtr (v : Expr) : Bool :=
   match v with
   | Expr.ctor c _           => c.size == 0 && c.ssize == 0 && c.usize == 0
   | Expr.lit (LitVal.num n) => n ≤ maxSmallNat
+  -- `lean_box_uint32` only uses a tagged pointer on 64-bit platforms
+  | Expr.box IRType.uint8 _
+  | Expr.box IRType.uint16 _ => true
   | _ => false
 
 private def updateVarInfo (ctx : Context) (x : VarId) (t : IRType) (v : Expr) : Context :=
   { ctx with
     varMap := ctx.varMap.insert x {
         ref := t.isObj && !isScalarBoxedInTaggedPtr v,
-        persistent := isPersistent v,
+        persistent := isPersistent ctx v,
         consume := consumeExpr ctx.varMap v
     }
   }
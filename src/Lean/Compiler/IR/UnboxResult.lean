@@ -5,7 +5,9 @@ Authors: Leonardo de Moura
 -/
 prelude
 import Lean.Data.Format
+import Lean.Data.HashMap
 import Lean.Compiler.IR.Basic
+import Lean.Compiler.IR.FreeVars
 
 namespace Lean.IR.UnboxResult
 
@@ -21,4 +23,174 @@ builtin_initialize unboxAttr : TagAttribute ←
 def hasUnboxAttr (env : Environment) (n : Name) : Bool :=
 unboxAttr.hasTag env n
 
+/-!
+Multi-value returns. The backends compile a function `f` whose every `ret` returns a fresh constructor whose fields
+are all boxed scalars of a layout accepted by `hasPortableLayout`, e.g. `(a, b) : UInt64 × UInt64` or
+`(x, y) : Float × Float`, into a worker `f._unboxed`
+returning the unboxed fields as a struct (`IRType.struct`), and a wrapper `f` that boxes the worker's result. The
+wrapper is used by closures, the interpreter, and all callers that need the constructor object. Callers that only
+project and unbox the fields of the result call the worker instead, avoiding all allocations.
+
+The analysis runs on the final IR stored in the environment, so that callers in other modules come to the same
+conclusion about the existence of a worker as the module defining `f`.
+-/
+
+def mkUnboxedName (n : Name) : Name :=
+  Name.mkStr n "_unboxed"
+
+/-- The result of a function with a worker: the returned constructor and the types of its boxed scalar fields. -/
+structure UnboxedResult where
+  ctor  : CtorInfo
+  types : Array IRType
+
+/-- Variables whose code differs from the IR in a function body that uses unboxed results. -/
+structure UnboxedVars where
+  /-- Variables holding unboxed results, i.e. structs, with their field types. These are the results of worker
+  calls and, inside a worker, the returned constructors. -/
+  structVars : HashMap VarId (Array IRType) := {}
+  /-- Projections `let p := proj[i] r` of struct variables `r`, which are not materialized. -/
+  projVars   : HashMap VarId (VarId × Nat) := {}
+  /-- Boxed fields `let b := box z` of constructors returned by a worker, which are not materialized. -/
+  boxVars    : HashMap VarId VarId := {}
+
+private inductive Ret where
+  | ctor (x : VarId) (r : UnboxedResult) (boxVars : Array (VarId × VarId))
+  | selfCall (x : VarId)
+
+/-- Return the index of the instruction declaring `x` in `bs`. -/
+private def findVDecl? (bs : Array FnBody) (x : VarId) : Option Nat :=
+  bs.findIdx? fun
+    | .vdecl y .. => y == x
+    | _           => false
+
+/-- Return true iff `x` occurs in no instruction of `bs` except for the ones at `is`. -/
+private def onlyUsedAt (bs : Array FnBody) (x : VarId) (is : List Nat) : Bool :=
+  bs.size.all fun i => is.contains i || !bs[i]!.hasFreeVar x
+
+/-- Check that `ret x` at the end of block `bs` returns a constructor of boxed scalars used nowhere else, or the
+result of a tail call of `f` itself. -/
+private def checkRet? (f : FunId) (bs : Array FnBody) (x : VarId) : Option Ret := do
+  let i ← findVDecl? bs x
+  guard (onlyUsedAt bs x [i])
+  match bs[i]! with
+  | .vdecl _ _ (.fap g _) _ =>
+    guard (g == f)
+    return .selfCall x
+  | .vdecl _ _ (.ctor c ys) _ =>
+    guard (c.size > 0 && c.usize == 0 && c.ssize == 0 && ys.size == c.size)
+    let mut types := #[]
+    let mut boxVars := #[]
+    for y in ys do
+      let .var b := y | none
+      guard (!boxVars.any (·.1 == b))
+      let j ← findVDecl? bs b
+      let .vdecl _ _ (.box t z) _ := bs[j]! | none
+      guard (t.isScalar && onlyUsedAt bs b [i, j])
+      types := types.push t
+      boxVars := boxVars.push (b, z)
+    return .ctor x { ctor := c, types } boxVars
+  | _ => none
+
+private partial def collectRets? (f : FunId) (b : FnBody) (rs : Array Ret) : Option (Array Ret) := do
+  let (bs, term) := b.flatten
+  let mut rs := rs
+  for instr in bs do
+    if let .jdecl _ _ v _ := instr then
+      rs ← collectRets? f v rs
+  match term with
+  | .ret (.var x)     => return rs.push (← checkRet? f bs x)
+  | .case _ _ _ alts  => alts.foldlM (fun rs alt => collectRets? f alt.body rs) rs
+  | .jmp .. | .unreachable => return rs
+  | _                 => none
+
+/--
+Return true iff a struct with fields of the given types is returned in the same registers by C functions and by LLVM
+functions returning a first-class struct value, so that modules compiled by different backends can call each other's
+workers. For larger or mixed structs, the C ABI packs several fields into one register (e.g. `{i32, i32}` into `rax`
+on x86-64) or returns them in memory, while LLVM returns each field in a separate register. We only accept one or
+two fields that are all `UInt64` or all `Float` on 64-bit platforms other than Windows, whose C ABI returns even
+such structs in memory (16 bytes) or in an integer register (a single `Float`).
+-/
+def hasPortableLayout (types : Array IRType) : Bool :=
+  System.Platform.numBits == 64 && !System.Platform.isWindows &&
+  0 < types.size && types.size ≤ 2 &&
+  (types.all (· == IRType.uint64) || types.all (· == IRType.float))
+
+/-- If `decl` has a worker returning its result unboxed, return the result and the variables of its body that hold
+or make up the unboxed result. -/
+def analyzeWorker? (decl : Decl) : Option (UnboxedResult × UnboxedVars) := do
+  let .fdecl f xs t b _ := decl | none
+  guard (!xs.isEmpty && t.isObj)
+  let rets ← collectRets? f b #[]
+  let mut res? : Option UnboxedResult := none
+  for ret in rets do
+    if let .ctor _ r _ := ret then
+      if let some res := res? then
+        guard (res.ctor == r.ctor && res.types == r.types)
+      res? := some r
+  let res ← res?
+  guard (hasPortableLayout res.types)
+  let vars := rets.foldl (init := {}) fun (vars : UnboxedVars) ret => match ret with
+    | .ctor x _ bs   => { vars with
+      structVars := vars.structVars.insert x res.types
+      boxVars    := bs.foldl (fun m (b, z) => m.insert b z) vars.boxVars }
+    | .selfCall x    => { vars with structVars := vars.structVars.insert x res.types }
+  return (res, vars)
+
+/-- If `decl` has a worker, return its unboxed result. -/
+def getUnboxedResult? (decl : Decl) : Option UnboxedResult :=
+  (analyzeWorker? decl).map (·.1)
+
+/-- The declaration of the worker of `decl`, which has the body of `decl` but returns an unboxed result. -/
+def mkWorkerDecl (decl : Decl) (res : UnboxedResult) : Decl :=
+  match decl with
+  | .fdecl f xs _ b info => .fdecl (mkUnboxedName f) xs (.struct none res.types) b info
+  | decl                 => decl
+
+/-- If `x` is used only by `let p := proj[i] x` and `dec x` in `b`, return the projections. -/
+private partial def collectProjs? (x : VarId) (b : FnBody) (ps : Array (VarId × Nat)) : Option (Array (VarId × Nat)) :=
+  match b with
+  | .vdecl p _ (.proj i y) b => if y == x then collectProjs? x b (ps.push (p, i)) else collectProjs? x b ps
+  | .dec _ _ _ _ b           => collectProjs? x b ps
+  | .jdecl _ _ v b           => do collectProjs? x b (← collectProjs? x v ps)
+  | .case _ y _ alts         => do guard (y != x); alts.foldlM (fun ps alt => collectProjs? x alt.body ps) ps
+  | b =>
+    if b.isTerminal then
+      if b.hasFreeVar x then none else some ps
+    else if b.resetBody.hasFreeVar x then none
+    else collectProjs? x b.body ps
+
+/-- Return true iff `x` is used only by `inc x`, `dec x`, and `let z : t := unbox x` in `b`. -/
+private partial def onlyUnboxed (x : VarId) (t : IRType) : FnBody → Bool
+  | .vdecl _ t' (.unbox y) b  => (y != x || t' == t) && onlyUnboxed x t b
+  | .inc _ _ _ _ b
+  | .dec _ _ _ _ b            => onlyUnboxed x t b
+  | .jdecl _ _ v b            => onlyUnboxed x t v && onlyUnboxed x t b
+  | .case _ y _ alts          => y != x && alts.all fun alt => onlyUnboxed x t alt.body
+  | b =>
+    if b.isTerminal then !b.hasFreeVar x
+    else !b.resetBody.hasFreeVar x && onlyUnboxed x t b.body
+
+/-- Add the results of calls `let r := g ys` in `b` that can use the worker of `g` because `r` is only projected,
+and the projections are only unboxed. -/
+partial def collectUnboxedCalls (getResult? : FunId → Option UnboxedResult) (b : FnBody) (vars : UnboxedVars) : UnboxedVars :=
+  match b with
+  | .vdecl r t (.fap g _) k =>
+    let vars := collectUnboxedCalls getResult? k vars
+    if vars.structVars.contains r || !t.isObj then vars else
+    match getResult? g with
+    | none     => vars
+    | some res =>
+      match collectProjs? r k #[] with
+      | some ps =>
+        if ps.all fun (p, i) => i < res.types.size && onlyUnboxed p res.types[i]! k then
+          { vars with
+            structVars := vars.structVars.insert r res.types
+            projVars   := ps.foldl (fun m (p, i) => m.insert p (r, i)) vars.projVars }
+        else vars
+      | none => vars
+  | .jdecl _ _ v k        => collectUnboxedCalls getResult? k (collectUnboxedCalls getResult? v vars)
+  | .case _ _ _ alts      => alts.foldl (fun vars alt => collectUnboxedCalls getResult? alt.body vars) vars
+  | b                     => if b.isTerminal then vars else collectUnboxedCalls getResult? b.body vars
+
 end Lean.IR.UnboxResult
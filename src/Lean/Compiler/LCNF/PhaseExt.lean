@@ -32,6 +32,8 @@ def mkDeclExt (name : Name := by exact decl_name%) : IO DeclExt := do
     exportEntriesFn := fun s =>
       let decls := s.foldl (init := #[]) fun decls _ decl => decls.push decl
       sortDecls decls
+    replay?         := some fun old new decls =>
+      new.foldl (init := decls) fun decls declName decl => if old.contains declName then decls else decls.insert declName decl
   }
 
 builtin_initialize baseExt : PersistentEnvExtension Decl Decl DeclExtState ← mkDeclExt
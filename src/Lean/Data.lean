@@ -20,6 +20,8 @@ import Lean.Data.OpenDecl
 import Lean.Data.Options
 import Lean.Data.Parsec
 import Lean.Data.PersistentArray
+import Lean.Data.CompactPersistentHashMap
+import Lean.Data.FlatHashMap
 import Lean.Data.PersistentHashMap
 import Lean.Data.PersistentHashSet
 import Lean.Data.Position
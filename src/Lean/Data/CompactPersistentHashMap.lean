@@ -0,0 +1,130 @@
+/-
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.Data.Array.Basic
+import Init.Data.Hashable
+
+/-!
+# Compact persistent hash maps
+
+`CompactPersistentHashMap` is a hash array mapped trie like `PersistentHashMap`, but its nodes are
+implemented in the runtime (`src/runtime/hamt.cpp`). A node stores a bitmap of the hash fragments
+occupied by key/value pairs and a bitmap of those occupied by child nodes, followed by only the
+occupied slots, which are located using popcount indexing. Key/value pairs are stored inline in the
+node object instead of in separate `Entry` objects, and nodes are updated in place when they are not
+shared.
+
+Once all 64 bits of the hash are used up, colliding keys are stored in a list node.
+-/
+
+namespace Lean
+universe u v w
+
+namespace CompactPersistentHashMap
+
+private opaque NodePointed : NonemptyType.{0}
+
+/-- A node of a `CompactPersistentHashMap`, implemented in the runtime. -/
+def Node (_ : Type u) (_ : Type v) : Type := NodePointed.type
+
+instance : Nonempty (Node α β) := NodePointed.property
+
+@[extern "lean_cphashmap_node_mk_empty"]
+opaque Node.mkEmpty (u : Unit) : Node α β
+
+/-
+The runtime functions take the `BEq` and `Hashable` instances explicitly, which are represented by
+their only field, and the hash of the key.
+-/
+
+@[extern "lean_cphashmap_node_find"]
+opaque Node.find? (beq : @& BEq α) (n : @& Node α β) (k : @& α) (h : UInt64) : Option β
+
+@[extern "lean_cphashmap_node_contains"]
+opaque Node.contains (beq : @& BEq α) (n : @& Node α β) (k : @& α) (h : UInt64) : Bool
+
+@[extern "lean_cphashmap_node_to_array"]
+opaque Node.toArray (n : @& Node α β) : Array (α × β)
+
+end CompactPersistentHashMap
+
+open CompactPersistentHashMap in
+structure CompactPersistentHashMap (α : Type u) (β : Type v) [BEq α] [Hashable α] where
+  root : Node α β := Node.mkEmpty ()
+  size : Nat      := 0
+
+abbrev CPHashMap (α : Type u) (β : Type v) [BEq α] [Hashable α] := CompactPersistentHashMap α β
+
+namespace CompactPersistentHashMap
+
+variable {α : Type u} {β : Type v}
+
+instance [BEq α] [Hashable α] : Inhabited (CompactPersistentHashMap α β) := ⟨{}⟩
+
+def empty [BEq α] [Hashable α] : CompactPersistentHashMap α β := {}
+
+def isEmpty [BEq α] [Hashable α] (m : CompactPersistentHashMap α β) : Bool :=
+  m.size == 0
+
+/-
+The runtime functions take the whole map so that they can update `size` in place as well. The
+`Hashable` instance is needed for moving existing keys down the trie.
+-/
+
+@[extern "lean_cphashmap_insert"]
+private opaque insertImpl (beq : @& BEq α) (hashable : @& Hashable α)
+  (m : CompactPersistentHashMap α β) (k : α) (h : UInt64) (v : β) : CompactPersistentHashMap α β
+
+@[extern "lean_cphashmap_erase"]
+private opaque eraseImpl (beq : @& BEq α) (hashable : @& Hashable α)
+  (m : CompactPersistentHashMap α β) (k : @& α) (h : UInt64) : CompactPersistentHashMap α β
+
+@[inline] def insert {beq : BEq α} {hashable : Hashable α} (m : CompactPersistentHashMap α β) (k : α)
+    (v : β) : CompactPersistentHashMap α β :=
+  insertImpl beq hashable m k (hash k) v
+
+@[inline] def erase {beq : BEq α} {hashable : Hashable α} (m : CompactPersistentHashMap α β) (k : α) :
+    CompactPersistentHashMap α β :=
+  eraseImpl beq hashable m k (hash k)
+
+@[inline] def find? {beq : BEq α} {_ : Hashable α} (m : CompactPersistentHashMap α β) (k : α) : Option β :=
+  m.root.find? beq k (hash k)
+
+instance {_ : BEq α} {_ : Hashable α} : GetElem (CompactPersistentHashMap α β) α (Option β) fun _ _ => True where
+  getElem m i _ := m.find? i
+
+@[inline] def findD {_ : BEq α} {_ : Hashable α} (m : CompactPersistentHashMap α β) (a : α) (b₀ : β) : β :=
+  (m.find? a).getD b₀
+
+@[inline] def find! {_ : BEq α} {_ : Hashable α} [Inhabited β] (m : CompactPersistentHashMap α β) (a : α) : β :=
+  match m.find? a with
+  | some b => b
+  | none   => panic! "key is not in the map"
+
+@[inline] def contains [beq : BEq α] [Hashable α] (m : CompactPersistentHashMap α β) (k : α) : Bool :=
+  m.root.contains beq k (hash k)
+
+def toArray {_ : BEq α} {_ : Hashable α} (m : CompactPersistentHashMap α β) : Array (α × β) :=
+  m.root.toArray
+
+def toList {_ : BEq α} {_ : Hashable α} (m : CompactPersistentHashMap α β) : List (α × β) :=
+  m.toArray.toList
+
+section
+variable {m : Type w → Type w} [Monad m] {σ : Type w}
+
+@[inline] def foldlM {_ : BEq α} {_ : Hashable α} (map : CompactPersistentHashMap α β) (f : σ → α → β → m σ) (init : σ) : m σ :=
+  map.toArray.foldlM (fun acc (k, v) => f acc k v) init
+
+@[inline] def foldl {_ : BEq α} {_ : Hashable α} (map : CompactPersistentHashMap α β) (f : σ → α → β → σ) (init : σ) : σ :=
+  map.toArray.foldl (fun acc (k, v) => f acc k v) init
+
+@[inline] def forM {_ : BEq α} {_ : Hashable α} (map : CompactPersistentHashMap α β) (f : α → β → m PUnit) : m PUnit :=
+  map.toArray.forM fun (k, v) => f k v
+
+end
+
+end CompactPersistentHashMap
+end Lean
@@ -0,0 +1,136 @@
+/-
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.Data.Array.Basic
+import Init.Data.Hashable
+
+/-!
+# Flat hash maps
+
+`FlatHashMap` is an open-addressing hash map implemented in the runtime
+(`src/runtime/flat_hashmap.cpp`) in the style of Swiss tables. Keys and values are stored inline in a
+single array of slots instead of in per-bucket association lists, and a separate array of control bytes
+holding 7 bits of the hash of each occupied slot is used to compare a whole group of slots at once
+during probing, using SIMD instructions where available.
+
+Like `HashMap`, the map is updated in place when it is not shared and copied otherwise, so it should
+be used linearly.
+
+The `BEq` instance is assumed to be reflexive: keys that are pointer-equal are not compared using it.
+-/
+
+namespace Lean
+universe u v w
+
+namespace FlatHashMap
+
+private opaque RawPointed : NonemptyType.{0}
+
+/-- The runtime representation of a `FlatHashMap`, which does not depend on the instances. -/
+def Raw (_ : Type u) (_ : Type v) : Type := RawPointed.type
+
+instance : Nonempty (Raw α β) := RawPointed.property
+
+/-
+The runtime functions take the `BEq` and `Hashable` instances explicitly, which are represented by
+their only field, and the hash of the key. The `Hashable` instance is needed for rehashing the keys
+when the map grows.
+-/
+
+@[extern "lean_flat_hashmap_mk"]
+opaque Raw.mk (capacity : @& Nat) : Raw α β
+
+@[extern "lean_flat_hashmap_insert"]
+opaque Raw.insert (beq : @& BEq α) (hashable : @& Hashable α) (m : Raw α β) (k : α) (h : UInt64) (v : β) :
+  Raw α β
+
+@[extern "lean_flat_hashmap_erase"]
+opaque Raw.erase (beq : @& BEq α) (hashable : @& Hashable α) (m : Raw α β) (k : @& α) (h : UInt64) : Raw α β
+
+@[extern "lean_flat_hashmap_find"]
+opaque Raw.find? (beq : @& BEq α) (m : @& Raw α β) (k : @& α) (h : UInt64) : Option β
+
+@[extern "lean_flat_hashmap_contains"]
+opaque Raw.contains (beq : @& BEq α) (m : @& Raw α β) (k : @& α) (h : UInt64) : Bool
+
+@[extern "lean_flat_hashmap_size"]
+opaque Raw.size (m : @& Raw α β) : Nat
+
+@[extern "lean_flat_hashmap_to_array"]
+opaque Raw.toArray (m : @& Raw α β) : Array (α × β)
+
+end FlatHashMap
+
+/-- An open-addressing hash map, implemented in the runtime. -/
+def FlatHashMap (α : Type u) (β : Type v) [BEq α] [Hashable α] : Type := FlatHashMap.Raw α β
+
+instance [BEq α] [Hashable α] : Nonempty (FlatHashMap α β) := inferInstanceAs (Nonempty (FlatHashMap.Raw α β))
+
+/-- Creates an empty map with room for at least `capacity` entries. -/
+def mkFlatHashMap {α : Type u} {β : Type v} [BEq α] [Hashable α] (capacity := 8) : FlatHashMap α β :=
+  FlatHashMap.Raw.mk capacity
+
+namespace FlatHashMap
+
+variable {α : Type u} {β : Type v}
+
+instance [BEq α] [Hashable α] : Inhabited (FlatHashMap α β) := ⟨mkFlatHashMap⟩
+
+instance [BEq α] [Hashable α] : EmptyCollection (FlatHashMap α β) := ⟨mkFlatHashMap⟩
+
+@[inline] def empty [BEq α] [Hashable α] : FlatHashMap α β :=
+  mkFlatHashMap
+
+variable [beq : BEq α] [hashable : Hashable α]
+
+@[inline] def insert (m : FlatHashMap α β) (a : α) (b : β) : FlatHashMap α β :=
+  Raw.insert beq hashable m a (hash a) b
+
+@[inline] def erase (m : FlatHashMap α β) (a : α) : FlatHashMap α β :=
+  Raw.erase beq hashable m a (hash a)
+
+@[inline] def find? (m : FlatHashMap α β) (a : α) : Option β :=
+  Raw.find? beq m a (hash a)
+
+@[inline] def findD (m : FlatHashMap α β) (a : α) (b₀ : β) : β :=
+  (m.find? a).getD b₀
+
+@[inline] def find! [Inhabited β] (m : FlatHashMap α β) (a : α) : β :=
+  match m.find? a with
+  | some b => b
+  | none   => panic! "key is not in the map"
+
+instance : GetElem (FlatHashMap α β) α (Option β) fun _ _ => True where
+  getElem m i _ := m.find? i
+
+@[inline] def contains (m : FlatHashMap α β) (a : α) : Bool :=
+  Raw.contains beq m a (hash a)
+
+@[inline] def size (m : FlatHashMap α β) : Nat :=
+  Raw.size m
+
+@[inline] def isEmpty (m : FlatHashMap α β) : Bool :=
+  m.size = 0
+
+def toArray (m : FlatHashMap α β) : Array (α × β) :=
+  Raw.toArray m
+
+def toList (m : FlatHashMap α β) : List (α × β) :=
+  m.toArray.toList
+
+@[inline] def foldM {δ : Type w} {m : Type w → Type w} [Monad m] (f : δ → α → β → m δ) (init : δ) (h : FlatHashMap α β) : m δ :=
+  h.toArray.foldlM (fun d (a, b) => f d a b) init
+
+@[inline] def fold {δ : Type w} (f : δ → α → β → δ) (init : δ) (m : FlatHashMap α β) : δ :=
+  m.toArray.foldl (fun d (a, b) => f d a b) init
+
+@[inline] def forM {m : Type w → Type w} [Monad m] (f : α → β → m PUnit) (h : FlatHashMap α β) : m PUnit :=
+  h.toArray.forM fun (a, b) => f a b
+
+def ofList (l : List (α × β)) : FlatHashMap α β :=
+  l.foldl (init := mkFlatHashMap l.length) fun m (a, b) => m.insert a b
+
+end FlatHashMap
+end Lean
@@ -213,10 +213,27 @@ end Json.Parser
 
 namespace Json
 
+/-- Builds an object in the same way as `Json.Parser.objectCore` from the fields in order of appearance. -/
+@[export lean_json_mk_obj]
+private def mkObjOfFields (kvs : Array (String × Json)) : Json :=
+  obj <| kvs.foldr (init := RBNode.leaf) fun (k, v) kvs => kvs.insert compare k v
+
+/--
+Native implementation of `Json.Parser.any` on a whole string, with exactly the same results. Returns `none` if `s` is
+not valid JSON, but also for some valid inputs it does not handle (deeply nested values and exponents with more than
+18 digits).
+-/
+@[extern "lean_json_parse_native"]
+opaque parseNative? (s : @& String) : Option Json
+
 def parse (s : String) : Except String Lean.Json :=
-  match Json.Parser.any s.mkIterator with
-  | Parsec.ParseResult.success _ res => Except.ok res
-  | Parsec.ParseResult.error it err  => Except.error s!"offset {repr it.i.byteIdx}: {err}"
+  match parseNative? s with
+  | some res => Except.ok res
+  | none =>
+    -- also produces the error message for invalid input
+    match Json.Parser.any s.mkIterator with
+    | Parsec.ParseResult.success _ res => Except.ok res
+    | Parsec.ParseResult.error it err  => Except.error s!"offset {repr it.i.byteIdx}: {err}"
 
 end Json
 
@@ -74,26 +74,33 @@ protected inductive CompressWorkItem
   | comma
 
 open Json.CompressWorkItem in
-partial def compress (j : Json) : String :=
-  go "" [json j]
-where go (acc : String) : List Json.CompressWorkItem → String
+/-- Reference implementation of `compress`. -/
+partial def compressCore (acc : String) : List Json.CompressWorkItem → String
   | []               => acc
   | json j :: is =>
     match j with
-    | null       => go (acc ++ "null") is
-    | bool true  => go (acc ++ "true") is
-    | bool false => go (acc ++ "false") is
-    | num s      => go (acc ++ s.toString) is
-    | str s      => go (acc ++ renderString s) is
-    | arr elems  => go (acc ++ "[") (elems.toList.map arrayElem ++ [arrayEnd] ++ is)
-    | obj kvs    => go (acc ++ "{") (kvs.fold (init := []) (fun acc k j => objectField k j :: acc) ++ [objectEnd] ++ is)
-  | arrayElem j :: arrayEnd :: is      => go acc (json j :: arrayEnd :: is)
-  | arrayElem j :: is                  => go acc (json j :: comma :: is)
-  | arrayEnd :: is                     => go (acc ++ "]") is
-  | objectField k j :: objectEnd :: is => go (acc ++ renderString k ++ ":") (json j :: objectEnd :: is)
-  | objectField k j :: is              => go (acc ++ renderString k ++ ":") (json j :: comma :: is)
-  | objectEnd :: is                    => go (acc ++ "}") is
-  | comma :: is                        => go (acc ++ ",") is
+    | null       => compressCore (acc ++ "null") is
+    | bool true  => compressCore (acc ++ "true") is
+    | bool false => compressCore (acc ++ "false") is
+    | num s      => compressCore (acc ++ s.toString) is
+    | str s      => compressCore (acc ++ renderString s) is
+    | arr elems  => compressCore (acc ++ "[") (elems.toList.map arrayElem ++ [arrayEnd] ++ is)
+    | obj kvs    => compressCore (acc ++ "{") (kvs.fold (init := []) (fun acc k j => objectField k j :: acc) ++ [objectEnd] ++ is)
+  | arrayElem j :: arrayEnd :: is      => compressCore acc (json j :: arrayEnd :: is)
+  | arrayElem j :: is                  => compressCore acc (json j :: comma :: is)
+  | arrayEnd :: is                     => compressCore (acc ++ "]") is
+  | objectField k j :: objectEnd :: is => compressCore (acc ++ renderString k ++ ":") (json j :: objectEnd :: is)
+  | objectField k j :: is              => compressCore (acc ++ renderString k ++ ":") (json j :: comma :: is)
+  | objectEnd :: is                    => compressCore (acc ++ "}") is
+  | comma :: is                        => compressCore (acc ++ ",") is
+
+/--
+Renders `j` without any whitespace. Fields of objects are rendered in descending order of their keys.
+Implemented natively, see `compressCore` for the reference implementation.
+-/
+@[extern "lean_json_compress"]
+def compress (j : @& Json) : String :=
+  compressCore "" [.json j]
 
 instance : ToFormat Json := ⟨render⟩
 instance : ToString Json := ⟨pretty⟩
@@ -381,10 +381,25 @@ structure SemanticTokensLegend where
 structure SemanticTokensOptions where
   legend : SemanticTokensLegend
   range  : Bool
-  full   : Bool /- | {
-    delta?: boolean;
-  } -/
-  deriving FromJson, ToJson
+  full   : Bool
+  /-- Whether `textDocument/semanticTokens/full/delta` is supported. Encoded as `full: { delta }`. -/
+  delta  : Bool := false
+
+instance : ToJson SemanticTokensOptions where
+  toJson o := Json.mkObj [
+    ("legend", toJson o.legend),
+    ("range", toJson o.range),
+    ("full", if o.full && o.delta then Json.mkObj [("delta", true)] else toJson o.full)
+  ]
+
+instance : FromJson SemanticTokensOptions where
+  fromJson? j := do
+    let legend ← j.getObjValAs? SemanticTokensLegend "legend"
+    let range ← j.getObjValAs? Bool "range"
+    let full ← j.getObjVal? "full"
+    match full with
+    | .bool full => return { legend, range, full }
+    | full => return { legend, range, full := true, delta := (full.getObjValAs? Bool "delta").toOption.getD false }
 
 structure SemanticTokensParams where
   textDocument : TextDocumentIdentifier
@@ -400,6 +415,40 @@ structure SemanticTokens where
   data      : Array Nat
   deriving FromJson, ToJson
 
+structure SemanticTokensDeltaParams where
+  textDocument     : TextDocumentIdentifier
+  previousResultId : String
+  deriving FromJson, ToJson
+
+/-- Replaces `deleteCount` numbers starting at `start` in the `data` of the previous result. -/
+structure SemanticTokensEdit where
+  start       : Nat
+  deleteCount : Nat
+  data?       : Option (Array Nat) := none
+  deriving FromJson, ToJson
+
+structure SemanticTokensDelta where
+  resultId? : Option String := none
+  edits     : Array SemanticTokensEdit
+  deriving FromJson, ToJson
+
+/-- Result of `textDocument/semanticTokens/full/delta`. -/
+inductive SemanticTokensDeltaResult where
+  | full  (tokens : SemanticTokens)
+  | delta (delta : SemanticTokensDelta)
+
+instance : ToJson SemanticTokensDeltaResult where
+  toJson
+    | .full tokens => toJson tokens
+    | .delta delta => toJson delta
+
+instance : FromJson SemanticTokensDeltaResult where
+  fromJson? j :=
+    if (j.getObjVal? "edits").toOption.isSome then
+      .delta <$> fromJson? j
+    else
+      .full <$> fromJson? j
+
 structure FoldingRangeParams where
   textDocument : TextDocumentIdentifier
   deriving FromJson, ToJson
@@ -26,6 +26,25 @@ structure Scope where
   isNoncomputable : Bool := false
   deriving Inhabited
 
+/--
+The body of a theorem or example being elaborated in a separate task, see `Elab.async`. Until
+`waitAsyncProofs` is called, a theorem is present in the environment with a `sorry` placeholder
+proof.
+-/
+structure AsyncProof where
+  /-- The command. -/
+  stx              : Syntax
+  /-- Scopes the command was elaborated in. -/
+  scopes           : List Scope
+  /-- Environment before the command. -/
+  env              : Environment
+  /-- Environment after adding the placeholder theorem, or `none` for examples. -/
+  placeholderEnv?  : Option Environment
+  /-- Final environment, messages, and info trees of elaborating the full command. -/
+  task             : Task (Environment × MessageLog × PersistentArray InfoTree)
+  /-- Whether messages and info trees of `task` are reported to the user by other means. -/
+  reported         : Bool := false
+
 structure State where
   env            : Environment
   messages       : MessageLog := {}
@@ -35,6 +54,8 @@ structure State where
   ngen           : NameGenerator := {}
   infoState      : InfoState := {}
   traceState     : TraceState := {}
+  /-- Pending asynchronously elaborated proofs of previous commands. -/
+  asyncProofs    : Array AsyncProof := #[]
   deriving Nonempty
 
 structure Context where
@@ -325,7 +346,7 @@ builtin_initialize registerTraceClass `Elab.input
 `elabCommand` wrapper that should be used for the initial invocation, not for recursive calls after
 macro expansion etc.
 -/
-def elabCommandTopLevel (stx : Syntax) : CommandElabM Unit := withRef stx do profileitM Exception "elaboration" (← getOptions) do
+private def elabCommandTopLevelCore (stx : Syntax) : CommandElabM Unit := withRef stx do profileitM Exception "elaboration" (← getOptions) do
   let initMsgs ← modifyGet fun st => (st.messages, { st with messages := {} })
   let initInfoTrees ← getResetInfoTrees
   try
@@ -347,6 +368,161 @@ def elabCommandTopLevel (stx : Syntax) : CommandElabM Unit := withRef stx do pro
     }
     addTraceAsMessages
 
+register_builtin_option Elab.async : Bool := {
+  defValue := false
+  descr    := "elaborate the bodies of theorems and examples in parallel tasks, waiting for them \
+    only before commands that are not declarations; messages of these commands may be reported \
+    out of order"
+}
+
+/-- Kinds of commands that never need the proofs of previous theorems. -/
+private def asyncSafeKinds : Array SyntaxNodeKind := #[
+  `Lean.Parser.Command.declaration, `Lean.Parser.Command.namespace,
+  `Lean.Parser.Command.section, `Lean.Parser.Command.end, `Lean.Parser.Command.open,
+  `Lean.Parser.Command.variable, `Lean.Parser.Command.universe, `Lean.Parser.Command.set_option]
+
+/-- Whether `stx` is a theorem or example whose body can be elaborated asynchronously. -/
+private def isAsyncCandidate (stx : Syntax) : Bool := Id.run do
+  unless stx.isOfKind `Lean.Parser.Command.declaration do
+    return false
+  -- attributes such as `simp` may inspect the proof, so they must not see the placeholder
+  unless stx[0][1].isNone do
+    return false
+  let decl := stx[1]
+  unless decl.isOfKind `Lean.Parser.Command.theorem || decl.isOfKind `Lean.Parser.Command.example do
+    return false
+  -- `where` declarations and termination hints lead to auxiliary definitions that later commands
+  -- may refer to
+  let val := decl[decl.getNumArgs - 1]
+  return val.isOfKind `Lean.Parser.Command.declValSimple && val[2][0].isNone && val[2][1].isNone &&
+    val[3].isNone
+
+/--
+Merges the constants and environment extension states elaborated in `asyncEnv`, which extends `env`,
+into `curr`, which extends `placeholderEnv`, which in turn extends `env`. The placeholder theorems are
+replaced, and auxiliary declarations such as matchers or equation lemmas are added unless later
+commands added an equal theorem of the same name already. Returns `none` if another constant of the
+same name exists or an extension state cannot be merged, see `Environment.replayExtensions`.
+-/
+private unsafe def mergeAsyncEnvUnsafe (env placeholderEnv asyncEnv curr : Environment) :
+    Option Environment := do
+  let newConsts := asyncEnv.constants.foldStage2 (s := #[])
+    (fun cs n c => if env.contains n then cs else cs.push c)
+  let mut curr := curr
+  for c in newConsts do
+    if let some c' := curr.find? c.name then
+      unless placeholderEnv.contains c.name do
+        -- e.g. an equation lemma generated by a later command as well
+        if (c matches .thmInfo _) && (c' matches .thmInfo _) && c.type == c'.type then
+          continue
+        none
+    curr := curr.addCheckedConstant c
+  curr.replayExtensions env asyncEnv (base := placeholderEnv)
+
+@[implemented_by mergeAsyncEnvUnsafe]
+private opaque mergeAsyncEnv (env placeholderEnv asyncEnv curr : Environment) : Option Environment
+
+/-- Removes the placeholder theorems of `placeholderEnv`, which extends `env`, from `curr`. -/
+private unsafe def erasePlaceholdersUnsafe (env placeholderEnv curr : Environment) : Environment :=
+  placeholderEnv.constants.foldStage2 (s := curr)
+    (fun curr n _ => if env.contains n then curr else curr.eraseConstant n)
+
+@[implemented_by erasePlaceholdersUnsafe]
+private opaque erasePlaceholders (env placeholderEnv curr : Environment) : Environment
+
+/--
+Waits for all pending proofs of previous commands, see `Elab.async`. Their messages and info trees
+are added to the current ones unless reported already, and the placeholder theorems are replaced with
+the elaborated ones along with the auxiliary declarations and environment extension entries created
+by their proofs. Theorems that cannot be merged this way are elaborated again in the current
+environment instead.
+-/
+def waitAsyncProofs : CommandElabM Unit := do
+  let proofs := (← get).asyncProofs
+  if proofs.isEmpty then
+    return
+  modify ({ · with asyncProofs := #[] })
+  for proof in proofs do
+    let (env, messages, trees) ← IO.wait proof.task
+    unless proof.reported do
+      modify fun s => { s with
+        messages := s.messages ++ messages
+        infoState.trees := s.infoState.trees ++ trees
+      }
+    if let some placeholderEnv := proof.placeholderEnv? then
+      if let some env := mergeAsyncEnv proof.env placeholderEnv env (← getEnv) then
+        setEnv env
+      else
+        let s ← get
+        set { s with env := erasePlaceholders proof.env placeholderEnv s.env, scopes := proof.scopes }
+        elabCommand proof.stx
+        modify fun s' => { s' with
+          messages := s.messages, scopes := s.scopes, infoState := s.infoState
+          traceState := s.traceState }
+
+/--
+Elaborates the theorem or example `stx` in a separate task. Theorems are also elaborated with a
+`sorry` body in the current thread so that later commands can use their statements and attributes.
+If that fails, e.g. because the statement contains holes solved by the body, the task is waited for
+immediately instead.
+-/
+private def elabCommandAsync (stx : Syntax) : CommandElabM Unit := do
+  let s ← get
+  let ctx ← read
+  let task ← BaseIO.asTask do
+    let act : CommandElabM Unit := withLogging do
+      let (output, _) ← IO.FS.withIsolatedStreams (elabCommandTopLevelCore stx)
+      if !output.isEmpty then
+        logInfoAt stx output
+    let s := { s with messages := {}, infoState.trees := {}, traceState := {}, asyncProofs := #[] }
+    match (← (act { ctx with snap? := none } |>.run s).toBaseIO) with
+    | .ok (_, s) => return (s.env, s.messages, s.infoState.trees)
+    | .error ex  => return (s.env, MessageLog.empty.add <| mkMessageAux ctx stx ex.toMessageData .error, {})
+  let decl := stx[1]
+  if decl.isOfKind `Lean.Parser.Command.example then
+    modify fun s => { s with asyncProofs := s.asyncProofs.push { stx, scopes := s.scopes, env := s.env, placeholderEnv? := none, task } }
+    return
+  let val := decl[decl.getNumArgs - 1]
+  let body ← withRef val[1] `(sorry)
+  modify ({ · with messages := {} })
+  elabCommand <| stx.setArg 1 <| decl.setArg (decl.getNumArgs - 1) <| val.setArg 1 body
+  let s' ← get
+  if s'.messages.hasErrors then
+    let (env, messages, trees) ← IO.wait task
+    set { s with
+      env, messages := s.messages ++ messages, infoState.trees := s.infoState.trees ++ trees }
+  else
+    set { s' with
+      messages := s.messages, infoState := s.infoState, traceState := s.traceState
+      asyncProofs := s.asyncProofs.push { stx, scopes := s.scopes, env := s.env, placeholderEnv? := s'.env, task } }
+
+/--
+Elaborates a top-level command, including running linters and reporting traces. With `Elab.async`,
+the bodies of theorems and examples are elaborated in parallel to further commands.
+-/
+def elabCommandTopLevel (stx : Syntax) : CommandElabM Unit := do
+  if Elab.async.get (← getOptions) && isAsyncCandidate stx then
+    elabCommandAsync stx
+  else if !asyncSafeKinds.contains stx.getKind then
+    waitAsyncProofs
+    elabCommandTopLevelCore stx
+  else if stx.isOfKind `Lean.Parser.Command.declaration && !(← get).asyncProofs.isEmpty then
+    -- The kernel may have to unfold one of the pending proofs, e.g. when reducing well-founded
+    -- recursion, and fail on its placeholder. Elaborate the declaration again after waiting for them
+    -- if it fails.
+    let s ← get
+    modify ({ · with messages := {} })
+    elabCommandTopLevelCore stx
+    let s' ← get
+    if s'.messages.hasErrors then
+      set s
+      waitAsyncProofs
+      elabCommandTopLevelCore stx
+    else
+      set { s' with messages := s.messages ++ s'.messages }
+  else
+    elabCommandTopLevelCore stx
+
 /-- Adapt a syntax transformation to a regular, command-producing elaborator. -/
 def adaptExpander (exp : Syntax → CommandElabM Syntax) : CommandElab := fun stx => do
   let stx' ← exp stx
@@ -101,6 +101,13 @@ def process (input : String) (env : Environment) (opts : Options) (fileName : Op
 builtin_initialize
   registerTraceClass `Elab.info
 
+register_builtin_option olean.storeIndices : Bool := {
+  defValue := false
+  descr    := "store the instance and simp lemma indices of the module and all its imports in its \
+    .olean file if they are at least twice as large as the indices stored in its imports, so that \
+    importing it first does not rebuild them; see `ScopedEnvExtension.StateSnapshot`"
+}
+
 @[export lean_run_frontend]
 def runFrontend
     (input : String)
@@ -136,8 +143,7 @@ def runFrontend
       let trees := s.commandState.infoState.trees.toArray
       let references ←
         Lean.Server.findModuleRefs inputCtx.fileMap trees (localVars := false) |>.toLspModuleRefs
-      let ilean := { module := mainModuleName, references : Lean.Server.Ilean }
-      IO.FS.writeFile ileanFileName $ Json.compress $ toJson ilean
+      Lean.Server.Ilean.ofModuleRefs mainModuleName references |>.save ileanFileName
 
     if let some out := trace.profiler.output.get? opts then
       let traceState := s.commandState.traceState
@@ -152,7 +158,10 @@ def runFrontend
       let profile ← Firefox.Profile.export mainModuleName.toString startTime traceState opts
       IO.FS.writeFile ⟨out⟩ <| Json.compress <| toJson profile
 
-    return (s.commandState.env, !s.commandState.messages.hasErrors)
+    let mut env := s.commandState.env
+    if olean.storeIndices.get opts then
+      env ← ScopedEnvExtension.storeStateSnapshots env
+    return (env, !s.commandState.messages.hasErrors)
 
   let ctx := { inputCtx with }
   let processor := Language.Lean.process
@@ -162,8 +171,7 @@ def runFrontend
   if let some ileanFileName := ileanFileName? then
     let trees := snaps.getAll.concatMap (match ·.infoTree? with | some t => #[t] | _ => #[])
     let references := Lean.Server.findModuleRefs inputCtx.fileMap trees (localVars := false)
-    let ilean := { module := mainModuleName, references := ← references.toLspModuleRefs : Lean.Server.Ilean }
-    IO.FS.writeFile ileanFileName $ Json.compress $ toJson ilean
+    Lean.Server.Ilean.ofModuleRefs mainModuleName (← references.toLspModuleRefs) |>.save ileanFileName
 
   let hasErrors := snaps.getAll.any (·.diagnostics.msgLog.hasErrors)
   -- TODO: remove default when reworking cmdline interface in Lean; currently the only case
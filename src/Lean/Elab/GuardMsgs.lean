@@ -141,6 +141,8 @@ def MessageOrdering.apply (mode : MessageOrdering) (msgs : List String) : List S
     let (whitespace, ordering, specFn) ← parseGuardMsgsSpec spec?
     let initMsgs ← modifyGet fun st => (st.messages, { st with messages := {} })
     elabCommandTopLevel cmd
+    -- proofs of previous commands were already waited for as `#guard_msgs` is not a declaration
+    waitAsyncProofs
     let msgs := (← get).messages
     let mut toCheck : MessageLog := .empty
     let mut toPassthrough : MessageLog := .empty
@@ -207,6 +207,12 @@ private def getTrustLevel (env : Environment) : UInt32 :=
 def getModuleIdxFor? (env : Environment) (declName : Name) : Option ModuleIdx :=
   env.const2ModIdx.find? declName
 
+/-- Name of the imported module `declName` was declared in, if any. -/
+@[export lean_environment_find_module_name_for]
+private def findModuleNameFor? (env : Environment) (declName : Name) : Option Name := do
+  let idx ← env.getModuleIdxFor? declName
+  env.header.moduleNames[idx.toNat]?
+
 def isConstructor (env : Environment) (declName : Name) : Bool :=
   match env.find? declName with
   | some (.ctorInfo _) => true
@@ -264,23 +270,25 @@ end ConstantInfo
 structure EnvExtensionInterface where
   ext          : Type → Type
   inhabitedExt : Inhabited σ → Inhabited (ext σ)
-  registerExt  (mkInitial : IO σ) : IO (ext σ)
+  registerExt  (mkInitial : IO σ) (replay? : Option (σ → σ → σ → Option σ)) : IO (ext σ)
   setState     (e : ext σ) (exts : Array EnvExtensionState) : σ → Array EnvExtensionState
   modifyState  (e : ext σ) (exts : Array EnvExtensionState) : (σ → σ) → Array EnvExtensionState
   getState     [Inhabited σ] (e : ext σ) (exts : Array EnvExtensionState) : σ
   mkInitialExtStates : IO (Array EnvExtensionState)
   ensureExtensionsSize : Array EnvExtensionState → IO (Array EnvExtensionState)
+  replayExtStates (old new base curr : Array EnvExtensionState) : Option (Array EnvExtensionState)
 
 instance : Inhabited EnvExtensionInterface where
   default := {
     ext                  := id
     inhabitedExt         := id
     ensureExtensionsSize := fun exts => pure exts
-    registerExt          := fun mk => mk
+    registerExt          := fun mk _ => mk
     setState             := fun _ exts _ => exts
     modifyState          := fun _ exts _ => exts
     getState             := fun ext _ => ext
     mkInitialExtStates   := pure #[]
+    replayExtStates      := fun _ _ _ curr => some curr
   }
 
 /-! # Unsafe implementation of `EnvExtensionInterface` -/
@@ -289,6 +297,10 @@ namespace EnvExtensionInterfaceUnsafe
 structure Ext (σ : Type) where
   idx       : Nat
   mkInitial : IO σ
+  /--
+  `replay? old new curr` applies the changes from `old` to `new` to the state `curr`, or fails if
+  they cannot be applied. See `Environment.replayExtensions`. -/
+  replay?   : Option (σ → σ → σ → Option σ) := none
   deriving Inhabited
 
 private builtin_initialize envExtensionsRef : IO.Ref (Array (Ext EnvExtensionState)) ← IO.mkRef #[]
@@ -338,7 +350,7 @@ unsafe def getState {σ} [Inhabited σ] (ext : Ext σ) (exts : Array EnvExtensio
   else
     panic! invalidExtMsg
 
-unsafe def registerExt {σ} (mkInitial : IO σ) : IO (Ext σ) := do
+unsafe def registerExt {σ} (mkInitial : IO σ) (replay? : Option (σ → σ → σ → Option σ)) : IO (Ext σ) := do
   unless (← initializing) do
     throw (IO.userError "failed to register environment, extensions can only be registered during initialization")
   let exts ← envExtensionsRef.get
@@ -346,6 +358,7 @@ unsafe def registerExt {σ} (mkInitial : IO σ) : IO (Ext σ) := do
   let ext : Ext σ := {
      idx        := idx,
      mkInitial  := mkInitial,
+     replay?    := replay?
   }
   envExtensionsRef.modify fun exts => exts.push (unsafeCast ext)
   pure ext
@@ -354,6 +367,28 @@ def mkInitialExtStates : IO (Array EnvExtensionState) := do
   let exts ← envExtensionsRef.get
   exts.mapM fun ext => ext.mkInitial
 
+unsafe def replayExtStates (old new base curr : Array EnvExtensionState) : Option (Array EnvExtensionState) := Id.run do
+  let exts := unsafeBaseIO envExtensionsRef.get
+  let mut curr := curr
+  for ext in exts do
+    let i := ext.idx
+    unless i < old.size && i < new.size && i < base.size && i < curr.size do
+      return none
+    let (o, n, c) := (old[i]!, new[i]!, curr[i]!)
+    -- `new` already contains the changes from `old` to `base`, so apply the later ones to `new`
+    let (o, n, c) := if ptrEq o base[i]! then (o, n, c) else (base[i]!, c, n)
+    if ptrEq o n then
+      curr := curr.set! i c
+    else if ptrEq o c then
+      curr := curr.set! i n
+    else if let some replay := ext.replay? then
+      -- both sides changed the state
+      let some s := replay o n c | return none
+      curr := curr.set! i s
+    else
+      curr := curr.set! i c
+  return some curr
+
 unsafe def imp : EnvExtensionInterface := {
   ext                  := Ext
   ensureExtensionsSize := ensureExtensionsArraySize
@@ -363,6 +398,7 @@ unsafe def imp : EnvExtensionInterface := {
   modifyState          := modifyState
   getState             := getState
   mkInitialExtStates   := mkInitialExtStates
+  replayExtStates      := replayExtStates
 }
 
 end EnvExtensionInterfaceUnsafe
@@ -396,8 +432,13 @@ end EnvExtension
    2- We do not use any synchronization primitive to access `envExtensionsRef`.
 
    Note that by default, extension state is *not* stored in .olean files and will not propagate across `import`s.
-   For that, you need to register a persistent environment extension. -/
-def registerEnvExtension {σ : Type} (mkInitial : IO σ) : IO (EnvExtension σ) := EnvExtensionInterfaceImp.registerExt mkInitial
+   For that, you need to register a persistent environment extension.
+
+   `replay? old new curr` should apply the changes made from `old` to `new` to `curr`, see
+   `Environment.replayExtensions`. Without it, the changes are dropped when both `new` and `curr`
+   changed the state, which is only fine for caches. -/
+def registerEnvExtension {σ : Type} (mkInitial : IO σ) (replay? : Option (σ → σ → σ → σ) := none) : IO (EnvExtension σ) :=
+  EnvExtensionInterfaceImp.registerExt mkInitial (replay?.map fun replay old new curr => some (replay old new curr))
 private def mkInitialExtensionStates : IO (Array EnvExtensionState) := EnvExtensionInterfaceImp.mkInitialExtStates
 
 @[export lean_mk_empty_environment]
@@ -493,11 +534,17 @@ structure PersistentEnvExtensionDescr (α β σ : Type) where
   addEntryFn      : σ → β → σ
   exportEntriesFn : σ → Array α
   statsFn         : σ → Format := fun _ => Format.nil
+  /--
+  `replay? old new curr` applies the local entries added from `old` to `new` to `curr`, see
+  `Environment.replayExtensions`. Persistent extensions without it cannot be replayed. -/
+  replay?         : Option (σ → σ → σ → σ) := none
 
 unsafe def registerPersistentEnvExtensionUnsafe {α β σ : Type} [Inhabited σ] (descr : PersistentEnvExtensionDescr α β σ) : IO (PersistentEnvExtension α β σ) := do
   let pExts ← persistentEnvExtensionsRef.get
   if pExts.any (fun ext => ext.name == descr.name) then throw (IO.userError s!"invalid environment extension, '{descr.name}' has already been used")
-  let ext ← registerEnvExtension do
+  let replay (old new curr : PersistentEnvExtensionState α σ) : Option (PersistentEnvExtensionState α σ) :=
+    descr.replay?.map fun replay => { curr with state := replay old.state new.state curr.state }
+  let ext ← EnvExtensionInterfaceImp.registerExt (replay? := some replay) do
     let initial ← descr.mkInitial
     let s : PersistentEnvExtensionState α σ := {
       importedEntries := #[],
@@ -539,6 +586,10 @@ def registerSimplePersistentEnvExtension {α σ : Type} [Inhabited σ] (descr :
       | (entries, s) => (e::entries, descr.addEntryFn s e),
     exportEntriesFn := fun s => descr.toArrayFn s.1.reverse,
     statsFn := fun s => format "number of local entries: " ++ format s.1.length
+    replay? := some fun (oldEntries, _) (newEntries, _) (entries, s) =>
+      -- `newEntries` extends `oldEntries` with the entries added in between, newest first
+      let added := newEntries.take (newEntries.length - oldEntries.length)
+      added.foldr (init := (entries, s)) fun e (entries, s) => (e::entries, descr.addEntryFn s e)
   }
 
 namespace SimplePersistentEnvExtension
@@ -978,6 +1029,35 @@ private def add (env : Environment) (cinfo : ConstantInfo) : Environment :=
   let env := registerNamePrefixes env cinfo.name
   env.addAux cinfo
 
+/--
+Adds a constant that has already been checked by the kernel in an environment that `env` extends,
+replacing any existing constant of the same name. Only used for merging asynchronously elaborated
+proofs, see `Lean.Elab.Command.AsyncProof`; unsafe as it bypasses the kernel.
+-/
+unsafe def addCheckedConstant (env : Environment) (cinfo : ConstantInfo) : Environment :=
+  env.add cinfo
+
+/--
+Removes the constant `declName` of the current module. Only used for replacing placeholder theorems
+of asynchronously elaborated proofs, see `Lean.Elab.Command.AsyncProof`; unsafe as other constants
+of `env` may still refer to it.
+-/
+unsafe def eraseConstant (env : Environment) (declName : Name) : Environment :=
+  { env with constants := { env.constants with map₂ := env.constants.map₂.erase declName } }
+
+/--
+Applies the changes to the extension states made from `old` to `new` to the extension states of
+`env`, where `new` and `base` are descendants of `old` and `env` is a descendant of `base`. States
+changed only on one side are taken from that side, and states changed on both sides are merged by the
+`replay?` function of their extension. Fails if a persistent extension changed on both sides has no
+such function. The changes from `old` to `base` must also have been made from `old` to `new`; for
+states changed by them, the changes from `base` to `env` are applied to `new` instead. Constants are
+not merged. Used for merging asynchronously elaborated proofs, see `Lean.Elab.Command.AsyncProof`.
+-/
+def replayExtensions (env : Environment) (old new : Environment) (base := old) : Option Environment := do
+  let exts ← EnvExtensionInterfaceImp.replayExtStates old.extensions new.extensions base.extensions env.extensions
+  return { env with extensions := exts }
+
 @[export lean_display_stats]
 def displayStats (env : Environment) : IO Unit := do
   let pExtDescrs ← persistentEnvExtensionsRef.get
@@ -152,6 +152,12 @@ structure CommandParsedSnapshotData extends Snapshot where
   finishedSnap : SnapshotTask CommandFinishedSnapshot
   /-- Cache for `save`; to be replaced with incrementality. -/
   tacticCache : IO.Ref Tactic.Cache
+  /--
+  Cache for the semantic tokens of this command, type dependent on the language server. As the
+  snapshot is only reused for commands before the first change, it stays valid across document
+  versions.
+  -/
+  semanticTokensRef? : Option (IO.Ref (Option Dynamic)) := none
 deriving Nonempty
 
 /-- State after a command has been parsed. -/
@@ -275,6 +281,11 @@ structure SetupImportsResult where
   opts : Options
   /-- Kernel trust level. -/
   trustLevel : UInt32 := 0
+  /--
+  Environment of the imports if they have already been loaded by other means, e.g. inherited from
+  a language server worker zygote.
+  -/
+  importedEnv? : Option Environment := none
 
 /--
 Entry point of the Lean language processor.
@@ -377,9 +388,12 @@ where
       let setup ← match (← setupImports stx) with
         | .ok setup => pure setup
         | .error snap => return snap
-      -- allows `headerEnv` to be leaked, which would live until the end of the process anyway
-      let (headerEnv, msgLog) ← Elab.processHeader (leakEnv := true) stx setup.opts .empty
-        ctx.toInputContext setup.trustLevel
+      let (headerEnv, msgLog) ← if let some env := setup.importedEnv? then
+        pure (env, .empty)
+      else
+        -- allows `headerEnv` to be leaked, which would live until the end of the process anyway
+        Elab.processHeader (leakEnv := true) stx setup.opts .empty ctx.toInputContext
+          setup.trustLevel
       let diagnostics := (← Snapshot.Diagnostics.ofMessageLog msgLog)
       if msgLog.hasErrors then
         return { diagnostics, result? := none }
@@ -482,6 +496,7 @@ where
         elabSnap := { range? := finishedSnap.range?, task := elabPromise.result }
         finishedSnap
         tacticCache
+        semanticTokensRef? := some (← IO.mkRef none)
       }
 
   doElab (stx : Syntax) (cmdState : Command.State) (hasParseError : Bool) (beginPos : String.Pos)
@@ -493,6 +508,7 @@ where
     -- TODO: do tactic snapshots, reuse old state for them
     SnapshotTask.ofIO (stx.getRange?.getD ⟨beginPos, beginPos⟩) do
       let scope := cmdState.scopes.head!
+      let numAsyncProofs := cmdState.asyncProofs.size
       let cmdStateRef ← IO.mkRef { cmdState with messages := .empty }
       /-
       The same snapshot may be executed by different tasks. So, to make sure `elabCommandTopLevel`
@@ -532,12 +548,25 @@ where
           pos      := ctx.fileMap.toPosition beginPos
           data     := output
         }
-      let cmdState := { cmdState with messages }
-      -- definitely resolve eventually
-      snap.new.resolve <| .ofTyped { diagnostics := .empty : SnapshotLeaf }
+      let mut cmdState := { cmdState with messages }
+      if let some proof := cmdState.asyncProofs[numAsyncProofs]? then
+        -- report the proof elaborated asynchronously by this command (see `Elab.async`) as soon as
+        -- it is finished instead of when it is waited for
+        cmdState := { cmdState with
+          asyncProofs := cmdState.asyncProofs.set! numAsyncProofs { proof with reported := true } }
+        let _ ← BaseIO.mapTask (t := proof.task) fun (_, messages, trees) => do
+          snap.new.resolve <| .ofTyped {
+            diagnostics := (← Snapshot.Diagnostics.ofMessageLog messages)
+            infoTree? := trees[0]?
+            : SnapshotLeaf
+          }
+      else
+        -- definitely resolve eventually
+        snap.new.resolve <| .ofTyped { diagnostics := .empty : SnapshotLeaf }
       return {
         diagnostics := (← Snapshot.Diagnostics.ofMessageLog cmdState.messages)
-        infoTree? := some cmdState.infoState.trees[0]!
+        -- missing if the proof of the command is elaborated asynchronously
+        infoTree? := cmdState.infoState.trees[0]?
         cmdState
       }
 
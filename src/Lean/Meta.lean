@@ -5,6 +5,7 @@ Authors: Leonardo de Moura
 -/
 prelude
 import Lean.Meta.Basic
+import Lean.Meta.SharedCache
 import Lean.Meta.LevelDefEq
 import Lean.Meta.WHNF
 import Lean.Meta.InferType
@@ -116,7 +116,10 @@ structure EqnsExtState where
 
 /- We generate the equations on demand. -/
 builtin_initialize eqnsExt : EnvExtension EqnsExtState ←
-  registerEnvExtension (pure {})
+  registerEnvExtension (pure {}) (replay? := some fun old new s =>
+    new.map.foldl (init := s) fun s declName eqs =>
+      if old.map.contains declName || s.map.contains declName then s
+      else { map := s.map.insert declName eqs, mapInv := eqs.foldl (init := s.mapInv) (·.insert · declName) })
 
 /--
 Simple equation theorem for nonrecursive definitions.
@@ -1955,6 +1955,39 @@ private def mkCacheKey (t s : Expr) : MetaM DefEqCacheKeyInfo := do
   let key := if Expr.quickLt t s then (t, s) else (s, t)
   return { key, kind }
 
+def DefEqCache.update (cache : DefEqCache) (mode : TransparencyMode) (key : Expr × Expr) (result : Bool) : DefEqCache :=
+  match mode with
+  | .reducible => { cache with reducible := cache.reducible.insert key result }
+  | .instances => { cache with instances := cache.instances.insert key result }
+  | .default   => { cache with default   := cache.default.insert key result }
+  | .all       => { cache with all       := cache.all.insert key result }
+
+builtin_initialize sharedDefEqCache : SharedCache ((Expr × Expr) × TransparencyMode) Bool ← SharedCache.new
+
+/--
+Besides the imported modules, `isDefEq` results for closed terms with imported constants depend on
+the reducibility settings of imported constants changed in the current module and on the unification
+hints. As in `whnfFingerprint`, any change of these extension states clears the shared cache.
+-/
+private def defEqFingerprint (env : Environment) : SharedCache.Fingerprint :=
+  #[SharedCache.Fingerprint.obj env.header, SharedCache.Fingerprint.obj (reducibilityExtraExt.getState env),
+    SharedCache.Fingerprint.obj (unificationHintExtension.getState env)]
+
+/--
+Returns `true` if the result for the permanent cache key `key` can be shared with other `MetaM` runs.
+We only share results for the transparency modes and the configuration used by default.
+-/
+private def useSharedDefEqCache (key : Expr × Expr) : MetaM Bool := do
+  unless (← useSharedCache) do
+    return false
+  let cfg ← getConfig
+  let opts ← getOptions
+  return !key.1.hasFVar && !key.2.hasFVar &&
+    (cfg.transparency matches .default | .all) &&
+    cfg.proofIrrelevance && cfg.etaStruct == .all && cfg.offsetCnstrs && cfg.unificationHints &&
+    backward.isDefEq.lazyProjDelta.get opts && backward.isDefEq.lazyWhnfCore.get opts &&
+    smartUnfolding.get opts
+
 private def getCachedResult (keyInfo : DefEqCacheKeyInfo) : MetaM LBool := do
   let cache ← match keyInfo.kind with
     | .transient => pure (← get).cache.defEqTrans
@@ -1966,20 +1999,24 @@ private def getCachedResult (keyInfo : DefEqCacheKeyInfo) : MetaM LBool := do
     | .all       => cache.all
   match cache.find? keyInfo.key with
   | some val => return val.toLBool
-  | none => return .undef
-
-def DefEqCache.update (cache : DefEqCache) (mode : TransparencyMode) (key : Expr × Expr) (result : Bool) : DefEqCache :=
-  match mode with
-  | .reducible => { cache with reducible := cache.reducible.insert key result }
-  | .instances => { cache with instances := cache.instances.insert key result }
-  | .default   => { cache with default   := cache.default.insert key result }
-  | .all       => { cache with all       := cache.all.insert key result }
+  | none =>
+    if keyInfo.kind matches .permanent then
+      if (← useSharedDefEqCache keyInfo.key) then
+        let mode ← getTransparency
+        if let some val ← sharedDefEqCache.find? (defEqFingerprint (← getEnv)) (keyInfo.key, mode) then
+          modifyDefEqPermCache fun c => c.update mode keyInfo.key val
+          return val.toLBool
+    return .undef
 
 private def cacheResult (keyInfo : DefEqCacheKeyInfo) (result : Bool) : MetaM Unit := do
   let mode ← getTransparency
   let key := keyInfo.key
   match keyInfo.kind with
-  | .permanent => modifyDefEqPermCache fun c => c.update mode key result
+  | .permanent =>
+    modifyDefEqPermCache fun c => c.update mode key result
+    let env ← getEnv
+    if (← useSharedDefEqCache key) && isSharedCacheKey env key.1 && isSharedCacheKey env key.2 then
+      sharedDefEqCache.insert (defEqFingerprint env) (meta.sharedCache.maxSize.get (← getOptions)) (key, mode) result
   | .transient =>
     /-
     We must ensure that all assigned metavariables in the key are replaced by their current assignments.
@@ -92,6 +92,7 @@ builtin_initialize instanceExtension : SimpleScopedEnvExtension InstanceEntry In
   registerSimpleScopedEnvExtension {
     initial  := {}
     addEntry := addInstanceEntry
+    storeStateSnapshots := true
   }
 
 private def mkInstanceKey (e : Expr) : MetaM (Array InstanceKey) := do
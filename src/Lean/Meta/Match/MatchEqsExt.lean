@@ -23,7 +23,10 @@ structure MatchEqnsExtState where
 
 /- We generate the equations and splitter on demand, and do not save them on .olean files. -/
 builtin_initialize matchEqnsExt : EnvExtension MatchEqnsExtState ←
-  registerEnvExtension (pure {})
+  registerEnvExtension (pure {}) (replay? := some fun old new s =>
+    new.map.foldl (init := s) fun s matchDeclName eqns =>
+      if old.map.contains matchDeclName || s.map.contains matchDeclName then s
+      else { map := s.map.insert matchDeclName eqns })
 
 def registerMatchEqns (matchDeclName : Name) (matchEqns : MatchEqns) : CoreM Unit :=
   modifyEnv fun env => matchEqnsExt.modifyState env fun s => { s with map := s.map.insert matchDeclName matchEqns }
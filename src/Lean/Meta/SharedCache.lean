@@ -0,0 +1,158 @@
+/-
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Lean.Meta.Basic
+
+/-!
+# Process-wide caches for `MetaM`
+
+The caches in `Meta.Cache` are local to a single `MetaM` run, so, for example, `whnf` and `isDefEq`
+problems on the same closed terms are solved again for every declaration. A `SharedCache` is a
+size-bounded cache stored in a global `IO.Ref` that can be used from all `MetaM` runs and threads
+of the process.
+
+Cached results may only depend on the key and on a *fingerprint* of the parts of the environment
+they were computed in, such as the imported modules and the reducibility settings. Fingerprints are
+arrays of objects compared by pointer. The cache keeps the objects of the current fingerprint alive
+so that their addresses cannot be reused, and it is cleared when a result for a different
+fingerprint is inserted. Fingerprints are coarse: the `whnf` and `isDefEq` caches use the whole state
+of the reducibility extension, so every reducibility attribute in the current module resets them.
+
+The cache consists of two generations of at most `meta.sharedCache.maxSize` entries each. When the
+current generation is full, it replaces the previous one, and hits in the previous generation are
+copied to the current one if it is not full yet.
+
+Lookups only read the state, so that concurrent lookups do not contend for the reference; it is only
+modified by insertions and by copying hits from the previous generation. The numbers of hits and
+misses are counted in separate references for the same reason.
+-/
+
+namespace Lean.Meta
+
+register_builtin_option meta.sharedCache : Bool := {
+  defValue := false
+  descr    := "share the `whnf` and `isDefEq` caches for closed terms between declarations and threads"
+}
+
+register_builtin_option meta.sharedCache.maxSize : Nat := {
+  defValue := 65536
+  descr    := "maximum number of entries per generation of the shared `whnf` and `isDefEq` caches"
+}
+
+structure SharedCache.Stats where
+  hits    : Nat := 0
+  misses  : Nat := 0
+  /-- Number of times the cache was cleared because of a different fingerprint. -/
+  resets  : Nat := 0
+  deriving Inhabited, Repr
+
+instance : ToString SharedCache.Stats where
+  toString s :=
+    let total := s.hits + s.misses
+    let rate := if total == 0 then 0 else s.hits * 100 / total
+    s!"{s.hits} hits, {s.misses} misses ({rate}% hit rate), {s.resets} resets"
+
+/-- Objects identifying the parts of the environment that cached results depend on. -/
+abbrev SharedCache.Fingerprint := Array NonScalar
+
+private unsafe def toNonScalarUnsafe (a : α) : NonScalar :=
+  unsafeCast a
+
+/-- Turns `a` into a fingerprint component. -/
+@[implemented_by toNonScalarUnsafe]
+opaque SharedCache.Fingerprint.obj (a : α) : NonScalar
+
+private unsafe def SharedCache.Fingerprint.ptrEqUnsafe (f₁ f₂ : Fingerprint) : Bool := Id.run do
+  if f₁.size != f₂.size then
+    return false
+  for a in f₁, b in f₂ do
+    unless _root_.ptrEq a b do
+      return false
+  return true
+
+@[implemented_by SharedCache.Fingerprint.ptrEqUnsafe]
+opaque SharedCache.Fingerprint.ptrEq (f₁ f₂ : Fingerprint) : Bool
+
+structure SharedCache.State (α β : Type) [BEq α] [Hashable α] where
+  fingerprint : Fingerprint := #[]
+  current     : PHashMap α β := {}
+  previous    : PHashMap α β := {}
+  /-- Maximum size of a generation, as given by the last `insert`. -/
+  maxSize     : Nat := 0
+  /-- Number of times the cache was cleared because of a different fingerprint. -/
+  resets      : Nat := 0
+  deriving Inhabited
+
+structure SharedCache (α β : Type) [BEq α] [Hashable α] where
+  ref    : IO.Ref (SharedCache.State α β)
+  hits   : IO.Ref Nat
+  misses : IO.Ref Nat
+
+instance [BEq α] [Hashable α] : Nonempty (SharedCache α β) :=
+  ⟨{ ref := Classical.ofNonempty, hits := Classical.ofNonempty, misses := Classical.ofNonempty }⟩
+
+namespace SharedCache
+
+variable {α β : Type} [BEq α] [Hashable α]
+
+def new : IO (SharedCache α β) :=
+  return { ref := (← IO.mkRef {}), hits := (← IO.mkRef 0), misses := (← IO.mkRef 0) }
+
+/-- Returns the result cached for `k`, if it was computed for the fingerprint `fp`. -/
+def find? (c : SharedCache α β) (fp : Fingerprint) (k : α) : BaseIO (Option β) := do
+  let s ← c.ref.get
+  let r? ← if !s.fingerprint.ptrEq fp then pure none else
+    match s.current.find? k with
+    | some v => pure (some v)
+    | none   =>
+      match s.previous.find? k with
+      | some v =>
+        if s.current.size < s.maxSize then
+          c.ref.modify fun s =>
+            if s.fingerprint.ptrEq fp && s.current.size < s.maxSize then
+              { s with current := s.current.insert k v }
+            else
+              s
+        pure (some v)
+      | none   => pure none
+  if r?.isSome then
+    c.hits.modify (· + 1)
+  else
+    c.misses.modify (· + 1)
+  return r?
+
+/-- Caches `v` as the result for `k` computed for the fingerprint `fp`. -/
+def insert (c : SharedCache α β) (fp : Fingerprint) (maxSize : Nat) (k : α) (v : β) : BaseIO Unit :=
+  c.ref.modify fun s =>
+    let s := if s.fingerprint.ptrEq fp then s else
+      { fingerprint := fp, resets := if s.fingerprint.isEmpty then s.resets else s.resets + 1 }
+    let s := { s with maxSize }
+    if s.current.size < maxSize then
+      { s with current := s.current.insert k v }
+    else
+      { s with previous := s.current, current := PersistentHashMap.empty.insert k v }
+
+def getStats (c : SharedCache α β) : BaseIO Stats :=
+  return { hits := (← c.hits.get), misses := (← c.misses.get), resets := (← c.ref.get).resets }
+
+end SharedCache
+
+/--
+Returns `true` if the shared caches are enabled and the results of the current `MetaM` run for closed
+terms can be shared, i.e., they do not depend on its configuration.
+-/
+def useSharedCache : MetaM Bool := do
+  return meta.sharedCache.get (← getOptions) && (← read).canUnfold?.isNone
+
+/--
+Returns `true` if `e` can be used as a key of a shared cache, i.e., it does not contain free variables or
+metavariables, and all its constants are imported. Constants of the current module may be redefined,
+e.g. when re-elaborating a file in the language server.
+-/
+def isSharedCacheKey (env : Environment) (e : Expr) : Bool :=
+  !e.hasFVar && !e.hasMVar && !e.hasLooseBVars &&
+    (e.find? fun e => e.isConst && (env.getModuleIdxFor? e.constName!).isNone).isNone
+
+end Lean.Meta
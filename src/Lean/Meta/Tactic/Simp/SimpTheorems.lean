@@ -375,6 +375,7 @@ def mkSimpExt (name : Name := by exact decl_name%) : IO SimpExtension :=
       | SimpEntry.thm e => addSimpTheoremEntry d e
       | SimpEntry.toUnfold n => d.addDeclToUnfoldCore n
       | SimpEntry.toUnfoldThms n thms => d.registerDeclToUnfoldThms n thms
+    storeStateSnapshots := true
   }
 
 abbrev SimpExtensionMap := HashMap Name SimpExtension
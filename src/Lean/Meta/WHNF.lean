@@ -12,6 +12,7 @@ import Lean.Meta.Offset
 import Lean.Meta.CtorRecognizer
 import Lean.Meta.Match.MatcherInfo
 import Lean.Meta.Match.MatchPatternAttr
+import Lean.Meta.SharedCache
 
 namespace Lean.Meta
 
@@ -929,21 +930,50 @@ def reduceNat? (e : Expr) : MetaM (Option Expr) :=
     | .all     => return true
     | _        => return false
 
+builtin_initialize sharedWhnfCache : SharedCache (ExprStructEq × TransparencyMode) Expr ← SharedCache.new
+
+/--
+Besides the imported modules, `whnf` results for closed terms with imported constants depend on the
+reducibility settings of imported constants changed in the current module. The fingerprint contains
+the whole state of `reducibilityExtraExt` as that is cheaper than extracting these settings, so *any*
+reducibility attribute in the current module, including `local` and `scoped` ones and ones on local
+constants, clears the shared cache when the next result is cached.
+-/
+private def whnfFingerprint (env : Environment) : SharedCache.Fingerprint :=
+  #[SharedCache.Fingerprint.obj env.header, SharedCache.Fingerprint.obj (reducibilityExtraExt.getState env)]
+
+@[inline] private def useSharedWHNFCache : MetaM Bool := do
+  return (← useSharedCache) && smartUnfolding.get (← getOptions)
+
+private def cacheLocal (mode : TransparencyMode) (e r : Expr) : MetaM Unit :=
+  match mode with
+  | .default => modify fun s => { s with cache.whnfDefault := s.cache.whnfDefault.insert e r }
+  | .all     => modify fun s => { s with cache.whnfAll     := s.cache.whnfAll.insert e r }
+  | _        => unreachable!
+
 @[inline] private def cached? (useCache : Bool) (e : Expr) : MetaM (Option Expr) := do
   if useCache then
-    match (← getConfig).transparency with
-    | .default => return (← get).cache.whnfDefault.find? e
-    | .all     => return (← get).cache.whnfAll.find? e
-    | _        => unreachable!
+    let mode := (← getConfig).transparency
+    let r? ← match mode with
+      | .default => pure <| (← get).cache.whnfDefault.find? e
+      | .all     => pure <| (← get).cache.whnfAll.find? e
+      | _        => unreachable!
+    if r?.isNone && !e.hasLevelMVar then
+      if (← useSharedWHNFCache) then
+        if let some r ← sharedWhnfCache.find? (whnfFingerprint (← getEnv)) (e, mode) then
+          cacheLocal mode e r
+          return some r
+    return r?
   else
     return none
 
 private def cache (useCache : Bool) (e r : Expr) : MetaM Expr := do
   if useCache then
-    match (← getConfig).transparency with
-    | .default => modify fun s => { s with cache.whnfDefault := s.cache.whnfDefault.insert e r }
-    | .all     => modify fun s => { s with cache.whnfAll     := s.cache.whnfAll.insert e r }
-    | _        => unreachable!
+    let mode := (← getConfig).transparency
+    cacheLocal mode e r
+    let env ← getEnv
+    if (← useSharedWHNFCache) && isSharedCacheKey env e then
+      sharedWhnfCache.insert (whnfFingerprint env) (meta.sharedCache.maxSize.get (← getOptions)) (e, mode) r
   return r
 
 @[export lean_whnf]
@@ -12,9 +12,34 @@ namespace Lean
 
 namespace ScopedEnvExtension
 
+/--
+Global state of a scoped environment extension after a module, i.e. the result of adding the global
+entries of the module and of all its imports. If requested by `storeStateSnapshots`, it is stored in
+the .olean file of the module for extensions with `Descr.storeStateSnapshots`. Importing a set of
+modules whose import closure starts with the same modules in the same order then starts from the
+snapshot instead of adding all these entries again, and lookups in the parts of the state not
+modified afterwards run directly against the memory-mapped .olean file.
+
+As each snapshot is a full copy of the state, storing one in every module of a library would take
+space quadratic in the length of its import chains. A module therefore only stores a snapshot if it
+contains at least twice as many entries as the snapshot its own state was imported from, so that
+the sizes of the snapshots along each import chain grow geometrically.
+-/
+structure StateSnapshot where
+  /-- Number of modules whose entries are contained, i.e. the imports of the module and itself. -/
+  numModules  : Nat
+  /-- Hash of the names of these modules in import order; see `hashModulePrefixes`. -/
+  modulesHash : UInt64
+  /-- Number of global entries contained in the state. -/
+  numEntries  : Nat
+  /-- The state, of type `σ` of the extension. -/
+  state       : NonScalar
+
 inductive Entry (α : Type) where
   | global : α → Entry α
   | scoped : Name → α → Entry α
+  /-- The last entry of a module if it stores a state snapshot. -/
+  | snapshot : StateSnapshot → Entry α
 
 structure State (σ : Type) where
   state        : σ
@@ -28,6 +53,17 @@ structure StateStack (α : Type) (β : Type) (σ : Type) where
   stateStack    : List (State σ) := {}
   scopedEntries : ScopedEntries β := {}
   newEntries    : List (Entry α) := []
+  /--
+  State of the imported and the global entries of the current module, without local or scoped
+  entries; only tracked if `Descr.storeStateSnapshots` is set.
+  -/
+  globalState?  : Option σ := none
+  /-- Number of entries added to `globalState?`, including the ones of the imported snapshot. -/
+  numGlobalEntries : Nat := 0
+  /-- Number of entries of the snapshot the imported state was started from, or `0`. -/
+  numSnapshotEntries : Nat := 0
+  /-- Snapshot to be exported along with `newEntries`. -/
+  snapshot?     : Option StateSnapshot := none
   deriving Inhabited
 
 structure Descr (α : Type) (β : Type) (σ : Type) where
@@ -37,6 +73,12 @@ structure Descr (α : Type) (β : Type) (σ : Type) where
   toOLeanEntry   : β → α
   addEntry       : σ → β → σ
   finalizeImport : σ → σ := id
+  /--
+  Whether the state may be stored in .olean files and imported from them; see `StateSnapshot`.
+  This should only be used for extensions whose imported state is expensive to compute and whose
+  `finalizeImport` is idempotent.
+  -/
+  storeStateSnapshots : Bool := false
 
 instance [Inhabited α] : Inhabited (Descr α β σ) where
   default := {
@@ -55,29 +97,73 @@ def ScopedEntries.insert (scopedEntries : ScopedEntries β) (ns : Name) (b : β)
   | none    => { map := scopedEntries.map.insert ns <| ({} : PArray β).push b }
   | some bs => { map := scopedEntries.map.insert ns <| bs.push b }
 
-def addImportedFn (descr : Descr α β σ) (as : Array (Array (Entry α))) : ImportM (StateStack α β σ) := do
+/-- `(hashModulePrefixes moduleNames)[i]` is the hash of the first `i` module names. -/
+def hashModulePrefixes (moduleNames : Array Name) : Array UInt64 := Id.run do
+  let mut h : UInt64 := 7
+  let mut hs := Array.mkEmpty (moduleNames.size + 1) |>.push h
+  for n in moduleNames do
+    h := mixHash h (hash n)
+    hs := hs.push h
+  return hs
+
+/-- Returns the state snapshot covering the longest prefix of the imported modules, if any. -/
+def findStateSnapshot? (moduleNames : Array Name) (as : Array (Array (Entry α))) :
+    Option StateSnapshot := Id.run do
+  unless as.any (·.back? matches some (.snapshot _)) do
+    return none
+  let hashes := hashModulePrefixes moduleNames
+  for i' in [0:as.size] do
+    let i := as.size - 1 - i'
+    if let some (.snapshot snapshot) := as[i]!.back? then
+      if snapshot.numModules == i + 1 && hashes[i + 1]! == snapshot.modulesHash then
+        return some snapshot
+  return none
+
+unsafe def addImportedFn (descr : Descr α β σ) (as : Array (Array (Entry α))) : ImportM (StateStack α β σ) := do
   let mut s ← descr.mkInitial
+  -- global entries of modules up to `start` are already contained in `s`
+  let mut start := 0
+  let mut numSnapshotEntries := 0
+  if descr.storeStateSnapshots then
+    if let some snapshot := findStateSnapshot? (← read).env.header.moduleNames as then
+      s := unsafeCast snapshot.state
+      start := snapshot.numModules
+      numSnapshotEntries := snapshot.numEntries
+  let mut numGlobalEntries := numSnapshotEntries
   let mut scopedEntries : ScopedEntries β := {}
-  for a in as do
-    for e in a do
+  for h : i in [0:as.size] do
+    for e in as[i]'h.upper do
       match e with
       | Entry.global a =>
-        let b ← descr.ofOLeanEntry s a
-        s := descr.addEntry s b
+        if i ≥ start then
+          let b ← descr.ofOLeanEntry s a
+          s := descr.addEntry s b
+          numGlobalEntries := numGlobalEntries + 1
       | Entry.scoped ns a =>
         let b ← descr.ofOLeanEntry s a
         scopedEntries := scopedEntries.insert ns b
+      | Entry.snapshot _ => pure ()
   s := descr.finalizeImport s
-  return { stateStack := [ { state := s } ], scopedEntries := scopedEntries }
+  return {
+    stateStack    := [ { state := s } ]
+    scopedEntries := scopedEntries
+    globalState?  := if descr.storeStateSnapshots then some s else none
+    numGlobalEntries, numSnapshotEntries
+  }
 
 def addEntryFn (descr : Descr α β σ) (s : StateStack α β σ) (e : Entry β) : StateStack α β σ :=
   match s with
-  | { stateStack := stateStack, scopedEntries := scopedEntries, newEntries := newEntries } =>
+  | { stateStack := stateStack, scopedEntries := scopedEntries, newEntries := newEntries,
+      globalState? := globalState?, numGlobalEntries := numGlobalEntries,
+      numSnapshotEntries := numSnapshotEntries, snapshot? := snapshot? } =>
     match e with
     | Entry.global b => {
         scopedEntries := scopedEntries
         newEntries    := (Entry.global (descr.toOLeanEntry b)) :: newEntries
         stateStack    := stateStack.map fun s => { s with state := descr.addEntry s.state b }
+        globalState?  := globalState?.map (descr.addEntry · b)
+        numGlobalEntries := numGlobalEntries + 1
+        numSnapshotEntries, snapshot?
       }
     | Entry.«scoped» ns b =>
       {
@@ -88,10 +174,15 @@ def addEntryFn (descr : Descr α β σ) (s : StateStack α β σ) (e : Entry β)
             { s with state := descr.addEntry s.state b }
           else
             s
+        globalState?, numGlobalEntries, numSnapshotEntries, snapshot?
       }
+    | Entry.snapshot _ => s
 
 def exportEntriesFn (s : StateStack α β σ) : Array (Entry α) :=
-  s.newEntries.toArray.reverse
+  let entries := s.newEntries.toArray.reverse
+  match s.snapshot? with
+  | some snapshot => entries.push (.snapshot snapshot)
+  | none          => entries
 
 end ScopedEnvExtension
 
@@ -156,6 +247,29 @@ def ScopedEnvExtension.add [Monad m] [MonadResolveName m] [MonadEnv m] (ext : Sc
   let ns ← getCurrNamespace
   modifyEnv (ext.addCore · b kind ns)
 
+unsafe def ScopedEnvExtension.storeStateSnapshotUnsafe (ext : ScopedEnvExtension α β σ) (env : Environment) : Environment :=
+  let s := ext.ext.getState env
+  match s.globalState? with
+  | some state =>
+    if s.numGlobalEntries > 0 && s.numGlobalEntries ≥ 2 * s.numSnapshotEntries then
+      let moduleNames := env.header.moduleNames.push env.mainModule
+      ext.ext.setState env { s with snapshot? := some {
+        numModules  := moduleNames.size
+        modulesHash := (hashModulePrefixes moduleNames).back
+        numEntries  := s.numGlobalEntries
+        state       := unsafeCast state
+      } }
+    else
+      env
+  | none => env
+
+/--
+Makes the .olean file of the current module include a `StateSnapshot` of the extension, if supported
+and if the module contains at least twice as many entries as the snapshot it imported.
+-/
+@[implemented_by ScopedEnvExtension.storeStateSnapshotUnsafe]
+opaque ScopedEnvExtension.storeStateSnapshot (ext : ScopedEnvExtension α β σ) (env : Environment) : Environment
+
 def ScopedEnvExtension.getState [Inhabited σ] (ext : ScopedEnvExtension α β σ) (env : Environment) : σ :=
   match ext.ext.getState env |>.stateStack with
   | top :: _ => top.state
@@ -199,6 +313,13 @@ def activateScoped [Monad m] [MonadEnv m] [MonadLiftT (ST IO.RealWorld) m] (name
   for ext in (← scopedEnvExtensionsRef.get) do
     modifyEnv (ext.activateScoped · namespaceName)
 
+/-- Makes the .olean file of the current module include a `StateSnapshot` of each extension that supports it. -/
+def ScopedEnvExtension.storeStateSnapshots (env : Environment) : BaseIO Environment := do
+  let mut env := env
+  for ext in (← scopedEnvExtensionsRef.get) do
+    env := ext.storeStateSnapshot env
+  return env
+
 abbrev SimpleScopedEnvExtension (α : Type) (σ : Type) := ScopedEnvExtension α α σ
 
 structure SimpleScopedEnvExtension.Descr (α : Type) (σ : Type) where
@@ -206,6 +327,8 @@ structure SimpleScopedEnvExtension.Descr (α : Type) (σ : Type) where
   addEntry       : σ → α → σ
   initial        : σ
   finalizeImport : σ → σ := id
+  /-- See `ScopedEnvExtension.Descr.storeStateSnapshots`. -/
+  storeStateSnapshots : Bool := false
 
 def registerSimpleScopedEnvExtension (descr : SimpleScopedEnvExtension.Descr α σ) : IO (SimpleScopedEnvExtension α σ) := do
   registerScopedEnvExtension {
@@ -215,6 +338,7 @@ def registerSimpleScopedEnvExtension (descr : SimpleScopedEnvExtension.Descr α
     toOLeanEntry   := id
     ofOLeanEntry   := fun _ a => return a
     finalizeImport := descr.finalizeImport
+    storeStateSnapshots := descr.storeStateSnapshots
   }
 
 end Lean
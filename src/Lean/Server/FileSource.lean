@@ -76,6 +76,9 @@ instance : FileSource SemanticTokensParams :=
 instance : FileSource SemanticTokensRangeParams :=
   ⟨fun p => fileSource p.textDocument⟩
 
+instance : FileSource SemanticTokensDeltaParams :=
+  ⟨fun p => fileSource p.textDocument⟩
+
 instance : FileSource FoldingRangeParams :=
   ⟨fun p => fileSource p.textDocument⟩
 
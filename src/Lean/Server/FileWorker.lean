@@ -29,6 +29,7 @@ import Lean.Server.FileWorker.SetupFile
 import Lean.Server.Rpc.Basic
 import Lean.Widget.InteractiveDiagnostic
 import Lean.Server.ImportCompletion
+import Lean.Server.Zygote
 
 /-!
 For general server architecture, see `README.md`. For details of IPC communication, see `Watchdog.lean`.
@@ -81,6 +82,11 @@ structure WorkerContext where
   Diagnostics that are included in every single `textDocument/publishDiagnostics` notification.
   -/
   stickyDiagnosticsRef : IO.Ref StickyDiagnostics
+  /--
+  Semantic tokens of the full document last sent to the client, possibly for a previous document
+  version. Used for answering `textDocument/semanticTokens/full/delta` requests.
+  -/
+  semanticTokensRef    : IO.Ref (Option SemanticTokens)
   hLog                 : FS.Stream
   initParams           : InitializeParams
   processor            : Parser.InputContext → BaseIO Lean.Language.Lean.InitialSnapshot
@@ -144,19 +150,20 @@ This option can only be set on the command line, not in the lakefile or via `set
   -/
   structure MemorizedInteractiveDiagnostics where
     diags : Array Widget.InteractiveDiagnostic
+    /-- `diags` converted to non-interactive diagnostics. -/
+    lspDiags : Array Lsp.Diagnostic
   deriving TypeName
 
   /--
   Sends a `textDocument/publishDiagnostics` notification to the client that contains the diagnostics
-  in `ctx.stickyDiagnosticsRef` and `doc.diagnosticsRef`.
+  in `ctx.stickyDiagnosticsRef` and `doc.lspDiagnosticsRef`.
   -/
   private def publishDiagnostics (ctx : WorkerContext) (doc : EditableDocumentCore)
       : BaseIO Unit := do
     let stickyInteractiveDiagnostics ← ctx.stickyDiagnosticsRef.get
-    let docInteractiveDiagnostics ← doc.diagnosticsRef.get
+    let docDiagnostics ← doc.lspDiagnosticsRef.get
     let diagnostics :=
-      stickyInteractiveDiagnostics.toArray ++ docInteractiveDiagnostics
-      |>.map (·.toDiagnostic)
+      stickyInteractiveDiagnostics.toArray.map (·.toDiagnostic) ++ docDiagnostics
     let notification := mkPublishDiagnosticsNotification doc.meta diagnostics
     ctx.chanOut.send notification
 
@@ -197,17 +204,21 @@ This option can only be set on the command line, not in the lakefile or via `set
   where
     go (node : SnapshotTree) (st : ReportSnapshotsState) : BaseIO (Task ReportSnapshotsState) := do
       if !node.element.diagnostics.msgLog.isEmpty then
-        let diags ←
+        let memorized ←
           if let some memorized ← node.element.diagnostics.interactiveDiagsRef?.bindM fun ref => do
               return (← ref.get).bind (·.get? MemorizedInteractiveDiagnostics) then
-            pure memorized.diags
+            pure memorized
           else
             let diags ← node.element.diagnostics.msgLog.toArray.mapM
               (Widget.msgToInteractiveDiagnostic doc.meta.text · ctx.clientHasWidgets)
+            -- converted only once so that publishing does not repeat the work for all previous
+            -- snapshots
+            let memorized := { diags, lspDiags := diags.map (·.toDiagnostic) }
             if let some cacheRef := node.element.diagnostics.interactiveDiagsRef? then
-              cacheRef.set <| some <| .mk { diags : MemorizedInteractiveDiagnostics }
-            pure diags
-        doc.diagnosticsRef.modify (· ++ diags)
+              cacheRef.set <| some <| .mk memorized
+            pure memorized
+        doc.diagnosticsRef.modify (· ++ memorized.diags)
+        doc.lspDiagnosticsRef.modify (· ++ memorized.lspDiags)
         if st.hasBlocked then
           publishDiagnostics ctx doc
 
@@ -260,6 +271,15 @@ abbrev WorkerM := ReaderT WorkerContext <| StateRefT WorkerState IO
 /-- Makes sure we load imports at most once per process as they cannot be unloaded. -/
 private builtin_initialize importsLoadedRef : IO.Ref Bool ← IO.mkRef false
 
+/-- Imports loaded by the zygote this worker was forked from; see `Lean.Server.Zygote`. -/
+private structure ZygoteImports where
+  imports    : Array Import
+  searchPath : SearchPath
+  opts       : Options
+  env        : Environment
+
+private builtin_initialize zygoteImportsRef : IO.Ref (Option ZygoteImports) ← IO.mkRef none
+
 open Language Lean in
 /--
 Callback from Lean language processor after parsing imports that requests necessary information from
@@ -319,9 +339,18 @@ def setupImports (meta : DocumentMeta) (cmdlineOpts : Options) (chanOut : Channe
   -- override cmdline options with file options
   let opts := cmdlineOpts.mergeBy (fun _ _ fileOpt => fileOpt) fileSetupResult.fileOptions
 
+  let mut importedEnv? := none
+  if let some zygote ← zygoteImportsRef.get then
+    unless Zygote.importsKey zygote.imports == Zygote.importsKey imports &&
+        zygote.searchPath == (← searchPathRef.get) && zygote.opts == opts do
+      -- the imports of the zygote cannot be unloaded either
+      IO.Process.exit Zygote.staleExitCode
+    importedEnv? := some zygote.env
+
   return .ok {
     mainModuleName
     opts
+    importedEnv?
   }
 
 /- Worker initialization sequence. -/
@@ -354,10 +383,12 @@ section Initialization
       chanIsProcessing
       cmdlineOpts := opts
       stickyDiagnosticsRef
+      semanticTokensRef := (← IO.mkRef none)
     }
     let doc : EditableDocumentCore := {
       meta, initSnap
       diagnosticsRef := (← IO.mkRef ∅)
+      lspDiagnosticsRef := (← IO.mkRef ∅)
     }
     let reporterCancelTk ← CancelToken.new
     let reporter ← reportSnapshots ctx doc reporterCancelTk
@@ -432,6 +463,7 @@ section Updates
     let doc : EditableDocumentCore := {
       meta, initSnap
       diagnosticsRef := (← IO.mkRef ∅)
+      lspDiagnosticsRef := (← IO.mkRef ∅)
     }
     let reporterCancelTk ← CancelToken.new
     let reporter ← reportSnapshots ctx doc reporterCancelTk
@@ -624,7 +656,8 @@ section MessageHandling
           srcSearchPath
           doc := st.doc
           hLog := ctx.hLog
-          initParams := ctx.initParams }
+          initParams := ctx.initParams
+          semanticTokensRef := ctx.semanticTokensRef }
       let t? ← EIO.toIO' <| handleLspRequest method params rc
       let t₁ ← match t? with
         | Except.error e =>
@@ -738,8 +771,9 @@ where
       severity? := DiagnosticSeverity.error
       message := err.toString }]
 
-@[export lean_server_worker_main]
-def workerMain (opts : Options) : IO UInt32 := do
+def runWorker (opts : Options) : IO UInt32 := do
+  -- Do not block request handling on freeing the snapshots of previous document versions.
+  IO.setDeferredDealloc true
   let i ← IO.getStdin
   let o ← IO.getStdout
   let e ← IO.getStderr
@@ -754,4 +788,53 @@ def workerMain (opts : Options) : IO UInt32 := do
     e.putStrLn s!"worker initialization error: {err}"
     return (1 : UInt32)
 
+open Language Lean in
+/--
+Runs a zygote for the imports of the document it is opened with and continues as a regular worker
+in each process forked from it; see `Lean.Server.Zygote`. Nothing is sent back on standard output,
+in particular no diagnostics, as the watchdog does not forward any output of the zygote.
+-/
+def runZygote (socketPath : System.FilePath) (cmdlineOpts : Options) : IO UInt32 := do
+  -- workers for the same imports may already connect while we are importing
+  Zygote.listen socketPath
+  let i ← IO.getStdin
+  let _ ← i.readLspRequestAs "initialize" InitializeParams
+  let ⟨_, param⟩ ← i.readLspNotificationAs "textDocument/didOpen" LeanDidOpenTextDocumentParams
+  let doc := param.textDocument
+  let meta : DocumentMeta := ⟨doc.uri, doc.version, doc.text.toFileMap, param.dependencyBuildMode?.getD .always⟩
+  let inputCtx := meta.mkInputContext
+  let (stx, _, msgLog) ← Parser.parseHeader inputCtx
+  if msgLog.hasErrors then
+    return (← fail)
+  let imports := Elab.headerToImports stx
+  let fileSetupResult ← setupFile meta imports fun _ => pure ()
+  unless fileSetupResult.kind matches .success | .noLakefile do
+    return (← fail)
+  let opts := cmdlineOpts.mergeBy (fun _ _ fileOpt => fileOpt) fileSetupResult.fileOptions
+  let (env, msgLog) ← Elab.processHeader (leakEnv := true) stx opts .empty inputCtx
+  if msgLog.hasErrors then
+    return (← fail)
+  zygoteImportsRef.set <| some { imports, searchPath := (← searchPathRef.get), opts, env }
+  if (← Zygote.serve) then
+    runWorker cmdlineOpts
+  else
+    return 0
+where
+  /-- Processes waiting on the socket fall back to running as regular workers. -/
+  fail : IO UInt32 := do
+    try IO.FS.removeFile socketPath catch _ => pure ()
+    -- the private directory created by `Zygote.mkSocketPath`
+    if let some dir := socketPath.parent then
+      try IO.FS.removeDir dir catch _ => pure ()
+    return 1
+
+@[export lean_server_worker_main]
+def workerMain (opts : Options) : IO UInt32 := do
+  if let some socketPath ← IO.getEnv Zygote.listenEnvVar then
+    return (← runZygote socketPath opts)
+  if let some socketPath ← IO.getEnv Zygote.attachEnvVar then
+    if let some exitCode ← Zygote.attach socketPath then
+      IO.Process.exit exitCode.toUInt8
+  runWorker opts
+
 end Lean.Server.FileWorker
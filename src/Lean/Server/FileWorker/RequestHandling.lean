@@ -545,6 +545,27 @@ def collectInfoBasedSemanticTokens (i : Elab.InfoTree) : Array LeanSemanticToken
       return ⟨ti.stx, SemanticTokenType.property⟩
     none
 
+/-- Type of state stored in `Snapshot.semanticTokensRef?`: all semantic tokens of the command. -/
+structure MemorizedSemanticTokens where
+  tokens : Array AbsoluteLspSemanticToken
+  deriving TypeName
+
+/--
+Collects all semantic tokens of the command in `s`. The tokens are memorized in the snapshot, so
+they are only computed once for each command even as the document is edited after it.
+-/
+def collectSnapshotSemanticTokens (text : FileMap) (s : Snapshot)
+    : BaseIO (Array AbsoluteLspSemanticToken) := do
+  if let some memorized ← s.semanticTokensRef?.bindM fun ref => do
+      return (← ref.get).bind (·.get? MemorizedSemanticTokens) then
+    return memorized.tokens
+  let leanSemanticTokens := collectSyntaxBasedSemanticTokens s.stx ++
+    collectInfoBasedSemanticTokens s.infoTree
+  let tokens := computeAbsoluteLspSemanticTokens text 0 none leanSemanticTokens
+  if let some ref := s.semanticTokensRef? then
+    ref.set <| some <| .mk { tokens : MemorizedSemanticTokens }
+  return tokens
+
 /-- Computes the semantic tokens in the range [beginPos, endPos?). -/
 def handleSemanticTokens (beginPos : String.Pos) (endPos? : Option String.Pos)
     : RequestM (RequestTask SemanticTokens) := do
@@ -562,22 +583,73 @@ def handleSemanticTokens (beginPos : String.Pos) (endPos? : Option String.Pos)
     mapTask t fun (snaps, _) => run doc snaps
 where
   run doc snaps : RequestM SemanticTokens := do
-    let mut leanSemanticTokens := #[]
+    let text := doc.meta.text
+    let beginLspPos := text.utf8PosToLspPos beginPos
+    let endLspPos? := endPos?.map text.utf8PosToLspPos
+    let mut absoluteLspSemanticTokens := #[]
     for s in snaps do
       if s.endPos <= beginPos then
         continue
-      let syntaxBasedSemanticTokens := collectSyntaxBasedSemanticTokens s.stx
-      let infoBasedSemanticTokens := collectInfoBasedSemanticTokens s.infoTree
-      leanSemanticTokens := leanSemanticTokens ++ syntaxBasedSemanticTokens ++ infoBasedSemanticTokens
-    let absoluteLspSemanticTokens := computeAbsoluteLspSemanticTokens doc.meta.text beginPos endPos? leanSemanticTokens
-    let absoluteLspSemanticTokens := filterDuplicateSemanticTokens absoluteLspSemanticTokens
+      let tokens ← collectSnapshotSemanticTokens text s
+      absoluteLspSemanticTokens := absoluteLspSemanticTokens ++ tokens.filter fun t =>
+        beginLspPos <= t.pos && endLspPos?.all (t.pos < ·)
+    absoluteLspSemanticTokens := filterDuplicateSemanticTokens absoluteLspSemanticTokens
     let semanticTokens := computeDeltaLspSemanticTokens absoluteLspSemanticTokens
     return semanticTokens
 
+/--
+Assigns a fresh result id to `tokens` and remembers them for answering later
+`textDocument/semanticTokens/full/delta` requests. Returns the previously remembered tokens.
+-/
+def rememberSemanticTokens (tokens : SemanticTokens)
+    : RequestM (Option SemanticTokens × SemanticTokens) := do
+  (← read).semanticTokensRef.modifyGet fun previous? =>
+    let id := previous?.bind (·.resultId?) |>.bind (·.toNat?) |>.getD 0
+    let tokens := { tokens with resultId? := toString (id + 1) }
+    ((previous?, tokens), some tokens)
+
+/--
+Computes a single edit that turns the token data `old` into `new` by replacing everything between
+their common prefix and common suffix. As each token is encoded relative to the previous one, an
+edit of the document usually only changes the data of the tokens close to the edit.
+-/
+def computeSemanticTokensEdit (old new : Array Nat) : SemanticTokensEdit := Id.run do
+  let mut start := 0
+  while start < old.size && start < new.size && old[start]! == new[start]! do
+    start := start + 1
+  let mut suffix := 0
+  while suffix < old.size - start && suffix < new.size - start &&
+      old[old.size - suffix - 1]! == new[new.size - suffix - 1]! do
+    suffix := suffix + 1
+  return {
+    start
+    deleteCount := old.size - start - suffix
+    data? := new.extract start (new.size - suffix)
+  }
+
 /-- Computes all semantic tokens for the document. -/
 def handleSemanticTokensFull (_ : SemanticTokensParams)
     : RequestM (RequestTask SemanticTokens) := do
-  handleSemanticTokens 0 none
+  let t ← handleSemanticTokens 0 none
+  mapTask t fun tokens? => do
+    return (← rememberSemanticTokens (← liftExcept tokens?)).2
+
+/--
+Computes all semantic tokens for the document as an edit of the tokens last sent to the client, or
+in full if the client does not have those.
+-/
+def handleSemanticTokensFullDelta (p : SemanticTokensDeltaParams)
+    : RequestM (RequestTask SemanticTokensDeltaResult) := do
+  let t ← handleSemanticTokens 0 none
+  mapTask t fun tokens? => do
+    let (previous?, tokens) ← rememberSemanticTokens (← liftExcept tokens?)
+    let some previous := previous?
+      | return .full tokens
+    if previous.resultId? != some p.previousResultId then
+      return .full tokens
+    let edit := computeSemanticTokensEdit previous.data tokens.data
+    let edits := if edit.deleteCount == 0 && edit.data?.all (·.isEmpty) then #[] else #[edit]
+    return .delta { resultId? := tokens.resultId?, edits }
 
 /-- Computes the semantic tokens in the range provided by `p`. -/
 def handleSemanticTokensRange (p : SemanticTokensRangeParams)
@@ -734,6 +806,11 @@ builtin_initialize
     SemanticTokensParams
     SemanticTokens
     handleSemanticTokensFull
+  registerLspRequestHandler
+    "textDocument/semanticTokens/full/delta"
+    SemanticTokensDeltaParams
+    SemanticTokensDeltaResult
+    handleSemanticTokensFullDelta
   registerLspRequestHandler
     "textDocument/semanticTokens/range"
     SemanticTokensRangeParams
@@ -44,14 +44,26 @@ private partial def mkCmdSnaps (initSnap : Language.Lean.InitialSnapshot) :
     } <| .delayed <| headerSuccess.firstCmdSnap.task.bind go
 where
   go cmdParsed :=
-    cmdParsed.data.finishedSnap.task.map fun finished =>
-      .ok <| .cons {
-        stx := cmdParsed.data.stx
-        mpState := cmdParsed.data.parserState
-        cmdState := finished.cmdState
-      } (match cmdParsed.next? with
-        | some next => .delayed <| next.task.bind go
-        | none => .nil)
+    cmdParsed.data.finishedSnap.task.bind fun finished =>
+      if finished.cmdState.infoState.trees.isEmpty then
+        -- the info tree of a proof elaborated asynchronously (see `Elab.async`) is only reported
+        -- in `elabSnap`
+        cmdParsed.data.elabSnap.task.map fun elabSnap =>
+          let trees := match elabSnap.tree.element.infoTree? with
+            | some tree => PersistentArray.empty.push tree
+            | none      => {}
+          mkSnap cmdParsed { finished.cmdState with infoState.trees := trees }
+      else
+        .pure <| mkSnap cmdParsed finished.cmdState
+  mkSnap cmdParsed cmdState :=
+    .ok <| .cons {
+      stx := cmdParsed.data.stx
+      mpState := cmdParsed.data.parserState
+      cmdState
+      semanticTokensRef? := cmdParsed.data.semanticTokensRef?
+    } (match cmdParsed.next? with
+      | some next => .delayed <| next.task.bind go
+      | none => .nil)
 
 /--
 A document bundled with processing information. Turned into `EditableDocument` as soon as the
@@ -69,6 +81,11 @@ structure EditableDocumentCore where
   `handleGetInteractiveDiagnosticsRequest`.
   -/
   diagnosticsRef : IO.Ref (Array Widget.InteractiveDiagnostic)
+  /--
+  Non-interactive versions of the diagnostics in `diagnosticsRef`, as sent in
+  `textDocument/publishDiagnostics` notifications.
+  -/
+  lspDiagnosticsRef : IO.Ref (Array Lsp.Diagnostic)
 
 /-- `EditableDocumentCore` with reporter task. -/
 structure EditableDocument extends EditableDocumentCore where
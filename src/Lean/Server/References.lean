@@ -182,24 +182,90 @@ open IO
 open Lsp
 open Elab
 
-/-- Content of individual `.ilean` files -/
+/-- Current version number of the ilean format. Version 3 was stored as JSON. -/
+def ileanVersion : Nat := 4
+
+/--
+Content of individual `.ilean` files.
+They are stored in the same binary format as .olean files so that they can be memory-mapped and used in place
+instead of being parsed; in particular, `references` is a hash map that can be queried directly.
+-/
 structure Ilean where
   /-- Version number of the ilean format. -/
-  version    : Nat := 3
+  version    : Nat := ileanVersion
   /-- Name of the module that this ilean data has been collected for. -/
   module     : Name
   /-- All references of this module. -/
   references : Lsp.ModuleRefs
-  deriving FromJson, ToJson
+  /--
+  All constants defined in this module with the range of their definition, precomputed from `references` so that
+  workspace symbol requests do not have to traverse all references.
+  -/
+  decls      : Array (Name × Lsp.Range)
+
+namespace Ilean
+
+/-- Collects the .ilean data for the references `references` of `module`. -/
+def ofModuleRefs (module : Name) (references : Lsp.ModuleRefs) : Ilean := Id.run do
+  let mut decls := #[]
+  for (ident, info) in references.toList do
+    if let (.const _ name, some ⟨range, _⟩) := (ident, info.definition?) then
+      decls := decls.push (name, range)
+  return { module, references, decls }
+
+private opaque RegionPointed : NonemptyType.{0}
+
+/-- Memory that a binary .ilean file has been loaded into, freed when the `Region` is no longer referenced. -/
+def Region : Type := RegionPointed.type
+
+instance : Nonempty Region := RegionPointed.property
+
+@[extern "lean_save_ilean_data"]
+private opaque saveIleanData (fname : @& System.FilePath) (mod : @& Name) (data : @& Ilean) : IO Unit
+@[extern "lean_read_ilean_data"]
+private opaque readIleanData (fname : @& System.FilePath) (useMmap : Bool) : IO (Ilean × Region)
+
+/-- Writes `self` to the .ilean file at `path`. -/
+def save (self : Ilean) (path : System.FilePath) : IO Unit :=
+  saveIleanData path self.module self
+
+/-- The JSON format of .ilean files up to version 3, which did not contain `decls`. -/
+private structure JsonIlean where
+  version    : Nat
+  module     : Name
+  references : Lsp.ModuleRefs
+  deriving FromJson
+
+end Ilean
+
+/-- An `Ilean` loaded from an .ilean file. -/
+structure LoadedIlean extends Ilean where
+  /--
+  Memory of the binary .ilean file that the data of `toIlean` lives in, or `none` for JSON .ilean files. The data
+  must not be used once the `LoadedIlean` is no longer referenced as the memory is freed then.
+  -/
+  region? : Option Ilean.Region
 
 namespace Ilean
 
-/-- Reads and parses the .ilean file at `path`. -/
-def load (path : System.FilePath) : IO Ilean := do
-  let content ← FS.readFile path
-  match Json.parse content >>= fromJson? with
-    | Except.ok ilean => pure ilean
-    | Except.error msg => throwServerError s!"Failed to load ilean at {path}: {msg}"
+/--
+Loads the .ilean file at `path`. Binary files are memory-mapped at their preferred address if `mmap` is set,
+and read into allocated memory otherwise, which should be used when reloading a file as its previous version
+may still be mapped at that address. JSON files of earlier versions are parsed.
+-/
+def load (path : System.FilePath) (mmap := true) : IO LoadedIlean := do
+  -- report missing files as such, which the watchdog relies on to detect vanished .ilean files
+  unless (← path.pathExists) do
+    throw <| .noFileOrDirectory path.toString 0 "file not found"
+  let isJson ← FS.withFile path .read fun h => return (← h.read 1).data == #['{'.toNat.toUInt8]
+  if isJson then
+    match Json.parse (← FS.readFile path) >>= fromJson? with
+    | .ok (ilean : JsonIlean) => return { ofModuleRefs ilean.module ilean.references with region? := none }
+    | .error msg => throwServerError s!"Failed to load ilean at {path}: {msg}"
+  let (ilean, region) ← readIleanData path mmap
+  unless ilean.version == ileanVersion do
+    throwServerError s!"Failed to load ilean at {path}: unsupported version {ilean.version}"
+  return { ilean with region? := some region }
 
 end Ilean
 /-! # Collecting and deduplicating definitions and usages -/
@@ -375,28 +441,49 @@ def findModuleRefs (text : FileMap) (trees : Array InfoTree) (localVars : Bool :
 
 /-! # Collecting and maintaining reference info from different sources -/
 
-/-- References from ilean files and current ilean information from file workers. -/
+/--
+References from ilean files and current ilean information from file workers.
+
+The references of ilean files live in the memory of the loaded files, which is freed when their `LoadedIlean` is no
+longer referenced. Data obtained from a `References` value must therefore not be used after the value itself.
+-/
 structure References where
   /-- References loaded from ilean files -/
-  ileans : HashMap Name (System.FilePath × Lsp.ModuleRefs)
+  ileans : HashMap Name (System.FilePath × LoadedIlean)
+  /-- For each constant, the modules in `ileans` that refer to it. -/
+  ileanModulesFor : HashMap RefIdent (Array Name)
   /-- References from workers, overriding the corresponding ilean files -/
   workers : HashMap Name (Nat × Lsp.ModuleRefs)
 
 namespace References
 
 /-- No ilean files, no information from workers. -/
-def empty : References := { ileans := HashMap.empty, workers := HashMap.empty }
-
-/-- Adds the contents of an ilean file `ilean` at `path` to `self`. -/
-def addIlean (self : References) (path : System.FilePath) (ilean : Ilean) : References :=
-  { self with ileans := self.ileans.insert ilean.module (path, ilean.references) }
+def empty : References := { ileans := HashMap.empty, ileanModulesFor := HashMap.empty, workers := HashMap.empty }
+
+/-- Removes the ilean file data of `module` from `self`. -/
+private def removeIleanOf (self : References) (module : Name) : References := Id.run do
+  let some (_, ilean) := self.ileans.find? module
+    | return self
+  let ileanModulesFor := ilean.references.fold (init := self.ileanModulesFor) fun idx ident _ =>
+    match ident, idx.find? ident with
+    | .const .., some modules =>
+      let modules := modules.erase module
+      if modules.isEmpty then idx.erase ident else idx.insert ident modules
+    | _, _ => idx
+  { self with ileans := self.ileans.erase module, ileanModulesFor }
+
+/-- Adds the contents of an ilean file `ilean` at `path` to `self`, replacing earlier contents for its module. -/
+def addIlean (self : References) (path : System.FilePath) (ilean : LoadedIlean) : References :=
+  let self := self.removeIleanOf ilean.module
+  let ileanModulesFor := ilean.references.fold (init := self.ileanModulesFor) fun idx ident _ =>
+    if ident matches .const .. then idx.insert ident (idx.findD ident #[] |>.push ilean.module) else idx
+  { self with ileans := self.ileans.insert ilean.module (path, ilean), ileanModulesFor }
 
 /-- Removes the ilean file data at `path` from `self`. -/
 def removeIlean (self : References) (path : System.FilePath) : References :=
   let namesToRemove := self.ileans.toList.filter (fun (_, p, _) => p == path)
     |>.map (fun (n, _, _) => n)
-  namesToRemove.foldl (init := self) fun self name =>
-    { self with ileans := self.ileans.erase name }
+  namesToRemove.foldl (init := self) removeIleanOf
 
 /--
 Updates the worker references in `self` with the `refs` of the worker managing the module `name`.
@@ -428,11 +515,33 @@ def finalizeWorkerRefs (self : References) (name : Name) (version : Nat) (refs :
 def removeWorkerRefs (self : References) (name : Name) : References :=
   { self with workers := self.workers.erase name }
 
-/-- Yields a map from all modules to all of their references. -/
+/-- Yields a map from all modules to all of their references. Prefer `findModuleRefs?` and `allModuleRefs`,
+which do not construct a new map. -/
 def allRefs (self : References) : HashMap Name Lsp.ModuleRefs :=
-  let ileanRefs := self.ileans.toArray.foldl (init := HashMap.empty) fun m (name, _, refs) => m.insert name refs
+  let ileanRefs := self.ileans.toArray.foldl (init := HashMap.empty) fun m (name, _, ilean) =>
+    m.insert name ilean.references
   self.workers.toArray.foldl (init := ileanRefs) fun m (name, _, refs) => m.insert name refs
 
+/-- Yields the references of `module`, preferring information from workers over ilean files. -/
+def findModuleRefs? (self : References) (module : Name) : Option Lsp.ModuleRefs :=
+  match self.workers.find? module with
+  | some (_, refs) => some refs
+  | none => self.ileans.find? module |>.map (·.2.references)
+
+/--
+Yields the references of all modules, preferring information from workers over ilean files.
+For modules whose references come from an ilean file, also yields the precomputed `Ilean.decls`.
+-/
+def allModuleRefs (self : References) : Array (Name × Lsp.ModuleRefs × Option (Array (Name × Lsp.Range))) :=
+  Id.run do
+    let mut result := #[]
+    for (module, _, refs) in self.workers.toList do
+      result := result.push (module, refs, none)
+    for (module, _, ilean) in self.ileans.toList do
+      if !self.workers.contains module then
+        result := result.push (module, ilean.references, some ilean.decls)
+    return result
+
 /--
 Yields all references in `self` for `ident`, as well as the `DocumentUri` that each
 reference occurs in.
@@ -442,16 +551,20 @@ def allRefsFor
     (srcSearchPath : SearchPath)
     (ident         : RefIdent)
     : IO (Array (DocumentUri × Lsp.RefInfo)) := do
-  let refsToCheck := match ident with
-    | RefIdent.const .. => self.allRefs.toArray
+  let infos : Array (Name × Lsp.RefInfo) := match ident with
+    | RefIdent.const .. =>
+      let workerInfos := self.workers.toArray.filterMap fun (module, _, refs) => (module, ·) <$> refs.find? ident
+      let ileanInfos := self.ileanModulesFor.findD ident #[] |>.filterMap fun module => do
+        guard !self.workers.contains module
+        let (_, ilean) ← self.ileans.find? module
+        (module, ·) <$> ilean.references.find? ident
+      workerInfos ++ ileanInfos
     | RefIdent.fvar identModule .. =>
-      match self.allRefs.find? identModule with
+      match self.findModuleRefs? identModule >>= (·.find? ident) with
       | none => #[]
-      | some refs => #[(identModule, refs)]
+      | some info => #[(identModule, info)]
   let mut result := #[]
-  for (module, refs) in refsToCheck do
-    let some info := refs.find? ident
-      | continue
+  for (module, info) in infos do
     let some path ← srcSearchPath.findModuleWithExt "lean" module
       | continue
     -- Resolve symlinks (such as `src` in the build dir) so that files are
@@ -462,13 +575,13 @@ def allRefsFor
 
 /-- Yields all references in `module` at `pos`. -/
 def findAt (self : References) (module : Name) (pos : Lsp.Position) (includeStop := false) : Array RefIdent := Id.run do
-  if let some refs := self.allRefs.find? module then
+  if let some refs := self.findModuleRefs? module then
     return refs.findAt pos includeStop
   #[]
 
 /-- Yields the first reference in `module` at `pos`. -/
 def findRange? (self : References) (module : Name) (pos : Lsp.Position) (includeStop := false) : Option Range := do
-  let refs ← self.allRefs.find? module
+  let refs ← self.findModuleRefs? module
   refs.findRange? pos includeStop
 
 /-- Location and parent declaration of a reference. -/
@@ -512,16 +625,20 @@ def definitionsMatching
     (srcSearchPath : SearchPath)
     (filter        : Name → Option α)
     (maxAmount?    : Option Nat := none) : IO $ Array (α × Location) := do
+  let mut modules := #[]
+  for (module, refs, decls?) in self.allModuleRefs do
+    let decls := decls?.getD <| refs.toArray.filterMap fun
+      | (RefIdent.const _ name, { definition? := some ⟨range, _⟩, .. }) => some (name, range)
+      | _ => none
+    let matching := decls.filterMap fun (name, range) => (·, range) <$> filter name
+    if !matching.isEmpty then
+      modules := modules.push (module, matching)
   let mut result := #[]
-  for (module, refs) in self.allRefs.toList do
+  for (module, matching) in modules do
     let some path ← srcSearchPath.findModuleWithExt "lean" module
       | continue
     let uri := System.Uri.pathToUri <| ← IO.FS.realPath path
-    for (ident, info) in refs.toList do
-      let (RefIdent.const _ name, some ⟨definitionRange, _⟩) := (ident, info.definition?)
-        | continue
-      let some a := filter name
-        | continue
+    for (a, definitionRange) in matching do
       result := result.push (a, ⟨uri, definitionRange⟩)
       if let some maxAmount := maxAmount? then
         if result.size >= maxAmount then
@@ -65,6 +65,8 @@ structure RequestContext where
   doc           : FileWorker.EditableDocument
   hLog          : IO.FS.Stream
   initParams    : Lsp.InitializeParams
+  /-- Semantic tokens of the document last sent to the client, see `FileWorker.WorkerContext`. -/
+  semanticTokensRef : IO.Ref (Option Lsp.SemanticTokens)
 
 abbrev RequestTask α := Task (Except RequestError α)
 abbrev RequestT m := ReaderT RequestContext <| ExceptT RequestError m
@@ -30,6 +30,8 @@ structure Snapshot where
   stx : Syntax
   mpState : Parser.ModuleParserState
   cmdState : Command.State
+  /-- See `Language.Lean.CommandParsedSnapshotData.semanticTokensRef?`. -/
+  semanticTokensRef? : Option (IO.Ref (Option Dynamic)) := none
 
 namespace Snapshot
 
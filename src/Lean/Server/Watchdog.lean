@@ -17,6 +17,7 @@ import Lean.Data.Lsp
 import Lean.Server.Utils
 import Lean.Server.Requests
 import Lean.Server.References
+import Lean.Server.Zygote
 
 /-!
 For general server architecture, see `README.md`. This module implements the watchdog process.
@@ -139,6 +140,29 @@ section FileWorker
   end FileWorker
 end FileWorker
 
+section WorkerZygote
+  def zygoteCfg : Process.StdioConfig := {
+    stdin  := Process.Stdio.piped
+    stdout := Process.Stdio.null
+    stderr := Process.Stdio.inherit
+  }
+
+  /-- A worker zygote for a set of imports; see `Lean.Server.Zygote`. -/
+  structure WorkerZygote where
+    socketPath : System.FilePath
+    /--
+    Standard input of the zygote. When the last reference to it is dropped, it is closed, which
+    makes the zygote exit once all workers forked from it have exited.
+    -/
+    stdin      : IO.FS.Handle
+    /-- Resolved with the exit code of the zygote. -/
+    exited     : Task (Except IO.Error UInt32)
+
+  structure WorkerZygotes where
+    /-- Zygotes by `Zygote.importsKey` of their imports. -/
+    zygotes    : RBMap String WorkerZygote compare := {}
+end WorkerZygote
+
 section ServerM
   abbrev FileWorkerMap := RBMap DocumentUri FileWorker compare
   abbrev ImportMap := RBMap DocumentUri (RBTree DocumentUri compare) compare
@@ -229,6 +253,8 @@ section ServerM
     references          : IO.Ref References
     serverRequestData   : IO.Ref ServerRequestData
     importData          : IO.Ref ImportData
+    /-- Worker zygotes, if enabled via `Zygote.enableEnvVar`. -/
+    zygotesRef?         : Option (IO.Ref WorkerZygotes)
 
   abbrev ServerM := ReaderT ServerContext IO
 
@@ -349,13 +375,67 @@ section ServerM
       | Except.ok ev   => ev
       | Except.error e => WorkerEvent.ioError e
 
+  /--
+  Returns the socket of the worker zygote for the imports of `m`, starting the zygote if necessary.
+  Returns `none` if zygotes are disabled or the zygote for these imports has failed.
+  -/
+  def findOrStartZygote? (m : DocumentMeta) : ServerM (Option System.FilePath) := do
+    let st ← read
+    let some zygotesRef := st.zygotesRef?
+      | return none
+    let (header, _, _) ← Parser.parseHeader m.mkInputContext
+    let key := Zygote.importsKey (Elab.headerToImports header)
+    let zs ← zygotesRef.get
+    if let some z := zs.zygotes.find? key then
+      if !(← IO.hasFinished z.exited) then
+        return some z.socketPath
+      -- a zygote that shut down because it was stale is replaced, a failed one is not
+      unless z.exited.get matches .ok 0 do
+        return none
+    let socketPath ← Zygote.mkSocketPath
+    -- no separate session, so that `kill` on the zygote does not affect workers forked from it
+    let proc ← Process.spawn {
+      toStdioConfig := zygoteCfg
+      cmd           := st.workerPath.toString
+      args          := #["--worker"] ++ st.args.toArray ++ #[m.uri]
+      env           := #[(Zygote.listenEnvVar, socketPath.toString)]
+    }
+    let exited ← proc.waitAsync
+    let (stdin, _) ← proc.takeStdin
+    let stdinStream := FS.Stream.ofHandle stdin
+    stdinStream.writeLspRequest ⟨0, "initialize", st.initParams⟩
+    stdinStream.writeLspNotification {
+      method := "textDocument/didOpen"
+      param  := {
+        textDocument := {
+          uri        := m.uri
+          languageId := "lean"
+          version    := m.version
+          text       := m.text.source
+        }
+        dependencyBuildMode? := m.dependencyBuildMode
+        : LeanDidOpenTextDocumentParams
+      }
+    }
+    zygotesRef.set { zygotes := zs.zygotes.insert key { socketPath, stdin, exited } }
+    return some socketPath
+
+  /-- Makes all worker zygotes exit once their workers have exited, e.g. because imports changed. -/
+  def stopZygotes : ServerM Unit := do
+    if let some zygotesRef := (← read).zygotesRef? then
+      zygotesRef.modify ({ · with zygotes := {} })
+
   def startFileWorker (m : DocumentMeta) : ServerM Unit := do
     (← read).hOut.writeLspMessage <| mkFileProgressAtPosNotification m 0
     let st ← read
+    let env := match (← findOrStartZygote? m) with
+      | some socketPath => #[(Zygote.attachEnvVar, some socketPath.toString)]
+      | none            => #[]
     let workerProc ← Process.spawn {
       toStdioConfig := workerCfg
       cmd           := st.workerPath.toString
       args          := #["--worker"] ++ st.args.toArray ++ #[m.uri]
+      env
       -- open session for `kill` above
       setsid        := true
     }
@@ -644,7 +724,7 @@ def handleCallHierarchyOutgoingCalls (p : CallHierarchyOutgoingCallsParams)
 
   let references ← (← read).references.get
 
-  let some refs := references.allRefs.find? module
+  let some refs := references.findModuleRefs? module
     | return #[]
 
   let items ← refs.toArray.filterMapM fun ⟨ident, info⟩ => do
@@ -782,11 +862,14 @@ section NotificationHandling
         for dependent in dependents do
           notifyAboutStaleDependency dependent change.uri
       | "ilean" =>
+        -- imported modules were rebuilt, so zygotes may hold outdated environments
+        stopZygotes
         if let FileChangeType.Deleted := change.type then
           references.modify (fun r => r.removeIlean path)
         else if ileans.contains path then
           try
-            let ilean ← Ilean.load path
+            -- the previous version of a changed file is still mapped at its preferred address
+            let ilean ← Ilean.load path (mmap := !change.type matches .Changed)
             if let FileChangeType.Changed := change.type then
               references.modify (fun r => r.removeIlean path |>.addIlean path ilean)
             else
@@ -935,6 +1018,7 @@ end MessageHandling
 
 section MainLoop
   def shutdown : ServerM Unit := do
+    stopZygotes
     let fileWorkers ← (←read).fileWorkersRef.get
     for ⟨uri, _⟩ in fileWorkers do
       terminateFileWorker uri
@@ -1033,6 +1117,7 @@ def mkLeanServerCapabilities : ServerCapabilities := {
       tokenModifiers := SemanticTokenModifier.names
     }
     full  := true
+    delta := true
     range := true
   }
   codeActionProvider? := some {
@@ -1099,6 +1184,11 @@ def initAndRunWatchdog (args : List String) (i o e : FS.Stream) : IO Unit := do
     freshServerRequestID  := 0
   }
   let importData ← IO.mkRef ⟨RBMap.empty, RBMap.empty⟩
+  let zygotesRef? ← if System.Platform.isWindows ||
+      ((← IO.getEnv Zygote.enableEnvVar).getD "").isEmpty then
+    pure none
+  else
+    some <$> IO.mkRef {}
   let i ← maybeTee "wdIn.txt" false i
   let o ← maybeTee "wdOut.txt" true o
   let e ← maybeTee "wdErr.txt" true e
@@ -1139,6 +1229,7 @@ def initAndRunWatchdog (args : List String) (i o e : FS.Stream) : IO Unit := do
     references
     serverRequestData
     importData
+    zygotesRef?
     : ServerContext
   }
 
@@ -0,0 +1,86 @@
+/-
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+-/
+prelude
+import Init.System.IO
+import Lean.Environment
+
+/-!
+# Worker zygotes
+
+Importing the header of a file is often the most expensive part of starting a file worker, and
+every worker for a file with the same imports loads the same .olean files into private memory
+again. When enabled via `LEAN_SERVER_ZYGOTE` (POSIX only), the watchdog instead starts one *zygote*
+per set of imports: a worker process that imports the header of the first file with these imports
+and then forks a copy of itself for each further worker with the same imports. The forked workers
+inherit the imported environment, which is shared with the zygote until written to and not
+reference counted as it is marked persistent.
+
+The watchdog still starts a separate process for each file worker, which passes its standard
+streams to the zygote via a Unix domain socket and then only waits for the forked worker to exit
+and reports its exit code. If no zygote can be reached, the process instead continues as a regular
+worker.
+
+Sockets are created in private directories, and both ends check that the other process runs as the
+same user. Forking is only done while the zygote has no other threads.
+
+A forked worker compares the imports, search path, and options it would use with those of the
+zygote; if they differ, it exits with `staleExitCode`, which makes the zygote shut down and report
+exit code 2 instead, i.e. a restart request to the watchdog.
+
+The zygote part is implemented in `src/runtime/zygote.cpp`.
+-/
+
+namespace Lean.Server.Zygote
+
+/-- Enables worker zygotes in the watchdog when set to a non-empty value. -/
+def enableEnvVar := "LEAN_SERVER_ZYGOTE"
+/-- Makes a file worker process become a zygote listening on the given socket. -/
+def listenEnvVar := "LEAN_WORKER_ZYGOTE_LISTEN"
+/-- Makes a file worker process attach to the zygote listening on the given socket. -/
+def attachEnvVar := "LEAN_WORKER_ZYGOTE"
+/-- Set to the process id of the zygote in each process forked from it. -/
+def childEnvVar := "LEAN_WORKER_ZYGOTE_PID"
+
+/-- Exit code of a forked worker for which the state of the zygote is not usable. -/
+def staleExitCode : UInt8 := 3
+
+/--
+Starts listening on the Unix domain socket at `socketPath`. Connecting processes wait until `serve`
+is called, or until the current process exits.
+-/
+@[extern "lean_io_zygote_listen"]
+opaque listen (socketPath : @& System.FilePath) : IO Unit
+
+/--
+Serves connections on the socket set up by `listen` by forking the current process for each of
+them. Returns `true` in each forked child, whose standard streams are now those of the connecting
+process, and `false` once the zygote should exit.
+
+No other threads may be running when this function is called.
+-/
+@[extern "lean_io_zygote_serve"]
+opaque serve : IO Bool
+
+/--
+Passes the standard streams of the current process to the zygote listening at `socketPath`, waiting
+up to 2 seconds for the socket to be created. Returns `none` if the zygote did not fork a child for them, and otherwise waits for that child and
+returns its exit code.
+-/
+@[extern "lean_io_zygote_attach"]
+opaque attach (socketPath : @& System.FilePath) : IO (Option UInt32)
+
+/-- Identifies the zygote that can be used for a file with the given imports. -/
+def importsKey (imports : Array Import) : String :=
+  toString <| imports.toList.map fun i => (i.module, i.runtimeOnly)
+
+/--
+Returns the path of a socket in a fresh directory that only the current user can access, so that other
+users cannot connect to the zygote or take over its socket path. The directory is removed when the
+zygote stops listening.
+-/
+@[extern "lean_io_zygote_mk_socket_path"]
+opaque mkSocketPath : IO System.FilePath
+
+end Lean.Server.Zygote
@@ -62,7 +62,7 @@ def findAllWithExt (sp : SearchPath) (ext : String) : IO (Array FilePath) := do
   let mut paths := #[]
   for p in sp do
     if (← p.isDir) then
-      paths := paths ++ (← p.walkDir).filter (·.extension == some ext)
+      paths := paths ++ (← p.walkDirEntries { extensions := #[ext], includeDirs := false }).map (·.path)
   return paths
 
 end SearchPath
@@ -290,6 +290,9 @@ static inline size_t lean_unbox(lean_object * o) { return (size_t)(o) >> 1; }
 LEAN_EXPORT void lean_set_exit_on_panic(bool flag);
 /* Enable/disable panic messages */
 LEAN_EXPORT void lean_set_panic_messages(bool flag);
+/* Enable/disable deferring the deallocation of large dead multi-threaded objects to a background thread.
+   When enabled, finalizers of external objects (see `lean_register_external_class`) may run on that thread. */
+LEAN_EXPORT void lean_set_deferred_dealloc(bool flag);
 
 LEAN_EXPORT lean_object * lean_panic_fn(lean_object * default_val, lean_object * msg);
 
@@ -1080,6 +1083,20 @@ static inline lean_obj_res lean_thunk_get_own(b_lean_obj_arg t) {
     return r;
 }
 
+/* Module-level values initialized on first use, see the `compiler.lazyClosedTerms` option.
+   A cell contains `NULL` before initialization, `LEAN_LAZY_BUSY` while a thread is executing `init`,
+   and the (persistent) value afterwards. */
+
+#define LEAN_LAZY_BUSY ((lean_object*)2)
+
+LEAN_EXPORT lean_object * lean_lazy_get_core(_Atomic(lean_object *) * cell, lean_object * (*init)(void));
+
+static inline b_lean_obj_res lean_lazy_get(_Atomic(lean_object *) * cell, lean_object * (*init)(void)) {
+    lean_object * r = *cell;
+    if (LEAN_LIKELY(r != NULL && r != LEAN_LAZY_BUSY)) return r;
+    return lean_lazy_get_core(cell, init);
+}
+
 /* Tasks */
 
 LEAN_EXPORT void lean_init_task_manager(void);
@@ -40,6 +40,19 @@ static expr * g_nat_lor      = nullptr;
 static expr * g_nat_xor      = nullptr;
 static expr * g_nat_shiftLeft  = nullptr;
 static expr * g_nat_shiftRight = nullptr;
+static expr * g_int_of_nat    = nullptr;
+static expr * g_int_neg_succ  = nullptr;
+static expr * g_int_neg       = nullptr;
+static expr * g_int_add       = nullptr;
+static expr * g_int_sub       = nullptr;
+static expr * g_int_mul       = nullptr;
+static expr * g_int_div       = nullptr;
+static expr * g_int_mod       = nullptr;
+static expr * g_int_ediv      = nullptr;
+static expr * g_int_emod      = nullptr;
+static expr * g_int_pow       = nullptr;
+static expr * g_int_nat_abs   = nullptr;
+static expr * g_int_to_nat    = nullptr;
 
 type_checker::state::state(environment const & env):
     m_env(env), m_ngen(*g_kernel_fresh) {}
@@ -637,6 +650,90 @@ optional<expr> type_checker::reduce_nat(expr const & e) {
     return none_expr();
 }
 
+/* Integer values are represented by `Int.ofNat n` and `Int.negSucc n` where `n` is a `Nat` literal.
+   We use the runtime `Int` primitives (the same ones used by compiled code) to compute with them. */
+optional<object_ref> type_checker::get_int_val(expr const & e) {
+    expr v = whnf(e);
+    if (!is_app(v)) return optional<object_ref>();
+    expr const & f = app_fn(v);
+    bool is_of_nat = f == *g_int_of_nat;
+    if (!is_of_nat && f != *g_int_neg_succ) return optional<object_ref>();
+    expr arg = whnf(app_arg(v));
+    if (!is_nat_lit_ext(arg)) return optional<object_ref>();
+    nat n = get_nat_val(arg);
+    if (is_of_nat)
+        return optional<object_ref>(object_ref(lean_nat_to_int(n.steal())));
+    else
+        return optional<object_ref>(object_ref(int_neg_succ_of_nat(n.steal())));
+}
+
+static expr mk_int_val(b_obj_arg v) {
+    if (int_lt(v, box(0))) {
+        nat n(lean_nat_abs(v));
+        return mk_app(*g_int_neg_succ, mk_lit(literal(n - nat(1))));
+    } else {
+        inc(v);
+        return mk_app(*g_int_of_nat, mk_lit(literal(nat(lean_int_to_nat(v)))));
+    }
+}
+
+template<typename F> optional<expr> type_checker::reduce_bin_int_op(F const & f, expr const & e) {
+    optional<object_ref> v1 = get_int_val(app_arg(app_fn(e)));
+    if (!v1) return none_expr();
+    optional<object_ref> v2 = get_int_val(app_arg(e));
+    if (!v2) return none_expr();
+    object_ref r(f(v1->raw(), v2->raw()));
+    return some_expr(mk_int_val(r.raw()));
+}
+
+/* `Int.pow` is defined by structural recursion on the exponent, so without this
+   shortcut `decide` on powers of integer literals takes time linear in the exponent. */
+optional<expr> type_checker::reduce_int_pow(expr const & e) {
+    optional<object_ref> v = get_int_val(app_arg(app_fn(e)));
+    if (!v) return none_expr();
+    expr arg = whnf(app_arg(e));
+    if (!is_nat_lit_ext(arg)) return none_expr();
+    nat k = get_nat_val(arg);
+    nat r(nat_pow(nat(lean_nat_abs(v->raw())).raw(), k.raw()));
+    if (int_lt(v->raw(), box(0)) && !(k % nat(2)).is_zero() && !r.is_zero())
+        return some_expr(mk_app(*g_int_neg_succ, mk_lit(literal(r - nat(1)))));
+    return some_expr(mk_app(*g_int_of_nat, mk_lit(literal(r))));
+}
+
+optional<expr> type_checker::reduce_int(expr const & e) {
+    if (has_fvar(e)) return none_expr();
+    unsigned nargs = get_app_num_args(e);
+    if (nargs == 1) {
+        expr const & f = app_fn(e);
+        if (!is_constant(f)) return none_expr();
+        if (f == *g_int_neg) {
+            optional<object_ref> v = get_int_val(app_arg(e));
+            if (!v) return none_expr();
+            object_ref r(int_neg(v->raw()));
+            return some_expr(mk_int_val(r.raw()));
+        }
+        if (f == *g_int_nat_abs || f == *g_int_to_nat) {
+            optional<object_ref> v = get_int_val(app_arg(e));
+            if (!v) return none_expr();
+            if (f == *g_int_to_nat && int_lt(v->raw(), box(0)))
+                return some_expr(mk_lit(literal(nat(0u))));
+            return some_expr(mk_lit(literal(nat(lean_nat_abs(v->raw())))));
+        }
+    } else if (nargs == 2) {
+        expr const & f = app_fn(app_fn(e));
+        if (!is_constant(f)) return none_expr();
+        if (f == *g_int_add)  return reduce_bin_int_op(int_add, e);
+        if (f == *g_int_sub)  return reduce_bin_int_op(int_sub, e);
+        if (f == *g_int_mul)  return reduce_bin_int_op(int_mul, e);
+        if (f == *g_int_div)  return reduce_bin_int_op(int_div, e);
+        if (f == *g_int_mod)  return reduce_bin_int_op(int_mod, e);
+        if (f == *g_int_ediv) return reduce_bin_int_op(lean_int_ediv, e);
+        if (f == *g_int_emod) return reduce_bin_int_op(lean_int_emod, e);
+        if (f == *g_int_pow)  return reduce_int_pow(e);
+    }
+    return none_expr();
+}
+
 /** \brief Put expression \c t in weak head normal form */
 expr type_checker::whnf(expr const & e) {
     // Do not cache easy cases
@@ -670,6 +767,9 @@ expr type_checker::whnf(expr const & e) {
         } else if (auto v = reduce_nat(t1)) {
             m_st->m_whnf.insert(mk_pair(e, *v));
             return *v;
+        } else if (auto v = reduce_int(t1)) {
+            m_st->m_whnf.insert(mk_pair(e, *v));
+            return *v;
         } else if (auto next_t = unfold_definition(t1)) {
             t = *next_t;
         } else {
@@ -979,6 +1079,10 @@ lbool type_checker::lazy_delta_reduction(expr & t_n, expr & s_n) {
                 return to_lbool(is_def_eq_core(*t_v, s_n));
             } else if (auto s_v = reduce_nat(s_n)) {
                 return to_lbool(is_def_eq_core(t_n, *s_v));
+            } else if (auto t_v = reduce_int(t_n)) {
+                return to_lbool(is_def_eq_core(*t_v, s_n));
+            } else if (auto s_v = reduce_int(s_n)) {
+                return to_lbool(is_def_eq_core(t_n, *s_v));
             }
         }
 
@@ -1218,6 +1322,19 @@ void initialize_type_checker() {
     g_nat_xor      = new_persistent_expr_const({"Nat", "xor"});
     g_nat_shiftLeft  = new_persistent_expr_const({"Nat", "shiftLeft"});
     g_nat_shiftRight = new_persistent_expr_const({"Nat", "shiftRight"});
+    g_int_of_nat   = new_persistent_expr_const({"Int", "ofNat"});
+    g_int_neg_succ = new_persistent_expr_const({"Int", "negSucc"});
+    g_int_neg      = new_persistent_expr_const({"Int", "neg"});
+    g_int_add      = new_persistent_expr_const({"Int", "add"});
+    g_int_sub      = new_persistent_expr_const({"Int", "sub"});
+    g_int_mul      = new_persistent_expr_const({"Int", "mul"});
+    g_int_div      = new_persistent_expr_const({"Int", "div"});
+    g_int_mod      = new_persistent_expr_const({"Int", "mod"});
+    g_int_ediv     = new_persistent_expr_const({"Int", "ediv"});
+    g_int_emod     = new_persistent_expr_const({"Int", "emod"});
+    g_int_pow      = new_persistent_expr_const({"Int", "pow"});
+    g_int_nat_abs  = new_persistent_expr_const({"Int", "natAbs"});
+    g_int_to_nat   = new_persistent_expr_const({"Int", "toNat"});
     g_string_mk    = new_persistent_expr_const({"String", "mk"});
     g_lean_reduce_bool = new_persistent_expr_const({"Lean", "reduceBool"});
     g_lean_reduce_nat  = new_persistent_expr_const({"Lean", "reduceNat"});
@@ -1244,6 +1361,19 @@ void finalize_type_checker() {
     delete g_nat_xor;
     delete g_nat_shiftLeft;
     delete g_nat_shiftRight;
+    delete g_int_of_nat;
+    delete g_int_neg_succ;
+    delete g_int_neg;
+    delete g_int_add;
+    delete g_int_sub;
+    delete g_int_mul;
+    delete g_int_div;
+    delete g_int_mod;
+    delete g_int_ediv;
+    delete g_int_emod;
+    delete g_int_pow;
+    delete g_int_nat_abs;
+    delete g_int_to_nat;
     delete g_string_mk;
     delete g_lean_reduce_bool;
     delete g_lean_reduce_nat;
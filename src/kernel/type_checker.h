@@ -102,6 +102,10 @@ private:
     template<typename F> optional<expr> reduce_bin_nat_op(F const & f, expr const & e);
     template<typename F> optional<expr> reduce_bin_nat_pred(F const & f, expr const & e);
     optional<expr> reduce_nat(expr const & e);
+    optional<object_ref> get_int_val(expr const & e);
+    template<typename F> optional<expr> reduce_bin_int_op(F const & f, expr const & e);
+    optional<expr> reduce_int_pow(expr const & e);
+    optional<expr> reduce_int(expr const & e);
 public:
     type_checker(state & st, local_ctx const & lctx, definition_safety ds = definition_safety::safe);
     type_checker(state & st, definition_safety ds = definition_safety::safe):type_checker(st, local_ctx(), ds) {}
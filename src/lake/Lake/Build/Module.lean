@@ -150,9 +150,11 @@ all possible artifacts (i.e., `.olean`, `ilean`, `.c`, and `.bc`).
 -/
 def Module.recBuildLean (mod : Module) : FetchM (BuildJob Unit) := do
   withRegisterJob mod.name.toString do
-  (← mod.deps.fetch).bindSync fun (dynlibPath, dynlibs) depTrace => do
+  -- hash the source file while the dependencies are being built
+  let srcJob ← Job.async (computeTrace { path := mod.leanFile : TextFilePath } : JobM BuildTrace)
+  let depsJob := (← mod.deps.fetch).toJob.zipWith (·, ·) srcJob
+  depsJob.bindSync fun (((dynlibPath, dynlibs), depTrace), srcTrace) => do
     let argTrace : BuildTrace := pureHash mod.leanArgs
-    let srcTrace : BuildTrace ← computeTrace { path := mod.leanFile : TextFilePath }
     let modTrace := (← getLeanTrace).mix <| argTrace.mix <| srcTrace.mix depTrace
     let upToDate ← buildUnlessUpToDate? (oldTrace := srcTrace) mod modTrace mod.traceFile do
       let hasLLVM := Lean.Internal.hasLLVMBackend ()
@@ -129,14 +129,14 @@ instance [ComputeHash α m] : ComputeTrace α m Hash := ⟨ComputeHash.computeHa
 instance : ComputeHash String Id := ⟨Hash.ofString⟩
 
 def computeFileHash (file : FilePath) : IO Hash :=
-  Hash.ofByteArray <$> IO.FS.readBinFile file
+  Hash.mk <$> IO.FS.hashFile file
 
 instance : ComputeHash FilePath IO := ⟨computeFileHash⟩
 
+/-- Same as `Hash.ofString (crlf2lf (← IO.FS.readFile file))`, but does not read the whole file into memory. -/
 def computeTextFileHash (file : FilePath) : IO Hash := do
-  let text ← IO.FS.readFile file
-  let text := crlf2lf text
-  return Hash.ofString text
+  let h ← IO.FS.hashFile file (normalizeEol := true)
+  return Hash.nil.mix ⟨h⟩
 
 /--
   A wrapper around `FilePath` that adjusts its `ComputeHash` implementation
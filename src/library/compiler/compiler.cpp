@@ -4,6 +4,13 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "runtime/thread.h"
+#include "runtime/interrupt.h"
 #include "util/option_declarations.h"
 #include "util/io.h"
 #include "kernel/type_checker.h"
@@ -34,8 +41,10 @@ Author: Leonardo de Moura
 
 namespace lean {
 static name * g_extract_closed = nullptr;
+static name * g_parallel       = nullptr;
 
 bool is_extract_closed_enabled(options const & opts) { return opts.get_bool(*g_extract_closed, true); }
+static bool is_parallel_enabled(options const & opts) { return opts.get_bool(*g_parallel, true); }
 
 static name get_real_name(name const & n) {
     if (optional<name> new_n = is_unsafe_rec_name(n))
@@ -55,11 +64,145 @@ static expr eta_expand(environment const & env, expr const & e) {
     return type_checker(env).eta_expand(e);
 }
 
+/* Minimum number of declarations in a group before per-declaration passes are run in parallel. */
+static unsigned const g_par_apply_threshold = 4;
+
+/* Value of the `compiler.parallel` option of the current `compile` call. */
+LEAN_THREAD_VALUE(bool, g_par_apply_enabled, false);
+
+/* Shared state of a parallel `apply`. Declarations are claimed by index by the calling thread
+   and by helper tasks on the task manager. */
+struct par_apply_state {
+    std::function<expr(comp_decl const &)> m_fn;
+    std::vector<comp_decl>            m_input;
+    std::vector<optional<expr>>       m_output;
+    std::atomic<unsigned>             m_next{0};
+    // heartbeat limit of the calling thread, which is thread-local
+    size_t                            m_max_heartbeat = 0;
+
+    mutex                             m_mutex;
+    condition_variable                m_cv;
+    // number of claimed declarations that have been processed
+    unsigned                          m_done = 0;
+    std::exception_ptr                m_ex;
+};
+
+/* Process declarations until all of them have been claimed. Note that `m_fn` may only be used
+   after a successful claim since it refers to the stack frame of the calling thread. */
+static void par_apply_worker(par_apply_state & s, bool helper) {
+    while (true) {
+        // when a helper is cancelled, the remaining declarations are claimed by the calling thread
+        if (helper && lean_io_check_canceled_core())
+            return;
+        unsigned i = s.m_next.fetch_add(1);
+        if (i >= s.m_input.size())
+            return;
+        std::exception_ptr ex;
+        optional<expr> r = none_expr();
+        try {
+            expr v = s.m_fn(s.m_input[i]);
+            // the result is handed over to the calling thread
+            mark_mt(v.raw());
+            r = v;
+        } catch (...) {
+            ex = std::current_exception();
+        }
+        unique_lock<mutex> lock(s.m_mutex);
+        s.m_output[i] = r;
+        if (ex && !s.m_ex)
+            s.m_ex = ex;
+        s.m_done++;
+        s.m_cv.notify_all();
+    }
+}
+
+static obj_res par_apply_worker_fn(obj_arg state, obj_arg) {
+    auto * s = static_cast<std::shared_ptr<par_apply_state> *>(lean_get_external_data(state));
+    // cancellation of the calling task is forwarded to this task by `par_apply`
+    scope_max_heartbeat max_heartbeat((*s)->m_max_heartbeat);
+    par_apply_worker(**s, /* helper */ true);
+    lean_dec(state);
+    return box(0);
+}
+
+static lean_external_class * g_par_apply_state_external_class = nullptr;
+
+static void par_apply_state_finalizer(void * s) {
+    delete static_cast<std::shared_ptr<par_apply_state> *>(s);
+}
+
+static void par_apply_state_foreach(void * /* mod */, b_obj_arg /* fn */) {
+}
+
+/* Return true if the declarations of a group should be processed in parallel.
+   Tracing is thread-local and its output must stay in order, so we stay sequential when it is enabled. */
+static bool use_par_apply(comp_decls const & ds) {
+    return g_par_apply_enabled && has_task_manager() && !is_trace_enabled() && length(ds) >= g_par_apply_threshold;
+}
+
+/* Apply `f` to the value of each declaration in `ds`, using the task manager to process them in parallel.
+   The passes used with `apply` only depend on the environment and the declaration itself, so the result
+   is the same as the sequential one. */
+static comp_decls par_apply(std::function<expr(comp_decl const &)> const & f, environment const & env, comp_decls const & ds) {
+    auto s = std::make_shared<par_apply_state>();
+    s->m_fn = f;
+    mark_mt(env.raw());
+    for (comp_decl const & d : ds) {
+        mark_mt(d.raw());
+        s->m_input.push_back(d);
+    }
+    s->m_output.resize(s->m_input.size());
+    s->m_max_heartbeat = get_max_heartbeat();
+    // the calling thread participates as well, so helpers that are never scheduled are harmless
+    unsigned num_helpers = std::max(std::min(hardware_concurrency(), static_cast<unsigned>(s->m_input.size())), 1u) - 1;
+    buffer<object *> helpers;
+    for (unsigned i = 0; i < num_helpers; i++) {
+        object * state = lean_alloc_external(g_par_apply_state_external_class, new std::shared_ptr<par_apply_state>(s));
+        object * c = lean_alloc_closure((void*)par_apply_worker_fn, 2, 1);
+        lean_closure_set(c, 0, state);
+        helpers.push_back(lean_task_spawn_core(c, 0, /* keep_alive */ true));
+    }
+    par_apply_worker(*s, /* helper */ false);
+    {
+        unique_lock<mutex> lock(s->m_mutex);
+        // only wait for declarations that have already been claimed by running helpers
+        bool canceled = false;
+        while (s->m_done < s->m_input.size()) {
+            s->m_cv.wait_for(lock, chrono::milliseconds(g_small_sleep));
+            if (!canceled && lean_io_check_canceled_core()) {
+                // the helpers check their own tasks for cancellation
+                canceled = true;
+                for (object * t : helpers)
+                    lean_io_cancel_core(t);
+            }
+        }
+    }
+    for (object * t : helpers)
+        lean_dec(t);
+    check_interrupted();
+    if (s->m_ex)
+        std::rethrow_exception(s->m_ex);
+    buffer<comp_decl> r;
+    for (unsigned i = 0; i < s->m_input.size(); i++)
+        r.push_back(comp_decl(s->m_input[i].fst(), *s->m_output[i]));
+    return comp_decls(r);
+}
+
 template<typename F>
 comp_decls apply(F && f, environment const & env, comp_decls const & ds) {
+    if (use_par_apply(ds))
+        return par_apply([&](comp_decl const & d) { return f(env, d.snd()); }, env, ds);
     return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(env, d.snd())); });
 }
 
+/* Like `apply`, but `f` also takes the name of the declaration. */
+template<typename F>
+comp_decls apply_decl(F && f, environment const & env, comp_decls const & ds) {
+    if (use_par_apply(ds))
+        return par_apply([&](comp_decl const & d) { return f(env, d.fst(), d.snd()); }, env, ds);
+    return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(env, d.fst(), d.snd())); });
+}
+
 template<typename F>
 comp_decls apply(F && f, comp_decls const & ds) {
     return map(ds, [&](comp_decl const & d) { return comp_decl(d.fst(), f(d.snd())); });
@@ -197,13 +340,14 @@ environment compile(environment const & env, options const & opts, names cs) {
 
     time_task t("compilation", opts, head(cs));
     scope_trace_env scope_trace(env, opts);
+    flet<bool> par_apply_enabled(g_par_apply_enabled, is_parallel_enabled(opts));
 
     comp_decls ds = to_comp_decls(env, cs);
     csimp_cfg cfg(opts);
     // Use the following line to see compiler intermediate steps
     // scope_traces_as_string trace_scope;
-    auto simp  = [&](environment const & env, expr const & e) { return csimp(env, e, cfg); };
-    auto esimp = [&](environment const & env, expr const & e) { return cesimp(env, e, cfg); };
+    auto simp  = [&](environment const & env, name const & n, expr const & e) { return csimp(env, e, cfg.for_decl(n)); };
+    auto esimp = [&](environment const & env, name const & n, expr const & e) { return cesimp(env, e, cfg.for_decl(n)); };
     trace_compiler(name({"compiler", "input"}), ds);
     ds = apply(eta_expand, env, ds);
     trace_compiler(name({"compiler", "eta_expand"}), ds);
@@ -215,7 +359,7 @@ environment compile(environment const & env, options const & opts, names cs) {
     ds = apply(cce, env, ds);
     trace_compiler(name({"compiler", "cce"}), ds);
     ds = apply(csimp_replace_constants, env, ds);
-    ds = apply(simp, env, ds);
+    ds = apply_decl(simp, env, ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     // trace(ds);
     environment new_env = env;
@@ -244,25 +388,25 @@ environment compile(environment const & env, options const & opts, names cs) {
     trace_compiler(name({"compiler", "erase_irrelevant"}), ds);
     ds = apply(struct_cases_on, new_env, ds);
     trace_compiler(name({"compiler", "struct_cases_on"}), ds);
-    ds = apply(esimp, new_env, ds);
+    ds = apply_decl(esimp, new_env, ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     ds = reduce_arity(new_env, ds);
     trace_compiler(name({"compiler", "reduce_arity"}), ds);
     std::tie(new_env, ds) = lambda_lifting(new_env, ds);
     trace_compiler(name({"compiler", "lambda_lifting"}), ds);
     // trace(ds);
-    ds = apply(esimp, new_env, ds);
+    ds = apply_decl(esimp, new_env, ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     new_env = cache_stage2(new_env, ds);
     trace_compiler(name({"compiler", "stage2"}), ds);
     if (is_extract_closed_enabled(opts)) {
         std::tie(new_env, ds) = extract_closed(new_env, ds);
         ds = apply(elim_dead_let, ds);
-        ds = apply(esimp, new_env, ds);
+        ds = apply_decl(esimp, new_env, ds);
         trace_compiler(name({"compiler", "extract_closed"}), ds);
     }
     new_env = cache_new_stage2(new_env, ds);
-    ds = apply(esimp, new_env, ds);
+    ds = apply_decl(esimp, new_env, ds);
     trace_compiler(name({"compiler", "simp"}), ds);
     ds = apply(simp_app_args, new_env, ds);
     ds = apply(ecse, new_env, ds);
@@ -280,9 +424,13 @@ extern "C" LEAN_EXPORT object * lean_compile_decls(object * env, object * opts,
 }
 
 void initialize_compiler() {
+    g_par_apply_state_external_class = lean_register_external_class(par_apply_state_finalizer, par_apply_state_foreach);
     g_extract_closed = new name{"compiler", "extract_closed"};
     mark_persistent(g_extract_closed->raw());
     register_bool_option(*g_extract_closed, true, "(compiler) enable/disable closed term caching");
+    g_parallel = new name{"compiler", "parallel"};
+    mark_persistent(g_parallel->raw());
+    register_bool_option(*g_parallel, true, "(compiler) process the declarations of large mutual groups in parallel");
     register_trace_class("compiler");
     register_trace_class({"compiler", "input"});
     register_trace_class({"compiler", "inline"});
@@ -325,5 +473,6 @@ void initialize_compiler() {
 
 void finalize_compiler() {
     delete g_extract_closed;
+    delete g_parallel;
 }
 }
@@ -29,8 +29,10 @@ Author: Leonardo de Moura
 #include "library/compiler/init_attribute.h"
 
 namespace lean {
-csimp_cfg::csimp_cfg(options const &):
+csimp_cfg::csimp_cfg(options const & opts):
     csimp_cfg() {
+    m_profile       = get_call_profile(opts);
+    m_hot_threshold = get_profile_hot_threshold(opts);
 }
 
 csimp_cfg::csimp_cfg() {
@@ -38,6 +40,20 @@ csimp_cfg::csimp_cfg() {
     m_inline_threshold                = 1;
     m_float_cases_threshold           = 20;
     m_inline_jp_threshold             = 2;
+    m_hot_threshold                   = 0;
+    m_hot_inline_threshold            = 8;
+}
+
+csimp_cfg csimp_cfg::for_decl(name const & decl) const {
+    csimp_cfg r(*this);
+    r.m_decl = decl;
+    return r;
+}
+
+unsigned csimp_cfg::get_inline_threshold(name const & fn) const {
+    if (m_profile && m_profile->get_calls(m_decl, fn) >= m_hot_threshold)
+        return m_hot_inline_threshold;
+    return m_inline_threshold;
 }
 
 /*
@@ -1741,7 +1757,7 @@ class csimp_fn {
             bool inline_attr           = has_inline_attribute(env(), const_name(fn));
             bool inline_if_reduce_attr = has_inline_if_reduce_attribute(env(), const_name(fn));
             if (!inline_attr && !inline_if_reduce_attr &&
-                (get_lcnf_size(env(), info->get_value()) > m_cfg.m_inline_threshold ||
+                (get_lcnf_size(env(), info->get_value()) > m_cfg.get_inline_threshold(const_name(fn)) ||
                  is_constant(e))) { /* We only inline constants if they are marked with the `[inline]` or `[inline_if_reduce]` attrs */
                 return none_expr();
             }
@@ -1767,7 +1783,7 @@ class csimp_fn {
             if (!info || !info->is_definition()) return none_expr();
             unsigned arity = get_num_nested_lambdas(info->get_value());
             if (get_app_num_args(e) < arity || arity == 0) return none_expr();
-            if (get_lcnf_size(env(), info->get_value()) > m_cfg.m_inline_threshold) return none_expr();
+            if (get_lcnf_size(env(), info->get_value()) > m_cfg.get_inline_threshold(const_name(fn))) return none_expr();
             if (is_recursive(const_name(fn))) return none_expr();
             if (uses_unsafe_inductive(c)) return none_expr();
             return some_expr(beta_reduce(info->get_value(), e, is_let_val));
@@ -5,7 +5,9 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Leonardo de Moura
 */
 #pragma once
+#include <memory>
 #include "kernel/environment.h"
+#include "library/compiler/profile.h"
 namespace lean {
 struct csimp_cfg {
     /* If `m_inline` == false, then we will not inline `c` even if it is marked with the attribute `[inline]`. */
@@ -18,9 +20,20 @@ struct csimp_cfg {
     unsigned m_float_cases_threshold;
     /* We inline join-points that are smaller m_inline_threshold. */
     unsigned m_inline_jp_threshold;
+    /* Call profile set using `compiler.profile`, if any. Functions called at least `m_hot_threshold` times from
+       `m_decl` according to the profile are considered cheap if `get_lcnf_size(val) < m_hot_inline_threshold`. */
+    std::shared_ptr<call_profile const> m_profile;
+    unsigned m_hot_threshold;
+    unsigned m_hot_inline_threshold;
+    /* Declaration being compiled, i.e. the caller whose profiled calls are used. */
+    name m_decl;
 public:
     csimp_cfg(options const & opts);
     csimp_cfg();
+    /* Return this configuration for simplifying the declaration `decl`. */
+    csimp_cfg for_decl(name const & decl) const;
+    /* Return the inlining threshold for calls to `fn` from `m_decl`, taking the call profile into account. */
+    unsigned get_inline_threshold(name const & fn) const;
 };
 
 expr csimp_core(environment const & env, local_ctx const & lctx, expr const & e, bool before_erasure, csimp_cfg const & cfg);
@@ -230,7 +230,7 @@ class eager_lambda_lifting_fn {
                 code = ::lean::mk_lambda(decl.get_user_name(), type, code);
             }
             if (apply_simp) {
-                code = csimp(env(), code, m_cfg);
+                code = csimp(env(), code, m_cfg.for_decl(m_base_name));
             }
             expr type = cheap_beta_reduce(type_checker(m_st).infer(code));
             name n    = next_name();
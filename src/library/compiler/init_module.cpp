@@ -15,10 +15,13 @@ Author: Leonardo de Moura
 #include "library/compiler/ll_infer_type.h"
 #include "library/compiler/ir.h"
 #include "library/compiler/ir_interpreter.h"
+#include "library/compiler/ir_jit.h"
+#include "library/compiler/profile.h"
 
 namespace lean {
 void initialize_compiler_module() {
     initialize_compiler_util();
+    initialize_profile();
     initialize_lcnf();
     initialize_elim_dead_let();
     initialize_cse();
@@ -29,9 +32,11 @@ void initialize_compiler_module() {
     initialize_ll_infer_type();
     initialize_ir();
     initialize_ir_interpreter();
+    initialize_ir_jit();
 }
 
 void finalize_compiler_module() {
+    finalize_ir_jit();
     finalize_ir_interpreter();
     finalize_ir();
     finalize_ll_infer_type();
@@ -42,6 +47,7 @@ void finalize_compiler_module() {
     finalize_cse();
     finalize_elim_dead_let();
     finalize_lcnf();
+    finalize_profile();
     finalize_compiler_util();
 }
 }
@@ -26,7 +26,10 @@ functions, which have a (relatively) homogeneous ABI that we can use without run
 `call/lookup_symbol` below.
 
 */
+#include <atomic>
+#include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #ifdef LEAN_WINDOWS
 #include <windows.h>
@@ -40,10 +43,15 @@ functions, which have a (relatively) homogeneous ABI that we can use without run
 #include "runtime/io.h"
 #include "runtime/option_ref.h"
 #include "runtime/array_ref.h"
+#include "runtime/load_dynlib.h"
+#include "runtime/thread.h"
 #include "kernel/trace.h"
 #include "library/time_task.h"
 #include "library/compiler/ir.h"
 #include "library/compiler/init_attribute.h"
+#include "library/compiler/ir_jit.h"
+#include "library/compiler/profile.h"
+#include "util/name_set.h"
 #include "util/nat.h"
 #include "util/option_declarations.h"
 
@@ -51,6 +59,14 @@ functions, which have a (relatively) homogeneous ABI that we can use without run
 #define LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE true
 #endif
 
+#ifndef LEAN_DEFAULT_INTERPRETER_JIT
+#define LEAN_DEFAULT_INTERPRETER_JIT false
+#endif
+
+#ifndef LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD
+#define LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD 1000
+#endif
+
 namespace lean {
 namespace ir {
 // C++ wrappers of Lean data types
@@ -191,6 +207,9 @@ static string_ref * g_mangle_prefix = nullptr;
 static string_ref * g_boxed_suffix = nullptr;
 static string_ref * g_boxed_mangled_suffix = nullptr;
 static name * g_interpreter_prefer_native = nullptr;
+static name * g_interpreter_jit = nullptr;
+static name * g_interpreter_jit_threshold = nullptr;
+static name * g_interpreter_profile = nullptr;
 
 // constants (lacking native declarations) initialized by `lean_run_init`
 static name_map<object *> * g_init_globals;
@@ -319,6 +338,85 @@ void * lookup_symbol_in_cur_exe(char const * sym) {
 #endif
 }
 
+extern "C" object * lean_environment_find_module_name_for(object * env, object * n);
+static optional<name> find_module_name_for(environment const & env, name const & n) {
+    option_ref<name> r(lean_environment_find_module_name_for(env.to_obj_arg(), n.to_obj_arg()));
+    return r ? optional<name>(r.get().value()) : optional<name>();
+}
+
+/* Native symbol lookups for declarations of imported modules, shared by all interpreter instances and threads.
+   Unlike the per-interpreter caches, these do not depend on the environment but only on the symbols of the current
+   process, so they survive switching environments or options. Keys are stored as C++ strings so that the cache does
+   not retain objects of compacted regions, which may be freed together with their environment. Failed lookups are
+   forgotten whenever a new library is loaded.
+
+   IR declarations are deliberately not shared here: they are objects of the compacted region of the module that
+   declares them, and `Environment.freeRegions` (e.g. at the end of `withImportModules`) frees that region while
+   the process keeps running, possibly importing the same module again into a new region. A process-wide entry
+   would then point into freed memory, and detecting this would need a lookup in the environment, which is what
+   resolving the declaration costs in the first place. They are cached per interpreter in `m_symbol_cache`
+   instead, whose lifetime is bounded by the environment it was created for. */
+class shared_symbol_cache {
+public:
+    struct entry {
+        // symbol address; `nullptr` if function does not have native code
+        void * m_addr;
+        // true iff the address is the one of the boxed version
+        bool m_boxed;
+    };
+private:
+    mutex                                                                       m_mutex;
+    // module name ↦ declaration name ↦ lookup result
+    std::unordered_map<std::string, std::unordered_map<std::string, entry>>    m_modules;
+    unsigned                                                                    m_num_dynlibs = 0;
+public:
+    // statistics, only read when they are displayed; local hits are counted by each interpreter and added on
+    // destruction
+    std::atomic<uint64>                                                         m_local_hits{0};
+    std::atomic<uint64>                                                         m_shared_hits{0};
+    std::atomic<uint64>                                                         m_misses{0};
+
+    optional<entry> find(std::string const & mod, std::string const & fn) {
+        lock_guard<mutex> lock(m_mutex);
+        unsigned num_dynlibs = get_num_loaded_dynlibs();
+        if (m_num_dynlibs != num_dynlibs) {
+            m_modules.clear();
+            m_num_dynlibs = num_dynlibs;
+        }
+        auto it = m_modules.find(mod);
+        if (it == m_modules.end())
+            return optional<entry>();
+        auto it2 = it->second.find(fn);
+        if (it2 == it->second.end())
+            return optional<entry>();
+        return optional<entry>(it2->second);
+    }
+
+    void insert(std::string const & mod, std::string const & fn, entry const & e) {
+        lock_guard<mutex> lock(m_mutex);
+        m_modules[mod][fn] = e;
+    }
+};
+
+static shared_symbol_cache * g_shared_symbol_cache = nullptr;
+
+void display_interpreter_stats(std::ostream & out) {
+    uint64 local_hits  = g_shared_symbol_cache->m_local_hits.load(std::memory_order_relaxed);
+    uint64 shared_hits = g_shared_symbol_cache->m_shared_hits.load(std::memory_order_relaxed);
+    uint64 misses      = g_shared_symbol_cache->m_misses.load(std::memory_order_relaxed);
+    uint64 total       = local_hits + shared_hits + misses;
+    out << "interpreter symbol lookups:            " << total << "\n";
+    out << "  local cache hits:                    " << local_hits << "\n";
+    out << "  shared cache hits:                   " << shared_hits << "\n";
+    out << "  resolved:                            " << misses << "\n";
+    if (total > 0)
+        out << "  hit rate:                            " << (100 * (local_hits + shared_hits) / total) << "%\n";
+    if (is_jit_available()) {
+        out << "JIT-compiled functions:                " << get_jit_num_compiled() << "\n";
+        out << "  released:                            " << get_jit_num_released() << "\n";
+    }
+}
+
 class interpreter;
 LEAN_THREAD_PTR(interpreter, g_interpreter);
 
@@ -355,6 +453,16 @@ class interpreter {
     };
     // caches symbol lookup successes _and_ failures
     name_map<symbol_cache_entry> m_symbol_cache;
+    // number of hits in `m_symbol_cache`, added to `g_shared_symbol_cache->m_local_hits` on destruction
+    uint64 m_symbol_cache_hits = 0;
+    // number of interpreted calls after which a function is JIT-compiled; `0` if the JIT is disabled
+    unsigned m_jit_threshold;
+    // JIT state of the functions called by this interpreter, shared with the other interpreters of the process
+    std::unordered_map<name, std::shared_ptr<jit_function>, name_hash_fn, name_eq_fn> m_jit_functions;
+    // file the call profile is written to (`interpreter.profile`); empty if profiling is disabled
+    std::string m_profile_path;
+    // caller => callee => number of calls, only used when profiling
+    std::unordered_map<name, std::unordered_map<name, uint64, name_hash_fn, name_eq_fn>, name_hash_fn, name_eq_fn> m_profile_counts;
 
     /** \brief Get current stack frame */
     inline frame & get_frame() {
@@ -757,19 +865,34 @@ private:
     /** \brief Return cached lookup result for given unmangled function name in the current binary. */
     symbol_cache_entry lookup_symbol(name const & fn) {
         if (symbol_cache_entry const * e = m_symbol_cache.find(fn)) {
+            m_symbol_cache_hits++;
             return *e;
         } else {
             symbol_cache_entry e_new { get_decl(fn), nullptr, false };
             if (m_prefer_native || decl_tag(e_new.m_decl) == decl_kind::Extern || has_init_attribute(m_env, fn)) {
-                string_ref mangled = name_mangle(fn, *g_mangle_prefix);
-                string_ref boxed_mangled(string_append(mangled.to_obj_arg(), g_boxed_mangled_suffix->raw()));
-                // check for boxed version first
-                if (void *p_boxed = lookup_symbol_in_cur_exe(boxed_mangled.data())) {
-                    e_new.m_addr = p_boxed;
-                    e_new.m_boxed = true;
-                } else if (void *p = lookup_symbol_in_cur_exe(mangled.data())) {
-                    // if there is no boxed version, there are no unboxed parameters, so use default version
-                    e_new.m_addr = p;
+                // declarations of the current module may still change, so only share lookups for imported ones
+                optional<name> mod = find_module_name_for(m_env, fn);
+                optional<shared_symbol_cache::entry> shared;
+                if (mod)
+                    shared = g_shared_symbol_cache->find(mod->escape(), fn.escape());
+                if (shared) {
+                    g_shared_symbol_cache->m_shared_hits.fetch_add(1, std::memory_order_relaxed);
+                    e_new.m_addr  = shared->m_addr;
+                    e_new.m_boxed = shared->m_boxed;
+                } else {
+                    g_shared_symbol_cache->m_misses.fetch_add(1, std::memory_order_relaxed);
+                    string_ref mangled = name_mangle(fn, *g_mangle_prefix);
+                    string_ref boxed_mangled(string_append(mangled.to_obj_arg(), g_boxed_mangled_suffix->raw()));
+                    // check for boxed version first
+                    if (void *p_boxed = lookup_symbol_in_cur_exe(boxed_mangled.data())) {
+                        e_new.m_addr = p_boxed;
+                        e_new.m_boxed = true;
+                    } else if (void *p = lookup_symbol_in_cur_exe(mangled.data())) {
+                        // if there is no boxed version, there are no unboxed parameters, so use default version
+                        e_new.m_addr = p;
+                    }
+                    if (mod)
+                        g_shared_symbol_cache->insert(mod->escape(), fn.escape(), shared_symbol_cache::entry { e_new.m_addr, e_new.m_boxed });
                 }
             }
             m_symbol_cache.insert(fn, e_new);
@@ -777,6 +900,33 @@ private:
         }
     }
 
+    /** \brief Count an interpreted call of `fn` and try to JIT-compile it once it becomes hot in this process. Return
+        the native code if `fn` has been compiled, by this or another interpreter; further calls of `fn` then use it via
+        `lookup_symbol`. */
+    jit_symbol count_call(name const & fn) {
+        std::shared_ptr<jit_function> & f = m_jit_functions[fn];
+        if (!f)
+            f = jit_get_function(fn, get_decl(fn).raw());
+        if (f->count_call(m_jit_threshold)) {
+            string_ref mangled = name_mangle(fn, *g_mangle_prefix);
+            string_ref boxed_mangled(string_append(mangled.to_obj_arg(), g_boxed_mangled_suffix->raw()));
+            jit_compile(m_env, fn, *f, mangled.data(), boxed_mangled.data());
+        }
+        jit_symbol s = f->get_symbol();
+        if (s.m_addr) {
+            symbol_cache_entry const * e = m_symbol_cache.find(fn);
+            if (!e || !e->m_addr)
+                m_symbol_cache.insert(fn, symbol_cache_entry { get_decl(fn), s.m_addr, s.m_boxed });
+        }
+        return s;
+    }
+
+    /** \brief Record a call of `fn` from the current function for `interpreter.profile`. */
+    void profile_call(name const & fn) {
+        name caller = m_call_stack.empty() ? name() : get_frame().m_fn;
+        m_profile_counts[caller][fn]++;
+    }
+
     /** \brief Retrieve Lean declaration from environment. */
     decl get_decl(name const & fn) {
         option_ref<decl> d = find_ir_decl(m_env, fn);
@@ -836,6 +986,9 @@ private:
     value call(name const & fn, array_ref<arg> const & args) {
         size_t old_size = m_arg_stack.size();
         value r;
+        if (!m_profile_path.empty()) {
+            profile_call(fn);
+        }
         symbol_cache_entry e = lookup_symbol(fn);
         if (e.m_addr) {
             object ** args2 = static_cast<object **>(LEAN_ALLOCA(args.size() * sizeof(object *))); // NOLINT
@@ -870,6 +1023,9 @@ private:
                                           << "For declarations from `Init` or `Lean`, you need to set `supportInterpreter := true` "
                                           << "in the relevant `lean_exe` statement in your `lakefile.lean`.");
             }
+            if (m_jit_threshold && decl_tag(e.m_decl) == decl_kind::Fun) {
+                count_call(fn);
+            }
             // evaluate args in old stack frame
             for (const auto & arg : args) {
                 m_arg_stack.push_back(eval_arg(arg));
@@ -885,6 +1041,22 @@ private:
     object * stub_m(object ** args) {
         decl d(args[2]);
         size_t old_size = m_arg_stack.size();
+        if (!m_profile_path.empty()) {
+            profile_call(decl_fun_id(d));
+        }
+        if (m_jit_threshold && decl_tag(d) == decl_kind::Fun) {
+            // closures point to `fn._boxed` if it exists, which is compiled together with `fn`
+            name fn = decl_fun_id(d);
+            if (fn.is_string() && !fn.is_atomic() && fn.get_string() == *g_boxed_suffix)
+                fn = fn.get_prefix();
+            jit_symbol s = count_call(fn);
+            if (s.m_addr) {
+                // closure arguments are boxed and owned, as expected by the boxed version; if there is no boxed version,
+                // all parameters are owned objects
+                lean_assert(s.m_boxed || fn == decl_fun_id(d));
+                return curry(s.m_addr, decl_params(d).size(), args + 3);
+            }
+        }
         for (size_t i = 0; i < decl_params(d).size(); i++) {
             m_arg_stack.push_back(args[3 + i]);
         }
@@ -946,11 +1118,25 @@ private:
 public:
     explicit interpreter(environment const & env, options const & opts) : m_env(env), m_opts(opts) {
         m_prefer_native = opts.get_bool(*g_interpreter_prefer_native, LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE);
+        m_jit_threshold = 0;
+        if (is_jit_available() && opts.get_bool(*g_interpreter_jit, LEAN_DEFAULT_INTERPRETER_JIT)) {
+            m_jit_threshold = std::max(opts.get_unsigned(*g_interpreter_jit_threshold, LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD), 1u);
+        }
+        m_profile_path = opts.get_string(*g_interpreter_profile, "");
     }
 
     interpreter(interpreter const &) = delete;
 
     ~interpreter() {
+        g_shared_symbol_cache->m_local_hits.fetch_add(m_symbol_cache_hits, std::memory_order_relaxed);
+        if (!m_profile_counts.empty()) {
+            call_profile p;
+            for (auto const & caller : m_profile_counts) {
+                for (auto const & callee : caller.second)
+                    p.add_calls(caller.first, callee.first, callee.second);
+            }
+            record_call_profile(m_profile_path, p);
+        }
         for_each(m_constant_cache, [](name const &, constant_cache_entry const & e) {
             if (!e.m_is_scalar) {
                 dec(e.m_val.m_obj);
@@ -1114,7 +1300,14 @@ void initialize_ir_interpreter() {
     mark_persistent(ir::g_boxed_mangled_suffix->raw());
     ir::g_interpreter_prefer_native = new name({"interpreter", "prefer_native"});
     ir::g_init_globals = new name_map<object *>();
+    ir::g_shared_symbol_cache = new ir::shared_symbol_cache();
     register_bool_option(*ir::g_interpreter_prefer_native, LEAN_DEFAULT_INTERPRETER_PREFER_NATIVE, "(interpreter) whether to use precompiled code where available");
+    ir::g_interpreter_jit = new name({"interpreter", "jit"});
+    register_bool_option(*ir::g_interpreter_jit, LEAN_DEFAULT_INTERPRETER_JIT, "(interpreter) compile frequently called functions of the current module to native code (requires LLVM support)");
+    ir::g_interpreter_jit_threshold = new name({"interpreter", "jit_threshold"});
+    register_unsigned_option(*ir::g_interpreter_jit_threshold, LEAN_DEFAULT_INTERPRETER_JIT_THRESHOLD, "(interpreter) number of interpreted calls after which a function is compiled to native code when `interpreter.jit` is enabled");
+    ir::g_interpreter_profile = new name({"interpreter", "profile"});
+    register_option(*ir::g_interpreter_profile, {}, data_value_kind::String, "", "(interpreter) record the number of calls between functions and accumulate them in the given file when the process exits, for use with `compiler.profile`");
     DEBUG_CODE({
         register_trace_class({"interpreter"});
         register_trace_class({"interpreter", "call"});
@@ -1123,7 +1316,11 @@ void initialize_ir_interpreter() {
 }
 
 void finalize_ir_interpreter() {
+    delete ir::g_shared_symbol_cache;
     delete ir::g_init_globals;
+    delete ir::g_interpreter_profile;
+    delete ir::g_interpreter_jit_threshold;
+    delete ir::g_interpreter_jit;
     delete ir::g_interpreter_prefer_native;
     delete ir::g_boxed_mangled_suffix;
     delete ir::g_boxed_suffix;
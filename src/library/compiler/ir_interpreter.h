@@ -5,6 +5,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 Author: Sebastian Ullrich
 */
 #pragma once
+#include <iostream>
 #include "kernel/environment.h"
 #include "runtime/object.h"
 
@@ -13,6 +14,8 @@ namespace ir {
 /** \brief Run `n` using the "boxed" ABI, i.e. with all-owned parameters. */
 object * run_boxed(environment const & env, options const & opts, name const & fn, unsigned n, object **args);
 uint32 run_main(environment const & env, options const & opts, int argv, char * argc[]);
+/** \brief Display hit counts of the interpreter's native symbol caches. */
+void display_interpreter_stats(std::ostream & out);
 }
 void initialize_ir_interpreter();
 void finalize_ir_interpreter();
@@ -0,0 +1,251 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+JIT tier of the IR interpreter. Functions of the current module that are called often enough by the interpreter are
+compiled to native code in-process by reusing the LLVM backend (`EmitLLVM.lean`) and ORC's LLJIT. Each compilation
+produces a self-contained LLVM module: all functions except for the requested entry points get internal linkage,
+and the entry points are renamed to unique symbols, so that functions can be compiled repeatedly (e.g. after they
+have been redefined) without symbol clashes. Declarations of imported modules are resolved to the native code
+already present in the process, just like in the interpreter's `lookup_symbol`.
+
+Call counts and compiled code are kept per process in `jit_function` objects. Each compiled module is added to the
+JIT with its own resource tracker, which is used to release the code once the function has been redefined (which
+happens when the language server re-elaborates a file) and no interpreter uses the old definition anymore. Closures
+of compiled code can only escape into values computed by commands that use the old definition, which are discarded
+together with it.
+*/
+#include <string>
+#include <unordered_map>
+#include "runtime/io.h"
+#include "runtime/thread.h"
+#include "library/compiler/ir_jit.h"
+
+#ifdef LEAN_LLVM
+#include "llvm-c/Core.h"
+#include "llvm-c/Error.h"
+#include "llvm-c/LLJIT.h"
+#include "llvm-c/Orc.h"
+#include "llvm-c/Target.h"
+#include "llvm-c/Transforms/PassBuilder.h"
+#endif
+
+namespace lean {
+namespace ir {
+static mutex * g_jit_mutex = nullptr;
+// JIT state of the functions called by interpreters of this process, protected by `g_jit_mutex`
+static std::unordered_map<name, std::shared_ptr<jit_function>, name_hash_fn, name_eq_fn> * g_jit_functions = nullptr;
+static std::atomic<unsigned> g_jit_num_compiled{0};
+static std::atomic<unsigned> g_jit_num_released{0};
+
+jit_function::jit_function(object * d):m_decl(d) {
+    inc(d);
+}
+
+std::shared_ptr<jit_function> jit_get_function(name const & fn, object * d) {
+    lock_guard<mutex> lock(*g_jit_mutex);
+    std::shared_ptr<jit_function> & f = (*g_jit_functions)[fn];
+    if (!f || f->m_decl != d)
+        f = std::make_shared<jit_function>(d);
+    return f;
+}
+
+unsigned get_jit_num_compiled() {
+    return g_jit_num_compiled.load(std::memory_order_relaxed);
+}
+
+unsigned get_jit_num_released() {
+    return g_jit_num_released.load(std::memory_order_relaxed);
+}
+
+#ifdef LEAN_LLVM
+extern "C" object * lean_ir_emit_llvm_jit(object * env, object * fn, size_t llvmctx, object * w);
+
+static LLVMOrcLLJITRef g_jit = nullptr;
+static bool g_jit_failed = false;
+static unsigned g_jit_next_idx = 0;
+
+static void jit_report_error(void *, LLVMErrorRef err) {
+    // failed lookups are reported to `jit_compile` as well, which falls back to the interpreter
+    LLVMConsumeError(err);
+}
+
+/* Create the LLJIT instance on first use. Must be called with `g_jit_mutex` held. */
+static bool init_jit() {
+    if (g_jit)
+        return true;
+    if (g_jit_failed)
+        return false;
+    g_jit_failed = true;
+    if (LLVMInitializeNativeTarget() || LLVMInitializeNativeAsmPrinter())
+        return false;
+    LLVMOrcLLJITRef jit;
+    if (LLVMErrorRef err = LLVMOrcCreateLLJIT(&jit, nullptr)) {
+        LLVMConsumeError(err);
+        return false;
+    }
+    LLVMOrcDefinitionGeneratorRef gen;
+    if (LLVMErrorRef err = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&gen, LLVMOrcLLJITGetGlobalPrefix(jit), nullptr, nullptr)) {
+        LLVMConsumeError(err);
+        LLVMConsumeError(LLVMOrcDisposeLLJIT(jit));
+        return false;
+    }
+    LLVMOrcJITDylibAddGenerator(LLVMOrcLLJITGetMainJITDylib(jit), gen);
+    LLVMOrcExecutionSessionSetErrorReporter(LLVMOrcLLJITGetExecutionSession(jit), jit_report_error, nullptr);
+    g_jit = jit;
+    g_jit_failed = false;
+    return true;
+}
+
+/* Give all definitions of `mod` internal linkage except for `sym` and `boxed_sym`, which are renamed by appending
+   `suffix`. */
+static void internalize(LLVMModuleRef mod, std::string const & sym, std::string const & boxed_sym, std::string const & suffix) {
+    for (LLVMValueRef f = LLVMGetFirstFunction(mod); f; f = LLVMGetNextFunction(f)) {
+        if (LLVMIsDeclaration(f))
+            continue;
+        size_t len;
+        char const * n = LLVMGetValueName2(f, &len);
+        std::string f_name(n, len);
+        if (f_name == sym || f_name == boxed_sym) {
+            std::string new_name = f_name + suffix;
+            LLVMSetValueName2(f, new_name.data(), new_name.size());
+            LLVMSetLinkage(f, LLVMExternalLinkage);
+        } else {
+            LLVMSetLinkage(f, LLVMInternalLinkage);
+        }
+    }
+    for (LLVMValueRef g = LLVMGetFirstGlobal(mod); g; g = LLVMGetNextGlobal(g)) {
+        if (!LLVMIsDeclaration(g))
+            LLVMSetLinkage(g, LLVMInternalLinkage);
+    }
+}
+
+static optional<LLVMOrcExecutorAddress> jit_lookup(std::string const & sym) {
+    LLVMOrcExecutorAddress addr;
+    if (LLVMErrorRef err = LLVMOrcLLJITLookup(g_jit, &addr, sym.c_str())) {
+        LLVMConsumeError(err);
+        return optional<LLVMOrcExecutorAddress>();
+    }
+    return optional<LLVMOrcExecutorAddress>(addr);
+}
+
+/* Remove the code added using `rt` from the JIT. */
+static void jit_remove(LLVMOrcResourceTrackerRef rt) {
+    if (LLVMErrorRef err = LLVMOrcResourceTrackerRemove(rt))
+        LLVMConsumeError(err);
+    LLVMOrcReleaseResourceTracker(rt);
+}
+
+jit_function::~jit_function() {
+    if (m_tracker) {
+        jit_remove(static_cast<LLVMOrcResourceTrackerRef>(m_tracker));
+        g_jit_num_released++;
+    }
+    dec(m_decl);
+}
+
+bool is_jit_available() {
+    return true;
+}
+
+jit_symbol jit_compile(environment const & env, name const & fn, jit_function & f, std::string const & sym,
+                       std::string const & boxed_sym) {
+    std::string suffix;
+    {
+        lock_guard<mutex> lock(*g_jit_mutex);
+        if (!init_jit())
+            return jit_symbol();
+        // `.` does not occur in mangled names, so the new symbols cannot clash with existing ones
+        suffix = "._jit" + std::to_string(g_jit_next_idx++);
+    }
+    LLVMOrcThreadSafeContextRef tsctx = LLVMOrcCreateNewThreadSafeContext();
+    LLVMContextRef ctx = LLVMOrcThreadSafeContextGetContext(tsctx);
+    object * r = lean_ir_emit_llvm_jit(env.to_obj_arg(), fn.to_obj_arg(), reinterpret_cast<size_t>(ctx), io_mk_world());
+    if (io_result_is_error(r) || is_scalar(io_result_get_value(r))) {
+        // unsupported function or error while emitting
+        dec_ref(r);
+        LLVMOrcDisposeThreadSafeContext(tsctx);
+        return jit_symbol();
+    }
+    LLVMModuleRef mod = reinterpret_cast<LLVMModuleRef>(lean_unbox_usize(cnstr_get(io_result_get_value(r), 0)));
+    dec_ref(r);
+    internalize(mod, sym, boxed_sym, suffix);
+    LLVMSetTarget(mod, LLVMOrcLLJITGetTripleString(g_jit));
+    LLVMSetDataLayout(mod, LLVMOrcLLJITGetDataLayoutStr(g_jit));
+    LLVMPassBuilderOptionsRef pb_opts = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef err = LLVMRunPasses(mod, "default<O2>", nullptr, pb_opts);
+    LLVMDisposePassBuilderOptions(pb_opts);
+    if (err) {
+        LLVMConsumeError(err);
+        LLVMDisposeModule(mod);
+        LLVMOrcDisposeThreadSafeContext(tsctx);
+        return jit_symbol();
+    }
+    // the module takes shared ownership of the context
+    LLVMOrcThreadSafeModuleRef tsm = LLVMOrcCreateNewThreadSafeModule(mod, tsctx);
+    LLVMOrcDisposeThreadSafeContext(tsctx);
+    LLVMOrcResourceTrackerRef rt = LLVMOrcJITDylibCreateResourceTracker(LLVMOrcLLJITGetMainJITDylib(g_jit));
+    if (LLVMErrorRef err = LLVMOrcLLJITAddLLVMIRModuleWithRT(g_jit, rt, tsm)) {
+        LLVMConsumeError(err);
+        LLVMOrcReleaseResourceTracker(rt);
+        return jit_symbol();
+    }
+    // code is generated on lookup, which fails if symbols used by the module cannot be resolved
+    jit_symbol s;
+    if (optional<LLVMOrcExecutorAddress> addr = jit_lookup(boxed_sym + suffix)) {
+        s.m_addr  = reinterpret_cast<void *>(*addr);
+        s.m_boxed = true;
+    } else if (optional<LLVMOrcExecutorAddress> addr = jit_lookup(sym + suffix)) {
+        // if there is no boxed version, there are no unboxed parameters, so use default version
+        s.m_addr  = reinterpret_cast<void *>(*addr);
+    }
+    if (!s.m_addr) {
+        jit_remove(rt);
+        return s;
+    }
+    f.m_tracker = rt;
+    f.m_symbol  = s;
+    f.m_compiled.store(true, std::memory_order_release);
+    g_jit_num_compiled++;
+    return s;
+}
+#else
+jit_function::~jit_function() {
+    dec(m_decl);
+}
+
+bool is_jit_available() {
+    return false;
+}
+
+jit_symbol jit_compile(environment const &, name const &, jit_function &, std::string const &, std::string const &) {
+    return jit_symbol();
+}
+#endif
+
+extern "C" LEAN_EXPORT obj_res lean_ir_jit_is_available(obj_arg) {
+    return io_result_mk_ok(box(is_jit_available()));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_ir_jit_is_compiled(b_obj_arg fn, obj_arg) {
+    lock_guard<mutex> lock(*g_jit_mutex);
+    auto it = g_jit_functions->find(name(fn, true));
+    return io_result_mk_ok(box(it != g_jit_functions->end() && it->second->get_symbol().m_addr != nullptr));
+}
+}
+
+void initialize_ir_jit() {
+    ir::g_jit_mutex = new mutex();
+    ir::g_jit_functions = new std::unordered_map<name, std::shared_ptr<ir::jit_function>, name_hash_fn, name_eq_fn>();
+}
+
+void finalize_ir_jit() {
+    // release the compiled code before the JIT itself
+    delete ir::g_jit_functions;
+#ifdef LEAN_LLVM
+    if (ir::g_jit)
+        LLVMConsumeError(LLVMOrcDisposeLLJIT(ir::g_jit));
+#endif
+    delete ir::g_jit_mutex;
+}
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include "kernel/environment.h"
+
+namespace lean {
+namespace ir {
+struct jit_symbol {
+    // address of the compiled code; `nullptr` if compilation failed
+    void * m_addr  = nullptr;
+    // true iff `m_addr` is the boxed version of the function
+    bool   m_boxed = false;
+};
+/** \brief JIT state of a function of the current module, shared by all interpreters of the process so that calls
+    made through different interpreters (e.g. of different commands, or of closures called from native code) are
+    counted together and the function is compiled at most once. */
+class jit_function {
+    // IR declaration of the function, which identifies its definition; owned
+    object *              m_decl;
+    std::atomic<unsigned> m_calls{0};
+    // set by the interpreter that compiles the function
+    std::atomic<bool>     m_claimed{false};
+    std::atomic<bool>     m_compiled{false};
+    // valid iff `m_compiled`
+    jit_symbol            m_symbol;
+    // `LLVMOrcResourceTrackerRef` of the compiled code, which is released with this object
+    void *                m_tracker = nullptr;
+    friend jit_symbol jit_compile(environment const & env, name const & fn, jit_function & f, std::string const & sym,
+                                  std::string const & boxed_sym);
+    friend std::shared_ptr<jit_function> jit_get_function(name const & fn, object * d);
+public:
+    explicit jit_function(object * d);
+    jit_function(jit_function const &) = delete;
+    ~jit_function();
+    /** \brief Count a call and return true iff the function has now been called at least `threshold` times in this
+        process and the caller should compile it, which is the case for only one call. */
+    bool count_call(unsigned threshold) {
+        return
+            m_calls.fetch_add(1, std::memory_order_relaxed) + 1 >= threshold &&
+            !m_claimed.load(std::memory_order_relaxed) &&
+            !m_claimed.exchange(true, std::memory_order_relaxed);
+    }
+    /** \brief Return the compiled code, or a symbol with `m_addr == nullptr` if the function has not been compiled. */
+    jit_symbol get_symbol() const { return m_compiled.load(std::memory_order_acquire) ? m_symbol : jit_symbol(); }
+};
+/** \brief Return true if this build of Lean supports JIT compilation of interpreted functions. */
+bool is_jit_available();
+/** \brief Return the JIT state of `fn`, whose IR declaration is `d` (borrowed). If `fn` was redefined, i.e. the
+    state of `fn` belongs to a different declaration, the old state is replaced, and the code compiled for it is
+    released as soon as no interpreter uses it anymore. */
+std::shared_ptr<jit_function> jit_get_function(name const & fn, object * d);
+/** \brief Compile `fn` of the current module of `env` together with the functions of the current module it uses
+    to native code, and store the result in `f`. `sym` and `boxed_sym` are the mangled names of `fn` and its boxed
+    version. */
+jit_symbol jit_compile(environment const & env, name const & fn, jit_function & f, std::string const & sym,
+                       std::string const & boxed_sym);
+/** \brief Number of functions compiled in this process, and number of compiled functions whose code has been
+    released since. */
+unsigned get_jit_num_compiled();
+unsigned get_jit_num_released();
+}
+void initialize_ir_jit();
+void finalize_ir_jit();
+}
@@ -473,6 +473,22 @@ extern "C" LEAN_EXPORT lean_object *lean_llvm_array_type(
 #endif  // LEAN_LLVM
 }
 
+extern "C" LEAN_EXPORT lean_object *lean_llvm_struct_type_in_context(
+    size_t ctx, lean_object *elemtys, uint8_t packed, lean_object * /* w */) {
+#ifndef LEAN_LLVM
+    lean_always_assert(
+        false && ("Please build a version of Lean4 with -DLLVM=ON to invoke "
+                  "the LLVM backend function."));
+#else
+    lean::array_ref<lean_object *> arr(elemtys, true);
+    LLVMTypeRef *tys = array_ref_to_ArrayLLVMType(arr);
+    LLVMTypeRef out =
+        LLVMStructTypeInContext(lean_to_Context(ctx), tys, arr.size(), packed);
+    free(tys);
+    return lean_io_result_mk_ok(lean_box_usize(Type_to_lean(out)));
+#endif  // LEAN_LLVM
+}
+
 extern "C" LEAN_EXPORT lean_object *lean_llvm_create_builder_in_context(
     size_t ctx, lean_object * /* w */) {
 #ifndef LEAN_LLVM
@@ -668,6 +684,32 @@ extern "C" LEAN_EXPORT lean_object *lean_llvm_build_inbounds_gep2(size_t ctx,
 #endif  // LEAN_LLVM
 }
 
+extern "C" LEAN_EXPORT lean_object *lean_llvm_build_extract_value(size_t ctx,
+    size_t builder, size_t agg, uint64_t idx, lean_object *name, lean_object * /* w */) {
+#ifndef LEAN_LLVM
+    lean_always_assert(
+        false && ("Please build a version of Lean4 with -DLLVM=ON to invoke "
+                  "the LLVM backend function."));
+#else
+    LLVMValueRef out = LLVMBuildExtractValue(
+        lean_to_Builder(builder), lean_to_Value(agg), idx, lean_string_cstr(name));
+    return lean_io_result_mk_ok(lean_box_usize(Value_to_lean(out)));
+#endif  // LEAN_LLVM
+}
+
+extern "C" LEAN_EXPORT lean_object *lean_llvm_build_insert_value(size_t ctx,
+    size_t builder, size_t agg, size_t val, uint64_t idx, lean_object *name, lean_object * /* w */) {
+#ifndef LEAN_LLVM
+    lean_always_assert(
+        false && ("Please build a version of Lean4 with -DLLVM=ON to invoke "
+                  "the LLVM backend function."));
+#else
+    LLVMValueRef out = LLVMBuildInsertValue(
+        lean_to_Builder(builder), lean_to_Value(agg), lean_to_Value(val), idx, lean_string_cstr(name));
+    return lean_io_result_mk_ok(lean_box_usize(Value_to_lean(out)));
+#endif  // LEAN_LLVM
+}
+
 extern "C" LEAN_EXPORT lean_object *lean_llvm_build_gep2(size_t ctx, size_t builder,
                                                         size_t ty,
                                                         size_t pointer,
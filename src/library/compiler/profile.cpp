@@ -0,0 +1,246 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Call profiles for profile-guided inlining and specialization. A profile is a plain text file of the form
+```
+lean-call-profile 2
+call	<count>	<caller root>	<callee root>
+...
+```
+(fields separated by tabs). It is written by the IR interpreter when `interpreter.profile` is set, once per process
+when it exits, and accumulated over all runs writing to the same file. It is read by the compiler when
+`compiler.profile` is set. Concurrent processes using the same profile synchronize through a lock on the file
+`<profile>.lock`.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#ifdef LEAN_WINDOWS
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#endif
+#include "runtime/sstream.h"
+#include "runtime/thread.h"
+#include "runtime/buffer.h"
+#include "util/option_declarations.h"
+#include "library/compiler/profile.h"
+
+#ifndef LEAN_DEFAULT_COMPILER_PROFILE_HOT_THRESHOLD
+#define LEAN_DEFAULT_COMPILER_PROFILE_HOT_THRESHOLD 1000
+#endif
+
+namespace lean {
+static char const * g_profile_header = "lean-call-profile 2";
+
+static name * g_compiler_profile = nullptr;
+static name * g_compiler_profile_hot_threshold = nullptr;
+
+static mutex * g_profile_mutex = nullptr;
+// profiles read by this process, by path
+static std::unordered_map<std::string, std::shared_ptr<call_profile const>> * g_loaded_profiles = nullptr;
+// counts recorded by this process that have not been written yet, by path
+static std::unordered_map<std::string, call_profile> * g_pending_profiles = nullptr;
+
+name get_profile_root(name const & n) {
+    if (n.is_anonymous())
+        return n;
+    buffer<name> prefixes;
+    for (name it = n; !it.is_anonymous(); it = it.get_prefix())
+        prefixes.push_back(it);
+    // `prefixes` is ordered from longest to shortest; keep the longest prefix without generated components, but
+    // never strip the first component (e.g. `_private`)
+    name r = prefixes.back();
+    for (unsigned i = prefixes.size() - 1; i > 0; i--) {
+        name const & p = prefixes[i - 1];
+        if (p.is_string() && p.get_string().data()[0] == '_')
+            break;
+        r = p;
+    }
+    return r;
+}
+
+static std::string profile_key(name const & n) {
+    return get_profile_root(n).to_string();
+}
+
+void call_profile::add_calls(name const & caller, name const & callee, uint64 n) {
+    std::string caller_key = profile_key(caller);
+    std::string callee_key = profile_key(callee);
+    m_edges[caller_key][callee_key] += n;
+    m_calls[callee_key] += n;
+    m_executed.insert(caller_key);
+    m_executed.insert(callee_key);
+}
+
+void call_profile::merge(call_profile const & p) {
+    for (auto const & caller : p.m_edges) {
+        auto & edges = m_edges[caller.first];
+        for (auto const & callee : caller.second)
+            edges[callee.first] += callee.second;
+    }
+    for (auto const & c : p.m_calls)
+        m_calls[c.first] += c.second;
+    m_executed.insert(p.m_executed.begin(), p.m_executed.end());
+}
+
+uint64 call_profile::get_calls(name const & caller, name const & callee) const {
+    auto it = m_edges.find(profile_key(caller));
+    if (it == m_edges.end())
+        return 0;
+    auto it2 = it->second.find(profile_key(callee));
+    return it2 == it->second.end() ? 0 : it2->second;
+}
+
+uint64 call_profile::get_calls(name const & fn) const {
+    auto it = m_calls.find(profile_key(fn));
+    return it == m_calls.end() ? 0 : it->second;
+}
+
+bool call_profile::was_executed(name const & fn) const {
+    return m_executed.count(profile_key(fn)) > 0;
+}
+
+call_profile call_profile::load(std::string const & path) {
+    std::ifstream in(path);
+    if (in.fail())
+        throw exception(sstream() << "failed to open profile '" << path << "'");
+    std::string line;
+    if (!std::getline(in, line) || line != g_profile_header)
+        throw exception(sstream() << "failed to read profile '" << path << "', invalid header");
+    call_profile p;
+    unsigned line_num = 1;
+    while (std::getline(in, line)) {
+        line_num++;
+        if (line.empty())
+            continue;
+        buffer<std::string> fields;
+        std::istringstream fs(line);
+        std::string field;
+        while (std::getline(fs, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() == 4 && fields[0] == "call") {
+            uint64 n = std::strtoull(fields[1].c_str(), nullptr, 10);
+            p.m_edges[fields[2]][fields[3]] += n;
+            p.m_calls[fields[3]] += n;
+            p.m_executed.insert(fields[2]);
+            p.m_executed.insert(fields[3]);
+        } else {
+            throw exception(sstream() << "failed to read profile '" << path << "', invalid line " << line_num);
+        }
+    }
+    return p;
+}
+
+void call_profile::save(std::string const & path) const {
+    std::ofstream out(path);
+    if (out.fail())
+        throw exception(sstream() << "failed to write profile '" << path << "'");
+    out << g_profile_header << "\n";
+    for (auto const & caller : m_edges) {
+        for (auto const & callee : caller.second)
+            out << "call\t" << callee.second << "\t" << caller.first << "\t" << callee.first << "\n";
+    }
+}
+
+/* Exclusive lock on `<path>.lock`, which protects the profile `path` against concurrent accesses by other processes.
+   Threads of the same process must additionally hold `g_profile_mutex`. */
+class profile_file_lock {
+    FILE * m_fp;
+public:
+    explicit profile_file_lock(std::string const & path) {
+        std::string lock_path = path + ".lock";
+        m_fp = fopen(lock_path.c_str(), "a");
+        if (!m_fp)
+            throw exception(sstream() << "failed to open profile lock file '" << lock_path << "'");
+#ifdef LEAN_WINDOWS
+        OVERLAPPED o = {0};
+        bool ok = LockFileEx((HANDLE)_get_osfhandle(_fileno(m_fp)), LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &o);
+#else
+        bool ok = !flock(fileno(m_fp), LOCK_EX);
+#endif
+        if (!ok) {
+            fclose(m_fp);
+            throw exception(sstream() << "failed to lock profile lock file '" << lock_path << "'");
+        }
+    }
+    ~profile_file_lock() {
+        // closing the file releases the lock
+        fclose(m_fp);
+    }
+};
+
+void record_call_profile(std::string const & path, call_profile const & p) {
+    lock_guard<mutex> lock(*g_profile_mutex);
+    (*g_pending_profiles)[path].merge(p);
+}
+
+/* Write the counts recorded by this process. Called both by `finalize_profile` and when the process exits, since
+   `lean` may exit without finalizing modules; the first call writes them. */
+static void flush_call_profiles() {
+    if (!g_profile_mutex)
+        return;
+    lock_guard<mutex> lock(*g_profile_mutex);
+    for (auto const & e : *g_pending_profiles) {
+        try {
+            profile_file_lock file_lock(e.first);
+            // merge with the counts written by earlier runs and by concurrent processes
+            call_profile r;
+            if (std::ifstream(e.first).good())
+                r = call_profile::load(e.first);
+            r.merge(e.second);
+            r.save(e.first);
+        } catch (exception & ex) {
+            std::cerr << ex.what() << "\n";
+        }
+    }
+    g_pending_profiles->clear();
+}
+
+std::shared_ptr<call_profile const> get_call_profile(options const & opts) {
+    char const * path = opts.get_string(*g_compiler_profile, "");
+    if (!path || !*path)
+        return nullptr;
+    lock_guard<mutex> lock(*g_profile_mutex);
+    auto it = g_loaded_profiles->find(path);
+    if (it != g_loaded_profiles->end())
+        return it->second;
+    profile_file_lock file_lock(path);
+    auto p = std::make_shared<call_profile const>(call_profile::load(path));
+    g_loaded_profiles->emplace(path, p);
+    return p;
+}
+
+unsigned get_profile_hot_threshold(options const & opts) {
+    return opts.get_unsigned(*g_compiler_profile_hot_threshold, LEAN_DEFAULT_COMPILER_PROFILE_HOT_THRESHOLD);
+}
+
+void initialize_profile() {
+    g_profile_mutex = new mutex();
+    g_loaded_profiles = new std::unordered_map<std::string, std::shared_ptr<call_profile const>>();
+    g_pending_profiles = new std::unordered_map<std::string, call_profile>();
+    std::atexit(flush_call_profiles);
+    g_compiler_profile = new name({"compiler", "profile"});
+    register_option(*g_compiler_profile, {}, data_value_kind::String, "",
+                    "(compiler) call profile written by `interpreter.profile` used to guide inlining and specialization");
+    g_compiler_profile_hot_threshold = new name({"compiler", "profile_hot_threshold"});
+    register_unsigned_option(*g_compiler_profile_hot_threshold, LEAN_DEFAULT_COMPILER_PROFILE_HOT_THRESHOLD,
+                             "(compiler) number of profiled calls after which a function is inlined more aggressively");
+}
+
+void finalize_profile() {
+    flush_call_profiles();
+    delete g_compiler_profile_hot_threshold;
+    delete g_compiler_profile;
+    delete g_pending_profiles;
+    delete g_loaded_profiles;
+    delete g_profile_mutex;
+    g_profile_mutex = nullptr;
+}
+}
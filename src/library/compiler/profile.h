@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "runtime/int64.h"
+#include "util/options.h"
+#include "util/name.h"
+
+namespace lean {
+/** \brief Call counts collected by the IR interpreter (option `interpreter.profile`) and consumed by the compiler
+    (option `compiler.profile`).
+
+    Functions are identified by their "profile root" (see `get_profile_root`), so that counts collected for
+    auxiliary declarations such as `f._lambda_1` or `List.map._at.f._spec_1` are attributed to `f` and `List.map`,
+    respectively, which are the names the compiler sees when it makes inlining and specialization decisions. */
+class call_profile {
+    // (caller root, callee root) => number of calls
+    std::unordered_map<std::string, std::unordered_map<std::string, uint64>> m_edges;
+    // callee root => number of calls
+    std::unordered_map<std::string, uint64> m_calls;
+    // roots of all functions that have been executed, either as caller or as callee
+    std::unordered_set<std::string> m_executed;
+public:
+    void add_calls(name const & caller, name const & callee, uint64 n);
+    void merge(call_profile const & p);
+
+    /** \brief Return the number of calls from (any part of) `caller` to `callee`. */
+    uint64 get_calls(name const & caller, name const & callee) const;
+    /** \brief Return the number of calls to `fn`. */
+    uint64 get_calls(name const & fn) const;
+    /** \brief Return true iff `fn` was executed at all. Functions missing from the profile may simply not have been
+        run by the profiled workload, so callers should treat them as unknown rather than cold. */
+    bool was_executed(name const & fn) const;
+
+    bool empty() const { return m_calls.empty(); }
+
+    /** \brief Read a profile written by `save`. Throws an exception if the file cannot be read. */
+    static call_profile load(std::string const & path);
+    void save(std::string const & path) const;
+};
+
+/** \brief Strip compiler-generated suffixes such as `_lambda_<idx>`, `_at`, `_spec_<idx>`, `_rarg`, and `_boxed`
+    from a declaration name. */
+name get_profile_root(name const & n);
+
+/** \brief Add `p` to the counts of this process for the profile stored at `path`. They are added to the file, which
+    is created if it does not exist yet and otherwise accumulated over all runs, once when the process exits.
+    Thread safe. */
+void record_call_profile(std::string const & path, call_profile const & p);
+
+/** \brief Return the profile specified by the option `compiler.profile`, or `nullptr` if the option is not set.
+    Profiles are read once per process. */
+std::shared_ptr<call_profile const> get_call_profile(options const & opts);
+/** \brief Option `compiler.profile_hot_threshold`: number of profiled calls after which a function is considered hot. */
+unsigned get_profile_hot_threshold(options const & opts);
+
+void initialize_profile();
+void finalize_profile();
+}
@@ -269,6 +269,8 @@ class specialize_fn {
     local_ctx           m_lctx;
     buffer<comp_decl>   m_new_decls;
     name                m_base_name;
+    // declaration whose code is being visited, `m_base_name` or a specialization of it; used to look up call counts
+    name                m_caller;
     name                m_at;
     name                m_spec;
     unsigned            m_next_idx{1};
@@ -278,6 +280,26 @@ class specialize_fn {
 
     name_generator & ngen() { return m_st.ngen(); }
 
+    /* Return true if the call profile shows that `m_caller` was executed but never called `fn`, in which case
+       specializing the call would only increase code size. Declarations missing from the profile are unknown
+       rather than cold, since the profiled workload may simply not have run them. */
+    bool is_cold_call(name const & fn) {
+        return
+            m_cfg.m_profile &&
+            m_cfg.m_profile->was_executed(m_caller) &&
+            m_cfg.m_profile->get_calls(m_caller, fn) == 0;
+    }
+
+    /* Return true if the call profile shows that `m_caller` calls `fn` at least `compiler.profile_hot_threshold`
+       times, in which case we specialize `fn` for its higher-order arguments as if it had a `@[specialize]`
+       attribute. */
+    bool is_hot_call(name const & fn) {
+        return
+            m_cfg.m_profile &&
+            m_cfg.m_profile->get_calls(m_caller, fn) >= m_cfg.m_hot_threshold &&
+            !has_nospecialize_attribute(env(), fn);
+    }
+
     expr visit_lambda(expr e) {
         flet<local_ctx> save_lctx(m_lctx, m_lctx);
         buffer<expr> fvars;
@@ -446,7 +468,7 @@ class specialize_fn {
     }
 
     bool has_specialize_attribute(name const & fn) {
-        return ::lean::has_specialize_attribute(env(), fn) || m_to_respecialize.contains(fn);
+        return ::lean::has_specialize_attribute(env(), fn) || m_to_respecialize.contains(fn) || is_hot_call(fn);
     }
 
     void get_bool_mask(name const & fn, unsigned args_size, buffer<bool> & mask) {
@@ -981,8 +1003,11 @@ class specialize_fn {
         }
         code = eta_expand_specialization(code);
         // lean_trace(name("compiler", "spec_info"), tout() << "STEP 2 " << n << "\n" << code << "\n";);
-        code = csimp(env(), code, m_cfg);
-        code = visit(code);
+        code = csimp(env(), code, m_cfg.for_decl(n));
+        {
+            flet<name> set_caller(m_caller, n);
+            code = visit(code);
+        }
         lean_trace(name("compiler", "specialize"), tout() << "new code " << n << "\n" << trace_pp_expr(code) << "\n";);
         comp_decl new_decl(n, code);
         m_new_decls.push_back(new_decl);
@@ -1051,6 +1076,10 @@ class specialize_fn {
     }
 
     optional<expr> specialize(expr const & fn, buffer<expr> const & args, spec_ctx & ctx) {
+        if (is_cold_call(const_name(fn))) {
+            lean_trace(name({"compiler", "specialize"}), tout() << "COLD: " << const_name(fn) << " at " << m_caller << "\n";);
+            return none_expr();
+        }
         if (!is_specialize_candidate(fn, args))
             return none_expr();
         if (num_parts(const_name(fn)) > 32) {
@@ -1218,6 +1247,7 @@ public:
 
     pair<environment, comp_decls> operator()(comp_decl const & d) {
         m_base_name = d.fst();
+        m_caller    = d.fst();
         lean_trace(name({"compiler", "specialize"}), tout() << "INPUT: " << d.fst() << "\n" << trace_pp_expr(d.snd()) << "\n";);
         expr new_v = visit(d.snd());
         comp_decl new_d(d.fst(), new_v);
@@ -45,7 +45,7 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 
 namespace lean {
 
-/** On-disk format of a .olean file. */
+/** On-disk format of a .olean file. Binary .ilean files use the same format with a different magic number. */
 struct olean_header {
     // 5 bytes: magic number
     char marker[5] = {'o', 'l', 'e', 'a', 'n'};
@@ -61,8 +61,12 @@ struct olean_header {
 // make sure we don't have any padding bytes, which also ensures `data` is properly aligned
 static_assert(sizeof(olean_header) == 5 + 1 + 42 + sizeof(size_t), "olean_header must be packed");
 
-extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, object *) {
-    std::string olean_fn(string_cstr(fname));
+static char const g_olean_marker[5] = {'o', 'l', 'e', 'a', 'n'};
+static char const g_ilean_marker[5] = {'i', 'l', 'e', 'a', 'n'};
+
+/* Write the object graph `mdata` to `olean_fn`, with the header `marker` and a preferred `mmap` base address
+   derived from `base_hash`. */
+static object * save_compacted_file(char const * marker, std::string const & olean_fn, uint64 base_hash, b_obj_arg mdata) {
     // we first write to a temp file and then move it to the correct path (possibly deleting an older file)
     // so that we neither expose partially-written files nor modify possibly memory-mapped files
     std::string olean_tmp_fn = olean_fn + ".tmp";
@@ -80,7 +84,7 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
         // Let's start with a hash of the module name. Note that while our string hash is a dubious 32-bit
         // algorithm, the mixing of multiple `Name` parts seems to result in a nicely distributed 64-bit
         // output
-        size_t base_addr = name(mod, true).hash();
+        size_t base_addr = base_hash;
         // x86-64 user space is currently limited to the lower 47 bits
         // https://en.wikipedia.org/wiki/X86-64#Virtual_address_space_details
         // On Linux at least, the stack grows down from ~0x7fff... followed by shared libraries, so reserve
@@ -95,6 +99,7 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
 
         // see/sync with file format description above
         olean_header header = {};
+        memcpy(header.marker, marker, sizeof(header.marker));
         header.base_addr = base_addr;
         strncpy(header.githash, LEAN_GITHASH, sizeof(header.githash));
         out.write(reinterpret_cast<char *>(&header), sizeof(header));
@@ -126,8 +131,19 @@ extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg
     }
 }
 
-extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *) {
-    std::string olean_fn(string_cstr(fname));
+extern "C" LEAN_EXPORT object * lean_save_module_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg mdata, object *) {
+    return save_compacted_file(g_olean_marker, string_cstr(fname), name(mod, true).hash(), mdata);
+}
+
+extern "C" LEAN_EXPORT object * lean_save_ilean_data(b_obj_arg fname, b_obj_arg mod, b_obj_arg data, object *) {
+    // make sure the preferred base address differs from the one of the corresponding .olean file
+    return save_compacted_file(g_ilean_marker, string_cstr(fname), hash(name(mod, true).hash(), 11), data);
+}
+
+/* Read a file written by `save_compacted_file` with the same `marker`, using `mmap` if `use_mmap` is set and the
+   preferred base address is free. Returns the contents and the `compacted_region` they are stored in. */
+static object * read_compacted_file(char const * marker, std::string const & olean_fn, bool use_mmap,
+                                    compacted_region * & region_out) {
     try {
         std::ifstream in(olean_fn, std::ios_base::binary);
         if (in.fail()) {
@@ -143,7 +159,7 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
         if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
             return io_result_mk_error((sstream() << "failed to read file '" << olean_fn << "', invalid header").str());
         }
-        if (memcmp(header.marker, default_header.marker, sizeof(header.marker)) != 0
+        if (memcmp(header.marker, marker, sizeof(header.marker)) != 0
             || header.version != default_header.version
 #ifdef LEAN_CHECK_OLEAN_VERSION
             || strncmp(header.githash, LEAN_GITHASH, sizeof(header.githash)) != 0
@@ -165,7 +181,9 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
         if (h_olean_fn == NULL) {
             return io_result_mk_error((sstream() << "failed to map '" << olean_fn << "': " << GetLastError()).str());
         }
-        buffer = static_cast<char *>(MapViewOfFileEx(h_map, FILE_MAP_READ, 0, 0, 0, base_addr));
+        if (use_mmap) {
+            buffer = static_cast<char *>(MapViewOfFileEx(h_map, FILE_MAP_READ, 0, 0, 0, base_addr));
+        }
         free_data = [=]() {
             if (buffer) {
                 lean_always_assert(UnmapViewOfFile(base_addr));
@@ -179,11 +197,13 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
             return io_result_mk_error((sstream() << "failed to open '" << olean_fn << "': " << strerror(errno)).str());
         }
 #ifdef LEAN_MMAP
-        buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+        if (use_mmap) {
+            buffer = static_cast<char *>(mmap(base_addr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+        }
 #endif
         close(fd);
         free_data = [=]() {
-            if (buffer != MAP_FAILED) {
+            if (buffer && buffer != MAP_FAILED) {
                 lean_always_assert(munmap(buffer, size) == 0);
             }
         };
@@ -214,16 +234,58 @@ extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *)
         __lsan_ignore_object(region);
 #endif
 #endif
-        object * mod = region->read();
-        object * mod_region = alloc_cnstr(0, 2, 0);
-        cnstr_set(mod_region, 0, mod);
-        cnstr_set(mod_region, 1, box_size_t(reinterpret_cast<size_t>(region)));
-        return io_result_mk_ok(mod_region);
+        region_out = region;
+        return io_result_mk_ok(region->read());
     } catch (exception & ex) {
         return io_result_mk_error((sstream() << "failed to read '" << olean_fn << "': " << ex.what()).str());
     }
 }
 
+extern "C" LEAN_EXPORT object * lean_read_module_data(object * fname, object *) {
+    compacted_region * region = nullptr;
+    object * r = read_compacted_file(g_olean_marker, string_cstr(fname), true, region);
+    if (io_result_is_error(r))
+        return r;
+    object * mod = io_result_get_value(r);
+    inc(mod);
+    dec_ref(r);
+    object * mod_region = alloc_cnstr(0, 2, 0);
+    cnstr_set(mod_region, 0, mod);
+    cnstr_set(mod_region, 1, box_size_t(reinterpret_cast<size_t>(region)));
+    return io_result_mk_ok(mod_region);
+}
+
+static lean_external_class * g_ilean_region_class = nullptr;
+
+static void ilean_region_finalizer(void * region) {
+    delete static_cast<compacted_region *>(region);
+}
+
+static void ilean_region_foreach(void *, b_obj_arg) {}
+
+/* Unlike the regions of .olean files, which live as long as their environment, the region of an .ilean file is
+   owned by an `IleanRegion` external object and freed with it. */
+extern "C" LEAN_EXPORT object * lean_read_ilean_data(b_obj_arg fname, uint8 use_mmap, object *) {
+    compacted_region * region = nullptr;
+    object * r = read_compacted_file(g_ilean_marker, string_cstr(fname), use_mmap, region);
+    if (io_result_is_error(r))
+        return r;
+    object * ilean = io_result_get_value(r);
+    inc(ilean);
+    dec_ref(r);
+    object * ilean_region = alloc_cnstr(0, 2, 0);
+    cnstr_set(ilean_region, 0, ilean);
+    cnstr_set(ilean_region, 1, alloc_external(g_ilean_region_class, region));
+    return io_result_mk_ok(ilean_region);
+}
+
+void initialize_module() {
+    g_ilean_region_class = lean_register_external_class(ilean_region_finalizer, ilean_region_foreach);
+}
+
+void finalize_module() {
+}
+
 /*
 @[export lean.write_module_core]
 def writeModule (env : Environment) (fname : String) : IO Unit := */
@@ -15,4 +15,7 @@ Authors: Leonardo de Moura, Gabriel Ebner, Sebastian Ullrich
 namespace lean {
 /** \brief Store module using \c env. */
 void write_module(environment const & env, std::string const & olean_fn);
+
+void initialize_module();
+void finalize_module();
 }
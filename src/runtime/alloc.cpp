@@ -453,6 +453,13 @@ extern "C" LEAN_EXPORT unsigned lean_small_mem_size(void * o) {
 
 #endif
 
+void export_heap_objs() {
+#ifdef LEAN_SMALL_ALLOCATOR
+    if (g_heap)
+        g_heap->export_objs();
+#endif
+}
+
 void initialize_alloc() {
 #ifdef LEAN_SMALL_ALLOCATOR
     g_heap_manager = new heap_manager();
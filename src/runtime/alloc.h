@@ -12,6 +12,9 @@ namespace lean {
 void init_thread_heap();
 void * alloc(size_t sz);
 void dealloc(void * o, size_t sz);
+/* Send the objects owned by other heaps that were deallocated by this thread back to their heaps now,
+   instead of waiting for the export list to fill up. */
+void export_heap_objs();
 uint64_t get_num_heartbeats();
 void initialize_alloc();
 void finalize_alloc();
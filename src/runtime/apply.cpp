@@ -11,25 +11,51 @@ namespace lean {
 #define obj lean_object
 #define fx(i) lean_closure_arg_cptr(f)[i]
 
+/* Number of fixed arguments that fit in the memory cell of the closure `f`. */
+static inline unsigned closure_capacity(obj* f) {
+    return (lean_small_object_size(f) - sizeof(lean_closure_object)) / sizeof(void*);
+}
+
+/* Partial applications are often extended again, e.g. by curried functions and monad transformer stacks
+   that receive their arguments one at a time. Thus, we reserve room for the remaining arguments of
+   closures that do not use the boxed calling convention, and `fix_args` updates them in place. */
+static obj* alloc_partial_closure(void* fun, unsigned arity, unsigned num_fixed) {
+    unsigned capacity = arity <= LEAN_CLOSURE_MAX_ARGS ? arity - 1 : num_fixed;
+    lean_closure_object * o = reinterpret_cast<lean_closure_object*>(lean_alloc_small_object(sizeof(lean_closure_object) + sizeof(void*)*capacity));
+    lean_set_st_header(reinterpret_cast<obj*>(o), LeanClosure, 0);
+    o->m_fun = fun;
+    o->m_arity = arity;
+    o->m_num_fixed = num_fixed;
+    return reinterpret_cast<obj*>(o);
+}
+
 static obj* fix_args(obj* f, unsigned n, obj*const* as) {
     unsigned arity = lean_closure_arity(f);
     unsigned fixed = lean_closure_num_fixed(f);
     unsigned new_fixed = fixed + n;
     lean_assert(new_fixed < arity);
-    obj * r = lean_alloc_closure(lean_closure_fun(f), arity, new_fixed);
-    obj ** source = lean_closure_arg_cptr(f);
-    obj ** target = lean_closure_arg_cptr(r);
-    if (!lean_is_exclusive(f)) {
-      for (unsigned i = 0; i < fixed; i++, source++, target++) {
-          *target = *source;
-          lean_inc(*target);
-      }
-      lean_dec_ref(f);
+    obj * r;
+    obj ** target;
+    if (lean_is_exclusive(f) && closure_capacity(f) >= new_fixed) {
+      r = f;
+      lean_to_closure(r)->m_num_fixed = new_fixed;
+      target = lean_closure_arg_cptr(r) + fixed;
     } else {
-      for (unsigned i = 0; i < fixed; i++, source++, target++) {
-          *target = *source;
+      r = alloc_partial_closure(lean_closure_fun(f), arity, new_fixed);
+      obj ** source = lean_closure_arg_cptr(f);
+      target = lean_closure_arg_cptr(r);
+      if (!lean_is_exclusive(f)) {
+        for (unsigned i = 0; i < fixed; i++, source++, target++) {
+            *target = *source;
+            lean_inc(*target);
+        }
+        lean_dec_ref(f);
+      } else {
+        for (unsigned i = 0; i < fixed; i++, source++, target++) {
+            *target = *source;
+        }
+        lean_free_small_object(f);
       }
-      lean_free_small_object(f);
     }
     for (unsigned i = 0; i < n; i++, as++, target++) {
         *target = *as;
@@ -40,6 +66,28 @@ static obj* fix_args(obj* f, unsigned n, obj*const* as) {
 static inline obj* fix_args(obj* f, std::initializer_list<obj*> const & l) {
     return fix_args(f, l.size(), l.begin());
 }
+
+/* Store the fixed arguments of `f` at `args`, consume `f`, and return its code pointer.
+   If `f` is not shared, we move the arguments instead of incrementing their reference counters
+   here and decrementing them again when `f` is deleted. */
+static inline void* take_fixed_args(obj* f, obj** args) {
+    void * fun = lean_closure_fun(f);
+    unsigned fixed = lean_closure_num_fixed(f);
+    obj ** source = lean_closure_arg_cptr(f);
+    if (!lean_is_exclusive(f)) {
+      for (unsigned i = 0; i < fixed; i++) {
+          args[i] = source[i];
+          lean_inc(args[i]);
+      }
+      lean_dec_ref(f);
+    } else {
+      for (unsigned i = 0; i < fixed; i++) {
+          args[i] = source[i];
+      }
+      lean_free_small_object(f);
+    }
+    return fun;
+}
 typedef obj* (*fn1)(obj*); // NOLINT
 #define FN1(f) reinterpret_cast<fn1>(lean_closure_fun(f))
 typedef obj* (*fn2)(obj*, obj*); // NOLINT
@@ -96,7 +144,6 @@ case 16: return reinterpret_cast<fn16>(f)(as[0], as[1], as[2], as[3], as[4], as[
 default: return reinterpret_cast<fnn>(f)(as);
 }
 }
-static obj* curry(obj* f, unsigned n, obj** as) { return curry(lean_closure_fun(f), n, as); }
 extern "C" obj* lean_apply_n(obj*, unsigned, obj**);
 extern "C" LEAN_EXPORT obj* lean_apply_1(obj* f, obj* a1) {
 if (lean_is_scalar(f)) { lean_dec(a1); return f; } // f is an erased proof
@@ -144,11 +191,9 @@ if (arity == fixed + 1) {
     lean_assert(arity > 16);
     obj * as[1] = { a1 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 1; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 1) {
   lean_assert(fixed < arity);
@@ -201,19 +246,16 @@ if (arity == fixed + 2) {
     lean_assert(arity > 16);
     obj * as[2] = { a1, a2 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 2; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 2) {
   obj * as[2] = { a1, a2 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 2+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2});
@@ -261,19 +303,16 @@ if (arity == fixed + 3) {
     lean_assert(arity > 16);
     obj * as[3] = { a1, a2, a3 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 3; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 3) {
   obj * as[3] = { a1, a2, a3 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 3+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3});
@@ -319,19 +358,16 @@ if (arity == fixed + 4) {
     lean_assert(arity > 16);
     obj * as[4] = { a1, a2, a3, a4 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 4; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 4) {
   obj * as[4] = { a1, a2, a3, a4 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 4+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4});
@@ -375,19 +411,16 @@ if (arity == fixed + 5) {
     lean_assert(arity > 16);
     obj * as[5] = { a1, a2, a3, a4, a5 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 5; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 5) {
   obj * as[5] = { a1, a2, a3, a4, a5 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 5+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5});
@@ -429,19 +462,16 @@ if (arity == fixed + 6) {
     lean_assert(arity > 16);
     obj * as[6] = { a1, a2, a3, a4, a5, a6 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 6; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 6) {
   obj * as[6] = { a1, a2, a3, a4, a5, a6 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 6+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6});
@@ -481,19 +511,16 @@ if (arity == fixed + 7) {
     lean_assert(arity > 16);
     obj * as[7] = { a1, a2, a3, a4, a5, a6, a7 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 7; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 7) {
   obj * as[7] = { a1, a2, a3, a4, a5, a6, a7 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 7+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7});
@@ -531,19 +558,16 @@ if (arity == fixed + 8) {
     lean_assert(arity > 16);
     obj * as[8] = { a1, a2, a3, a4, a5, a6, a7, a8 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 8; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 8) {
   obj * as[8] = { a1, a2, a3, a4, a5, a6, a7, a8 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 8+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8});
@@ -579,19 +603,16 @@ if (arity == fixed + 9) {
     lean_assert(arity > 16);
     obj * as[9] = { a1, a2, a3, a4, a5, a6, a7, a8, a9 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 9; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 9) {
   obj * as[9] = { a1, a2, a3, a4, a5, a6, a7, a8, a9 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 9+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9});
@@ -625,19 +646,16 @@ if (arity == fixed + 10) {
     lean_assert(arity > 16);
     obj * as[10] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 10; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 10) {
   obj * as[10] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 10+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9, a10});
@@ -669,19 +687,16 @@ if (arity == fixed + 11) {
     lean_assert(arity > 16);
     obj * as[11] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 11; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 11) {
   obj * as[11] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 11+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11});
@@ -711,19 +726,16 @@ if (arity == fixed + 12) {
     lean_assert(arity > 16);
     obj * as[12] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 12; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 12) {
   obj * as[12] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 12+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12});
@@ -751,19 +763,16 @@ if (arity == fixed + 13) {
     lean_assert(arity > 16);
     obj * as[13] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 13; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 13) {
   obj * as[13] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 13+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13});
@@ -789,19 +798,16 @@ if (arity == fixed + 14) {
     lean_assert(arity > 16);
     obj * as[14] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 14; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 14) {
   obj * as[14] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 14+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14});
@@ -825,19 +831,16 @@ if (arity == fixed + 15) {
     lean_assert(arity > 16);
     obj * as[15] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 15; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 15) {
   obj * as[15] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 15+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15});
@@ -859,19 +862,16 @@ if (arity == fixed + 16) {
     lean_assert(arity > 16);
     obj * as[16] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16 };
     obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-    for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+    void * fun = take_fixed_args(f, args);
     for (unsigned i = 0; i < 16; i++) args[fixed+i] = as[i];
-    obj * r = FNN(f)(args);
-    lean_dec_ref(f);
-    return r;
+    return reinterpret_cast<fnn>(fun)(args);
   }
 } else if (arity < fixed + 16) {
   obj * as[16] = { a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16 };
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = curry(f, arity, args);
-  lean_dec_ref(f);
+  obj * new_f = curry(fun, arity, args);
   return lean_apply_n(new_f, 16+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, {a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16});
@@ -884,17 +884,14 @@ unsigned arity = lean_closure_arity(f);
 unsigned fixed = lean_closure_num_fixed(f);
 if (arity == fixed + n) {
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < n; i++) args[fixed+i] = as[i];
-  obj * r = FNN(f)(args);
-  lean_dec_ref(f);
-  return r;
+  return reinterpret_cast<fnn>(fun)(args);
 } else if (arity < fixed + n) {
   obj ** args = static_cast<obj**>(LEAN_ALLOCA(arity*sizeof(obj*))); // NOLINT
-  for (unsigned i = 0; i < fixed; i++) { lean_inc(fx(i)); args[i] = fx(i); }
+  void * fun = take_fixed_args(f, args);
   for (unsigned i = 0; i < arity-fixed; i++) args[fixed+i] = as[i];
-  obj * new_f = FNN(f)(args);
-  lean_dec_ref(f);
+  obj * new_f = reinterpret_cast<fnn>(fun)(args);
   return lean_apply_n(new_f, n+fixed-arity, &as[arity-fixed]);
 } else {
   return fix_args(f, n, as);
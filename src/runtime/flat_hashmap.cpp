@@ -0,0 +1,318 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Runtime implementation of `Lean.FlatHashMap`, an open-addressing hash map in the style of Swiss tables.
+
+A map is a constructor object with the fields
+* `ctrl`: a `ByteArray` with one control byte per slot, followed by a copy of the first `group::width` control bytes
+  so that a group can be loaded at any slot,
+* `slots`: an `Array` with the key and value of slot `i` at positions `2*i` and `2*i+1`,
+and the number of entries and the number of slots that can still be filled before growing as scalars.
+
+A control byte is `ctrl_empty`, `ctrl_deleted`, or the lower 7 bits (`h2`) of the (mixed) hash of the key in the
+slot. Lookups probe the groups of `group::width` consecutive slots starting at the slot given by the remaining bits
+of the hash (`h1`), comparing all control bytes of a group with `h2` at once using SSE2 or, as a fallback, 64-bit
+word operations. Only keys of matching slots are compared using `BEq`. Probing stops at the first group with an
+empty slot.
+
+All updates are done in place if the map, its control bytes, and its slots are exclusive, and on a copy otherwise.
+`BEq` and `Hashable` instances are represented by their only field, i.e. a closure.
+*/
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "runtime/object.h"
+
+namespace lean {
+static uint8_t const ctrl_empty   = 0x80;
+static uint8_t const ctrl_deleted = 0xFE;
+
+#if defined(__SSE2__)
+struct group {
+    static constexpr unsigned width = 16;
+    __m128i m_ctrl;
+    explicit group(uint8_t const * p) : m_ctrl(_mm_loadu_si128(reinterpret_cast<__m128i const *>(p))) {}
+    /* Bit `i` of the result is set if slot `i` of the group has control byte `c`. */
+    uint32_t match(uint8_t c) const { return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(c), m_ctrl)); }
+    uint32_t match_empty() const { return match(ctrl_empty); }
+    uint32_t match_empty_or_deleted() const { return _mm_movemask_epi8(m_ctrl); }
+    static unsigned slot(uint32_t bits) { return __builtin_ctz(bits); }
+};
+#else
+struct group {
+    static constexpr unsigned width = 8;
+    static constexpr uint64_t lsbs  = 0x0101010101010101ull;
+    static constexpr uint64_t msbs  = 0x8080808080808080ull;
+    uint64_t m_ctrl = 0;
+    explicit group(uint8_t const * p) {
+        for (unsigned i = 0; i < width; i++)
+            m_ctrl |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    /* The most significant bit of byte `i` of the result is set if slot `i` of the group has control byte `c`. May
+       report false positives for bytes above a true positive, which are filtered out by the key comparison. */
+    uint64_t match(uint8_t c) const {
+        uint64_t x = m_ctrl ^ (lsbs * c);
+        return (x - lsbs) & ~x & msbs;
+    }
+    uint64_t match_empty() const { return m_ctrl & (~m_ctrl << 6) & msbs; }
+    uint64_t match_empty_or_deleted() const { return m_ctrl & msbs; }
+    static unsigned slot(uint64_t bits) { return __builtin_ctzll(bits) / 8; }
+};
+#endif
+
+static size_t const min_capacity = 16;
+static_assert(min_capacity >= group::width, "the copied control bytes must not wrap around");
+
+static inline size_t max_load(size_t capacity) {
+    return capacity - capacity / 8;
+}
+
+static inline lean_object * fhm_ctrl(b_obj_arg m) { return lean_ctor_get(m, 0); }
+static inline lean_object * fhm_slots(b_obj_arg m) { return lean_ctor_get(m, 1); }
+static inline size_t fhm_size(b_obj_arg m) { return lean_ctor_get_usize(m, 2); }
+static inline size_t fhm_growth_left(b_obj_arg m) { return lean_ctor_get_usize(m, 3); }
+static inline void fhm_set_size(b_obj_arg m, size_t sz) { lean_ctor_set_usize(m, 2, sz); }
+static inline void fhm_set_growth_left(b_obj_arg m, size_t n) { lean_ctor_set_usize(m, 3, n); }
+static inline size_t fhm_capacity(b_obj_arg m) { return lean_array_size(fhm_slots(m)) / 2; }
+
+static obj_res fhm_alloc(size_t capacity) {
+    obj_res ctrl = lean_alloc_sarray(1, capacity + group::width, capacity + group::width);
+    memset(lean_sarray_cptr(ctrl), ctrl_empty, capacity + group::width);
+    obj_res slots = lean_alloc_array(2 * capacity, 2 * capacity);
+    for (size_t i = 0; i < 2 * capacity; i++)
+        lean_array_set_core(slots, i, lean_box(0));
+    obj_res m = lean_alloc_ctor(0, 2, 2 * sizeof(size_t));
+    lean_ctor_set(m, 0, ctrl);
+    lean_ctor_set(m, 1, slots);
+    fhm_set_size(m, 0);
+    fhm_set_growth_left(m, max_load(capacity));
+    return m;
+}
+
+/* Largest power of two capacity for which the sizes of the control bytes and of the slots do not overflow. */
+static size_t const max_capacity = static_cast<size_t>(1) << (sizeof(size_t) * 8 - 5);
+
+/* Smallest power of two capacity that can hold `n` entries. */
+static size_t fhm_capacity_for(size_t n) {
+    if (n > max_load(max_capacity))
+        lean_internal_panic_out_of_memory();
+    size_t capacity = min_capacity;
+    while (max_load(capacity) < n)
+        capacity *= 2;
+    return capacity;
+}
+
+/* Mixes the bits of the hash, as many `Hashable` instances, e.g. for `Nat`, do not. */
+static inline uint64_t fhm_mix(uint64_t h) {
+    h ^= h >> 32;
+    h *= 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+static inline uint8_t fhm_h2(uint64_t h) { return h & 0x7F; }
+static inline size_t fhm_h1(uint64_t h) { return static_cast<size_t>(h >> 7); }
+
+static inline void fhm_set_ctrl(uint8_t * ctrl, size_t capacity, size_t i, uint8_t c) {
+    ctrl[i] = c;
+    if (i < group::width)
+        ctrl[capacity + i] = c;
+}
+
+/* We assume `BEq` to be reflexive, so pointer-equal keys, e.g. equal scalars, are equal without
+   calling the closure. */
+static inline bool fhm_key_eq(b_obj_arg beq, b_obj_arg k, b_obj_arg k2) {
+    if (k == k2)
+        return true;
+    lean_inc(beq); lean_inc(k); lean_inc(k2);
+    return lean_unbox(lean_apply_2(beq, k, k2));
+}
+
+static inline uint64_t fhm_hash(b_obj_arg hashable, b_obj_arg k) {
+    lean_inc(hashable); lean_inc(k);
+    obj_res r = lean_apply_1(hashable, k);
+    uint64_t h = lean_unbox_uint64(r);
+    lean_dec(r);
+    return fhm_mix(h);
+}
+
+static size_t const not_found = static_cast<size_t>(-1);
+
+/* Returns the slot containing `k`, or `not_found`. `h` is the mixed hash of `k`. */
+static size_t fhm_find_slot(b_obj_arg beq, b_obj_arg m, b_obj_arg k, uint64_t h) {
+    uint8_t const * ctrl = lean_sarray_cptr(fhm_ctrl(m));
+    lean_object ** slots = lean_array_cptr(fhm_slots(m));
+    size_t mask = fhm_capacity(m) - 1;
+    size_t pos  = fhm_h1(h) & mask;
+    uint8_t h2  = fhm_h2(h);
+    for (size_t step = group::width;; step += group::width) {
+        group g(ctrl + pos);
+        for (auto bits = g.match(h2); bits; bits &= bits - 1) {
+            size_t i = (pos + group::slot(bits)) & mask;
+            if (fhm_key_eq(beq, k, slots[2 * i]))
+                return i;
+        }
+        if (g.match_empty())
+            return not_found;
+        pos = (pos + step) & mask;
+    }
+}
+
+/* Returns the first empty or deleted slot in the probe sequence of `h`. */
+static size_t fhm_find_free_slot(uint8_t const * ctrl, size_t capacity, uint64_t h) {
+    size_t mask = capacity - 1;
+    size_t pos  = fhm_h1(h) & mask;
+    for (size_t step = group::width;; step += group::width) {
+        group g(ctrl + pos);
+        if (auto bits = g.match_empty_or_deleted())
+            return (pos + group::slot(bits)) & mask;
+        pos = (pos + step) & mask;
+    }
+}
+
+/* Returns `m` if it is exclusive together with its control bytes and slots, and a copy of it otherwise. */
+static obj_res fhm_ensure_exclusive(obj_arg m) {
+    if (!lean_is_exclusive(m)) {
+        obj_res r = lean_alloc_ctor(0, 2, 2 * sizeof(size_t));
+        lean_inc(fhm_ctrl(m));
+        lean_inc(fhm_slots(m));
+        lean_ctor_set(r, 0, fhm_ctrl(m));
+        lean_ctor_set(r, 1, fhm_slots(m));
+        fhm_set_size(r, fhm_size(m));
+        fhm_set_growth_left(r, fhm_growth_left(m));
+        lean_dec_ref(m);
+        m = r;
+    }
+    if (!lean_is_exclusive(fhm_ctrl(m)))
+        lean_ctor_set(m, 0, lean_copy_byte_array(fhm_ctrl(m)));
+    if (!lean_is_exclusive(fhm_slots(m)))
+        lean_ctor_set(m, 1, lean_copy_array(fhm_slots(m)));
+    return m;
+}
+
+/* Moves all entries of `m` into a new map with room for at least one more entry, rehashing all keys. */
+static obj_res fhm_resize(b_obj_arg hashable, obj_arg m) {
+    size_t size     = fhm_size(m);
+    obj_res r       = fhm_alloc(fhm_capacity_for(size + 1 > size * 2 ? size + 1 : size * 2));
+    size_t capacity = fhm_capacity(r);
+    uint8_t * ctrl  = lean_sarray_cptr(fhm_ctrl(r));
+    lean_object ** slots = lean_array_cptr(fhm_slots(r));
+    bool owned = lean_is_exclusive(m) && lean_is_exclusive(fhm_slots(m));
+    uint8_t const * old_ctrl = lean_sarray_cptr(fhm_ctrl(m));
+    lean_object ** old_slots = lean_array_cptr(fhm_slots(m));
+    for (size_t i = 0; i < fhm_capacity(m); i++) {
+        if (old_ctrl[i] & 0x80)
+            continue;
+        lean_object * k = old_slots[2 * i];
+        lean_object * v = old_slots[2 * i + 1];
+        uint64_t h = fhm_hash(hashable, k);
+        size_t j = fhm_find_free_slot(ctrl, capacity, h);
+        fhm_set_ctrl(ctrl, capacity, j, fhm_h2(h));
+        if (owned) {
+            old_slots[2 * i] = lean_box(0);
+            old_slots[2 * i + 1] = lean_box(0);
+        } else {
+            lean_inc(k); lean_inc(v);
+        }
+        slots[2 * j] = k;
+        slots[2 * j + 1] = v;
+    }
+    fhm_set_size(r, size);
+    fhm_set_growth_left(r, max_load(capacity) - size);
+    lean_dec_ref(m);
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_flat_hashmap_mk(b_obj_arg capacity) {
+    size_t n = lean_is_scalar(capacity) ? lean_unbox(capacity) : 0;
+    return fhm_alloc(fhm_capacity_for(n));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_flat_hashmap_size(b_obj_arg m) {
+    return lean_usize_to_nat(fhm_size(m));
+}
+
+extern "C" LEAN_EXPORT obj_res lean_flat_hashmap_find(b_obj_arg beq, b_obj_arg m, b_obj_arg k, uint64_t h) {
+    size_t i = fhm_find_slot(beq, m, k, fhm_mix(h));
+    if (i == not_found)
+        return lean_box(0);
+    lean_object * v = lean_array_get_core(fhm_slots(m), 2 * i + 1);
+    lean_inc(v);
+    obj_res r = lean_alloc_ctor(1, 1, 0);
+    lean_ctor_set(r, 0, v);
+    return r;
+}
+
+extern "C" LEAN_EXPORT uint8_t lean_flat_hashmap_contains(b_obj_arg beq, b_obj_arg m, b_obj_arg k, uint64_t h) {
+    return fhm_find_slot(beq, m, k, fhm_mix(h)) != not_found;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_flat_hashmap_insert(b_obj_arg beq, b_obj_arg hashable, obj_arg m, obj_arg k,
+                                                         uint64_t h, obj_arg v) {
+    h = fhm_mix(h);
+    size_t i = fhm_find_slot(beq, m, k, h);
+    if (i != not_found) {
+        m = fhm_ensure_exclusive(m);
+        lean_object ** slots = lean_array_cptr(fhm_slots(m));
+        lean_dec(slots[2 * i]);
+        lean_dec(slots[2 * i + 1]);
+        slots[2 * i] = k;
+        slots[2 * i + 1] = v;
+        return m;
+    }
+    size_t capacity = fhm_capacity(m);
+    i = fhm_find_free_slot(lean_sarray_cptr(fhm_ctrl(m)), capacity, h);
+    bool was_empty = lean_sarray_cptr(fhm_ctrl(m))[i] == ctrl_empty;
+    if (was_empty && fhm_growth_left(m) == 0) {
+        m = fhm_resize(hashable, m);
+        capacity = fhm_capacity(m);
+        i = fhm_find_free_slot(lean_sarray_cptr(fhm_ctrl(m)), capacity, h);
+    } else {
+        m = fhm_ensure_exclusive(m);
+    }
+    if (was_empty)
+        fhm_set_growth_left(m, fhm_growth_left(m) - 1);
+    fhm_set_ctrl(lean_sarray_cptr(fhm_ctrl(m)), capacity, i, fhm_h2(h));
+    lean_object ** slots = lean_array_cptr(fhm_slots(m));
+    slots[2 * i] = k;
+    slots[2 * i + 1] = v;
+    fhm_set_size(m, fhm_size(m) + 1);
+    return m;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_flat_hashmap_erase(b_obj_arg beq, b_obj_arg, obj_arg m, b_obj_arg k, uint64_t h) {
+    size_t i = fhm_find_slot(beq, m, k, fhm_mix(h));
+    if (i == not_found)
+        return m;
+    m = fhm_ensure_exclusive(m);
+    lean_object ** slots = lean_array_cptr(fhm_slots(m));
+    lean_dec(slots[2 * i]);
+    lean_dec(slots[2 * i + 1]);
+    slots[2 * i] = lean_box(0);
+    slots[2 * i + 1] = lean_box(0);
+    // deleted slots are counted against `growth_left` until the next resize
+    fhm_set_ctrl(lean_sarray_cptr(fhm_ctrl(m)), fhm_capacity(m), i, ctrl_deleted);
+    fhm_set_size(m, fhm_size(m) - 1);
+    return m;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_flat_hashmap_to_array(b_obj_arg m) {
+    uint8_t const * ctrl = lean_sarray_cptr(fhm_ctrl(m));
+    lean_object ** slots = lean_array_cptr(fhm_slots(m));
+    size_t size = fhm_size(m);
+    obj_res r = lean_alloc_array(size, size);
+    size_t j = 0;
+    for (size_t i = 0; i < fhm_capacity(m); i++) {
+        if (ctrl[i] & 0x80)
+            continue;
+        lean_inc(slots[2 * i]);
+        lean_inc(slots[2 * i + 1]);
+        obj_res p = lean_alloc_ctor(0, 2, 0);
+        lean_ctor_set(p, 0, slots[2 * i]);
+        lean_ctor_set(p, 1, slots[2 * i + 1]);
+        lean_array_set_core(r, j++, p);
+    }
+    return r;
+}
+}
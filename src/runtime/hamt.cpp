@@ -0,0 +1,402 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Nodes of `Lean.CompactPersistentHashMap`, a hash array mapped trie with bitmap-indexed nodes.
+
+A trie node is a constructor object with tag 0 whose scalar area contains two 32-bit bitmaps: bit
+`i` of `datamap` is set if the node contains a key/value pair whose hash has fragment `i` at the
+node's level, and bit `i` of `nodemap` is set if it contains a child node for fragment `i`. The
+object fields are the key/value pairs in bit order, followed by the child nodes in bit order, so
+the position of a slot is determined by the number of set bits below it. Children always contain
+at least two key/value pairs; a child that would only contain a single one is inlined into its parent.
+
+Once all 64 bits of the hash are used up, keys are stored in collision nodes with tag 1 whose only
+field is an array of alternating keys and values.
+
+`BEq` and `Hashable` instances are represented by their only field, i.e. a closure.
+*/
+#include "runtime/object.h"
+
+namespace lean {
+static unsigned const g_hamt_bits      = 5;
+static unsigned const g_hamt_max_shift = 60;
+
+static inline unsigned hamt_num_objs(unsigned num_data, unsigned num_nodes) {
+    return 2 * num_data + num_nodes;
+}
+
+static inline uint32_t hamt_datamap(b_obj_arg n) {
+    return lean_ctor_get_uint32(n, lean_ctor_num_objs(n) * sizeof(void*));
+}
+
+static inline uint32_t hamt_nodemap(b_obj_arg n) {
+    return lean_ctor_get_uint32(n, lean_ctor_num_objs(n) * sizeof(void*) + sizeof(uint32_t));
+}
+
+static inline uint32_t hamt_bit(uint64_t h, unsigned shift) {
+    return 1u << ((h >> shift) & ((1u << g_hamt_bits) - 1));
+}
+
+/* Number of set bits of `map` below `bit`. */
+static inline unsigned hamt_index(uint32_t map, uint32_t bit) {
+    return __builtin_popcount(map & (bit - 1));
+}
+
+static obj_res hamt_alloc_node(unsigned num_objs, uint32_t datamap, uint32_t nodemap) {
+    obj_res r = lean_alloc_ctor(0, num_objs, 2 * sizeof(uint32_t));
+    lean_ctor_set_uint32(r, num_objs * sizeof(void*), datamap);
+    lean_ctor_set_uint32(r, num_objs * sizeof(void*) + sizeof(uint32_t), nodemap);
+    return r;
+}
+
+static obj_res hamt_mk_collision(obj_arg kvs) {
+    obj_res r = lean_alloc_ctor(1, 1, 0);
+    lean_ctor_set(r, 0, kvs);
+    return r;
+}
+
+static inline bool hamt_is_collision(b_obj_arg n) {
+    return lean_ptr_tag(n) == 1;
+}
+
+/* Compares the key `k` being looked up to the stored key `k2`. */
+static inline bool hamt_key_eq(b_obj_arg beq, b_obj_arg k, b_obj_arg k2) {
+    lean_inc(beq); lean_inc(k); lean_inc(k2);
+    return lean_unbox(lean_apply_2(beq, k, k2));
+}
+
+static inline uint64_t hamt_hash(b_obj_arg hashable, b_obj_arg k) {
+    lean_inc(hashable); lean_inc(k);
+    obj_res r = lean_apply_1(hashable, k);
+    uint64_t h = lean_unbox_uint64(r);
+    lean_dec(r);
+    return h;
+}
+
+/*
+Copies the fields `[begin, end)` of `n` to `r` starting at `dst`. The fields are moved if `owned`,
+i.e. if `n` is exclusive and is released with `hamt_release` afterwards.
+*/
+static void hamt_copy_fields(b_obj_arg n, b_obj_arg r, unsigned begin, unsigned end, unsigned dst, bool owned) {
+    for (unsigned i = begin; i < end; i++) {
+        lean_object * o = lean_ctor_get(n, i);
+        if (!owned) lean_inc(o);
+        lean_ctor_set(r, dst + i - begin, o);
+    }
+}
+
+static void hamt_release(obj_arg n, bool owned) {
+    if (owned)
+        lean_free_object(n);
+    else
+        lean_dec_ref(n);
+}
+
+/* Returns `n` if it is exclusive and a copy sharing its fields otherwise. */
+static obj_res hamt_ensure_exclusive(obj_arg n) {
+    if (lean_is_exclusive(n))
+        return n;
+    unsigned num_objs = lean_ctor_num_objs(n);
+    obj_res r = hamt_is_collision(n) ? lean_alloc_ctor(1, 1, 0)
+                                     : hamt_alloc_node(num_objs, hamt_datamap(n), hamt_nodemap(n));
+    hamt_copy_fields(n, r, 0, num_objs, 0, false);
+    lean_dec_ref(n);
+    return r;
+}
+
+/* Creates a node containing the two given pairs, whose keys differ. */
+static obj_res hamt_mk_two(obj_arg k1, obj_arg v1, uint64_t h1, obj_arg k2, obj_arg v2, uint64_t h2, unsigned shift) {
+    if (shift > g_hamt_max_shift) {
+        obj_res kvs = lean_alloc_array(4, 4);
+        lean_array_set_core(kvs, 0, k1);
+        lean_array_set_core(kvs, 1, v1);
+        lean_array_set_core(kvs, 2, k2);
+        lean_array_set_core(kvs, 3, v2);
+        return hamt_mk_collision(kvs);
+    }
+    uint32_t b1 = hamt_bit(h1, shift);
+    uint32_t b2 = hamt_bit(h2, shift);
+    if (b1 == b2) {
+        obj_res r = hamt_alloc_node(1, 0, b1);
+        lean_ctor_set(r, 0, hamt_mk_two(k1, v1, h1, k2, v2, h2, shift + g_hamt_bits));
+        return r;
+    }
+    obj_res r = hamt_alloc_node(4, b1 | b2, 0);
+    unsigned i1 = b1 < b2 ? 0 : 2;
+    lean_ctor_set(r, i1, k1);
+    lean_ctor_set(r, i1 + 1, v1);
+    lean_ctor_set(r, 2 - i1, k2);
+    lean_ctor_set(r, 3 - i1, v2);
+    return r;
+}
+
+static obj_res hamt_find(b_obj_arg beq, b_obj_arg n, b_obj_arg k, uint64_t h) {
+    unsigned shift = 0;
+    while (true) {
+        if (hamt_is_collision(n)) {
+            lean_object * kvs = lean_ctor_get(n, 0);
+            size_t sz = lean_array_size(kvs);
+            for (size_t i = 0; i < sz; i += 2) {
+                if (hamt_key_eq(beq, k, lean_array_get_core(kvs, i)))
+                    return lean_array_get_core(kvs, i + 1);
+            }
+            return nullptr;
+        }
+        uint32_t bit     = hamt_bit(h, shift);
+        uint32_t datamap = hamt_datamap(n);
+        if (datamap & bit) {
+            unsigned i = 2 * hamt_index(datamap, bit);
+            return hamt_key_eq(beq, k, lean_ctor_get(n, i)) ? lean_ctor_get(n, i + 1) : nullptr;
+        }
+        uint32_t nodemap = hamt_nodemap(n);
+        if (!(nodemap & bit))
+            return nullptr;
+        n = lean_ctor_get(n, 2 * __builtin_popcount(datamap) + hamt_index(nodemap, bit));
+        shift += g_hamt_bits;
+    }
+}
+
+/* Consumes `n`, `k`, and `v`. Sets `added` if `k` was not in `n` before. */
+static obj_res hamt_insert(b_obj_arg beq, b_obj_arg hashable, obj_arg n, obj_arg k, uint64_t h, obj_arg v,
+                           unsigned shift, bool & added) {
+    if (hamt_is_collision(n)) {
+        n = hamt_ensure_exclusive(n);
+        lean_object * kvs = lean_ctor_get(n, 0);
+        lean_ctor_set(n, 0, lean_box(0));
+        size_t sz = lean_array_size(kvs);
+        for (size_t i = 0; i < sz; i += 2) {
+            if (hamt_key_eq(beq, k, lean_array_get_core(kvs, i))) {
+                kvs = lean_array_fset(kvs, lean_box(i), k);
+                kvs = lean_array_fset(kvs, lean_box(i + 1), v);
+                lean_ctor_set(n, 0, kvs);
+                added = false;
+                return n;
+            }
+        }
+        kvs = lean_array_push(lean_array_push(kvs, k), v);
+        lean_ctor_set(n, 0, kvs);
+        added = true;
+        return n;
+    }
+    uint32_t bit       = hamt_bit(h, shift);
+    uint32_t datamap   = hamt_datamap(n);
+    uint32_t nodemap   = hamt_nodemap(n);
+    unsigned num_data  = __builtin_popcount(datamap);
+    unsigned num_nodes = __builtin_popcount(nodemap);
+    if (datamap & bit) {
+        unsigned i = 2 * hamt_index(datamap, bit);
+        lean_object * k2 = lean_ctor_get(n, i);
+        if (hamt_key_eq(beq, k, k2)) {
+            n = hamt_ensure_exclusive(n);
+            lean_dec(lean_ctor_get(n, i));
+            lean_dec(lean_ctor_get(n, i + 1));
+            lean_ctor_set(n, i, k);
+            lean_ctor_set(n, i + 1, v);
+            added = false;
+            return n;
+        }
+        // replace the pair with a child containing it and the new pair
+        added = true;
+        bool owned = lean_is_exclusive(n);
+        lean_object * v2 = lean_ctor_get(n, i + 1);
+        if (!owned) { lean_inc(k2); lean_inc(v2); }
+        uint64_t h2 = hamt_hash(hashable, k2);
+        obj_res child = hamt_mk_two(k2, v2, h2, k, v, h, shift + g_hamt_bits);
+        unsigned j = 2 * num_data + hamt_index(nodemap, bit);
+        obj_res r = hamt_alloc_node(hamt_num_objs(num_data - 1, num_nodes + 1), datamap & ~bit, nodemap | bit);
+        hamt_copy_fields(n, r, 0, i, 0, owned);
+        hamt_copy_fields(n, r, i + 2, j, i, owned);
+        lean_ctor_set(r, j - 2, child);
+        hamt_copy_fields(n, r, j, lean_ctor_num_objs(n), j - 1, owned);
+        hamt_release(n, owned);
+        return r;
+    }
+    if (nodemap & bit) {
+        unsigned i = 2 * num_data + hamt_index(nodemap, bit);
+        n = hamt_ensure_exclusive(n);
+        lean_object * child = lean_ctor_get(n, i);
+        lean_ctor_set(n, i, lean_box(0));
+        lean_ctor_set(n, i, hamt_insert(beq, hashable, child, k, h, v, shift + g_hamt_bits, added));
+        return n;
+    }
+    // new pair in this node
+    added = true;
+    bool owned = lean_is_exclusive(n);
+    unsigned i = 2 * hamt_index(datamap, bit);
+    obj_res r = hamt_alloc_node(hamt_num_objs(num_data + 1, num_nodes), datamap | bit, nodemap);
+    hamt_copy_fields(n, r, 0, i, 0, owned);
+    lean_ctor_set(r, i, k);
+    lean_ctor_set(r, i + 1, v);
+    hamt_copy_fields(n, r, i, lean_ctor_num_objs(n), i + 2, owned);
+    hamt_release(n, owned);
+    return r;
+}
+
+/* Consumes `n`. Sets `removed` if `k` was in `n`. */
+static obj_res hamt_erase(b_obj_arg beq, obj_arg n, b_obj_arg k, uint64_t h, unsigned shift, bool & removed) {
+    if (hamt_is_collision(n)) {
+        lean_object * kvs = lean_ctor_get(n, 0);
+        size_t sz = lean_array_size(kvs);
+        for (size_t i = 0; i < sz; i += 2) {
+            if (hamt_key_eq(beq, k, lean_array_get_core(kvs, i))) {
+                obj_res new_kvs = lean_alloc_array(sz - 2, sz - 2);
+                for (size_t j = 0, d = 0; j < sz; j++) {
+                    if (j == i || j == i + 1) continue;
+                    lean_object * o = lean_array_get_core(kvs, j);
+                    lean_inc(o);
+                    lean_array_set_core(new_kvs, d++, o);
+                }
+                lean_dec_ref(n);
+                removed = true;
+                return hamt_mk_collision(new_kvs);
+            }
+        }
+        removed = false;
+        return n;
+    }
+    uint32_t bit       = hamt_bit(h, shift);
+    uint32_t datamap   = hamt_datamap(n);
+    uint32_t nodemap   = hamt_nodemap(n);
+    unsigned num_data  = __builtin_popcount(datamap);
+    unsigned num_nodes = __builtin_popcount(nodemap);
+    if (datamap & bit) {
+        unsigned i = 2 * hamt_index(datamap, bit);
+        if (!hamt_key_eq(beq, k, lean_ctor_get(n, i))) {
+            removed = false;
+            return n;
+        }
+        removed = true;
+        bool owned = lean_is_exclusive(n);
+        if (owned) {
+            lean_dec(lean_ctor_get(n, i));
+            lean_dec(lean_ctor_get(n, i + 1));
+        }
+        obj_res r = hamt_alloc_node(hamt_num_objs(num_data - 1, num_nodes), datamap & ~bit, nodemap);
+        hamt_copy_fields(n, r, 0, i, 0, owned);
+        hamt_copy_fields(n, r, i + 2, lean_ctor_num_objs(n), i, owned);
+        hamt_release(n, owned);
+        return r;
+    }
+    if (!(nodemap & bit)) {
+        removed = false;
+        return n;
+    }
+    unsigned i = 2 * num_data + hamt_index(nodemap, bit);
+    n = hamt_ensure_exclusive(n);
+    lean_object * child = lean_ctor_get(n, i);
+    lean_ctor_set(n, i, lean_box(0));
+    child = hamt_erase(beq, child, k, h, shift + g_hamt_bits, removed);
+    // inline the remaining pair of a child that has become a singleton
+    lean_object * ck; lean_object * cv;
+    if (hamt_is_collision(child) && lean_array_size(lean_ctor_get(child, 0)) == 2) {
+        ck = lean_array_get_core(lean_ctor_get(child, 0), 0);
+        cv = lean_array_get_core(lean_ctor_get(child, 0), 1);
+    } else if (!hamt_is_collision(child) && lean_ctor_num_objs(child) == 2 && hamt_nodemap(child) == 0) {
+        ck = lean_ctor_get(child, 0);
+        cv = lean_ctor_get(child, 1);
+    } else {
+        lean_ctor_set(n, i, child);
+        return n;
+    }
+    lean_inc(ck); lean_inc(cv);
+    lean_dec_ref(child);
+    unsigned j = 2 * hamt_index(datamap, bit);
+    obj_res r = hamt_alloc_node(hamt_num_objs(num_data + 1, num_nodes - 1), datamap | bit, nodemap & ~bit);
+    hamt_copy_fields(n, r, 0, j, 0, true);
+    lean_ctor_set(r, j, ck);
+    lean_ctor_set(r, j + 1, cv);
+    hamt_copy_fields(n, r, j, i, j + 2, true);
+    hamt_copy_fields(n, r, i + 1, lean_ctor_num_objs(n), i + 2, true);
+    hamt_release(n, true);
+    return r;
+}
+
+static obj_res hamt_to_array(b_obj_arg n, obj_arg r) {
+    auto push = [&](lean_object * k, lean_object * v) {
+        lean_inc(k); lean_inc(v);
+        obj_res p = lean_alloc_ctor(0, 2, 0);
+        lean_ctor_set(p, 0, k);
+        lean_ctor_set(p, 1, v);
+        r = lean_array_push(r, p);
+    };
+    if (hamt_is_collision(n)) {
+        lean_object * kvs = lean_ctor_get(n, 0);
+        for (size_t i = 0; i < lean_array_size(kvs); i += 2)
+            push(lean_array_get_core(kvs, i), lean_array_get_core(kvs, i + 1));
+        return r;
+    }
+    unsigned num_data = __builtin_popcount(hamt_datamap(n));
+    for (unsigned i = 0; i < num_data; i++)
+        push(lean_ctor_get(n, 2 * i), lean_ctor_get(n, 2 * i + 1));
+    for (unsigned i = 2 * num_data; i < lean_ctor_num_objs(n); i++)
+        r = hamt_to_array(lean_ctor_get(n, i), r);
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_cphashmap_node_mk_empty(obj_arg) {
+    return hamt_alloc_node(0, 0, 0);
+}
+
+extern "C" LEAN_EXPORT obj_res lean_cphashmap_node_find(b_obj_arg beq, b_obj_arg n, b_obj_arg k, uint64_t h) {
+    lean_object * v = hamt_find(beq, n, k, h);
+    if (!v)
+        return lean_box(0);
+    lean_inc(v);
+    obj_res r = lean_alloc_ctor(1, 1, 0);
+    lean_ctor_set(r, 0, v);
+    return r;
+}
+
+extern "C" LEAN_EXPORT uint8_t lean_cphashmap_node_contains(b_obj_arg beq, b_obj_arg n, b_obj_arg k, uint64_t h) {
+    return hamt_find(beq, n, k, h) != nullptr;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_cphashmap_node_to_array(b_obj_arg n) {
+    return hamt_to_array(n, lean_mk_empty_array());
+}
+
+/* `m` is a `CompactPersistentHashMap`, i.e. a structure with fields `root` and `size`. */
+static obj_res hamt_update_map(obj_arg m, lean_object * & root) {
+    if (lean_is_exclusive(m)) {
+        root = lean_ctor_get(m, 0);
+        lean_ctor_set(m, 0, lean_box(0));
+        return m;
+    }
+    root = lean_ctor_get(m, 0);
+    lean_inc(root);
+    obj_res r = lean_alloc_ctor(0, 2, 0);
+    lean_object * size = lean_ctor_get(m, 1);
+    lean_inc(size);
+    lean_ctor_set(r, 1, size);
+    lean_dec_ref(m);
+    return r;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_cphashmap_insert(b_obj_arg beq, b_obj_arg hashable, obj_arg m, obj_arg k, uint64_t h,
+                                                      obj_arg v) {
+    lean_object * root;
+    m = hamt_update_map(m, root);
+    bool added = false;
+    lean_ctor_set(m, 0, hamt_insert(beq, hashable, root, k, h, v, 0, added));
+    if (added) {
+        lean_object * size = lean_ctor_get(m, 1);
+        lean_ctor_set(m, 1, lean_nat_add(size, lean_box(1)));
+        lean_dec(size);
+    }
+    return m;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_cphashmap_erase(b_obj_arg beq, b_obj_arg, obj_arg m, b_obj_arg k, uint64_t h) {
+    lean_object * root;
+    m = hamt_update_map(m, root);
+    bool removed = false;
+    lean_ctor_set(m, 0, hamt_erase(beq, root, k, h, 0, removed));
+    if (removed) {
+        lean_object * size = lean_ctor_get(m, 1);
+        lean_ctor_set(m, 1, lean_nat_sub(size, lean_box(1)));
+        lean_dec(size);
+    }
+    return m;
+}
+}
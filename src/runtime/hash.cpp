@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura
 */
+#include <cstring>
 #include "runtime/hash.h"
 
 namespace lean {
@@ -55,4 +56,60 @@ uint64 hash_str(size_t len, unsigned char const * str, uint64 init_value) {
     return MurmurHash64A(str, len, init_value);
 }
 
+static const uint64 g_murmur_m = 0xc6a4a7935bd1e995;
+static const int g_murmur_r = 47;
+
+hash_str_stream::hash_str_stream(size_t len, uint64 init_value):
+    m_hash(init_value ^ (len * g_murmur_m)) {
+}
+
+void hash_str_stream::add_block(uint64 k) {
+    k *= g_murmur_m;
+    k ^= k >> g_murmur_r;
+    k *= g_murmur_m;
+
+    m_hash ^= k;
+    m_hash *= g_murmur_m;
+}
+
+void hash_str_stream::add(size_t n, unsigned char const * data) {
+    m_size += n;
+    if (m_tail_size > 0) {
+        unsigned k = std::min<size_t>(8 - m_tail_size, n);
+        memcpy(m_tail + m_tail_size, data, k);
+        m_tail_size += k;
+        data += k;
+        n    -= k;
+        if (m_tail_size < 8)
+            return;
+        uint64 b;
+        memcpy(&b, m_tail, 8);
+        add_block(b);
+        m_tail_size = 0;
+    }
+    // same as `MurmurHash64A`, which reads 8-byte blocks in native byte order
+    for (; n >= 8; data += 8, n -= 8) {
+        uint64 b;
+        memcpy(&b, data, 8);
+        add_block(b);
+    }
+    memcpy(m_tail, data, n);
+    m_tail_size = n;
+}
+
+uint64 hash_str_stream::finish() {
+    uint64 h = m_hash;
+    if (m_tail_size > 0) {
+        for (unsigned i = m_tail_size; i > 0; i--)
+            h ^= uint64(m_tail[i - 1]) << (8 * (i - 1));
+        h *= g_murmur_m;
+    }
+
+    h ^= h >> g_murmur_r;
+    h *= g_murmur_m;
+    h ^= h >> g_murmur_r;
+
+    return h;
+}
+
 }
@@ -12,6 +12,23 @@ namespace lean {
 
 uint64 hash_str(size_t len, unsigned char const * str, uint64 init_value);
 
+/** \brief Incremental version of `hash_str` for data that is not available as a single buffer, e.g. a file
+    that is read in chunks. The total length must be known in advance: after adding `len` bytes in total,
+    `finish()` returns `hash_str(len, data, init_value)` where `data` is the concatenation of all chunks. */
+class hash_str_stream {
+    uint64        m_hash;
+    size_t        m_size = 0;
+    unsigned char m_tail[8];
+    unsigned      m_tail_size = 0;
+    void add_block(uint64 k);
+public:
+    hash_str_stream(size_t len, uint64 init_value);
+    void add(size_t n, unsigned char const * data);
+    /** \brief Number of bytes added so far. */
+    size_t size() const { return m_size; }
+    uint64 finish();
+};
+
 inline uint64 hash(uint64 h, uint64 k) {
     uint64 m = 0xc6a4a7935bd1e995;
     uint64 r = 47;
@@ -12,6 +12,7 @@ Author: Leonardo de Moura
 #include "runtime/stack_overflow.h"
 #include "runtime/process.h"
 #include "runtime/mutex.h"
+#include "runtime/io_reactor.h"
 #include "runtime/init_module.h"
 
 namespace lean {
@@ -23,6 +24,7 @@ extern "C" LEAN_EXPORT void lean_initialize_runtime_module() {
     initialize_thread();
     initialize_mutex();
     initialize_process();
+    initialize_io_reactor();
     initialize_stack_overflow();
 }
 void initialize_runtime_module() {
@@ -30,6 +32,7 @@ void initialize_runtime_module() {
 }
 void finalize_runtime_module() {
     finalize_stack_overflow();
+    finalize_io_reactor();
     finalize_process();
     finalize_mutex();
     finalize_thread();
@@ -38,9 +38,14 @@ Authors: Leonardo de Moura, Sebastian Ullrich
 #include <string>
 #include <cstdlib>
 #include <cctype>
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <vector>
 #include <sys/stat.h>
 #include "util/io.h"
 #include "runtime/alloc.h"
+#include "runtime/hash.h"
 #include "runtime/io.h"
 #include "runtime/utf8.h"
 #include "runtime/object.h"
@@ -758,11 +763,16 @@ static obj_res timespec_to_obj(timespec const & ts) {
     return o;
 }
 
-extern "C" LEAN_EXPORT obj_res lean_io_metadata(b_obj_arg fname, obj_arg) {
-    struct stat st;
-    if (stat(string_cstr(fname), &st) != 0) {
-        return io_result_mk_error(decode_io_error(errno, fname));
-    }
+static uint8 file_type_of_mode(mode_t mode) {
+    return S_ISDIR(mode) ? 0 :
+           S_ISREG(mode) ? 1 :
+#ifndef LEAN_WINDOWS
+           S_ISLNK(mode) ? 2 :
+#endif
+           3;
+}
+
+static obj_res mk_metadata(struct stat const & st) {
     object * mdata = alloc_cnstr(0, 2, sizeof(uint64) + sizeof(uint8));
 #ifdef __APPLE__
     cnstr_set(mdata, 0, timespec_to_obj(st.st_atimespec));
@@ -776,14 +786,371 @@ extern "C" LEAN_EXPORT obj_res lean_io_metadata(b_obj_arg fname, obj_arg) {
     cnstr_set(mdata, 1, timespec_to_obj(st.st_mtim));
 #endif
     cnstr_set_uint64(mdata, 2 * sizeof(object *), st.st_size);
-    cnstr_set_uint8(mdata, 2 * sizeof(object *) + sizeof(uint64),
-                    S_ISDIR(st.st_mode) ? 0 :
-                    S_ISREG(st.st_mode) ? 1 :
-#ifndef LEAN_WINDOWS
-                    S_ISLNK(st.st_mode) ? 2 :
+    cnstr_set_uint8(mdata, 2 * sizeof(object *) + sizeof(uint64), file_type_of_mode(st.st_mode));
+    return mdata;
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_metadata(b_obj_arg fname, obj_arg) {
+    struct stat st;
+    if (stat(string_cstr(fname), &st) != 0) {
+        return io_result_mk_error(decode_io_error(errno, fname));
+    }
+    return io_result_mk_ok(mk_metadata(st));
+}
+
+static const size_t g_hash_file_chunk_size = 64 * 1024;
+
+/* Read `fp` from the beginning in chunks of (at most) `buf.size() - 1` bytes and pass them to `fn`.
+   If `normalize_eol` is true, `\r\n` is replaced by `\n`, like `Lake.crlf2lf`. Returns false on read errors. */
+template<typename F>
+static bool read_file_chunks(FILE * fp, bool normalize_eol, std::vector<unsigned char> & buf, F && fn) {
+    rewind(fp);
+    // `buf[0]` is reserved for a `\r` at the end of the previous chunk
+    bool pending_cr = false;
+    while (true) {
+        size_t n = fread(buf.data() + 1, 1, buf.size() - 1, fp);
+        if (n == 0)
+            break;
+        unsigned char * begin = buf.data() + 1;
+        unsigned char * end   = begin + n;
+        if (!normalize_eol) {
+            fn(n, begin);
+            continue;
+        }
+        if (pending_cr) {
+            *--begin = '\r';
+            pending_cr = false;
+        }
+        unsigned char * src = begin;
+        unsigned char * dst = begin;
+        while (src < end) {
+            unsigned char * cr = static_cast<unsigned char *>(memchr(src, '\r', end - src));
+            if (!cr) {
+                memmove(dst, src, end - src);
+                dst += end - src;
+                break;
+            }
+            memmove(dst, src, cr - src);
+            dst += cr - src;
+            if (cr + 1 == end) {
+                pending_cr = true;
+                break;
+            }
+            if (cr[1] != '\n')
+                *dst++ = '\r';
+            src = cr + 1;
+        }
+        fn(dst - begin, begin);
+    }
+    if (ferror(fp))
+        return false;
+    if (pending_cr) {
+        unsigned char cr = '\r';
+        fn(1, &cr);
+    }
+    return true;
+}
+
+/* IO.FS.hashFile (fname : @& FilePath) (normalizeEol : Bool) : IO UInt64 */
+extern "C" LEAN_EXPORT obj_res lean_io_hash_file(b_obj_arg fname, uint8 normalize_eol, obj_arg) {
+    FILE * fp = fopen(string_cstr(fname), "rb");
+    if (!fp) {
+        return io_result_mk_error(decode_io_error(errno, fname));
+    }
+    std::vector<unsigned char> buf(g_hash_file_chunk_size + 1);
+    // `hash_str` needs the length in advance; when normalizing, we need an extra pass to count it
+    size_t len = 0;
+    bool ok;
+    struct stat st;
+    if (normalize_eol) {
+        ok = read_file_chunks(fp, true, buf, [&](size_t n, unsigned char const *) { len += n; });
+    } else {
+        ok = fstat(fileno(fp), &st) == 0;
+        len = ok ? static_cast<size_t>(st.st_size) : 0;
+    }
+    hash_str_stream h(len, 11);
+    ok = ok && read_file_chunks(fp, normalize_eol, buf, [&](size_t n, unsigned char const * data) { h.add(n, data); });
+    int err = errno;
+    fclose(fp);
+    if (!ok) {
+        return io_result_mk_error(decode_io_error(err, fname));
+    }
+    if (h.size() != len) {
+        return io_result_mk_error((sstream() << "file '" << string_cstr(fname) << "' changed while it was being hashed").str());
+    }
+    // same seed as `lean_byte_array_hash` and `lean_string_hash`
+    return io_result_mk_ok(box_uint64(h.finish()));
+}
+
+/*
+structure WalkConfig where
+  extensions     : Array String
+  pattern?       : Option String
+  skipDirs       : Array String
+  metadata       : Bool
+  followSymlinks : Bool
+  includeDirs    : Bool
+
+structure WalkEntry where
+  path     : FilePath
+  type     : FileType
+  metadata : Option Metadata
+*/
+struct walk_entry {
+    std::string m_path;
+    uint8       m_type; // `FileType`
+    bool        m_has_stat;
+    struct stat m_stat;
+};
+
+/* Shared state of a parallel directory walk. Directories are processed from a shared queue by
+   the calling thread and by helper tasks on the task manager. */
+struct walk_state {
+    std::vector<std::string>           m_extensions;
+    optional<std::string>              m_pattern;
+    std::vector<std::string>           m_skip_dirs;
+    bool                               m_metadata;
+    bool                               m_follow_symlinks;
+    bool                               m_include_dirs;
+
+    mutex                              m_mutex;
+    condition_variable                 m_cv;
+    std::vector<std::string>           m_queue;
+    // number of directories queued or being read
+    unsigned                           m_pending = 0;
+    std::vector<walk_entry>            m_entries;
+    std::set<std::pair<dev_t, ino_t>>  m_visited;
+    int                                m_error = 0;
+    std::string                        m_error_path;
+};
+
+/* Match `s` against a glob pattern supporting `*` and `?`. */
+static bool glob_match(char const * p, char const * s) {
+    char const * star = nullptr;
+    char const * star_s = nullptr;
+    while (*s) {
+        if (*p == '?' || *p == *s) {
+            p++; s++;
+        } else if (*p == '*') {
+            star = p++;
+            star_s = s;
+        } else if (star) {
+            p = star + 1;
+            s = ++star_s;
+        } else {
+            return false;
+        }
+    }
+    while (*p == '*') p++;
+    return *p == 0;
+}
+
+static bool walk_file_matches(walk_state const & s, char const * name) {
+    if (!s.m_extensions.empty()) {
+        // same notion of extension as `FilePath.extension`
+        char const * dot = strrchr(name, '.');
+        if (!dot || dot == name)
+            return false;
+        if (std::find(s.m_extensions.begin(), s.m_extensions.end(), dot + 1) == s.m_extensions.end())
+            return false;
+    }
+    return !s.m_pattern || glob_match(s.m_pattern->c_str(), name);
+}
+
+/* Returns `true` if the directory with status `st` has not been entered before. Only needed when
+   following symbolic links, which may introduce cycles. */
+static bool walk_mark_visited(walk_state & s, struct stat const & st) {
+    unique_lock<mutex> lock(s.m_mutex);
+    return s.m_visited.insert(std::make_pair(st.st_dev, st.st_ino)).second;
+}
+
+/* Read a single directory, returning its reported entries and the subdirectories to traverse. */
+static int walk_read_dir(walk_state & s, std::string const & dir, std::vector<walk_entry> & entries,
+                         std::vector<std::string> & subdirs) {
+    DIR * dp = opendir(dir.c_str());
+    if (!dp)
+        return errno;
+    while (dirent * entry = readdir(dp)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        walk_entry e;
+        e.m_path = dir;
+#ifdef LEAN_WINDOWS
+        e.m_path += '\\';
+#else
+        e.m_path += '/';
 #endif
-                    3);
-    return io_result_mk_ok(mdata);
+        e.m_path += entry->d_name;
+        e.m_has_stat = false;
+        bool have_type = false;
+#if defined(DT_DIR)
+        // use the type reported by `readdir` to avoid a `stat` call per entry where possible
+        switch (entry->d_type) {
+        case DT_DIR: e.m_type = 0; have_type = true; break;
+        case DT_REG: e.m_type = 1; have_type = true; break;
+        case DT_LNK: e.m_type = 2; have_type = true; break;
+        case DT_UNKNOWN: break;
+        default: e.m_type = 3; have_type = true; break;
+        }
+#endif
+        if (!have_type) {
+            struct stat st;
+#ifdef LEAN_WINDOWS
+            if (stat(e.m_path.c_str(), &st) != 0)
+#else
+            if (lstat(e.m_path.c_str(), &st) != 0)
+#endif
+                continue; // entry vanished
+            e.m_type = file_type_of_mode(st.st_mode);
+        }
+        bool is_dir = e.m_type == 0;
+        if (e.m_type == 2 && s.m_follow_symlinks) {
+            struct stat st;
+            if (stat(e.m_path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                is_dir = true;
+                if (s.m_metadata) {
+                    e.m_has_stat = true;
+                    e.m_stat = st;
+                }
+            }
+        }
+        if (is_dir) {
+            if (std::find(s.m_skip_dirs.begin(), s.m_skip_dirs.end(), entry->d_name) != s.m_skip_dirs.end())
+                continue;
+            subdirs.push_back(e.m_path);
+            if (!s.m_include_dirs)
+                continue;
+        } else if (!walk_file_matches(s, entry->d_name)) {
+            continue;
+        }
+        if (s.m_metadata && !e.m_has_stat) {
+            if (stat(e.m_path.c_str(), &e.m_stat) != 0)
+                continue; // entry vanished or dangling symbolic link
+            e.m_has_stat = true;
+        }
+        entries.push_back(std::move(e));
+    }
+    lean_always_assert(closedir(dp) == 0);
+    return 0;
+}
+
+/* Process directories from the queue until the whole tree has been walked. */
+static void walk_worker(walk_state & s) {
+    std::vector<walk_entry> entries;
+    std::vector<std::string> subdirs;
+    unique_lock<mutex> lock(s.m_mutex);
+    while (true) {
+        if (s.m_queue.empty()) {
+            if (s.m_pending == 0)
+                return;
+            s.m_cv.wait(lock);
+            continue;
+        }
+        std::string dir = std::move(s.m_queue.back());
+        s.m_queue.pop_back();
+        lock.unlock();
+        int err = 0;
+        if (s.m_follow_symlinks) {
+            struct stat st;
+            if (stat(dir.c_str(), &st) != 0)
+                err = errno;
+            else if (!walk_mark_visited(s, st))
+                dir.clear();
+        }
+        if (!err && !dir.empty())
+            err = walk_read_dir(s, dir, entries, subdirs);
+        lock.lock();
+        // ignore directories that vanished during the walk
+        if (err && err != ENOENT && !s.m_error) {
+            s.m_error      = err;
+            s.m_error_path = dir;
+        }
+        std::move(entries.begin(), entries.end(), std::back_inserter(s.m_entries));
+        entries.clear();
+        s.m_pending += subdirs.size();
+        std::move(subdirs.begin(), subdirs.end(), std::back_inserter(s.m_queue));
+        subdirs.clear();
+        s.m_pending--;
+        s.m_cv.notify_all();
+    }
+}
+
+static obj_res walk_worker_fn(obj_arg state, obj_arg) {
+    auto * s = static_cast<std::shared_ptr<walk_state> *>(lean_get_external_data(state));
+    walk_worker(**s);
+    lean_dec(state);
+    return box(0);
+}
+
+static lean_external_class * g_walk_state_external_class = nullptr;
+
+static void walk_state_finalizer(void * s) {
+    delete static_cast<std::shared_ptr<walk_state> *>(s);
+}
+
+static void walk_state_foreach(void * /* mod */, b_obj_arg /* fn */) {
+}
+
+static std::vector<std::string> array_to_strings(b_obj_arg a) {
+    std::vector<std::string> r;
+    for (size_t i = 0; i < array_size(a); i++)
+        r.push_back(string_to_std(array_cptr(a)[i]));
+    return r;
+}
+
+/* walkDirEntries : @& FilePath → @& WalkConfig → IO (Array WalkEntry) */
+extern "C" LEAN_EXPORT obj_res lean_io_walk_dir(b_obj_arg root, b_obj_arg cfg, obj_arg) {
+    auto s = std::make_shared<walk_state>();
+    s->m_extensions = array_to_strings(cnstr_get(cfg, 0));
+    if (!is_scalar(cnstr_get(cfg, 1)))
+        s->m_pattern = string_to_std(cnstr_get(cnstr_get(cfg, 1), 0));
+    s->m_skip_dirs = array_to_strings(cnstr_get(cfg, 2));
+    s->m_metadata        = cnstr_get_uint8(cfg, 3 * sizeof(object *));
+    s->m_follow_symlinks = cnstr_get_uint8(cfg, 3 * sizeof(object *) + 1);
+    s->m_include_dirs    = cnstr_get_uint8(cfg, 3 * sizeof(object *) + 2);
+
+    std::string root_path = string_to_std(root);
+    struct stat st;
+    if (stat(root_path.c_str(), &st) != 0)
+        return io_result_mk_error(decode_io_error(errno, root));
+    if (!S_ISDIR(st.st_mode))
+        return io_result_mk_error(decode_io_error(ENOTDIR, root));
+    s->m_queue.push_back(root_path);
+    s->m_pending = 1;
+
+    if (has_task_manager()) {
+        // the calling thread participates in the walk, so helpers that are never scheduled are harmless
+        unsigned num_helpers = std::max(std::min(hardware_concurrency(), 8u), 1u) - 1;
+        for (unsigned i = 0; i < num_helpers; i++) {
+            object * state = lean_alloc_external(g_walk_state_external_class, new std::shared_ptr<walk_state>(s));
+            object * c = lean_alloc_closure((void*)walk_worker_fn, 2, 1);
+            lean_closure_set(c, 0, state);
+            lean_dec(lean_task_spawn_core(c, 0, /* keep_alive */ true));
+        }
+    }
+    walk_worker(*s);
+
+    unique_lock<mutex> lock(s->m_mutex);
+    if (s->m_error) {
+        object * fname = mk_string(s->m_error_path);
+        object * r = io_result_mk_error(decode_io_error(s->m_error, fname));
+        dec_ref(fname);
+        return r;
+    }
+    std::vector<walk_entry> & entries = s->m_entries;
+    std::sort(entries.begin(), entries.end(), [](walk_entry const & a, walk_entry const & b) {
+        return a.m_path < b.m_path;
+    });
+    object * arr = lean_alloc_array(entries.size(), entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        walk_entry const & e = entries[i];
+        object * lentry = alloc_cnstr(0, 2, sizeof(uint8));
+        cnstr_set(lentry, 0, mk_string(e.m_path));
+        cnstr_set(lentry, 1, e.m_has_stat ? mk_option_some(mk_metadata(e.m_stat)) : mk_option_none());
+        cnstr_set_uint8(lentry, 2 * sizeof(object *), e.m_type);
+        lean_array_set_core(arr, i, lentry);
+    }
+    return io_result_mk_ok(arr);
 }
 
 extern "C" LEAN_EXPORT obj_res lean_io_create_dir(b_obj_arg p, obj_arg) {
@@ -1089,6 +1456,7 @@ void initialize_io() {
     g_io_error_nullptr_read = lean_mk_io_user_error(mk_string("null reference read"));
     mark_persistent(g_io_error_nullptr_read);
     g_io_handle_external_class = lean_register_external_class(io_handle_finalizer, io_handle_foreach);
+    g_walk_state_external_class = lean_register_external_class(walk_state_finalizer, walk_state_foreach);
 #if defined(LEAN_WINDOWS)
     _setmode(_fileno(stdout), _O_BINARY);
     _setmode(_fileno(stderr), _O_BINARY);
@@ -0,0 +1,457 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+An event loop for non-blocking I/O. On Linux, a single reactor thread waits on an `epoll`
+instance and completes outstanding operations by resolving the `IO.Promise` backing the
+task returned to the caller, so that waiting on many pipes or child processes at once
+does not tie up one thread per operation. On other platforms, and when the reactor is
+not available, every operation falls back to a dedicated task performing the blocking
+primitive.
+*/
+#if defined(__linux__) && !defined(LEAN_EMSCRIPTEN) && defined(LEAN_MULTI_THREAD)
+#define LEAN_IO_REACTOR
+#endif
+
+#include <cstdio>
+#include <cerrno>
+#include <memory>
+#if defined(LEAN_IO_REACTOR)
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h> // NOLINT
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#endif
+#if !defined(LEAN_WINDOWS)
+#include <poll.h>
+#endif
+#include "runtime/object.h"
+#include "runtime/io.h"
+#include "runtime/thread.h"
+#include "runtime/io_reactor.h"
+
+namespace lean {
+extern "C" obj_res lean_io_prim_handle_read(b_obj_arg h, usize nbytes, obj_arg);
+extern "C" obj_res lean_io_prim_handle_write(b_obj_arg h, b_obj_arg buf, obj_arg);
+extern "C" obj_res lean_io_prim_handle_flush(b_obj_arg h, obj_arg);
+extern "C" obj_res lean_io_process_child_wait(b_obj_arg cfg, b_obj_arg child, obj_arg);
+extern "C" obj_res lean_io_promise_new(obj_arg);
+extern "C" obj_res lean_io_promise_resolve(obj_arg value, b_obj_arg promise, obj_arg);
+
+typedef object * (*lean_cfun2)(object *, object *); // NOLINT
+typedef object * (*lean_cfun3)(object *, object *, object *); // NOLINT
+
+static FILE * io_get_handle(lean_object * hfile) {
+    return static_cast<FILE *>(lean_get_external_data(hfile));
+}
+
+/* Convert an `IO α` result into an `Except IO.Error α` value suitable for a task result. */
+static obj_res io_result_to_except(obj_arg r) {
+    bool ok = io_result_is_ok(r);
+    object * v = ok ? io_result_get_value(r) : io_result_get_error(r);
+    inc(v);
+    dec_ref(r);
+    object * e = alloc_cnstr(ok ? 1 : 0, 1, 0);
+    cnstr_set(e, 0, v);
+    return e;
+}
+
+static obj_res mk_except_ok_core(obj_arg v) {
+    object * e = alloc_cnstr(1, 1, 0);
+    cnstr_set(e, 0, v);
+    return e;
+}
+
+static obj_res mk_except_io_error(int errnum) {
+    object * e = alloc_cnstr(0, 1, 0);
+    cnstr_set(e, 0, decode_io_error(errnum, nullptr));
+    return e;
+}
+
+static obj_res mk_closure_2_1(lean_cfun2 fn, obj_arg a) {
+    object * c = lean_alloc_closure((void*)fn, 2, 1);
+    lean_closure_set(c, 0, a);
+    return c;
+}
+
+static obj_res mk_closure_3_2(lean_cfun3 fn, obj_arg a1, obj_arg a2) {
+    object * c = lean_alloc_closure((void*)fn, 3, 2);
+    lean_closure_set(c, 0, a1);
+    lean_closure_set(c, 1, a2);
+    return c;
+}
+
+/* Run `c : Unit → Except IO.Error α` on a dedicated worker, or synchronously if there is no task manager. */
+static obj_res spawn_blocking(obj_arg c) {
+    return io_result_mk_ok(task_spawn(c, /* Task.Priority.dedicated */ 9, /* keep_alive */ true));
+}
+
+static obj_res handle_read_blocking_fn(obj_arg h, obj_arg nbytes, obj_arg) {
+    object * r = lean_io_prim_handle_read(h, unbox_size_t(nbytes), io_mk_world());
+    dec(h);
+    dec(nbytes);
+    return io_result_to_except(r);
+}
+
+static obj_res handle_write_blocking_fn(obj_arg h, obj_arg buf, obj_arg) {
+    object * r = lean_io_prim_handle_write(h, buf, io_mk_world());
+    if (io_result_is_ok(r)) {
+        dec_ref(r);
+        r = lean_io_prim_handle_flush(h, io_mk_world());
+    }
+    dec(h);
+    dec(buf);
+    return io_result_to_except(r);
+}
+
+static obj_res handle_wait_blocking_fn(obj_arg h, obj_arg write, obj_arg) {
+#if !defined(LEAN_WINDOWS)
+    pollfd pfd;
+    pfd.fd     = fileno(io_get_handle(h));
+    pfd.events = unbox(write) ? POLLOUT : POLLIN;
+    int r;
+    do {
+        r = poll(&pfd, 1, -1);
+    } while (r < 0 && errno == EINTR);
+    dec(h);
+    if (r < 0)
+        return mk_except_io_error(errno);
+#else
+    // no readiness notification for anonymous pipes on Windows; report the handle as ready
+    (void)write;
+    dec(h);
+#endif
+    return mk_except_ok_core(box(0));
+}
+
+static obj_res child_wait_blocking_fn(obj_arg child, obj_arg) {
+    object * r = lean_io_process_child_wait(box(0), child, io_mk_world());
+    dec(child);
+    return io_result_to_except(r);
+}
+
+#if defined(LEAN_IO_REACTOR)
+
+enum class reactor_op_kind { Read, Write, Readable, Writable, ChildExit };
+
+struct reactor_op {
+    reactor_op_kind m_kind;
+    /* File descriptor registered with `epoll`, owned by the operation: a duplicate of the handle's
+       descriptor (so that the operation survives the handle being closed and several operations
+       on the same handle can be registered at once) or a `pidfd`. */
+    int             m_fd;
+    uint32_t        m_events;
+    object *        m_promise;
+    size_t          m_nbytes  = 0;
+    object *        m_buf     = nullptr;
+    size_t          m_offset  = 0;
+    pid_t           m_pid     = 0;
+    reactor_op(reactor_op_kind k, int fd, uint32_t events, object * promise):
+        m_kind(k), m_fd(fd), m_events(events), m_promise(promise) {}
+};
+
+class io_reactor {
+    int                      m_epoll_fd;
+    int                      m_wakeup_fd;
+    std::unique_ptr<lthread> m_thread;
+
+    /* Try to make progress on `op`. Returns the `Except IO.Error α` result if the operation is
+       complete, or `nullptr` if it should be rearmed and retried on the next readiness event. */
+    static object * run_op(reactor_op * op) {
+        switch (op->m_kind) {
+        case reactor_op_kind::Read: {
+            object * res = lean_alloc_sarray(1, 0, op->m_nbytes);
+            ssize_t n = ::read(op->m_fd, lean_sarray_cptr(res), op->m_nbytes);
+            if (n < 0) {
+                int err = errno;
+                dec_ref(res);
+                return err == EAGAIN || err == EINTR ? nullptr : mk_except_io_error(err);
+            }
+            lean_sarray_set_size(res, n);
+            return mk_except_ok_core(res);
+        }
+        case reactor_op_kind::Write: {
+            size_t size  = lean_sarray_size(op->m_buf);
+            // Writable readiness only guarantees room for `PIPE_BUF` bytes in a pipe, so larger
+            // buffers are written in chunks to avoid blocking the reactor.
+            size_t chunk = std::min(size - op->m_offset, static_cast<size_t>(PIPE_BUF));
+            ssize_t n = ::write(op->m_fd, lean_sarray_cptr(op->m_buf) + op->m_offset, chunk);
+            if (n < 0) {
+                int err = errno;
+                return err == EAGAIN || err == EINTR ? nullptr : mk_except_io_error(err);
+            }
+            op->m_offset += n;
+            return op->m_offset == size ? mk_except_ok_core(box(0)) : nullptr;
+        }
+        case reactor_op_kind::Readable: case reactor_op_kind::Writable:
+            return mk_except_ok_core(box(0));
+        case reactor_op_kind::ChildExit: {
+            int status;
+            pid_t r = waitpid(op->m_pid, &status, WNOHANG);
+            if (r == 0)
+                return nullptr;
+            if (r < 0)
+                return mk_except_io_error(errno);
+            if (WIFEXITED(status)) {
+                return mk_except_ok_core(box_uint32(static_cast<unsigned>(WEXITSTATUS(status))));
+            } else {
+                lean_assert(WIFSIGNALED(status));
+                // use bash's convention
+                return mk_except_ok_core(box_uint32(128 + static_cast<unsigned>(WTERMSIG(status))));
+            }
+        }
+        }
+        lean_unreachable();
+    }
+
+    void finish(reactor_op * op, object * result) {
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, op->m_fd, nullptr);
+        close(op->m_fd);
+        dec_ref(lean_io_promise_resolve(result, op->m_promise, io_mk_world()));
+        dec_ref(op->m_promise);
+        if (op->m_buf) dec_ref(op->m_buf);
+        delete op;
+    }
+
+    void process(reactor_op * op) {
+        if (object * r = run_op(op)) {
+            finish(op, r);
+            return;
+        }
+        epoll_event ev;
+        ev.events   = op->m_events | EPOLLONESHOT;
+        ev.data.ptr = op;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, op->m_fd, &ev) != 0)
+            finish(op, mk_except_io_error(errno));
+    }
+
+    void loop() {
+        epoll_event events[64];
+        while (true) {
+            int n = epoll_wait(m_epoll_fd, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            for (int i = 0; i < n; i++) {
+                if (events[i].data.ptr == nullptr)
+                    return; // `m_wakeup_fd`: shutdown requested
+                process(static_cast<reactor_op *>(events[i].data.ptr));
+            }
+        }
+    }
+
+public:
+    io_reactor(int epoll_fd, int wakeup_fd):m_epoll_fd(epoll_fd), m_wakeup_fd(wakeup_fd) {
+        m_thread.reset(new lthread([this]() { loop(); }));
+    }
+
+    ~io_reactor() {
+        close(m_wakeup_fd);
+        close(m_epoll_fd);
+    }
+
+    void shutdown() {
+        uint64_t one = 1;
+        lean_always_assert(::write(m_wakeup_fd, &one, sizeof(one)) == sizeof(one));
+        m_thread->join();
+    }
+
+    static io_reactor * create() {
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+            return nullptr;
+        int wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wakeup_fd < 0) {
+            close(epoll_fd);
+            return nullptr;
+        }
+        epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.ptr = nullptr;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev) != 0) {
+            close(wakeup_fd);
+            close(epoll_fd);
+            return nullptr;
+        }
+        return new io_reactor(epoll_fd, wakeup_fd);
+    }
+
+    /* Register `op` and return its result task. Takes ownership of `op`. */
+    obj_res submit(reactor_op * op) {
+        object * task = op->m_promise;
+        inc_ref(task);
+        epoll_event ev;
+        ev.events   = op->m_events | EPOLLONESHOT;
+        ev.data.ptr = op;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, op->m_fd, &ev) == 0) {
+            // `op` may already have been completed and freed by the reactor thread at this point
+            return io_result_mk_ok(task);
+        }
+        int err = errno;
+        object * r;
+        if (err == EPERM) {
+            // Regular files and similar descriptors do not support `epoll` but are always ready.
+            do {
+                r = run_op(op);
+            } while (!r);
+        } else {
+            r = mk_except_io_error(err);
+        }
+        close(op->m_fd);
+        dec_ref(lean_io_promise_resolve(r, op->m_promise, io_mk_world()));
+        dec_ref(op->m_promise);
+        if (op->m_buf) dec_ref(op->m_buf);
+        delete op;
+        return io_result_mk_ok(task);
+    }
+};
+
+static mutex *      g_io_reactor_mutex = nullptr;
+static io_reactor * g_io_reactor       = nullptr;
+static bool         g_io_reactor_failed = false;
+/* Set by `stop_io_reactor` so that the reactor is not restarted while the task manager is being finalized. */
+static bool         g_io_reactor_stopped = false;
+
+/* Return the reactor, starting it on first use. Returns `nullptr` if it is unavailable, in which
+   case callers should use the blocking fallback. */
+static io_reactor * get_io_reactor() {
+    if (!has_task_manager())
+        return nullptr;
+    unique_lock<mutex> lock(*g_io_reactor_mutex);
+    if (!g_io_reactor && !g_io_reactor_failed && !g_io_reactor_stopped) {
+        g_io_reactor = io_reactor::create();
+        g_io_reactor_failed = g_io_reactor == nullptr;
+    }
+    return g_io_reactor;
+}
+
+static object * mk_promise() {
+    object * r = lean_io_promise_new(io_mk_world());
+    object * p = io_result_get_value(r);
+    inc_ref(p);
+    dec_ref(r);
+    return p;
+}
+
+/* Register an operation on a duplicate of the descriptor of `h`. */
+static obj_res submit_handle_op(io_reactor * reactor, b_obj_arg h, reactor_op_kind kind, uint32_t events,
+                                size_t nbytes, object * buf) {
+    FILE * fp = io_get_handle(h);
+    int fd = fcntl(fileno(fp), F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        if (buf) dec_ref(buf);
+        return io_result_mk_error(decode_io_error(errno, nullptr));
+    }
+    reactor_op * op = new reactor_op(kind, fd, events, mk_promise());
+    op->m_nbytes = nbytes;
+    if (buf) {
+        // the buffer is released by the reactor thread
+        mark_mt(buf);
+    }
+    op->m_buf    = buf;
+    return reactor->submit(op);
+}
+
+void stop_io_reactor() {
+    unique_lock<mutex> lock(*g_io_reactor_mutex);
+    if (g_io_reactor) {
+        g_io_reactor->shutdown();
+        delete g_io_reactor;
+        g_io_reactor = nullptr;
+    }
+    // do not restart the reactor during shutdown
+    g_io_reactor_stopped = true;
+}
+
+void enable_io_reactor() {
+    unique_lock<mutex> lock(*g_io_reactor_mutex);
+    g_io_reactor_stopped = false;
+}
+
+void initialize_io_reactor() {
+    g_io_reactor_mutex = new mutex();
+}
+
+void finalize_io_reactor() {
+    stop_io_reactor();
+    delete g_io_reactor_mutex;
+}
+
+#else
+
+void stop_io_reactor() {}
+void enable_io_reactor() {}
+void initialize_io_reactor() {}
+void finalize_io_reactor() {}
+
+#endif
+
+/* Handle.readAsync : (@& Handle) → USize → IO (Task (Except IO.Error ByteArray)) */
+extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_read_async(b_obj_arg h, usize nbytes, obj_arg /* w */) {
+#if defined(LEAN_IO_REACTOR)
+    if (io_reactor * reactor = get_io_reactor())
+        return submit_handle_op(reactor, h, reactor_op_kind::Read, EPOLLIN, nbytes, nullptr);
+#endif
+    inc_ref(h);
+    return spawn_blocking(mk_closure_3_2(handle_read_blocking_fn, h, box_size_t(nbytes)));
+}
+
+/* Handle.writeAsync : (@& Handle) → ByteArray → IO (Task (Except IO.Error Unit)) */
+extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_write_async(b_obj_arg h, obj_arg buf, obj_arg /* w */) {
+#if defined(LEAN_IO_REACTOR)
+    if (io_reactor * reactor = get_io_reactor()) {
+        // preserve the order with respect to previous buffered writes
+        if (std::fflush(io_get_handle(h)) != 0) {
+            dec_ref(buf);
+            return io_result_mk_error(decode_io_error(errno, nullptr));
+        }
+        return submit_handle_op(reactor, h, reactor_op_kind::Write, EPOLLOUT, 0, buf);
+    }
+#endif
+    inc_ref(h);
+    return spawn_blocking(mk_closure_3_2(handle_write_blocking_fn, h, buf));
+}
+
+/* Handle.waitReadable : (@& Handle) → IO (Task (Except IO.Error Unit)) */
+extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_wait_readable(b_obj_arg h, obj_arg /* w */) {
+#if defined(LEAN_IO_REACTOR)
+    if (io_reactor * reactor = get_io_reactor())
+        return submit_handle_op(reactor, h, reactor_op_kind::Readable, EPOLLIN, 0, nullptr);
+#endif
+    inc_ref(h);
+    return spawn_blocking(mk_closure_3_2(handle_wait_blocking_fn, h, box(false)));
+}
+
+/* Handle.waitWritable : (@& Handle) → IO (Task (Except IO.Error Unit)) */
+extern "C" LEAN_EXPORT obj_res lean_io_prim_handle_wait_writable(b_obj_arg h, obj_arg /* w */) {
+#if defined(LEAN_IO_REACTOR)
+    if (io_reactor * reactor = get_io_reactor())
+        return submit_handle_op(reactor, h, reactor_op_kind::Writable, EPOLLOUT, 0, nullptr);
+#endif
+    inc_ref(h);
+    return spawn_blocking(mk_closure_3_2(handle_wait_blocking_fn, h, box(true)));
+}
+
+/* Child.waitAsync {cfg : @& StdioConfig} : @& Child cfg → IO (Task (Except IO.Error UInt32)) */
+extern "C" LEAN_EXPORT obj_res lean_io_process_child_wait_async(b_obj_arg, b_obj_arg child, obj_arg /* w */) {
+#if defined(LEAN_IO_REACTOR) && defined(SYS_pidfd_open)
+    if (io_reactor * reactor = get_io_reactor()) {
+        pid_t pid = cnstr_get_uint32(child, 3 * sizeof(object *));
+        int fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (fd >= 0) {
+            reactor_op * op = new reactor_op(reactor_op_kind::ChildExit, fd, EPOLLIN, mk_promise());
+            op->m_pid = pid;
+            return reactor->submit(op);
+        }
+        // `pidfd_open` is not supported by kernels older than 5.3; fall back to a waiting thread
+    }
+#endif
+    inc_ref(child);
+    return spawn_blocking(mk_closure_2_1(child_wait_blocking_fn, child));
+}
+}
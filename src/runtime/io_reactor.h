@@ -0,0 +1,15 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+*/
+#pragma once
+
+namespace lean {
+/* Stop the I/O reactor thread, if it was started. Outstanding operations are never resolved.
+   Must be called before the task manager is finalized since the reactor resolves promises. */
+void stop_io_reactor();
+/* Allow the reactor to be started again after `stop_io_reactor`. Called when a new task manager is created. */
+void enable_io_reactor();
+void initialize_io_reactor();
+void finalize_io_reactor();
+}
@@ -4,6 +4,7 @@ Released under Apache 2.0 license as described in the file LICENSE.
 
 Author: Leonardo de Moura, Mac Malone
 */
+#include <atomic>
 #include "runtime/io.h"
 #include "runtime/object.h"
 #include "runtime/sstream.h"
@@ -17,6 +18,12 @@ Author: Leonardo de Moura, Mac Malone
 #endif
 
 namespace lean {
+static std::atomic<unsigned> g_num_loaded_dynlibs(0);
+
+unsigned get_num_loaded_dynlibs() {
+    return g_num_loaded_dynlibs;
+}
+
 void load_dynlib(std::string path) {
 #ifdef LEAN_WINDOWS
     HMODULE h = LoadLibrary(path.c_str());
@@ -30,6 +37,7 @@ void load_dynlib(std::string path) {
     }
 #endif
     // NOTE: we never unload libraries
+    g_num_loaded_dynlibs++;
 }
 
 /* loadDynlib : System.FilePath -> IO Unit */
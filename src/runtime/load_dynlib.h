@@ -9,4 +9,6 @@ Author: Mac Malone
 
 namespace lean {
 LEAN_EXPORT void load_dynlib(std::string path);
+/* Number of libraries successfully loaded by `load_dynlib`. Can be used to invalidate cached symbol lookup failures. */
+LEAN_EXPORT unsigned get_num_loaded_dynlibs();
 }
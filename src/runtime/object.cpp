@@ -20,6 +20,7 @@ Author: Leonardo de Moura
 #include "runtime/interrupt.h"
 #include "runtime/buffer.h"
 #include "runtime/io.h"
+#include "runtime/io_reactor.h"
 #include "runtime/hash.h"
 
 #ifdef __GLIBC__
@@ -220,19 +221,9 @@ static inline void dec(lean_object * o, lean_object* & todo) {
     }
 }
 
-#ifdef LEAN_LAZY_RC
-LEAN_THREAD_PTR(object, g_to_free);
-#endif
-
 static void lean_del_core(object * o, object * & todo);
 
 extern "C" LEAN_EXPORT lean_object * lean_alloc_object(size_t sz) {
-#ifdef LEAN_LAZY_RC
-     if (g_to_free) {
-         object * o = pop_back(g_to_free);
-         lean_del_core(o, g_to_free);
-     }
-#endif
 #ifdef LEAN_SMALL_ALLOCATOR
     return (lean_object*)alloc(sz);
 #else
@@ -299,11 +290,141 @@ static void lean_del_core(object * o, object * & todo) {
     }
 }
 
-extern "C" LEAN_EXPORT void lean_dec_ref_cold(lean_object * o) {
-    if (o->m_rc == 1 || std::atomic_fetch_add_explicit(lean_get_rc_mt_addr(o), 1, std::memory_order_acq_rel) == -1) {
+#if defined(LEAN_MULTI_THREAD)
+/* Deferred deallocation
+
+   When a thread drops the last reference to a big object graph, e.g., an old environment or a large persistent map,
+   deleting it synchronously can stall the thread for a long time. In this mode, a thread deletes at most
+   `LEAN_DEFERRED_DEALLOC_THRESHOLD` objects of a dead multi-threaded graph itself, and hands the remaining ones
+   over to a background reclaimer thread.
+
+   Only multi-threaded graphs are handed over: all objects reachable from a multi-threaded object are
+   multi-threaded or persistent (see `lean_mark_mt`), so the reclaimer only needs atomic operations to update
+   their reference counters. Children of single-threaded objects may still be used by the current thread.
+
+   The reclaimer frees small objects owned by other heaps, so they go through its export list. It flushes this list
+   after each batch to make the memory available to the owning heaps again.
+
+   Finalizers of external objects in a handed over graph run on the reclaimer thread. They may already run on any
+   thread dropping a multi-threaded object, so they must not depend on the thread they run on. */
+#define LEAN_DEFERRED_DEALLOC_THRESHOLD 4096
+
+static void lean_del_all(object * todo) {
+    while (todo != nullptr) {
+        object * o = pop_back(todo);
+        lean_del_core(o, todo);
+    }
+}
+
 #ifdef LEAN_LAZY_RC
-        push_back(g_to_free, o);
+static std::atomic<bool> g_deferred_dealloc(true);
+#else
+static std::atomic<bool> g_deferred_dealloc(false);
+#endif
+LEAN_THREAD_VALUE(bool, g_in_reclaimer, false);
+
+class reclaimer {
+    mutex                    m_mutex;
+    condition_variable       m_cv;
+    std::vector<object *>    m_todo; // lists of dead objects linked using `push_back`
+    bool                     m_stopped{false};
+    std::unique_ptr<lthread> m_thread;
+
+    void loop() {
+        g_in_reclaimer = true;
+        unique_lock<mutex> lock(m_mutex);
+        while (true) {
+            if (m_todo.empty()) {
+                if (m_stopped)
+                    break;
+                m_cv.wait(lock);
+                continue;
+            }
+            std::vector<object *> todo;
+            todo.swap(m_todo);
+            lock.unlock();
+            for (object * t : todo)
+                lean_del_all(t);
+            export_heap_objs();
+            lock.lock();
+        }
+    }
+
+public:
+    /* Return `false` if the reclaimer has been stopped, and the objects must be deleted by the caller. */
+    bool push(object * todo) {
+        unique_lock<mutex> lock(m_mutex);
+        if (m_stopped)
+            return false;
+        if (!m_thread) {
+            try {
+                m_thread.reset(new lthread([this]() { loop(); }));
+            } catch (exception &) {
+                m_stopped = true;
+                return false;
+            }
+        }
+        m_todo.push_back(todo);
+        m_cv.notify_one();
+        return true;
+    }
+
+    /* Delete all pending objects and wait for the reclaimer thread to finish. */
+    void stop() {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_stopped = true;
+            m_cv.notify_one();
+        }
+        if (m_thread)
+            m_thread->join();
+        m_thread.reset();
+    }
+};
+
+static reclaimer * g_reclaimer = nullptr;
+
+static void lean_del_deferred(object * o) {
+    object * todo = nullptr;
+    for (unsigned i = 0; i < LEAN_DEFERRED_DEALLOC_THRESHOLD; i++) {
+        lean_del_core(o, todo);
+        if (todo == nullptr)
+            return;
+        o = pop_back(todo);
+    }
+    push_back(todo, o);
+    if (!g_reclaimer->push(todo))
+        lean_del_all(todo);
+}
+
+static void stop_reclaimer() {
+    if (g_reclaimer)
+        g_reclaimer->stop();
+}
 #else
+static void stop_reclaimer() {}
+#endif
+
+extern "C" LEAN_EXPORT void lean_set_deferred_dealloc(bool flag) {
+#if defined(LEAN_MULTI_THREAD)
+    g_deferred_dealloc = flag;
+#else
+    (void)flag;
+#endif
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_set_deferred_dealloc(uint8 flag, obj_arg) {
+    lean_set_deferred_dealloc(flag);
+    return io_result_mk_ok(box(0));
+}
+
+extern "C" LEAN_EXPORT void lean_dec_ref_cold(lean_object * o) {
+    if (o->m_rc == 1 || std::atomic_fetch_add_explicit(lean_get_rc_mt_addr(o), 1, std::memory_order_acq_rel) == -1) {
+#if defined(LEAN_MULTI_THREAD)
+        /* `o->m_rc` is still `1` if `o` is single-threaded, and `0` if it was multi-threaded. */
+        if (o->m_rc == 0 && g_deferred_dealloc.load(std::memory_order_relaxed) && !g_in_reclaimer)
+            return lean_del_deferred(o);
+#endif
         object * todo = nullptr;
         while (true) {
             lean_del_core(o, todo);
@@ -311,7 +432,6 @@ extern "C" LEAN_EXPORT void lean_dec_ref_cold(lean_object * o) {
                 return;
             o = pop_back(todo);
         }
-#endif
     }
 }
 
@@ -363,6 +483,27 @@ extern "C" LEAN_EXPORT lean_obj_res lean_array_set_panic(lean_obj_arg a, lean_ob
     return lean_panic_fn(a, lean_mk_string("Error: index out of bounds"));
 }
 
+// =======================================
+// Lazily initialized module-level values
+
+extern "C" LEAN_EXPORT b_obj_res lean_lazy_get_core(std::atomic<object *> * cell, object * (*init)()) {
+    object * r = nullptr;
+    if (cell->compare_exchange_strong(r, LEAN_LAZY_BUSY)) {
+        r = init();
+        /* Same as eagerly initialized module-level values. Note that `r` is not reachable by other threads yet. */
+        lean_mark_persistent(r);
+        cell->store(r);
+        return r;
+    } else {
+        /* There is another thread executing `init`. We keep waiting for it to store the value. */
+        while (r == LEAN_LAZY_BUSY) {
+            this_thread::yield();
+            r = cell->load();
+        }
+        return r;
+    }
+}
+
 // =======================================
 // Thunks
 
@@ -863,6 +1004,7 @@ extern "C" LEAN_EXPORT void lean_init_task_manager_using(unsigned num_workers) {
 #if defined(LEAN_MULTI_THREAD)
     if (num_workers > 0) {
         g_task_manager = new task_manager(num_workers);
+        enable_io_reactor();
     }
 #endif
 }
@@ -881,6 +1023,8 @@ extern "C" LEAN_EXPORT void lean_init_task_manager() {
 }
 
 extern "C" LEAN_EXPORT void lean_finalize_task_manager() {
+    stop_io_reactor();
+    stop_reclaimer();
     if (g_task_manager) {
         delete g_task_manager;
         g_task_manager = nullptr;
@@ -892,17 +1036,24 @@ scoped_task_manager::scoped_task_manager(unsigned num_workers) {
 #if defined(LEAN_MULTI_THREAD)
     if (num_workers > 0) {
         g_task_manager = new task_manager(num_workers);
+        enable_io_reactor();
     }
 #endif
 }
 
 scoped_task_manager::~scoped_task_manager() {
+    stop_io_reactor();
+    stop_reclaimer();
     if (g_task_manager) {
         delete g_task_manager;
         g_task_manager = nullptr;
     }
 }
 
+bool has_task_manager() {
+    return g_task_manager != nullptr;
+}
+
 void deactivate_task(lean_task_object * t) {
     if (g_task_manager) {
         g_task_manager->deactivate_task(t);
@@ -2343,6 +2494,9 @@ extern "C" LEAN_EXPORT lean_external_class * lean_register_external_class(lean_e
 }
 
 void initialize_object() {
+#if defined(LEAN_MULTI_THREAD)
+    g_reclaimer         = new reclaimer();
+#endif
     g_ext_classes       = new std::vector<external_object_class*>();
     g_ext_classes_mutex = new mutex();
     g_array_empty       = lean_alloc_array(0, 0);
@@ -2350,6 +2504,10 @@ void initialize_object() {
 }
 
 void finalize_object() {
+#if defined(LEAN_MULTI_THREAD)
+    stop_reclaimer();
+    delete g_reclaimer;
+#endif
     for (external_object_class * cls : *g_ext_classes) delete cls;
     delete g_ext_classes;
     delete g_ext_classes_mutex;
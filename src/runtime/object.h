@@ -280,6 +280,9 @@ public:
     ~scoped_task_manager();
 };
 
+/* Return `true` if tasks are run by worker threads, i.e. if `lean_io_promise_new` may be used. */
+LEAN_EXPORT bool has_task_manager();
+
 inline obj_res task_spawn(obj_arg c, unsigned prio = 0, bool keep_alive = false) { return lean_task_spawn_core(c, prio, keep_alive); }
 inline obj_res task_pure(obj_arg a) { return lean_task_pure(a); }
 inline obj_res task_bind(obj_arg x, obj_arg f, unsigned prio = 0, bool sync = false, bool keep_alive = false) { return lean_task_bind_core(x, f, prio, sync, keep_alive); }
@@ -9,6 +9,7 @@ Author: Jared Roesch
 #include <iostream>
 #include <iomanip>
 #include <utility>
+#include <algorithm>
 #include <system_error>
 
 #if defined(LEAN_WINDOWS)
@@ -24,7 +25,15 @@ Author: Jared Roesch
 #include <fcntl.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <spawn.h>
 #include <limits.h> // NOLINT
+#include <vector>
+#endif
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 29)
+// `posix_spawn_file_actions_addchdir_np` is needed to implement `SpawnArgs.cwd`
+#define LEAN_POSIX_SPAWN
+extern char ** environ;
 #endif
 
 #include "runtime/object.h"
@@ -321,6 +330,23 @@ extern "C" LEAN_EXPORT obj_res lean_io_process_child_kill(b_obj_arg, b_obj_arg c
 
 struct pipe { int m_read_fd; int m_write_fd; };
 
+/* Failure to start the program itself, e.g. because it could not be found or `cwd` does not exist,
+   as opposed to failures setting up the child. Only these are attributed to the command name. */
+struct spawn_error { int m_err; };
+
+static pipe mk_cloexec_pipe() {
+    int fds[2];
+#ifdef __APPLE__
+    // this is inherently racy, but there is nothing we can do on MacOS
+    if (::pipe(fds) == -1) { throw errno; }
+    if (::fcntl(fds[0], F_SETFD, FD_CLOEXEC)) { throw errno; }
+    if (::fcntl(fds[1], F_SETFD, FD_CLOEXEC)) { throw errno; }
+#else
+    if (::pipe2(fds, O_CLOEXEC) == -1) { throw errno; }
+#endif
+    return pipe { fds[0], fds[1] };
+}
+
 static optional<pipe> setup_stdio(stdio cfg) {
     /* Setup stdio based on process configuration. */
     switch (cfg) {
@@ -328,16 +354,7 @@ static optional<pipe> setup_stdio(stdio cfg) {
         /* We should need to do nothing in this case */
         return optional<pipe>();
     case stdio::PIPED:
-        int fds[2];
-#ifdef __APPLE__
-        // this is inherently racy, but there is nothing we can do on MacOS
-        if (::pipe(fds) == -1) { throw errno; }
-        if (::fcntl(fds[0], F_SETFD, FD_CLOEXEC)) { throw errno; }
-        if (::fcntl(fds[1], F_SETFD, FD_CLOEXEC)) { throw errno; }
-#else
-        if (::pipe2(fds, O_CLOEXEC) == -1) { throw errno; }
-#endif
-        return optional<pipe>(pipe { fds[0], fds[1] });
+        return optional<pipe>(mk_cloexec_pipe());
     case stdio::NUL:
         /* We should map /dev/null. */
         return optional<pipe>();
@@ -345,14 +362,115 @@ static optional<pipe> setup_stdio(stdio cfg) {
     lean_unreachable();
 }
 
-static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const & args, stdio stdin_mode, stdio stdout_mode,
-  stdio stderr_mode, option_ref<string_ref> const & cwd, array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env,
-  bool do_setsid) {
-    /* Setup stdio based on process configuration. */
-    auto stdin_pipe  = setup_stdio(stdin_mode);
-    auto stdout_pipe = setup_stdio(stdout_mode);
-    auto stderr_pipe = setup_stdio(stderr_mode);
+#if defined(LEAN_POSIX_SPAWN)
+/* Return `true` if `env` changes the `PATH` used to look up `proc_name`. `posix_spawnp` searches the
+   parent's `PATH`, while `execvp` in the forked child used the updated environment. */
+static bool env_overrides_path(string_ref const & proc_name, array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env) {
+    if (strchr(proc_name.data(), '/'))
+        return false;
+    for (auto & entry : env) {
+        if (strcmp(entry.fst().data(), "PATH") == 0)
+            return true;
+    }
+    return false;
+}
+
+/* The parent's environment updated with `env`, in the format expected by `execve`. */
+static std::vector<std::string> mk_child_environ(array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env) {
+    std::vector<std::string> r;
+    for (char ** it = environ; *it; it++)
+        r.push_back(*it);
+    for (auto & entry : env) {
+        std::string key = entry.fst().to_std_string();
+        auto is_entry = [&](std::string const & e) {
+            return e.size() > key.size() && e.compare(0, key.size(), key) == 0 && e[key.size()] == '=';
+        };
+        r.erase(std::remove_if(r.begin(), r.end(), is_entry), r.end());
+        if (entry.snd())
+            r.push_back(key + "=" + entry.snd().get()->data());
+    }
+    return r;
+}
 
+/* Start the child using `posix_spawnp`, which glibc implements using `clone(CLONE_VM | CLONE_VFORK)`.
+   Unlike `fork`, it does not copy the parent's page tables, whose cost is proportional to the size of
+   the parent's heap and dominated spawning from language servers and build drivers. Throws
+   `spawn_error` if changing directory or executing the program fails, and the error number on other
+   failures. */
+static pid_t posix_spawn_child(string_ref const & proc_name, array_ref<string_ref> const & args, stdio stdin_mode,
+  stdio stdout_mode, stdio stderr_mode, optional<pipe> const & stdin_pipe, optional<pipe> const & stdout_pipe,
+  optional<pipe> const & stderr_pipe, option_ref<string_ref> const & cwd,
+  array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env, bool do_setsid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    if (int err = posix_spawn_file_actions_init(&actions)) { throw err; }
+    if (int err = posix_spawnattr_init(&attr)) {
+        posix_spawn_file_actions_destroy(&actions);
+        throw err;
+    }
+    // The other ends of the pipes are closed on `exec` as they were created with `O_CLOEXEC`.
+    int err = 0;
+    if (stdin_pipe) {
+        err = err ? err : posix_spawn_file_actions_adddup2(&actions, stdin_pipe->m_read_fd, STDIN_FILENO);
+    } else if (stdin_mode == stdio::NUL) {
+        err = err ? err : posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+    if (stdout_pipe) {
+        err = err ? err : posix_spawn_file_actions_adddup2(&actions, stdout_pipe->m_write_fd, STDOUT_FILENO);
+    } else if (stdout_mode == stdio::NUL) {
+        err = err ? err : posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+    if (stderr_pipe) {
+        err = err ? err : posix_spawn_file_actions_adddup2(&actions, stderr_pipe->m_write_fd, STDERR_FILENO);
+    } else if (stderr_mode == stdio::NUL) {
+        err = err ? err : posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+    if (cwd) {
+        err = err ? err : posix_spawn_file_actions_addchdir_np(&actions, cwd.get()->data());
+    }
+    if (do_setsid) {
+        err = err ? err : posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID);
+    }
+
+    buffer<char *> pargs;
+    pargs.push_back(const_cast<char *>(proc_name.data()));
+    for (auto & arg : args)
+        pargs.push_back(const_cast<char *>(arg.data()));
+    pargs.push_back(NULL);
+
+    std::vector<std::string> child_environ;
+    buffer<char *> penv;
+    if (env.size()) {
+        child_environ = mk_child_environ(env);
+        for (std::string & e : child_environ)
+            penv.push_back(const_cast<char *>(e.c_str()));
+        penv.push_back(NULL);
+    }
+
+    pid_t pid = -1;
+    int spawn_err = err ? 0 : posix_spawnp(&pid, pargs[0], &actions, &attr, pargs.data(), env.size() ? penv.data() : environ);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err) { throw err; }
+    if (spawn_err) { throw spawn_error { spawn_err }; }
+    return pid;
+}
+#endif
+
+/* Start the child using `fork` and `execvp`. Like `posix_spawn_child`, throws `spawn_error` if changing
+   directory or executing the program fails: the child sends the error number through a pipe that is
+   closed on a successful `exec`. */
+static pid_t fork_child(string_ref const & proc_name, array_ref<string_ref> const & args, stdio stdin_mode,
+  stdio stdout_mode, stdio stderr_mode, optional<pipe> const & stdin_pipe, optional<pipe> const & stdout_pipe,
+  optional<pipe> const & stderr_pipe, option_ref<string_ref> const & cwd,
+  array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env, bool do_setsid) {
+    pipe err_pipe = mk_cloexec_pipe();
+    auto exit_with_errno = [&]() {
+        int err = errno;
+        ssize_t n = write(err_pipe.m_write_fd, &err, sizeof(err));
+        (void)n;
+        _exit(127);
+    };
     int pid = fork();
 
     if (pid == 0) {
@@ -390,8 +508,7 @@ static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const &
 
         if (cwd) {
             if (chdir(cwd.get()->data()) < 0) {
-                std::cerr << "could not change directory to " << cwd.get()->data() << std::endl;
-                exit(-1);
+                exit_with_errno();
             }
         }
 
@@ -405,12 +522,54 @@ static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const &
             pargs.push_back(strdup(arg.data()));
         pargs.push_back(NULL);
 
-        if (execvp(pargs[0], pargs.data()) < 0) {
-            std::cerr << "could not execute external process '" << pargs[0] << "'" << std::endl;
-            exit(-1);
-        }
+        execvp(pargs[0], pargs.data());
+        exit_with_errno();
     } else if (pid == -1) {
-        throw errno;
+        int err = errno;
+        close(err_pipe.m_read_fd);
+        close(err_pipe.m_write_fd);
+        throw err;
+    }
+    close(err_pipe.m_write_fd);
+    int err;
+    ssize_t n;
+    do {
+        n = read(err_pipe.m_read_fd, &err, sizeof(err));
+    } while (n == -1 && errno == EINTR);
+    close(err_pipe.m_read_fd);
+    if (n == sizeof(err)) {
+        waitpid(pid, nullptr, 0);
+        throw spawn_error { err };
+    }
+    return pid;
+}
+
+static obj_res spawn(string_ref const & proc_name, array_ref<string_ref> const & args, stdio stdin_mode, stdio stdout_mode,
+  stdio stderr_mode, option_ref<string_ref> const & cwd, array_ref<pair_ref<string_ref, option_ref<string_ref>>> const & env,
+  bool do_setsid) {
+    /* Setup stdio based on process configuration. */
+    auto stdin_pipe  = setup_stdio(stdin_mode);
+    auto stdout_pipe = setup_stdio(stdout_mode);
+    auto stderr_pipe = setup_stdio(stderr_mode);
+
+    pid_t pid;
+    try {
+#if defined(LEAN_POSIX_SPAWN)
+        if (!env_overrides_path(proc_name, env)) {
+            pid = posix_spawn_child(proc_name, args, stdin_mode, stdout_mode, stderr_mode, stdin_pipe, stdout_pipe,
+                                    stderr_pipe, cwd, env, do_setsid);
+        } else
+#endif
+        pid = fork_child(proc_name, args, stdin_mode, stdout_mode, stderr_mode, stdin_pipe, stdout_pipe, stderr_pipe,
+                         cwd, env, do_setsid);
+    } catch (...) {
+        for (auto const & p : { stdin_pipe, stdout_pipe, stderr_pipe }) {
+            if (p) {
+                close(p->m_read_fd);
+                close(p->m_write_fd);
+            }
+        }
+        throw;
     }
 
     object * parent_stdin  = box(0);
@@ -472,6 +631,9 @@ extern "C" LEAN_EXPORT obj_res lean_io_process_spawn(obj_arg args_, obj_arg) {
                 cnstr_get_ref_t<option_ref<string_ref>>(args, 3),
                 cnstr_get_ref_t<array_ref<pair_ref<string_ref, option_ref<string_ref>>>>(args, 4),
                 cnstr_get_uint8(args.raw(), 5 * sizeof(object *)));
+    } catch (spawn_error const & err) {
+        // attribute errors such as `ENOENT` from executing the program to the command name
+        return lean_io_result_mk_error(decode_io_error(err.m_err, cnstr_get(args.raw(), 1)));
     } catch (int err) {
         return lean_io_result_mk_error(decode_io_error(err, nullptr));
     } catch (std::system_error const & err) {
@@ -0,0 +1,485 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Process zygotes: a process that has done expensive initialization that can be shared, such as
+importing the environment of a language server file worker, listens on a Unix domain socket and forks
+a copy of itself for each connection. The connecting process passes its standard streams, which
+become those of the forked child, and then waits for the exit code of the child. Pages of the zygote
+are shared with all children until written to. As only the forking thread survives `fork`, the
+zygote must not have started any other threads.
+
+The socket is created in a fresh directory only accessible by the current user, and both sides check that the
+process on the other end of a connection belongs to the same user.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#if !defined(LEAN_WINDOWS)
+#include <string>
+#include <unordered_map>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#if defined(__GLIBC__)
+#include <stdio_ext.h>
+#endif
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#endif
+#include "runtime/object.h"
+#include "runtime/io.h"
+#include "runtime/thread.h"
+
+namespace lean {
+#if defined(LEAN_WINDOWS)
+
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_mk_socket_path(obj_arg) {
+    return io_result_mk_error("process zygotes are not supported on Windows");
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_listen(b_obj_arg, obj_arg) {
+    return io_result_mk_error("process zygotes are not supported on Windows");
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_serve(obj_arg) {
+    return io_result_mk_error("process zygotes are not supported on Windows");
+}
+
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_attach(b_obj_arg, obj_arg) {
+    return io_result_mk_ok(box(0));
+}
+
+#else
+
+// exit code with which a forked child reports that the state of the zygote is not usable for it
+static int const g_zygote_stale_exit_code = 3;
+// exit code reported to the connecting process in this case
+static int const g_zygote_restart_exit_code = 2;
+
+// how long `lean_io_zygote_attach` waits for the socket to be created, in total 2s
+static unsigned const g_zygote_attach_retries = 100;
+static unsigned const g_zygote_attach_retry_delay_us = 20000;
+
+// how long `lean_io_zygote_serve` waits for other threads to exit, e.g. those of finished dedicated tasks, in total 2s
+static unsigned const g_zygote_threads_retries = 100;
+static unsigned const g_zygote_threads_retry_delay_us = 20000;
+
+// name of the socket in the directory created by `lean_io_zygote_mk_socket_path`
+static char const * g_zygote_socket_name = "zygote.sock";
+
+static int g_listen_fd = -1;
+static std::string * g_listen_path = nullptr;
+static int g_sigchld_pipe[2] = {-1, -1};
+
+static void on_sigchld(int) {
+    int saved_errno = errno;
+    char c = 0;
+    if (write(g_sigchld_pipe[1], &c, 1) < 0) {}
+    errno = saved_errno;
+}
+
+static void set_cloexec(int fd) {
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+/* Returns the number of threads of the current process, or 0 if it cannot be determined on this platform. */
+static unsigned get_num_threads() {
+#if defined(__linux__)
+    DIR * dir = opendir("/proc/self/task");
+    if (!dir)
+        return 0;
+    unsigned n = 0;
+    while (dirent * e = readdir(dir)) {
+        if (e->d_name[0] != '.')
+            n++;
+    }
+    closedir(dir);
+    return n;
+#elif defined(__APPLE__)
+    thread_act_array_t threads;
+    mach_msg_type_number_t n;
+    if (task_threads(mach_task_self(), &threads, &n) != KERN_SUCCESS)
+        return 0;
+    for (mach_msg_type_number_t i = 0; i < n; i++)
+        mach_port_deallocate(mach_task_self(), threads[i]);
+    vm_deallocate(mach_task_self(), reinterpret_cast<vm_address_t>(threads), n * sizeof(thread_act_t));
+    return n;
+#else
+    return 0;
+#endif
+}
+
+/* Returns true if the process at the other end of the Unix domain socket `conn` runs as the current user. */
+static bool is_peer_same_user(int conn) {
+#if defined(SO_PEERCRED)
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 || len != sizeof(cred))
+        return false;
+    return cred.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(conn, &uid, &gid) < 0)
+        return false;
+    return uid == geteuid();
+#endif
+}
+
+static bool init_sockaddr(sockaddr_un & addr, char const * path) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::strcpy(addr.sun_path, path);
+    return true;
+}
+
+static bool send_stdio(int conn) {
+    int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    char byte = 0;
+    iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    ssize_t n;
+    do { n = sendmsg(conn, &msg, 0); } while (n < 0 && errno == EINTR);
+    return n == 1;
+}
+
+static bool recv_stdio(int conn, int * fds) {
+    char byte;
+    iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    do { n = recvmsg(conn, &msg, 0); } while (n < 0 && errno == EINTR);
+    if (n != 1)
+        return false;
+    cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        return false;
+    if (cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        size_t k = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < k; i++) {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            close(fd);
+        }
+        return false;
+    }
+    std::memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    return true;
+}
+
+static void send_all(int conn, void const * data, size_t size) {
+    ssize_t n;
+    do { n = send(conn, data, size, 0); } while (n < 0 && errno == EINTR);
+}
+
+static bool read_exact(int conn, void * data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        ssize_t n = read(conn, static_cast<char *>(data) + received, size - received);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        received += n;
+    }
+    return true;
+}
+
+static void send_exit_code(int conn, uint32 code) {
+    send_all(conn, &code, sizeof(code));
+}
+
+/* Turns the current process into a forked child serving the connection `conn`, whose standard streams are `fds`. */
+static void become_child(int listen_fd, std::unordered_map<pid_t, int> const & children, int conn, int * fds) {
+    close(listen_fd);
+    g_listen_fd = -1;
+    close(g_sigchld_pipe[0]);
+    close(g_sigchld_pipe[1]);
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    for (auto const & c : children)
+        close(c.second);
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < 3; i++) {
+        dup2(fds[i], i);
+        if (fds[i] > 2)
+            close(fds[i]);
+    }
+    // drop anything the zygote had already buffered from its own standard input
+    clearerr(stdin);
+#if defined(__GLIBC__)
+    __fpurge(stdin);
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+    fpurge(stdin);
+#endif
+    set_cloexec(conn);
+    // lets the child and its tools tell that it was forked, and from which zygote
+    setenv("LEAN_WORKER_ZYGOTE_PID", std::to_string(getppid()).c_str(), 1);
+#if defined(LEAN_MULTI_THREAD)
+    // The connecting process does not send anything after the standard streams, so the connection only becomes
+    // readable when that process has died, in which case nobody is waiting for this one anymore.
+    std::thread([conn]() {
+        char byte;
+        ssize_t n;
+        do { n = read(conn, &byte, 1); } while (n < 0 && errno == EINTR);
+        _exit(1);
+    }).detach();
+#endif
+}
+
+/*
+Creates a fresh directory only accessible by the current user and returns the path of a socket in it. The directory is
+removed by the zygote when it stops listening.
+*/
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_mk_socket_path(obj_arg) {
+    char const * tmp_dir = getenv("TMPDIR");
+    std::string dir = std::string(tmp_dir && *tmp_dir ? tmp_dir : "/tmp") + "/lean-zygote-XXXXXX";
+    // `mkdtemp` creates the directory with permissions 0700
+    if (!mkdtemp(&dir[0]))
+        return io_result_mk_error(decode_io_error(errno, nullptr));
+    return io_result_mk_ok(mk_string(dir + "/" + g_zygote_socket_name));
+}
+
+/* Removes the socket at `path` and the directory containing it if it was created by `lean_io_zygote_mk_socket_path`. */
+static void remove_socket(std::string const & path) {
+    unlink(path.c_str());
+    size_t sep = path.rfind('/');
+    if (sep != std::string::npos && path.compare(sep + 1, std::string::npos, g_zygote_socket_name) == 0)
+        rmdir(path.substr(0, sep).c_str());
+}
+
+/*
+Starts listening on the Unix domain socket at `path`. Connections are accepted only once `lean_io_zygote_serve`
+is called, so the zygote can do its initialization in between without making connecting processes fail.
+*/
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_listen(b_obj_arg path, obj_arg) {
+    char const * cpath = string_cstr(path);
+    sockaddr_un addr;
+    if (g_listen_fd >= 0)
+        return io_result_mk_error("zygote is already listening");
+    if (!init_sockaddr(addr, cpath))
+        return io_result_mk_error(decode_io_error(errno, path));
+    unlink(cpath);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        return io_result_mk_error(decode_io_error(errno, path));
+    set_cloexec(listen_fd);
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+        int err = errno;
+        close(listen_fd);
+        return io_result_mk_error(decode_io_error(err, path));
+    }
+    g_listen_fd = listen_fd;
+    g_listen_path = new std::string(cpath);
+    return io_result_mk_ok(box(0));
+}
+
+/*
+Serves connections on the socket set up by `lean_io_zygote_listen` by forking the current process for each of them.
+Returns `true` in each forked child and `false` in the zygote once it should exit, which is the case when its
+standard input is closed or a child exited with `g_zygote_stale_exit_code`, and all children have finished.
+*/
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_serve(obj_arg) {
+    if (g_listen_fd < 0)
+        return io_result_mk_error("zygote is not listening");
+    int listen_fd = g_listen_fd;
+    // only the current thread survives `fork`, so any other thread would leave the children in an inconsistent state
+    for (unsigned i = 0; get_num_threads() > 1; i++) {
+        if (i == g_zygote_threads_retries) {
+            // connecting processes fall back to running on their own
+            close(listen_fd);
+            remove_socket(*g_listen_path);
+            g_listen_fd = -1;
+            return io_result_mk_error("zygote cannot fork, other threads are running");
+        }
+        usleep(g_zygote_threads_retry_delay_us);
+    }
+    if (pipe(g_sigchld_pipe) < 0) {
+        int err = errno;
+        return io_result_mk_error(decode_io_error(err, nullptr));
+    }
+    for (int fd : g_sigchld_pipe) {
+        set_cloexec(fd);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigchld;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NOCLDSTOP | SA_RESTART;
+    sigaction(SIGCHLD, &sa, nullptr);
+    // a connecting process may die before receiving the exit code of its child
+    signal(SIGPIPE, SIG_IGN);
+
+    std::unordered_map<pid_t, int> children;
+    bool accepting = true;
+    // new connections fail from now on, so that their processes do not wait for the zygote
+    auto stop_accepting = [&]() {
+        if (accepting) {
+            accepting = false;
+            close(listen_fd);
+            remove_socket(*g_listen_path);
+            g_listen_fd = -1;
+        }
+    };
+    while (accepting || !children.empty()) {
+        pollfd pfds[3] = {{g_sigchld_pipe[0], POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}, {listen_fd, POLLIN, 0}};
+        if (poll(pfds, accepting ? 3 : 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (pfds[0].revents) {
+            char buf[64];
+            while (read(g_sigchld_pipe[0], buf, sizeof(buf)) > 0) {}
+            int status;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                auto it = children.find(pid);
+                if (it == children.end())
+                    continue;
+                // use bash's convention as in `lean_io_process_child_wait`
+                uint32 code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                if (code == g_zygote_stale_exit_code) {
+                    code = g_zygote_restart_exit_code;
+                    stop_accepting();
+                }
+                send_exit_code(it->second, code);
+                close(it->second);
+                children.erase(it);
+            }
+        }
+        if (!accepting)
+            continue;
+        if (pfds[1].revents) {
+            // nothing is sent to the zygote after it started serving, so its standard input has been closed
+            stop_accepting();
+            continue;
+        }
+        if (pfds[2].revents & POLLIN) {
+            int conn = accept(listen_fd, nullptr, nullptr);
+            if (conn < 0)
+                continue;
+            set_cloexec(conn);
+            if (!is_peer_same_user(conn)) {
+                close(conn);
+                continue;
+            }
+            int fds[3];
+            if (!recv_stdio(conn, fds)) {
+                close(conn);
+                continue;
+            }
+            fflush(stdout);
+            fflush(stderr);
+            pid_t pid = fork();
+            if (pid == 0) {
+                become_child(listen_fd, children, conn, fds);
+                return io_result_mk_ok(box(true));
+            }
+            for (int fd : fds)
+                close(fd);
+            if (pid < 0) {
+                send_exit_code(conn, 1);
+                close(conn);
+                continue;
+            }
+            // tell the connecting process that its standard streams are in use now
+            char byte = 0;
+            send_all(conn, &byte, 1);
+            children.emplace(pid, conn);
+        }
+    }
+    stop_accepting();
+    signal(SIGCHLD, SIG_DFL);
+    close(g_sigchld_pipe[0]);
+    close(g_sigchld_pipe[1]);
+    return io_result_mk_ok(box(false));
+}
+
+/*
+Connects to the zygote listening at `path` and passes it the standard streams of this process.
+Returns `none` if the zygote did not fork a child for this process, and otherwise the exit code of the forked child once it has
+finished.
+*/
+extern "C" LEAN_EXPORT obj_res lean_io_zygote_attach(b_obj_arg path, obj_arg) {
+    sockaddr_un addr;
+    if (!init_sockaddr(addr, string_cstr(path)))
+        return io_result_mk_ok(box(0));
+    int conn = -1;
+    // the zygote may have been started just before this process and not be listening yet
+    for (unsigned i = 0; i <= g_zygote_attach_retries; i++) {
+        conn = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (conn < 0)
+            return io_result_mk_ok(box(0));
+        set_cloexec(conn);
+        int r;
+        do { r = connect(conn, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)); } while (r < 0 && errno == EINTR);
+        if (r == 0)
+            break;
+        int err = errno;
+        close(conn);
+        conn = -1;
+        if (err != ENOENT && err != ECONNREFUSED)
+            break;
+        usleep(g_zygote_attach_retry_delay_us);
+    }
+    if (conn < 0)
+        return io_result_mk_ok(box(0));
+    if (!is_peer_same_user(conn) || !send_stdio(conn)) {
+        close(conn);
+        return io_result_mk_ok(box(0));
+    }
+    char forked;
+    if (!read_exact(conn, &forked, 1)) {
+        // no child was forked, so the standard streams are still ours
+        close(conn);
+        return io_result_mk_ok(box(0));
+    }
+    uint32 code;
+    if (!read_exact(conn, &code, sizeof(code))) {
+        // the zygote died without reporting an exit code
+        code = 1;
+    }
+    close(conn);
+    object * res = alloc_cnstr(1, 1, 0);
+    cnstr_set(res, 0, box_uint32(code));
+    return io_result_mk_ok(res);
+}
+#endif
+}
@@ -0,0 +1,563 @@
+/*
+Copyright (c) 2024 Lean FRO. All rights reserved.
+Released under Apache 2.0 license as described in the file LICENSE.
+
+Native implementations of `Lean.Json.parse` and `Lean.Json.compress`. Both produce exactly the same results as the
+Lean implementations in `Lean.Data.Json.Parser` and `Lean.Data.Json.Printer`, which remain the reference. Scanning of
+string contents, which makes up most of the work for typical LSP messages, is vectorized when SSE2 or NEON is
+available.
+*/
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "runtime/object.h"
+
+namespace lean {
+/*
+@[export lean_json_mk_obj]
+private def mkObj (kvs : Array (String × Json)) : Json */
+extern "C" object * lean_json_mk_obj(object * kvs);
+/*
+@[export lean_json_number_to_string]
+protected def JsonNumber.toString : JsonNumber → String */
+extern "C" object * lean_json_number_to_string(object * n);
+
+/* Constructor tags of `Lean.Json` */
+enum class json_kind { Null, Bool, Num, Str, Arr, Obj };
+
+/* Maximal nesting depth of arrays and objects handled by the native parser. Deeper values are left to the Lean
+   implementation. */
+static const unsigned g_json_max_depth = 512;
+
+/* Return a pointer to the first byte in `[p, end)` that is `"`, `\` or a control character (< 0x20), or `end`.
+   These are exactly the bytes that need special treatment in JSON strings, both when parsing and when rendering. */
+static inline char const * find_special(char const * p, char const * end) {
+#if defined(__SSE2__)
+    __m128i const quote  = _mm_set1_epi8('"');
+    __m128i const bslash = _mm_set1_epi8('\\');
+    __m128i const ctrl   = _mm_set1_epi8(0x1f);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+                                 // unsigned `v <= 0x1f`
+                                 _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+        int mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t const quote  = vdupq_n_u8('"');
+    uint8x16_t const bslash = vdupq_n_u8('\\');
+    uint8x16_t const ctrl   = vdupq_n_u8(0x1f);
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<uint8_t const *>(p));
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, bslash)), vcleq_u8(v, ctrl));
+        if (vmaxvq_u8(m) != 0)
+            break;  // found in this block, locate it below
+    }
+#endif
+    for (; p < end; p++) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\' || c < 0x20)
+            return p;
+    }
+    return end;
+}
+
+static inline bool is_json_ws(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool is_digit(char c) {
+    return '0' <= c && c <= '9';
+}
+
+static void push_utf8(std::string & out, unsigned c) {
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xc0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+    } else if (c < 0x10000) {
+        out += static_cast<char>(0xe0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+    }
+}
+
+/* Parser following `Lean.Json.Parser.any`. All parse functions return `nullptr` if the input is not valid JSON or
+   not supported by the native parser; the caller then falls back to the Lean implementation, which also produces the
+   error message. */
+class json_parser {
+    char const * m_p;
+    char const * m_end;
+    unsigned     m_depth = 0;
+    std::string  m_buf;
+
+    bool at_end() const { return m_p == m_end; }
+
+    void skip_ws() {
+        while (m_p < m_end && is_json_ws(*m_p))
+            m_p++;
+    }
+
+    bool skip_string(char const * s) {
+        size_t n = strlen(s);
+        if (static_cast<size_t>(m_end - m_p) < n || memcmp(m_p, s, n) != 0)
+            return false;
+        m_p += n;
+        return true;
+    }
+
+    bool hex_digit(unsigned & r) {
+        if (at_end())
+            return false;
+        char c = *m_p++;
+        if ('0' <= c && c <= '9')      r = 16*r + (c - '0');
+        else if ('a' <= c && c <= 'f') r = 16*r + (c - 'a' + 10);
+        else if ('A' <= c && c <= 'F') r = 16*r + (c - 'A' + 10);
+        else return false;
+        return true;
+    }
+
+    /* Parse the rest of a string after the opening `"`, see `Lean.Json.Parser.strCore`. */
+    object * parse_str() {
+        char const * start = m_p;
+        char const * q = find_special(m_p, m_end);
+        if (q < m_end && *q == '"') {
+            // common case: no escapes
+            m_p = q + 1;
+            return lean_mk_string_from_bytes(start, q - start);
+        }
+        m_buf.clear();
+        while (true) {
+            if (q == m_end || static_cast<unsigned char>(*q) < 0x20)
+                return nullptr;
+            m_buf.append(m_p, q);
+            m_p = q + 1;
+            if (*q == '"')
+                return lean_mk_string_from_bytes(m_buf.data(), m_buf.size());
+            // escape sequence, see `Lean.Json.Parser.escapedChar`
+            if (at_end())
+                return nullptr;
+            switch (*m_p++) {
+            case '\\': m_buf += '\\'; break;
+            case '"':  m_buf += '"'; break;
+            case '/':  m_buf += '/'; break;
+            case 'b':  m_buf += '\x08'; break;
+            case 'f':  m_buf += '\x0c'; break;
+            case 'n':  m_buf += '\n'; break;
+            case 'r':  m_buf += '\x0d'; break;
+            case 't':  m_buf += '\t'; break;
+            case 'u': {
+                unsigned c = 0;
+                if (!hex_digit(c) || !hex_digit(c) || !hex_digit(c) || !hex_digit(c))
+                    return nullptr;
+                // `Char.ofNat` maps surrogates to `\0`
+                if (0xd800 <= c && c <= 0xdfff)
+                    c = 0;
+                push_utf8(m_buf, c);
+                break;
+            }
+            default:
+                return nullptr;
+            }
+            q = find_special(m_p, m_end);
+        }
+    }
+
+    static object * digits_to_nat(char const * b1, char const * e1, char const * b2, char const * e2) {
+        size_t n = (e1 - b1) + (e2 - b2);
+        if (n <= 18) {
+            uint64 r = 0;
+            for (char const * p = b1; p < e1; p++) r = 10*r + (*p - '0');
+            for (char const * p = b2; p < e2; p++) r = 10*r + (*p - '0');
+            return lean_uint64_to_nat(r);
+        }
+        std::string s(b1, e1);
+        s.append(b2, e2);
+        return lean_cstr_to_nat(s.c_str());
+    }
+
+    /* See `Lean.Json.Parser.num` */
+    object * parse_num() {
+        bool neg = *m_p == '-';
+        if (neg)
+            m_p++;
+        if (at_end())
+            return nullptr;
+        char const * int_begin = m_p;
+        if (*m_p == '0') {
+            m_p++;
+        } else if ('1' <= *m_p && *m_p <= '9') {
+            while (m_p < m_end && is_digit(*m_p)) m_p++;
+        } else {
+            return nullptr;
+        }
+        char const * int_end    = m_p;
+        char const * frac_begin = m_p;
+        char const * frac_end   = m_p;
+        if (m_p < m_end && *m_p == '.') {
+            m_p++;
+            if (at_end() || !is_digit(*m_p))
+                return nullptr;
+            frac_begin = m_p;
+            while (m_p < m_end && is_digit(*m_p)) m_p++;
+            frac_end = m_p;
+        }
+        bool has_exp = false, exp_neg = false;
+        uint64 exp = 0;
+        if (m_p < m_end && (*m_p == 'e' || *m_p == 'E')) {
+            has_exp = true;
+            m_p++;
+            if (at_end())
+                return nullptr;
+            if (*m_p == '-') {
+                exp_neg = true;
+                m_p++;
+            } else if (*m_p == '+') {
+                m_p++;
+            }
+            if (at_end() || !is_digit(*m_p))
+                return nullptr;
+            while (m_p < m_end && *m_p == '0') m_p++;
+            char const * exp_begin = m_p;
+            while (m_p < m_end && is_digit(*m_p)) m_p++;
+            // leave huge exponents to the Lean implementation
+            if (m_p - exp_begin > 18)
+                return nullptr;
+            for (char const * p = exp_begin; p < m_p; p++) exp = 10*exp + (*p - '0');
+        }
+        // mantissa * 10^-exponent
+        object * mantissa = lean_nat_to_int(digits_to_nat(int_begin, int_end, frac_begin, frac_end));
+        if (neg) {
+            object * r = lean_int_neg(mantissa);
+            lean_dec(mantissa);
+            mantissa = r;
+        }
+        uint64 exponent = frac_end - frac_begin;
+        if (has_exp) {
+            if (exp_neg) {
+                // `JsonNumber.shiftr`
+                exponent += exp;
+            } else if (exp > exponent) {
+                // `JsonNumber.shiftl`
+                object * k = lean_uint64_to_nat(exp - exponent);
+                object * p = lean_nat_pow(lean_box(10), k);
+                lean_dec(k);
+                object * pi = lean_nat_to_int(p);
+                object * r = lean_int_mul(mantissa, pi);
+                lean_dec(pi);
+                lean_dec(mantissa);
+                mantissa = r;
+                exponent = 0;
+            } else {
+                exponent -= exp;
+            }
+        }
+        object * n = lean_alloc_ctor(0, 2, 0);
+        lean_ctor_set(n, 0, mantissa);
+        lean_ctor_set(n, 1, lean_uint64_to_nat(exponent));
+        object * r = lean_alloc_ctor(static_cast<unsigned>(json_kind::Num), 1, 0);
+        lean_ctor_set(r, 0, n);
+        return r;
+    }
+
+    object * parse_arr() {
+        object * elems = lean_alloc_array(0, 4);
+        if (!at_end() && *m_p == ']') {
+            m_p++;
+            skip_ws();
+            return elems;
+        }
+        while (true) {
+            object * v = parse_value();
+            if (!v) {
+                lean_dec(elems);
+                return nullptr;
+            }
+            elems = lean_array_push(elems, v);
+            char c = at_end() ? 0 : *m_p++;
+            skip_ws();
+            if (c == ']')
+                return elems;
+            if (c != ',') {
+                lean_dec(elems);
+                return nullptr;
+            }
+        }
+    }
+
+    object * parse_obj() {
+        object * kvs = lean_alloc_array(0, 4);
+        if (!at_end() && *m_p == '}') {
+            m_p++;
+            skip_ws();
+            return kvs;
+        }
+        while (true) {
+            object * k = nullptr;
+            object * v = nullptr;
+            if (!at_end() && *m_p == '"') {
+                m_p++;
+                k = parse_str();
+            }
+            if (k) {
+                skip_ws();
+                if (!at_end() && *m_p == ':') {
+                    m_p++;
+                    skip_ws();
+                    v = parse_value();
+                }
+            }
+            if (!v) {
+                if (k) lean_dec(k);
+                lean_dec(kvs);
+                return nullptr;
+            }
+            object * kv = lean_alloc_ctor(0, 2, 0);
+            lean_ctor_set(kv, 0, k);
+            lean_ctor_set(kv, 1, v);
+            kvs = lean_array_push(kvs, kv);
+            char c = at_end() ? 0 : *m_p++;
+            skip_ws();
+            if (c == '}')
+                return kvs;
+            if (c != ',') {
+                lean_dec(kvs);
+                return nullptr;
+            }
+        }
+    }
+
+public:
+    json_parser(char const * begin, char const * end):m_p(begin), m_end(end) {}
+
+    /* Parse a value and the whitespace following it, see `Lean.Json.Parser.anyCore`. */
+    object * parse_value() {
+        if (at_end())
+            return nullptr;
+        object * r = nullptr;
+        switch (*m_p) {
+        case '[': case '{': {
+            if (m_depth == g_json_max_depth)
+                return nullptr;
+            bool is_arr = *m_p == '[';
+            m_p++;
+            skip_ws();
+            m_depth++;
+            object * c = is_arr ? parse_arr() : parse_obj();
+            m_depth--;
+            if (!c)
+                return nullptr;
+            if (is_arr) {
+                r = lean_alloc_ctor(static_cast<unsigned>(json_kind::Arr), 1, 0);
+                lean_ctor_set(r, 0, c);
+            } else {
+                r = lean_json_mk_obj(c);
+            }
+            // `parse_arr`/`parse_obj` already skipped trailing whitespace
+            return r;
+        }
+        case '"': {
+            m_p++;
+            object * s = parse_str();
+            if (!s)
+                return nullptr;
+            r = lean_alloc_ctor(static_cast<unsigned>(json_kind::Str), 1, 0);
+            lean_ctor_set(r, 0, s);
+            break;
+        }
+        case 't': case 'f': {
+            bool b = *m_p == 't';
+            if (!skip_string(b ? "true" : "false"))
+                return nullptr;
+            r = lean_alloc_ctor(static_cast<unsigned>(json_kind::Bool), 0, 1);
+            lean_ctor_set_uint8(r, 0, b);
+            break;
+        }
+        case 'n':
+            if (!skip_string("null"))
+                return nullptr;
+            r = lean_box(static_cast<unsigned>(json_kind::Null));
+            break;
+        default:
+            if (*m_p != '-' && !is_digit(*m_p))
+                return nullptr;
+            r = parse_num();
+            if (!r)
+                return nullptr;
+            break;
+        }
+        skip_ws();
+        return r;
+    }
+
+    /* See `Lean.Json.Parser.any` */
+    object * parse() {
+        skip_ws();
+        object * r = parse_value();
+        if (r && !at_end()) {
+            lean_dec(r);
+            return nullptr;
+        }
+        return r;
+    }
+};
+
+/* Json.parseNative? (s : @& String) : Option Json */
+extern "C" LEAN_EXPORT object * lean_json_parse_native(b_obj_arg s) {
+    char const * begin = lean_string_cstr(s);
+    object * r = json_parser(begin, begin + lean_string_size(s) - 1).parse();
+    if (!r)
+        return lean_box(0);
+    object * some = lean_alloc_ctor(1, 1, 0);
+    lean_ctor_set(some, 0, r);
+    return some;
+}
+
+/* Printer following `Lean.Json.compress`. Nested values are processed with an explicit stack. */
+class json_printer {
+    struct frame {
+        bool     m_is_obj;
+        object * m_arr;       // array elements if `!m_is_obj`
+        size_t   m_i;
+        size_t   m_size;
+        size_t   m_kvs_begin; // object fields start at `m_kvs[m_kvs_begin]` if `m_is_obj`
+    };
+    std::string                                m_out;
+    std::vector<frame>                         m_stack;
+    std::vector<std::pair<object *, object *>> m_kvs;
+
+    /* See `Lean.Json.renderString` */
+    void print_str(b_obj_arg s) {
+        char const * p   = lean_string_cstr(s);
+        char const * end = p + lean_string_size(s) - 1;
+        m_out += '"';
+        while (true) {
+            char const * q = find_special(p, end);
+            m_out.append(p, q);
+            if (q == end)
+                break;
+            unsigned char c = *q;
+            switch (c) {
+            case '"':  m_out += "\\\""; break;
+            case '\\': m_out += "\\\\"; break;
+            case '\n': m_out += "\\n"; break;
+            case '\r': m_out += "\\r"; break;
+            default: {
+                char const * hex = "0123456789abcdef";
+                m_out += "\\u00";
+                m_out += hex[c >> 4];
+                m_out += hex[c & 0xf];
+            }
+            }
+            p = q + 1;
+        }
+        m_out += '"';
+    }
+
+    void print_num(b_obj_arg n) {
+        b_obj_arg m = lean_ctor_get(n, 0);
+        b_obj_arg e = lean_ctor_get(n, 1);
+        if (lean_is_scalar(m) && lean_is_scalar(e) && lean_unbox(e) == 0) {
+            m_out += std::to_string(lean_scalar_to_int64(m));
+        } else {
+            lean_inc(n);
+            object * s = lean_json_number_to_string(n);
+            m_out.append(lean_string_cstr(s), lean_string_size(s) - 1);
+            lean_dec(s);
+        }
+    }
+
+    /* Push the fields of the `RBNode` `n` in the order used by `compress`, i.e. by descending keys. */
+    void push_fields(b_obj_arg n) {
+        while (!lean_is_scalar(n)) {
+            // `RBNode.node color lchild key val rchild`
+            push_fields(lean_ctor_get(n, 3));
+            m_kvs.emplace_back(lean_ctor_get(n, 1), lean_ctor_get(n, 2));
+            n = lean_ctor_get(n, 0);
+        }
+    }
+
+    void print_value(b_obj_arg j) {
+        if (lean_is_scalar(j)) {
+            m_out += "null";
+            return;
+        }
+        switch (static_cast<json_kind>(lean_ptr_tag(j))) {
+        case json_kind::Null:
+            m_out += "null";
+            break;
+        case json_kind::Bool:
+            m_out += lean_ctor_get_uint8(j, 0) ? "true" : "false";
+            break;
+        case json_kind::Num:
+            print_num(lean_ctor_get(j, 0));
+            break;
+        case json_kind::Str:
+            print_str(lean_ctor_get(j, 0));
+            break;
+        case json_kind::Arr: {
+            object * elems = lean_ctor_get(j, 0);
+            m_out += '[';
+            m_stack.push_back(frame { false, elems, 0, lean_array_size(elems), 0 });
+            break;
+        }
+        case json_kind::Obj: {
+            size_t begin = m_kvs.size();
+            push_fields(lean_ctor_get(j, 0));
+            m_out += '{';
+            m_stack.push_back(frame { true, nullptr, 0, m_kvs.size() - begin, begin });
+            break;
+        }
+        }
+    }
+
+public:
+    object * print(b_obj_arg j) {
+        print_value(j);
+        while (!m_stack.empty()) {
+            frame & f = m_stack.back();
+            if (f.m_i == f.m_size) {
+                m_out += f.m_is_obj ? '}' : ']';
+                if (f.m_is_obj)
+                    m_kvs.resize(f.m_kvs_begin);
+                m_stack.pop_back();
+                continue;
+            }
+            if (f.m_i > 0)
+                m_out += ',';
+            object * v;
+            if (f.m_is_obj) {
+                auto const & kv = m_kvs[f.m_kvs_begin + f.m_i];
+                print_str(kv.first);
+                m_out += ':';
+                v = kv.second;
+            } else {
+                v = lean_array_get_core(f.m_arr, f.m_i);
+            }
+            f.m_i++;
+            // may invalidate `f`
+            print_value(v);
+        }
+        return lean_mk_string_from_bytes(m_out.data(), m_out.size());
+    }
+};
+
+/* Json.compress (j : @& Json) : String */
+extern "C" LEAN_EXPORT object * lean_json_compress(b_obj_arg j) {
+    return json_printer().print(j);
+}
+}
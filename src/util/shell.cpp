@@ -728,6 +728,7 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
 
         if (stats) {
             env.display_stats();
+            ir::display_interpreter_stats(std::cout);
         }
 
         if (run && ok) {
@@ -747,7 +748,7 @@ extern "C" LEAN_EXPORT int lean_main(int argc, char ** argv) {
                 return 1;
             }
             time_task _("C code generation", opts);
-            out << lean::ir::emit_c(env, *main_module_name).data();
+            out << lean::ir::emit_c(env, *main_module_name, opts).data();
             out.close();
         }
 
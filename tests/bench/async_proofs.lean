@@ -0,0 +1,228 @@
+/-!
+A proof-heavy file of independent theorems. Compare the elaboration time with and without
+`-DElab.async=true`, which elaborates the proofs in parallel.
+-/
+
+theorem omega_1 (a b c d : Nat) (h₁ : a + 1 < b) (h₂ : b + 2 * c ≤ d + 1) :
+    a + 2 * c + 1 < d + 1 + 1 := by
+  omega
+
+theorem decide_1 : (List.range 41).foldl (· + ·) 0 = 820 := by
+  decide
+
+theorem omega_2 (a b c d : Nat) (h₁ : a + 2 < b) (h₂ : b + 2 * c ≤ d + 2) :
+    a + 2 * c + 2 < d + 2 + 2 := by
+  omega
+
+theorem decide_2 : (List.range 42).foldl (· + ·) 0 = 861 := by
+  decide
+
+theorem omega_3 (a b c d : Nat) (h₁ : a + 3 < b) (h₂ : b + 2 * c ≤ d + 3) :
+    a + 2 * c + 3 < d + 3 + 3 := by
+  omega
+
+theorem decide_3 : (List.range 43).foldl (· + ·) 0 = 903 := by
+  decide
+
+theorem omega_4 (a b c d : Nat) (h₁ : a + 4 < b) (h₂ : b + 2 * c ≤ d + 4) :
+    a + 2 * c + 4 < d + 4 + 4 := by
+  omega
+
+theorem decide_4 : (List.range 44).foldl (· + ·) 0 = 946 := by
+  decide
+
+theorem omega_5 (a b c d : Nat) (h₁ : a + 5 < b) (h₂ : b + 2 * c ≤ d + 5) :
+    a + 2 * c + 5 < d + 5 + 5 := by
+  omega
+
+theorem decide_5 : (List.range 45).foldl (· + ·) 0 = 990 := by
+  decide
+
+theorem omega_6 (a b c d : Nat) (h₁ : a + 6 < b) (h₂ : b + 2 * c ≤ d + 6) :
+    a + 2 * c + 6 < d + 6 + 6 := by
+  omega
+
+theorem decide_6 : (List.range 46).foldl (· + ·) 0 = 1035 := by
+  decide
+
+theorem omega_7 (a b c d : Nat) (h₁ : a + 7 < b) (h₂ : b + 2 * c ≤ d + 7) :
+    a + 2 * c + 0 < d + 7 + 0 := by
+  omega
+
+theorem decide_7 : (List.range 47).foldl (· + ·) 0 = 1081 := by
+  decide
+
+theorem omega_8 (a b c d : Nat) (h₁ : a + 8 < b) (h₂ : b + 2 * c ≤ d + 8) :
+    a + 2 * c + 1 < d + 8 + 1 := by
+  omega
+
+theorem decide_8 : (List.range 48).foldl (· + ·) 0 = 1128 := by
+  decide
+
+theorem omega_9 (a b c d : Nat) (h₁ : a + 9 < b) (h₂ : b + 2 * c ≤ d + 9) :
+    a + 2 * c + 2 < d + 9 + 2 := by
+  omega
+
+theorem decide_9 : (List.range 49).foldl (· + ·) 0 = 1176 := by
+  decide
+
+theorem omega_10 (a b c d : Nat) (h₁ : a + 10 < b) (h₂ : b + 2 * c ≤ d + 10) :
+    a + 2 * c + 3 < d + 10 + 3 := by
+  omega
+
+theorem decide_10 : (List.range 50).foldl (· + ·) 0 = 1225 := by
+  decide
+
+theorem omega_11 (a b c d : Nat) (h₁ : a + 11 < b) (h₂ : b + 2 * c ≤ d + 11) :
+    a + 2 * c + 4 < d + 11 + 4 := by
+  omega
+
+theorem decide_11 : (List.range 51).foldl (· + ·) 0 = 1275 := by
+  decide
+
+theorem omega_12 (a b c d : Nat) (h₁ : a + 12 < b) (h₂ : b + 2 * c ≤ d + 12) :
+    a + 2 * c + 5 < d + 12 + 5 := by
+  omega
+
+theorem decide_12 : (List.range 52).foldl (· + ·) 0 = 1326 := by
+  decide
+
+theorem omega_13 (a b c d : Nat) (h₁ : a + 13 < b) (h₂ : b + 2 * c ≤ d + 13) :
+    a + 2 * c + 6 < d + 13 + 6 := by
+  omega
+
+theorem decide_13 : (List.range 53).foldl (· + ·) 0 = 1378 := by
+  decide
+
+theorem omega_14 (a b c d : Nat) (h₁ : a + 14 < b) (h₂ : b + 2 * c ≤ d + 14) :
+    a + 2 * c + 0 < d + 14 + 0 := by
+  omega
+
+theorem decide_14 : (List.range 54).foldl (· + ·) 0 = 1431 := by
+  decide
+
+theorem omega_15 (a b c d : Nat) (h₁ : a + 15 < b) (h₂ : b + 2 * c ≤ d + 15) :
+    a + 2 * c + 1 < d + 15 + 1 := by
+  omega
+
+theorem decide_15 : (List.range 55).foldl (· + ·) 0 = 1485 := by
+  decide
+
+theorem omega_16 (a b c d : Nat) (h₁ : a + 16 < b) (h₂ : b + 2 * c ≤ d + 16) :
+    a + 2 * c + 2 < d + 16 + 2 := by
+  omega
+
+theorem decide_16 : (List.range 56).foldl (· + ·) 0 = 1540 := by
+  decide
+
+theorem omega_17 (a b c d : Nat) (h₁ : a + 17 < b) (h₂ : b + 2 * c ≤ d + 17) :
+    a + 2 * c + 3 < d + 17 + 3 := by
+  omega
+
+theorem decide_17 : (List.range 57).foldl (· + ·) 0 = 1596 := by
+  decide
+
+theorem omega_18 (a b c d : Nat) (h₁ : a + 18 < b) (h₂ : b + 2 * c ≤ d + 18) :
+    a + 2 * c + 4 < d + 18 + 4 := by
+  omega
+
+theorem decide_18 : (List.range 58).foldl (· + ·) 0 = 1653 := by
+  decide
+
+theorem omega_19 (a b c d : Nat) (h₁ : a + 19 < b) (h₂ : b + 2 * c ≤ d + 19) :
+    a + 2 * c + 5 < d + 19 + 5 := by
+  omega
+
+theorem decide_19 : (List.range 59).foldl (· + ·) 0 = 1711 := by
+  decide
+
+theorem omega_20 (a b c d : Nat) (h₁ : a + 20 < b) (h₂ : b + 2 * c ≤ d + 20) :
+    a + 2 * c + 6 < d + 20 + 6 := by
+  omega
+
+theorem decide_20 : (List.range 60).foldl (· + ·) 0 = 1770 := by
+  decide
+
+theorem omega_21 (a b c d : Nat) (h₁ : a + 21 < b) (h₂ : b + 2 * c ≤ d + 21) :
+    a + 2 * c + 0 < d + 21 + 0 := by
+  omega
+
+theorem decide_21 : (List.range 61).foldl (· + ·) 0 = 1830 := by
+  decide
+
+theorem omega_22 (a b c d : Nat) (h₁ : a + 22 < b) (h₂ : b + 2 * c ≤ d + 22) :
+    a + 2 * c + 1 < d + 22 + 1 := by
+  omega
+
+theorem decide_22 : (List.range 62).foldl (· + ·) 0 = 1891 := by
+  decide
+
+theorem omega_23 (a b c d : Nat) (h₁ : a + 23 < b) (h₂ : b + 2 * c ≤ d + 23) :
+    a + 2 * c + 2 < d + 23 + 2 := by
+  omega
+
+theorem decide_23 : (List.range 63).foldl (· + ·) 0 = 1953 := by
+  decide
+
+theorem omega_24 (a b c d : Nat) (h₁ : a + 24 < b) (h₂ : b + 2 * c ≤ d + 24) :
+    a + 2 * c + 3 < d + 24 + 3 := by
+  omega
+
+theorem decide_24 : (List.range 64).foldl (· + ·) 0 = 2016 := by
+  decide
+
+theorem omega_25 (a b c d : Nat) (h₁ : a + 25 < b) (h₂ : b + 2 * c ≤ d + 25) :
+    a + 2 * c + 4 < d + 25 + 4 := by
+  omega
+
+theorem decide_25 : (List.range 65).foldl (· + ·) 0 = 2080 := by
+  decide
+
+theorem omega_26 (a b c d : Nat) (h₁ : a + 26 < b) (h₂ : b + 2 * c ≤ d + 26) :
+    a + 2 * c + 5 < d + 26 + 5 := by
+  omega
+
+theorem decide_26 : (List.range 66).foldl (· + ·) 0 = 2145 := by
+  decide
+
+theorem omega_27 (a b c d : Nat) (h₁ : a + 27 < b) (h₂ : b + 2 * c ≤ d + 27) :
+    a + 2 * c + 6 < d + 27 + 6 := by
+  omega
+
+theorem decide_27 : (List.range 67).foldl (· + ·) 0 = 2211 := by
+  decide
+
+theorem omega_28 (a b c d : Nat) (h₁ : a + 28 < b) (h₂ : b + 2 * c ≤ d + 28) :
+    a + 2 * c + 0 < d + 28 + 0 := by
+  omega
+
+theorem decide_28 : (List.range 68).foldl (· + ·) 0 = 2278 := by
+  decide
+
+theorem omega_29 (a b c d : Nat) (h₁ : a + 29 < b) (h₂ : b + 2 * c ≤ d + 29) :
+    a + 2 * c + 1 < d + 29 + 1 := by
+  omega
+
+theorem decide_29 : (List.range 69).foldl (· + ·) 0 = 2346 := by
+  decide
+
+theorem omega_30 (a b c d : Nat) (h₁ : a + 30 < b) (h₂ : b + 2 * c ≤ d + 30) :
+    a + 2 * c + 2 < d + 30 + 2 := by
+  omega
+
+theorem decide_30 : (List.range 70).foldl (· + ·) 0 = 2415 := by
+  decide
+
+theorem omega_31 (a b c d : Nat) (h₁ : a + 31 < b) (h₂ : b + 2 * c ≤ d + 31) :
+    a + 2 * c + 3 < d + 31 + 3 := by
+  omega
+
+theorem decide_31 : (List.range 71).foldl (· + ·) 0 = 2485 := by
+  decide
+
+theorem omega_32 (a b c d : Nat) (h₁ : a + 32 < b) (h₂ : b + 2 * c ≤ d + 32) :
+    a + 2 * c + 4 < d + 32 + 4 := by
+  omega
+
+theorem decide_32 : (List.range 72).foldl (· + ·) 0 = 2556 := by
+  decide
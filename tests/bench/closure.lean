@@ -0,0 +1,44 @@
+/-!
+Exercises `lean_apply_*` on closures: partial applications that are extended one argument at a
+time, over-applications of functions returning closures, and a monad transformer stack.
+-/
+
+@[noinline] def add3 (a b c : Nat) : Nat := a + b + c
+
+-- Each application extends the partial application created by the previous one.
+@[noinline] def applyCurried (f : Nat → Nat → Nat → Nat) (i : Nat) : Nat :=
+  let g := f i
+  let h := g (i + 1)
+  h (i + 2)
+
+@[noinline] def pick (b : Bool) : Nat → Nat :=
+  if b then (· + 1) else (· * 2)
+
+-- `f` has arity one, so this is an over-application.
+@[noinline] def applyOver (f : Bool → Nat → Nat) (i : Nat) : Nat :=
+  f (i % 3 == 0) i
+
+abbrev M := StateT Nat (ReaderT Nat (ExceptT String Id))
+
+@[noinline] def step (i : Nat) : M Unit := do
+  let k ← read
+  modify (· + i % k)
+
+def loop (n : Nat) : M Unit := do
+  for i in [0:n] do
+    step i
+
+def main : List String → IO UInt32
+  | [n] => do
+    let n := n.toNat!
+    let mut curried := 0
+    let mut over := 0
+    for i in [0:n] do
+      curried := curried + applyCurried add3 i
+      over := over + applyOver pick i
+    IO.println s!"curried: {curried}, over-applied: {over}"
+    match (loop n).run 0 |>.run 7 |>.run with
+    | .ok ((), s) => IO.println s!"state: {s}"
+    | .error e => throw <| IO.userError e
+    return 0
+  | _ => return 1
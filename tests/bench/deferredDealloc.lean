@@ -0,0 +1,38 @@
+import Lean.Data.RBMap
+
+/-!
+A request loop that replaces a large persistent map shared with other threads on every request,
+as the language server does with document snapshots. Dropping the previous map frees it on the
+request thread unless deferred deallocation is enabled. Request latency percentiles are printed
+to stderr.
+-/
+
+open Lean
+
+def mkMap (seed n : Nat) : RBMap Nat Nat compare := Id.run do
+  let mut m := {}
+  for i in [0:n] do
+    m := m.insert i (i + seed)
+  return m
+
+def main : List String → IO UInt32
+  | [mode, requests, size] => do
+    IO.setDeferredDealloc (mode == "on")
+    let n := size.toNat!
+    let mut state := mkMap 0 n
+    let mut sum := 0
+    let mut latencies : Array Nat := #[]
+    for r in [1:requests.toNat! + 1] do
+      -- built by another thread, so it is marked as multi-threaded
+      let next := (Task.spawn fun _ => mkMap r n).get
+      let start ← IO.monoNanosNow
+      sum := sum + (state.find? r).getD 0
+      state := next
+      let stop ← IO.monoNanosNow
+      latencies := latencies.push ((stop - start) / 1000)
+    let latencies := latencies.qsort (· < ·)
+    let percentile (p : Nat) := latencies[latencies.size * p / 100]!
+    IO.eprintln s!"latency (us): p50 {percentile 50}, p90 {percentile 90}, p99 {percentile 99}, max {latencies.back!}"
+    IO.println s!"sum: {sum}"
+    return 0
+  | _ => return 1
@@ -0,0 +1,62 @@
+import Lean.Data.HashMap
+import Lean.Data.FlatHashMap
+/-!
+Inserts and looks up `Nat` and `Name` keys in a `HashMap` and in a `FlatHashMap`, an open-addressing
+hash map implemented in the runtime.
+-/
+open Lean
+
+def names (n : Nat) : Array Name := Id.run do
+  let mut ns := Array.mkEmpty n
+  for i in [0:n] do
+    ns := ns.push <| (`Lean.Meta).str s!"decl{i / 16}" |>.str s!"eq_{i % 16}"
+  return ns
+
+def time (msg : String) (act : IO α) : IO α := do
+  let start ← IO.monoMsNow
+  let a ← act
+  IO.eprintln s!"{msg}: {(← IO.monoMsNow) - start}ms"
+  return a
+
+def benchHashMap [BEq α] [Hashable α] (msg : String) (keys : Array α) (iters : Nat) : IO Nat := do
+  let m ← time s!"{msg}: HashMap insert" do
+    let mut m : HashMap α Nat := {}
+    for _ in [0:iters] do
+      m := {}
+      for h : i in [0:keys.size] do
+        m := m.insert keys[i] i
+    return m
+  time s!"{msg}: HashMap find" do
+    let mut found := 0
+    for _ in [0:iters] do
+      for k in keys do
+        if let some i := m.find? k then found := found + i
+    return found
+
+def benchFlatHashMap [BEq α] [Hashable α] (msg : String) (keys : Array α) (iters : Nat) : IO Nat := do
+  let m ← time s!"{msg}: FlatHashMap insert" do
+    let mut m : FlatHashMap α Nat := {}
+    for _ in [0:iters] do
+      m := {}
+      for h : i in [0:keys.size] do
+        m := m.insert keys[i] i
+    return m
+  time s!"{msg}: FlatHashMap find" do
+    let mut found := 0
+    for _ in [0:iters] do
+      for k in keys do
+        if let some i := m.find? k then found := found + i
+    return found
+
+def main : List String → IO UInt32
+  | [n, iters] => do
+    let n := n.toNat!
+    let iters := iters.toNat!
+    let nats := Array.range n |>.map (· * 7919)
+    let ns := names n
+    let r₁ ← benchHashMap "Nat" nats iters
+    let r₂ ← benchFlatHashMap "Nat" nats iters
+    let r₃ ← benchHashMap "Name" ns iters
+    let r₄ ← benchFlatHashMap "Name" ns iters
+    return if r₁ == r₂ && r₃ == r₄ then 0 else 1
+  | _ => return 1
@@ -0,0 +1,65 @@
+import Lean.Data.Lsp
+/-!
+Renders and parses the kinds of messages that dominate language server traffic: large semantic token responses,
+diagnostics of big files and the recorded `initialize` request of `server_startup.log`. Compares the native
+`Json.compress` and `Json.parse` with their reference implementations in Lean.
+-/
+open Lean Lsp
+
+def semanticTokens (n : Nat) : Json := Id.run do
+  let mut data := Array.mkEmpty (5 * n)
+  for i in [0:n] do
+    data := data ++ #[i % 3, (7 * i) % 80, 1 + i % 12, i % 23, 0]
+  return Json.mkObj [("jsonrpc", "2.0"), ("id", 17), ("result", toJson ({ data } : SemanticTokens))]
+
+def diagnostics (n : Nat) : Json := Id.run do
+  let mut diags := #[]
+  for i in [0:n] do
+    let range : Range := ⟨⟨i, 2⟩, ⟨i, 30⟩⟩
+    diags := diags.push ({
+      range, severity? := some .error, source? := some "Lean 4"
+      message := s!"type mismatch\n  h{i}\nhas type\n  a = b : Prop\nbut is expected to have type\n  ∀ (x : α), x ∈ s → f x ≤ g x : Prop"
+    } : Diagnostic)
+  return Json.mkObj [("jsonrpc", "2.0"), ("method", "textDocument/publishDiagnostics"), ("params", toJson ({
+      uri := "file:///home/user/project/Project/Basic.lean", version? := some 3, diagnostics := diags
+    } : PublishDiagnosticsParams))]
+
+def recordedInitialize : IO Json := do
+  let log ← IO.FS.readFile "server_startup.log"
+  let some body := log.splitOn "\r\n\r\n" |>.get? 1 | throw <| .userError "invalid log"
+  IO.ofExcept <| Json.parse body
+
+def time (msg : String) (act : IO α) : IO α := do
+  let start ← IO.monoMsNow
+  let a ← act
+  IO.eprintln s!"{msg}: {(← IO.monoMsNow) - start}ms"
+  return a
+
+def parseRef (s : String) : Except String Json :=
+  match Json.Parser.any s.mkIterator with
+  | .success _ res => .ok res
+  | .error _ err => .error err
+
+def main : List String → IO UInt32
+  | [iters] => do
+    let msgs := #[semanticTokens 20000, diagnostics 2000, ← recordedInitialize]
+    let n := iters.toNat!
+    let sizes ← time "native" do
+      let mut size := 0
+      for _ in [0:n] do
+        for msg in msgs do
+          let s := msg.compress
+          let some j := Json.parse s |>.toOption | throw <| .userError "parse error"
+          size := size + s.utf8ByteSize + (if j == msg then 0 else 1)
+      return size
+    let sizes' ← time "reference" do
+      let mut size := 0
+      for _ in [0:n] do
+        for msg in msgs do
+          let s := Json.compressCore "" [.json msg]
+          let some j := parseRef s |>.toOption | throw <| .userError "parse error"
+          size := size + s.utf8ByteSize + (if j == msg then 0 else 1)
+      return size
+    IO.println s!"{sizes} bytes, same as reference: {sizes == sizes'}"
+    return 0
+  | _ => return 1
@@ -0,0 +1,55 @@
+import Lean.Data.PersistentHashMap
+import Lean.Data.CompactPersistentHashMap
+/-!
+Inserts, looks up and erases `Name` keys shaped like those of the environment in a
+`PersistentHashMap` and in a `CompactPersistentHashMap`, whose nodes are implemented in the runtime.
+Some older versions of the maps are kept alive so that not all updates can be done in place.
+-/
+open Lean
+
+def names (n : Nat) : Array Name := Id.run do
+  let mut ns := Array.mkEmpty n
+  for i in [0:n] do
+    ns := ns.push <| (`Lean.Meta).str s!"decl{i / 16}" |>.str s!"eq_{i % 16}"
+  return ns
+
+def time (msg : String) (act : IO α) : IO α := do
+  let start ← IO.monoMsNow
+  let a ← act
+  IO.eprintln s!"{msg}: {(← IO.monoMsNow) - start}ms"
+  return a
+
+def main : List String → IO UInt32
+  | [n, iters] => do
+    let ns := names n.toNat!
+    let iters := iters.toNat!
+    let r₁ ← time "PersistentHashMap" do
+      let mut found := 0
+      for _ in [0:iters] do
+        let mut m : PHashMap Name Nat := {}
+        let mut old := #[]
+        for h : i in [0:ns.size] do
+          m := m.insert ns[i] i
+          if i % 1000 == 0 then old := old.push m
+        for name in ns do
+          if m.contains name then found := found + 1
+        for h : i in [0:ns.size] do
+          if i % 2 == 0 then m := m.erase ns[i]
+        found := found + m.size + old.size
+      return found
+    let r₂ ← time "CompactPersistentHashMap" do
+      let mut found := 0
+      for _ in [0:iters] do
+        let mut m : CPHashMap Name Nat := {}
+        let mut old := #[]
+        for h : i in [0:ns.size] do
+          m := m.insert ns[i] i
+          if i % 1000 == 0 then old := old.push m
+        for name in ns do
+          if m.contains name then found := found + 1
+        for h : i in [0:ns.size] do
+          if i % 2 == 0 then m := m.erase ns[i]
+        found := found + m.size + old.size
+      return found
+    return if r₁ == r₂ then 0 else 1
+  | _ => return 1
@@ -0,0 +1,48 @@
+import Lean.Data.Lsp
+open IO Lean Lsp
+
+/-!
+Latency of the file worker when editing the end of a file with about 3000 lines: after each edit,
+waits for the diagnostics and then requests the semantic tokens of the full file, as a client does
+in response to `workspace/semanticTokens/refresh`.
+-/
+
+def mkFile (n : Nat) : String := Id.run do
+  let mut s := ""
+  for i in [0:n] do
+    s := s ++ s!"def f{i} (x y : Nat) : Nat :=\n  let z := x + y * {i}\n  z + x.succ\n\n"
+    if i % 50 == 0 then
+      s := s ++ s!"#eval f{i} 1 2\n\n"
+  return s
+
+def main (args : List String) : IO Unit := do
+  let edits := args.head!.toNat!
+  let uri := "file:///server_edit.lean"
+  let text := mkFile 750
+  Ipc.runWith (←IO.appPath) #["--server"] do
+    Ipc.writeRequest ⟨0, "initialize", { capabilities := {} : InitializeParams }⟩
+    let _ ← Ipc.readResponseAs 0 InitializeResult
+    Ipc.writeNotification ⟨"initialized", InitializedParams.mk⟩
+    Ipc.writeNotification ⟨"textDocument/didOpen", {
+      textDocument := { uri, languageId := "lean", version := 1, text } : DidOpenTextDocumentParams }⟩
+    let _ ← Ipc.collectDiagnostics 1 uri 1
+    Ipc.writeRequest ⟨2, "textDocument/semanticTokens/full", { textDocument := { uri } : SemanticTokensParams }⟩
+    let mut resultId := (← Ipc.readResponseAs 2 SemanticTokens).result.resultId?.getD ""
+    let mut requestNo : Nat := 3
+    let mut line := text.foldl (fun n c => if c == '\n' then n + 1 else n) 0
+    for i in [0:edits] do
+      let version := i + 2
+      Ipc.writeNotification ⟨"textDocument/didChange", {
+        textDocument := { uri, version? := version }
+        contentChanges := #[.rangeChange ⟨⟨line, 0⟩, ⟨line, 0⟩⟩ s!"def g{i} := f{i} {i} {i}\n"]
+        : DidChangeTextDocumentParams }⟩
+      line := line + 1
+      let _ ← Ipc.collectDiagnostics requestNo uri version
+      let tokensRequestNo := requestNo + 1
+      Ipc.writeRequest ⟨tokensRequestNo, "textDocument/semanticTokens/full/delta", {
+        textDocument := { uri }, previousResultId := resultId : SemanticTokensDeltaParams }⟩
+      match (← Ipc.readResponseAs tokensRequestNo SemanticTokensDeltaResult).result with
+      | .full tokens => resultId := tokens.resultId?.getD ""
+      | .delta delta => resultId := delta.resultId?.getD ""
+      requestNo := requestNo + 2
+    Ipc.shutdown requestNo
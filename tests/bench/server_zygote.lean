@@ -0,0 +1,69 @@
+import Lean.Data.Lsp
+open IO Lean Lsp
+
+/-!
+Opens a number of files with the same imports and reports the time until all of them have been
+elaborated as well as the total proportional set size (PSS) of all server processes afterwards.
+Run with `LEAN_SERVER_ZYGOTE=1` to compare against workers forked from a shared zygote.
+The memory measurement uses `/proc` and is only available on Linux.
+-/
+
+/-- Returns the parent process ids of all processes. -/
+def parentPids : IO (Array (Nat × Nat)) := do
+  let mut res := #[]
+  for entry in ← System.FilePath.readDir "/proc" do
+    let some pid := entry.fileName.toNat?
+      | continue
+    try
+      let stat ← FS.readFile (entry.path / "stat")
+      -- `pid (comm) state ppid ...`, where `comm` may contain spaces and parentheses
+      let fields := (stat.drop ((stat.revPosOf ')').get!.byteIdx + 2)).splitOn " "
+      res := res.push (pid, fields[1]!.toNat!)
+    catch _ =>
+      -- process exited in the meantime
+      continue
+  return res
+
+/-- Returns the PSS of `pid` in bytes. -/
+def pss (pid : Nat) : IO Nat := do
+  let mut total := 0
+  for line in (← FS.readFile s!"/proc/{pid}/smaps_rollup").splitOn "\n" do
+    if line.startsWith "Pss:" then
+      total := total + ((line.drop 4).trim.takeWhile Char.isDigit).toNat!
+  return total * 1024
+
+/-- Returns the total PSS of all descendants of `pid` in bytes. -/
+partial def descendantsPss (pid : Nat) : IO Nat := do
+  let ppids ← parentPids
+  let rec go (pid : Nat) : IO Nat := do
+    let mut total := 0
+    for (child, parent) in ppids do
+      if parent == pid then
+        total := total + (← go child)
+        try total := total + (← pss child) catch _ => pure ()
+    return total
+  go pid
+
+def main (args : List String) : IO Unit := do
+  let numFiles := args.head!.toNat!
+  Ipc.runWith (←IO.appPath) #["--server"] do
+    Ipc.writeRequest ⟨0, "initialize", { capabilities := {} : InitializeParams }⟩
+    let _ ← Ipc.readResponseAs 0 InitializeResult
+    Ipc.writeNotification ⟨"initialized", InitializedParams.mk⟩
+    let start ← IO.monoMsNow
+    let uris := (List.range numFiles).map (s!"file:///server_zygote{·}.lean")
+    for uri in uris, i in [0:numFiles] do
+      Ipc.writeNotification ⟨"textDocument/didOpen", {
+        textDocument := {
+          uri, languageId := "lean", version := 1
+          text := s!"import Lean\nopen Lean Elab\n\ndef x{i} : MetaM Nat := pure {i}\n#eval x{i}\n"
+        } : DidOpenTextDocumentParams }⟩
+    for uri in uris, i in [0:numFiles] do
+      let _ ← Ipc.collectDiagnostics (i + 1 : Nat) uri 1
+    let stop ← IO.monoMsNow
+    IO.println s!"'worker startup': {(stop - start).toFloat / 1000}"
+    if System.Platform.isOSX || System.Platform.isWindows then
+      IO.eprintln "PSS measurement is only supported on Linux"
+    else
+      IO.println s!"'server pss': {← descendantsPss (← IO.Process.getPID).toNat}"
+    Ipc.shutdown (numFiles + 1)
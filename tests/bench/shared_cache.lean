@@ -0,0 +1,36 @@
+import Lean
+/-!
+Many declarations that solve the same closed `whnf` and `isDefEq` problems. Run with
+`-Dmeta.sharedCache=true` to share the results between declarations. The statements only use
+imported constants, as results for terms containing constants of the current module are not shared.
+-/
+open Lean Meta
+
+/--
+Proves `n` statements about the same lists by `decide`, which share some subproblems but differ in
+the constant `i`, and `n` statements that are identical.
+-/
+macro "gen_theorems " n:num : command => do
+  let mut cmds := #[]
+  for i in [0:n.getNat] do
+    let t := mkIdent (Name.mkSimple s!"t{i}")
+    let u := mkIdent (Name.mkSimple s!"u{i}")
+    let i := Syntax.mkNumLit (toString i)
+    cmds := cmds.push (← `(theorem $t : ((List.range 40).map (· + $i)).length = 40 := by decide))
+    cmds := cmds.push (← `(theorem $u : (List.range 40).foldl (· + ·) 0 = 780 := by decide))
+  return ⟨mkNullNode cmds⟩
+
+gen_theorems 100
+
+example : (List.replicate 40 (1 : Fin 10)).length = 40 := by decide
+example : (List.replicate 40 (1 : Fin 10)).length ≥ 40 := by decide
+example : (List.replicate 40 (1 : Fin 10)).length ≤ 40 := by decide
+example : (List.replicate 40 (1 : Fin 10)).length ≠ 39 := by decide
+
+example : ((List.range 40).map (fun (i : Nat) => (i : Int))).length = 40 := by decide
+example : ((List.range 40).map (fun (i : Nat) => (i : Int))).length ≥ 40 := by decide
+example : ((List.range 40).map (fun (i : Nat) => (i : Int))).length ≤ 40 := by decide
+
+#eval show IO Unit from do
+  IO.println s!"whnf: {← sharedWhnfCache.getStats}"
+  IO.println s!"isDefEq: {← sharedDefEqCache.getStats}"
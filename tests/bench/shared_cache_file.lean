@@ -0,0 +1,52 @@
+import Lean
+/-!
+Elaborates a large file of the standard library without and with `meta.sharedCache`, reporting the
+median wall-clock time of both settings and the hit rates of the shared caches. The settings are run
+alternately and in alternating order, after an unmeasured run that loads the imports into the OS
+caches. Each run imports the file's dependencies again, so its fingerprint differs from that of the
+previous run and the shared caches start empty.
+-/
+open Lean Elab Meta
+
+def elabFile (fileName : System.FilePath) (opts : Options) : IO Nat := do
+  let input ← IO.FS.readFile fileName
+  let start ← IO.monoMsNow
+  let (_, ok) ← runFrontend input opts fileName.toString `SharedCacheFile
+  unless ok do
+    throw <| IO.userError s!"{fileName} contains errors"
+  return (← IO.monoMsNow) - start
+
+def hitRate (stats : SharedCache.Stats) : Nat :=
+  let total := stats.hits + stats.misses
+  if total == 0 then 0 else stats.hits * 100 / total
+
+def median (times : Array Nat) : Nat :=
+  let times := times.qsort (· < ·)
+  times[times.size / 2]!
+
+def main (args : List String) : IO Unit := do
+  let fileName := args.head?.getD "../../src/Init/Data/List/Lemmas.lean"
+  let rounds := args[1]? >>= String.toNat? |>.getD 3
+  initSearchPath (← findSysroot)
+  let off : Options := {}
+  let on := meta.sharedCache.set {} true
+  discard <| elabFile fileName off
+  let mut timesOff := #[]
+  let mut timesOn := #[]
+  for i in [0:rounds] do
+    if i % 2 == 0 then
+      timesOff := timesOff.push (← elabFile fileName off)
+      timesOn := timesOn.push (← elabFile fileName on)
+    else
+      timesOn := timesOn.push (← elabFile fileName on)
+      timesOff := timesOff.push (← elabFile fileName off)
+  let whnf ← sharedWhnfCache.getStats
+  let defEq ← sharedDefEqCache.getStats
+  IO.println s!"wall-clock without meta.sharedCache (ms): {median timesOff}"
+  IO.println s!"wall-clock with meta.sharedCache (ms): {median timesOn}"
+  IO.eprintln s!"all runs without: {timesOff}, with: {timesOn}"
+  IO.println s!"whnf hit rate (%): {hitRate whnf}"
+  -- every run but the first resets the caches once for its new imports
+  IO.println s!"whnf resets per run: {(whnf.resets - (rounds - 1)) / rounds}"
+  IO.println s!"isDefEq hit rate (%): {hitRate defEq}"
+  IO.println s!"isDefEq resets per run: {(defEq.resets - (rounds - 1)) / rounds}"
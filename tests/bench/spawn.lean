@@ -0,0 +1,17 @@
+/-!
+Spawns many short-lived processes from a process with a large heap, as language servers and
+build drivers do. With `fork`, every spawn has to copy the page tables of the whole heap.
+-/
+
+def main : List String → IO UInt32
+  | [heapMB, n] => do
+    -- keep about `heapMB` MB of live objects around while spawning: a pointer and a list cell per element
+    let heap := (Array.range (heapMB.toNat! * 1024 * 1024 / 32)).map ([·])
+    let mut failed := 0
+    for _ in [0:n.toNat!] do
+      let child ← IO.Process.spawn { cmd := "true" }
+      if (← child.wait) != 0 then
+        failed := failed + 1
+    IO.println s!"heap size: {heap.size}, failed spawns: {failed}"
+    return 0
+  | _ => return 1
@@ -0,0 +1,30 @@
+import Lean
+
+/-!
+Startup time of a binary that links the `Lean` package. The children do no work, so their run time
+is dominated by the initialization of all imported modules and of the closed terms of this module.
+Build with `LEAN_OPTS=-Dcompiler.lazyClosedTerms=true` to initialize the closed terms of this module
+on first use instead.
+-/
+
+open Lean in
+/-- Defines `n` functions that each contain a closed term, which is extracted by the compiler. -/
+macro "gen_closed_terms " n:num : command => do
+  let mut cmds := #[]
+  for i in [0:n.getNat] do
+    let f := mkIdent (Name.mkSimple s!"table{i}")
+    cmds := cmds.push (← `(def $f (j : Nat) : Nat := ((List.range 1000).toArray.map (· + $(Syntax.mkNumLit (toString i))))[j]!))
+  return ⟨mkNullNode cmds⟩
+
+gen_closed_terms 200
+
+def main : List String → IO UInt32
+  | [n] => do
+    let self ← IO.appPath
+    for _ in [0:n.toNat!] do
+      let out ← IO.Process.output { cmd := self.toString }
+      if out.exitCode != 0 then
+        throw <| IO.userError s!"child failed: {out.stderr}"
+    IO.println s!"started {n} times, {table0 1 + table199 1}"
+    return 0
+  | _ => return 0
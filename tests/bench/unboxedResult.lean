@@ -0,0 +1,46 @@
+/-!
+Numeric kernels whose inner functions return pairs of scalars. Such functions are compiled to workers returning
+their results unboxed, so the kernels run without allocating.
+-/
+
+/-- One step of the Mandelbrot iteration `z := z^2 + c` on complex numbers. -/
+@[noinline] def step (zr zi cr ci : Float) : Float × Float :=
+  (zr * zr - zi * zi + cr, 2 * zr * zi + ci)
+
+def escapes (zr zi cr ci : Float) : Nat → Bool
+  | 0 => false
+  | n+1 =>
+    let (zr, zi) := step zr zi cr ci
+    zr * zr + zi * zi > 4 || escapes zr zi cr ci n
+
+def mandelbrot (size maxIter : Nat) : Nat := Id.run do
+  let mut inside := 0
+  for y in [0:size] do
+    for x in [0:size] do
+      let cr := 3 * x.toFloat / size.toFloat - 2
+      let ci := 3 * y.toFloat / size.toFloat - 1.5
+      unless escapes 0 0 cr ci maxIter do
+        inside := inside + 1
+  return inside
+
+@[noinline] def divMod (a b : UInt64) : UInt64 × UInt64 :=
+  (a / b, a % b)
+
+partial def digitSumOf (a acc : UInt64) : UInt64 :=
+  if a == 0 then acc else
+    let (q, r) := divMod a 10
+    digitSumOf q (acc + r)
+
+/-- Sum of the decimal digits of all numbers below `n`. -/
+def digitSum (n : Nat) : UInt64 := Id.run do
+  let mut sum := 0
+  for i in [0:n] do
+    sum := digitSumOf i.toUInt64 sum
+  return sum
+
+def main : List String → IO UInt32
+  | [size, n] => do
+    IO.println s!"mandelbrot: {mandelbrot size.toNat! 100}"
+    IO.println s!"digit sum: {digitSum n.toNat!}"
+    return 0
+  | _ => return 1
@@ -0,0 +1,37 @@
+/-!
+Walks a synthetic source tree of about the size of Mathlib (`dirs` directories with `files`
+source files each, plus build artifacts), as done by source discovery and the language server,
+comparing `FilePath.walkDir` with the native `FilePath.walkDirEntries`.
+-/
+open System IO.FS
+
+def mkTree (root : FilePath) (dirs files : Nat) : IO Unit := do
+  for d in [0:dirs] do
+    -- three levels of nesting, like `Mathlib/Algebra/Group/Basic.lean`
+    let dir := root / s!"D{d % 8}" / s!"E{d % 64}" / s!"F{d}"
+    createDirAll dir
+    for f in [0:files] do
+      writeFile (dir / s!"File{f}.lean") ""
+      writeFile (dir / s!"File{f}.olean") ""
+
+def time (msg : String) (act : IO α) : IO α := do
+  let start ← IO.monoMsNow
+  let a ← act
+  IO.eprintln s!"{msg}: {(← IO.monoMsNow) - start}ms"
+  return a
+
+def main : List String → IO UInt32
+  | [dirs, files] => do
+    let root : FilePath := "walkDir.tmp"
+    if ← root.pathExists then removeDirAll root
+    mkTree root dirs.toNat! files.toNat!
+    let ps ← time "walkDir" do
+      return (← root.walkDir).filter (·.extension == some "lean")
+    let es ← time "walkDirEntries" do
+      root.walkDirEntries { extensions := #["lean"], includeDirs := false }
+    let es' ← time "walkDirEntries with metadata" do
+      root.walkDirEntries { extensions := #["lean"], includeDirs := false, metadata := true }
+    IO.println s!"walkDir: {ps.size}, walkDirEntries: {es.size}, with metadata: {es'.size}"
+    removeDirAll root
+    return 0
+  | _ => return 1
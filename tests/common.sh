@@ -24,8 +24,17 @@ function lean_has_llvm_support {
     lean --features | grep -q "LLVM"
 }
 
+# Additional options for `lean` are taken from `LEAN_OPTS` or from the file `$f.lean_opts`.
+function lean_opts {
+    if [ -f "$f.lean_opts" ]; then
+        cat "$f.lean_opts"
+    else
+        echo "${LEAN_OPTS-}"
+    fi
+}
+
 function compile_lean_c_backend {
-    lean --c="$f.c" "$f" || fail "Failed to compile $f into C file"
+    lean $(lean_opts) --c="$f.c" "$f" || fail "Failed to compile $f into C file"
     leanc ${LEANC_OPTS-} -O3 -DNDEBUG -o "$f.out" "$@" "$f.c" || fail "Failed to compile C file $f.c"
 }
 
@@ -34,7 +43,7 @@ function compile_lean_llvm_backend {
     rm "*.ll" || true # remove debugging files.
     rm "*.bc" || true # remove bitcode files
     rm "*.o" || true # remove object files
-    lean --bc="$f.linked.bc" "$f" || fail "Failed to compile $f into bitcode file"
+    lean $(lean_opts) --bc="$f.linked.bc" "$f" || fail "Failed to compile $f into bitcode file"
     leanc ${LEANC_OPTS-} -O3 -DNDEBUG -o "$f.out" "$@" "$f.linked.bc" || fail "Failed to link object file '$f.linked.bc'"
     set +o xtrace
 }
@@ -0,0 +1,22 @@
+-- exported functions are compiled with inferred borrow annotations and called through a wrapper from C
+@[export lean_test_export_sum]
+def sumList (xs : List Nat) (ys : Array Nat) : Nat :=
+  xs.foldl (· + ·) 0 + ys.foldl (· + ·) 0
+
+@[export lean_test_export_len]
+def totalLength (xs : Array String) (sep : String) : Nat :=
+  xs.foldl (fun n s => n + s.length + sep.length) 0
+
+/-- Calls the exported functions from C with the declared ownership of their arguments,
+see `exportBorrow.lean.driver.c`. -/
+@[extern "lean_test_call_exports"]
+opaque callExports : IO (Array Nat)
+
+def main : IO Unit := do
+  let xs := List.range 100
+  let ys := Array.range 10
+  IO.println (sumList xs ys)
+  IO.println (sumList xs ys + sumList [] ys)
+  IO.println (totalLength #["a", "bc", "def"] ", ")
+  IO.println xs.length
+  IO.println (← callExports)
@@ -0,0 +1,43 @@
+#include <lean/lean.h>
+
+/* declared signatures of the exported functions in `exportBorrow.lean`: all parameters are owned */
+lean_object * lean_test_export_sum(lean_object * xs, lean_object * ys);
+lean_object * lean_test_export_len(lean_object * xs, lean_object * sep);
+
+static lean_object * mk_list(unsigned n) {
+    lean_object * r = lean_box(0);
+    for (unsigned i = n; i > 0; i--) {
+        lean_object * c = lean_alloc_ctor(1, 2, 0);
+        lean_ctor_set(c, 0, lean_box(i));
+        lean_ctor_set(c, 1, r);
+        r = c;
+    }
+    return r;
+}
+
+lean_object * lean_test_call_exports(lean_object * w) {
+    lean_object * out = lean_mk_empty_array();
+    lean_object * ys = lean_mk_empty_array();
+    for (unsigned i = 0; i < 5; i++)
+        ys = lean_array_push(ys, lean_box(i));
+    /* unshared list, shared array: the caller keeps a reference to `ys` */
+    lean_inc(ys);
+    out = lean_array_push(out, lean_test_export_sum(mk_list(10), ys));
+    lean_object * xs = mk_list(3);
+    lean_inc(xs);
+    lean_inc(ys);
+    out = lean_array_push(out, lean_test_export_sum(xs, ys));
+    out = lean_array_push(out, lean_box(lean_array_size(ys)));
+    /* the last references to `xs` and `ys` */
+    out = lean_array_push(out, lean_test_export_sum(xs, ys));
+    lean_object * strs = lean_mk_empty_array();
+    strs = lean_array_push(strs, lean_mk_string("hello"));
+    strs = lean_array_push(strs, lean_mk_string("world"));
+    lean_object * sep = lean_mk_string(", ");
+    lean_inc(sep);
+    out = lean_array_push(out, lean_test_export_len(strs, sep));
+    /* `sep` is still alive since we kept a reference */
+    out = lean_array_push(out, lean_string_length(sep));
+    lean_dec(sep);
+    return lean_io_result_mk_ok(out);
+}
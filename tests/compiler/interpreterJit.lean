@@ -0,0 +1,42 @@
+/-!
+Run with `interpreter.jit` and a low threshold, the functions of this module are compiled to native code
+after a few interpreted calls. The output must be the same as the one of the plain interpreter and of the
+compiled program.
+-/
+
+structure Point where
+  x : Float
+  y : Float
+  tag : UInt8
+
+def Point.add (p q : Point) : Point :=
+  { x := p.x + q.x, y := p.y + q.y, tag := p.tag ^^^ q.tag }
+
+def fib : Nat → Nat
+  | 0 => 0
+  | 1 => 1
+  | n + 2 => fib n + fib (n + 1)
+
+def mix (a : UInt64) (b : UInt32) : UInt64 :=
+  a * 6364136223846793005 + b.toUInt64
+
+partial def collatz (n : Nat) (steps : Nat := 0) : Nat :=
+  if n ≤ 1 then steps
+  else if n % 2 == 0 then collatz (n / 2) (steps + 1)
+  else collatz (3 * n + 1) (steps + 1)
+
+def words (n : Nat) : String :=
+  String.intercalate " " ((List.range n).map fun i => s!"w{i}")
+
+def applyN (f : Nat → Nat) : Nat → Nat → Nat
+  | 0, a => a
+  | n + 1, a => applyN f n (f a)
+
+def main : IO Unit := do
+  IO.println (fib 25)
+  IO.println ((List.range 100).foldl (fun acc i => mix acc i.toUInt32) 1)
+  IO.println ((List.range 1000).map (collatz ·) |>.foldl max 0)
+  IO.println ((List.range 20).map words |>.map String.length)
+  let p := (List.range 100).foldl (fun (p : Point) i => p.add { x := i.toFloat, y := 0.5, tag := i.toUInt8 }) ⟨0, 0, 0⟩
+  IO.println s!"{p.x} {p.y} {p.tag}"
+  IO.println (applyN (· * 3 % 1000003) 10000 1)
@@ -0,0 +1,16 @@
+/-!
+Closed terms that are initialized on first use with `compiler.lazyClosedTerms`, including concurrent
+first uses from several tasks.
+-/
+
+@[noinline] def squares (i : Nat) : Nat :=
+  ((List.range 1000).toArray.map (fun x => x * x))[i]!
+
+@[noinline] def greeting (i : Nat) : String :=
+  #["hello", "world", "lazy", "closed", "terms"][i % 5]!
+
+def main : IO Unit := do
+  let tasks := (List.range 8).map fun i => Task.spawn fun _ => squares (i * 100) + (greeting i).length
+  IO.println (tasks.map Task.get)
+  IO.println (squares 999)
+  IO.println (greeting 3)
@@ -0,0 +1,26 @@
+structure Config where
+  name  : String
+  sizes : List Nat
+  inner : Array (List Nat)
+
+def defaultConfig : Config :=
+  { name := "default", sizes := [1, 2, 3], inner := #[[4, 5], [6]] }
+
+-- projections of closed terms are persistent objects
+def total (n : Nat) : Nat := Id.run do
+  let mut acc := 0
+  for i in [0:n] do
+    let sizes := defaultConfig.sizes
+    let inner := defaultConfig.inner
+    acc := acc + sizes.foldl (· + ·) 0 + (inner.getD (i % 2) []).length
+  return acc
+
+def consume (xs : List Nat) : List Nat :=
+  xs.map (· + 1)
+
+def main : IO Unit := do
+  IO.println (total 1000)
+  IO.println (consume defaultConfig.sizes)
+  IO.println (consume (defaultConfig.inner.getD 0 []))
+  IO.println defaultConfig.name
+  IO.println ((Array.range 1000).foldl (fun acc i => acc + (UInt8.ofNat i).toNat) 0)
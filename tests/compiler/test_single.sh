@@ -1,10 +1,14 @@
 #!/usr/bin/env bash
 source ../common.sh
 
+# C code called from the test, e.g. to call `@[export]` functions
+driver=()
+[ -f "$f.driver.c" ] && driver=("$f.driver.c")
+
 # First check the C version actually works...
 echo "running C program..."
 rm "./$f.out" || true
-compile_lean_c_backend
+compile_lean_c_backend "${driver[@]}"
 exec_check "./$f.out"
 diff_produced
 
@@ -12,7 +16,7 @@ diff_produced
 if lean_has_llvm_support; then
     echo "running LLVM program..."
     rm "./$f.out" || true
-    compile_lean_llvm_backend
+    compile_lean_llvm_backend "${driver[@]}"
     exec_check "./$f.out"
     diff_produced
 fi
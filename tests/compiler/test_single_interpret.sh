@@ -1,5 +1,5 @@
 #!/usr/bin/env bash
 source ../common.sh
 
-exec_check lean -Dlinter.all=false --run "$f"
+exec_check lean $(lean_opts) -Dlinter.all=false --run "$f"
 diff_produced
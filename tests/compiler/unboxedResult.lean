@@ -0,0 +1,29 @@
+-- Functions returning pairs of scalars are compiled to workers returning them unboxed
+
+@[noinline] def divMod (a b : UInt64) : UInt64 × UInt64 :=
+  (a / b, a % b)
+
+def fib2 : Nat → UInt64 → UInt64 → UInt64 × UInt64
+  | 0,   a, b => (a, b)
+  | n+1, a, b => fib2 n b (a + b)
+
+@[noinline] def minMax (xs : Array Float) (i : Nat) (lo hi : Float) : Float × Float :=
+  if h : i < xs.size then
+    let x := xs[i]
+    minMax xs (i+1) (if x < lo then x else lo) (if x > hi then x else hi)
+  else (lo, hi)
+termination_by xs.size - i
+
+@[noinline] def sign (x : Int) : UInt8 × Bool :=
+  if x < 0 then (255, true) else if x == 0 then (0, false) else (1, false)
+
+def main : IO Unit := do
+  let (q, r) := divMod 100 7
+  IO.println s!"{q} {r}"
+  let (a, b) := fib2 50 0 1
+  IO.println s!"{a} {b}"
+  let (lo, hi) := minMax #[3.5, -1.25, 8, 2] 0 0 0
+  IO.println s!"{lo} {hi}"
+  -- the boxed results are still used by closures and callers that keep the pair
+  IO.println (repr ([10, 20, 30].map (divMod · 3)))
+  IO.println (repr ([-5, 0, 5].map sign))
@@ -0,0 +1,13 @@
+-- Functions with workers returning unboxed results, see `test.sh`
+
+@[noinline] def divMod (a b : UInt64) : UInt64 × UInt64 :=
+  (a / b, a % b)
+
+@[noinline] def minMax (x y : Float) : Float × Float :=
+  if x < y then (x, y) else (y, x)
+
+@[noinline] def halves (a : UInt32) : UInt32 × UInt32 :=
+  (a >>> 16, a &&& 0xffff)
+
+@[noinline] def sign (x : Int) : UInt8 × Bool :=
+  if x < 0 then (255, true) else if x == 0 then (0, false) else (1, false)
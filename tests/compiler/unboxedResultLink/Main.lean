@@ -0,0 +1,12 @@
+import Lib
+
+-- the results are only projected and unboxed, so the workers of `Lib` are called if they exist
+def main : IO Unit := do
+  let (q, r) := divMod 100 7
+  IO.println s!"{q} {r}"
+  let (lo, hi) := minMax 2.5 (-1.25)
+  IO.println s!"{lo} {hi}"
+  let (h, l) := halves 0x12345678
+  IO.println s!"{h} {l}"
+  let (s, neg) := sign (-3)
+  IO.println s!"{s} {neg}"
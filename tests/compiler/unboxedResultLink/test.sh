@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+# Link modules compiled by the C and the LLVM backend that call each other's functions with unboxed results
+set -euo pipefail
+
+if ! lean --features | grep -q "LLVM"; then
+    echo "skipping test, lean was built without LLVM support"
+    exit 0
+fi
+
+rm -rf build
+mkdir -p build
+export LEAN_PATH=build
+lean --root=. -o build/Lib.olean --c=build/Lib.c --bc=build/Lib.bc Lib.lean
+lean --root=. -o build/Main.olean --c=build/Main.c --bc=build/Main.bc Main.lean
+
+expected="14 2
+-1.250000 2.500000
+4660 22136
+255 true"
+
+for backends in "c bc" "bc c"; do
+    set -- $backends
+    leanc -O3 -DNDEBUG -o "build/test_$1_$2.out" "build/Lib.$1" "build/Main.$2"
+    out=$("./build/test_$1_$2.out")
+    if [ "$out" != "$expected" ]; then
+        echo "unexpected output with Lib.$1 and Main.$2:"
+        echo "$out"
+        exit 1
+    fi
+done
@@ -57,3 +57,18 @@ def usingIO {α} (x : IO α) : IO α := x
   let (stdin, lean) ← lean.takeStdin
   stdin.putStr "#exit\n"
   lean.wait
+
+#eval usingIO do
+  let out ← output { cmd := "sh", args := #["-c", "pwd; echo $FOO; echo ${HOME+set}"], cwd := "/", env := #[("FOO", "bar"), ("HOME", none)] }
+  IO.print out.stdout
+
+-- failing to start the program is an error attributed to the command, both with `posix_spawn` and
+-- with the `fork` fallback used when `env` sets `PATH`
+#eval usingIO do
+  for env in #[#[], #[("PATH", some "/bin:/usr/bin")]] do
+    for (cmd, cwd) in [("does-not-exist", none), ("sh", some "/does-not-exist")] do
+      try
+        discard <| output { cmd, args := #["-c", "true"], cwd, env }
+        IO.println "no error"
+      catch e =>
+        IO.println e
@@ -0,0 +1,38 @@
+open IO Process
+
+-- not in the run/ directory because then it would be run with -j0
+
+def usingIO {α} (x : IO α) : IO α := x
+
+def await (t : Task (Except IO.Error α)) : IO α := do
+  IO.ofExcept (← IO.wait t)
+
+#eval usingIO do
+  let child ← spawn { cmd := "sh", args := #["-c", "read x; echo got $x; exit 3"], stdin := .piped, stdout := .piped }
+  let exit ← child.waitAsync
+  let out ← child.stdout.readAsync 1024
+  await (← child.stdin.writeAsync "hi\n".toUTF8)
+  IO.println (String.fromUTF8! (← await out)).trim
+  IO.println (← await exit)
+
+#eval usingIO do
+  let child ← spawn { cmd := "sh", args := #["-c", "sleep 0.1; echo ready"], stdout := .piped }
+  await (← child.stdout.waitReadable)
+  IO.println (← child.stdout.getLine).trim
+  discard <| await (← child.waitAsync)
+
+#eval usingIO do
+  -- many outstanding waits at once
+  let children ← (List.range 100).mapM fun i => spawn { cmd := "sh", args := #["-c", s!"exit {i % 7}"] }
+  let tasks ← children.mapM (·.waitAsync)
+  let codes ← tasks.mapM await
+  IO.println (codes.foldl (· + ·) 0)
+
+#eval usingIO do
+  -- writes larger than the pipe buffer are completed in chunks
+  let child ← spawn { cmd := "wc", args := #["-c"], stdin := .piped, stdout := .piped }
+  let (stdin, child) ← child.takeStdin
+  -- `stdin` is closed after its last use, while the pending write keeps the pipe open until it is done
+  await (← stdin.writeAsync (ByteArray.mk (mkArray 200000 65)))
+  IO.println (← child.stdout.readToEnd).trim
+  discard <| await (← child.waitAsync)
@@ -0,0 +1,34 @@
+def mkList (seed n : Nat) : List Nat :=
+  List.range n |>.map (· + seed)
+
+/--
+Drops a large multi-threaded list whose last element is the input of a `cat` process. The reclaimer thread
+closes it when freeing the list, so `cat` terminates.
+-/
+def reclaimHandle : IO Unit := do
+  let child ← IO.Process.spawn { cmd := "cat", stdin := .piped, stdout := .null }
+  let (stdin, child) ← child.takeStdin
+  let n := 100000
+  let xs := (Task.spawn fun _ => (List.range n).map fun i => if i + 1 == n then some stdin else none).get
+  IO.println xs.length
+  let waiter ← IO.asTask (prio := .dedicated) child.wait
+  for _ in [0:1000] do
+    if ← IO.hasFinished waiter then
+      return
+    IO.sleep 10
+  child.kill
+  throw <| IO.userError "the list was not reclaimed"
+
+def main : IO Unit := do
+  IO.setDeferredDealloc true
+  let mut sum := 0
+  for i in [0:20] do
+    -- results of tasks are multi-threaded, so dropping them is deferred
+    let tasks := (List.range 4).map fun j => Task.spawn fun _ => mkList (i + j) 100000
+    let lists := tasks.map Task.get
+    sum := sum + lists.foldl (fun acc l => acc + l.length) 0
+  IO.println sum
+  reclaimHandle
+  IO.setDeferredDealloc false
+
+#eval main
@@ -0,0 +1,15 @@
+set_option Elab.async true
+
+theorem foo (n : Nat) : n + 0 = n := by
+  simp only [Nat.add_zero]
+            --^ textDocument/hover
+
+theorem bar : 2 + 2 = 4 :=
+  Nat.le_antisymm (Nat.le_refl _) (Nat.le_refl _)
+      --^ textDocument/hover
+
+example : 2 + 2 = 4 := by decide
+                         --^ textDocument/hover
+
+def baz := foo 0
+         --^ textDocument/hover
@@ -0,0 +1,63 @@
+import Lean
+
+set_option Elab.async true
+
+theorem t1 : 1 + 1 = 2 := by decide
+
+-- only the statement of `t1` is needed
+theorem t2 : 1 + 1 = 2 ∧ True := ⟨t1, trivial⟩
+
+-- creates the auxiliary definition `t3.match_1`
+theorem t3 (n : Nat) : n + 0 = n :=
+  match n with
+  | 0 => rfl
+  | _ + 1 => rfl
+
+example : 2 + 2 = 4 := by decide
+
+namespace Foo
+-- also creates an auxiliary definition, so it is elaborated again in `Foo` when waited for
+theorem t5 (n : Nat) : n * 1 = n :=
+  match n with
+  | 0 => rfl
+  | 1 => rfl
+  | _ + 2 => Nat.mul_one _
+end Foo
+
+def five := 5
+
+-- declarations with attributes are elaborated synchronously
+@[simp] theorem t6 : five = 5 := rfl
+
+example : five + 0 = 5 := by simp only [t6, Nat.add_zero]
+
+/-- warning: declaration uses 'sorry' -/
+#guard_msgs in
+theorem t4 : 1 = 2 := sorry
+
+-- waits for the proofs and replaces the placeholders
+/-- info: 't2' does not depend on any axioms -/
+#guard_msgs in
+#print axioms t2
+
+/-- info: 't3' does not depend on any axioms -/
+#guard_msgs in
+#print axioms t3
+
+/-- info: 't4' depends on axioms: [sorryAx] -/
+#guard_msgs in
+#print axioms t4
+
+/-- info: 'Foo.t5' does not depend on any axioms -/
+#guard_msgs in
+#print axioms Foo.t5
+
+/-- info: 't6' does not depend on any axioms -/
+#guard_msgs in
+#print axioms t6
+
+open Lean Meta in
+#eval show MetaM Unit from do
+  for n in [``t3.match_1, ``Foo.t5.match_1] do
+    unless (← isMatcher n) do
+      throwError "missing matcher info of `{n}`"
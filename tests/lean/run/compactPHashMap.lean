@@ -0,0 +1,74 @@
+import Lean.Data.CompactPersistentHashMap
+import Lean.Data.PersistentHashMap
+/-!
+Compares `CompactPersistentHashMap` against `PersistentHashMap` on random sequences of inserts and
+erases, including old versions of the maps that share nodes with newer ones and keys whose hashes
+collide.
+-/
+open Lean
+
+/-- Keys with only three distinct hashes, so that most keys collide on all bits of the hash. -/
+structure Colliding where
+  n : Nat
+  deriving BEq, Repr
+
+instance : Hashable Colliding where
+  hash k := (k.n % 3).toUInt64
+
+/-- Keys whose hashes only differ in the bits used by the last levels of the trie. -/
+structure HighBits where
+  n : Nat
+  deriving BEq, Repr
+
+instance : Hashable HighBits where
+  hash k := (k.n % 16).toUInt64 <<< 58
+
+def checkEq [BEq κ] [Hashable κ] [Repr κ] (keyOf : Nat → κ) (numKeys : Nat)
+    (m : CPHashMap κ Nat) (m' : PHashMap κ Nat) : IO Unit := do
+  -- `PersistentHashMap.size` also counts replaced entries
+  let size := m'.toList.length
+  unless m.size == size && m.toArray.size == size do
+    throw <| IO.userError s!"size {m.size} instead of {size}"
+  for i in [0:numKeys] do
+    let k := keyOf i
+    unless m.find? k == m'.find? k && m.contains k == m'.contains k do
+      throw <| IO.userError s!"{repr k}: {m.find? k} instead of {m'.find? k}"
+  let toSorted (kvs : Array (κ × Nat)) :=
+    kvs.map (fun (k, v) => (toString (repr k), v)) |>.qsort (·.1 < ·.1)
+  unless toSorted m.toArray == toSorted m'.toList.toArray do
+    throw <| IO.userError "toArray differs"
+
+def test [BEq κ] [Hashable κ] [Repr κ] (keyOf : Nat → κ) (numKeys numOps : Nat) : IO Unit := do
+  let mut gen := mkStdGen 42
+  let mut m : CPHashMap κ Nat := {}
+  let mut m' : PHashMap κ Nat := {}
+  let mut versions := #[]
+  for i in [0:numOps] do
+    let (r, gen') := randNat gen 0 (3 * numKeys - 1)
+    gen := gen'
+    let k := keyOf (r % numKeys)
+    if r < numKeys then
+      m := m.erase k
+      m' := m'.erase k
+    else
+      m := m.insert k i
+      m' := m'.insert k i
+    if i % (numOps / 20) == 0 then
+      versions := versions.push (m, m')
+  checkEq keyOf numKeys m m'
+  -- old versions must not have been modified by updates of the maps sharing their nodes
+  for (n, n') in versions do
+    checkEq keyOf numKeys n n'
+  -- erase everything
+  for i in [0:numKeys] do
+    m := m.erase (keyOf i)
+    m' := m'.erase (keyOf i)
+  checkEq keyOf numKeys m m'
+  unless m.isEmpty do
+    throw <| IO.userError "map not empty"
+
+#eval test id 2000 20000
+#eval test (·.toUInt64) 300 5000
+#eval test (toString ·) 1000 10000
+#eval test Colliding.mk 60 3000
+#eval test HighBits.mk 200 5000
@@ -0,0 +1,72 @@
+import Lean.Data.FlatHashMap
+import Lean.Data.HashMap
+/-!
+Compares `FlatHashMap` against `HashMap` on random sequences of inserts and erases, which resize the
+map and reuse deleted slots, including copies of shared maps and keys whose hashes collide.
+-/
+open Lean
+
+/-- Keys with only five distinct hashes. -/
+structure Colliding where
+  n : Nat
+  deriving BEq, Repr
+
+instance : Hashable Colliding where
+  hash k := (k.n % 5).toUInt64
+
+def checkEq [BEq κ] [Hashable κ] [Repr κ] (keyOf : Nat → κ) (numKeys : Nat)
+    (m : FlatHashMap κ Nat) (m' : HashMap κ Nat) : IO Unit := do
+  unless m.size == m'.size && m.toArray.size == m'.size do
+    throw <| IO.userError s!"size {m.size} instead of {m'.size}"
+  for i in [0:numKeys] do
+    let k := keyOf i
+    unless m.find? k == m'.find? k && m.contains k == m'.contains k do
+      throw <| IO.userError s!"{repr k}: {m.find? k} instead of {m'.find? k}"
+  let toSorted (kvs : Array (κ × Nat)) :=
+    kvs.map (fun (k, v) => (toString (repr k), v)) |>.qsort (·.1 < ·.1)
+  unless toSorted m.toArray == toSorted m'.toArray do
+    throw <| IO.userError "toArray differs"
+
+def test [BEq κ] [Hashable κ] [Repr κ] (keyOf : Nat → κ) (numKeys numOps : Nat) : IO Unit := do
+  let mut gen := mkStdGen 42
+  -- start small so that the map is resized several times
+  let mut m : FlatHashMap κ Nat := mkFlatHashMap (capacity := 1)
+  let mut m' : HashMap κ Nat := {}
+  let mut versions := #[]
+  for i in [0:numOps] do
+    let (r, gen') := randNat gen 0 (3 * numKeys - 1)
+    gen := gen'
+    let k := keyOf (r % numKeys)
+    if r < numKeys then
+      m := m.erase k
+      m' := m'.erase k
+    else
+      m := m.insert k i
+      m' := m'.insert k i
+    -- the maps are shared now, so the next update must copy them
+    if i % (numOps / 20) == 0 then
+      versions := versions.push (m, m')
+  checkEq keyOf numKeys m m'
+  for (n, n') in versions do
+    checkEq keyOf numKeys n n'
+  -- fill the slots of erased keys with new ones without growing the map
+  for i in [0:numKeys] do
+    if i % 2 == 0 then
+      m := m.erase (keyOf i)
+      m' := m'.erase (keyOf i)
+  for i in [0:numKeys] do
+    if i % 4 == 0 then
+      m := m.insert (keyOf i) i
+      m' := m'.insert (keyOf i) i
+  checkEq keyOf numKeys m m'
+  for i in [0:numKeys] do
+    m := m.erase (keyOf i)
+    m' := m'.erase (keyOf i)
+  checkEq keyOf numKeys m m'
+  unless m.isEmpty do
+    throw <| IO.userError "map not empty"
+
+#eval test id 2000 20000
+#eval test (·.toUInt64) 300 5000
+#eval test (toString ·) 1000 10000
+#eval test Colliding.mk 100 3000
@@ -0,0 +1,24 @@
+def check (name : String) (content : ByteArray) : IO Unit := do
+  let file : System.FilePath := s!"hashFile_{name}.tmp"
+  IO.FS.writeBinFile file content
+  try
+    unless (← IO.FS.hashFile file) == hash (← IO.FS.readBinFile file) do
+      throw <| IO.userError s!"{name}: hash mismatch"
+    let text := String.fromUTF8! content
+    unless (← IO.FS.hashFile file (normalizeEol := true)) == hash (text.replace "\r\n" "\n") do
+      throw <| IO.userError s!"{name}: normalized hash mismatch"
+  finally
+    IO.FS.removeFile file
+
+def bigText : String := Id.run do
+  let mut s := ""
+  for i in [0:20000] do
+    s := s ++ s!"line {i}" ++ (if i % 3 == 0 then "\r\n" else if i % 3 == 1 then "\n" else "\r")
+  return s
+
+#eval do
+  check "empty" .empty
+  check "short" "abc".toUTF8
+  check "crlf" "a\r\nb\r\r\nc\n\r".toUTF8
+  check "trailingCr" "abcdefgh\r".toUTF8
+  check "big" bigText.toUTF8
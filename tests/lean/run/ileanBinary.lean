@@ -0,0 +1,55 @@
+import Lean.Server.References
+open Lean Lean.Server Lean.Lsp
+
+def loc (line : Nat) : RefInfo.Location :=
+  { range := ⟨⟨line, 0⟩, ⟨line, 3⟩⟩, parentDecl? := none }
+
+#eval show IO Unit from do
+  let file : System.FilePath := "ileanBinary.ilean.tmp"
+  let foo := RefIdent.const `Test `Test.foo
+  let bar := RefIdent.const `Other `Other.bar
+  let refs : Lsp.ModuleRefs := HashMap.empty
+    |>.insert foo { definition? := loc 1, usages := #[loc 5, loc 7] }
+    |>.insert bar { definition? := none, usages := #[loc 3] }
+  (Ilean.ofModuleRefs `Test refs).save file
+  let ilean ← Ilean.load file
+  IO.FS.removeFile file
+  assert! ilean.module == `Test
+  assert! ilean.decls.map (·.1) == #[`Test.foo]
+  assert! (ilean.references.find? foo).map (·.usages.size) == some 2
+  assert! (ilean.references.find? bar).map (·.definition?.isNone) == some true
+  assert! (ilean.references.find? (.const `Test `Test.baz)).isNone
+  let refs := References.empty.addIlean file ilean
+  assert! (refs.findAt `Test ⟨5, 1⟩).size == 1
+  let defs ← refs.definitionsMatching {} fun n => if n == `Test.foo then some () else none
+  assert! defs.isEmpty -- `Test` is not in the (empty) source search path
+  assert! refs.ileanModulesFor.find? bar == some #[`Test]
+  -- reloading a file while its previous version is still mapped
+  (Ilean.ofModuleRefs `Test (refs.findModuleRefs? `Test |>.get! |>.erase bar)).save file
+  let ilean' ← Ilean.load file (mmap := false)
+  IO.FS.removeFile file
+  let refs := refs.addIlean file ilean'
+  assert! refs.ileans.size == 1
+  assert! refs.ileanModulesFor.find? bar == none
+  assert! refs.ileanModulesFor.find? foo == some #[`Test]
+  assert! (refs.removeIlean file).ileanModulesFor.isEmpty
+
+-- .ilean files of version 3 were stored as JSON
+#eval show IO Unit from do
+  let file : System.FilePath := "ileanBinary.json.ilean.tmp"
+  let refs : Lsp.ModuleRefs := HashMap.empty
+    |>.insert (.const `Test `Test.foo) { definition? := loc 1, usages := #[loc 5] }
+  IO.FS.writeFile file <| Json.compress <|
+    Json.mkObj [("version", 3), ("module", toJson `Test), ("references", toJson refs)]
+  let ilean ← Ilean.load file
+  IO.FS.removeFile file
+  assert! ilean.region?.isNone
+  assert! ilean.module == `Test
+  assert! ilean.decls.map (·.1) == #[`Test.foo]
+
+#eval show IO Unit from do
+  try
+    discard <| Ilean.load "ileanBinaryMissing.ilean"
+  catch
+    | .noFileOrDirectory .. => pure ()
+    | e => throw e
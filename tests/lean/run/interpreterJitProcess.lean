@@ -0,0 +1,38 @@
+import Lean
+/-!
+The interpreter's JIT tier counts calls per process and compiles hot functions, including functions that are only
+called through closures. Does nothing if Lean was built without LLVM support.
+-/
+open Lean IR
+
+def fib : Nat → Nat
+  | 0 => 0
+  | 1 => 1
+  | n + 2 => fib n + fib (n + 1)
+
+def addOne (x : Nat) : Nat := x + 1
+
+-- no `@[specialize]`, so `f` is called through a closure
+def applyN (f : Nat → Nat) : Nat → Nat → Nat
+  | 0,     a => a
+  | n + 1, a => applyN f n (f a)
+
+def step (x : Nat) : Nat := x * 3 % 1000003
+
+def cold (x : Nat) : Nat := x * 5 % 1000003
+
+set_option interpreter.jit true
+set_option interpreter.jit_threshold 10
+
+#eval fib 15
+#eval applyN addOne 100 0
+-- each `#eval` uses a new interpreter, but calls are counted per process
+#eval step (step (step (step (step 1))))
+#eval step (step (step (step (step 2))))
+#eval cold (cold 1)
+
+#eval show IO Unit from do
+  unless ← isJitAvailable do return
+  for fn in [``fib, ``addOne, ``applyN, ``step] do
+    unless ← isJitCompiled fn do throw <| IO.userError s!"{fn} was not compiled"
+  if ← isJitCompiled ``cold then throw <| IO.userError "cold was compiled"
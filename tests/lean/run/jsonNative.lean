@@ -0,0 +1,34 @@
+import Lean.Data.Json
+open Lean
+
+/-! The native `Json.parse` and `Json.compress` must agree with the reference implementations in Lean. -/
+
+def parseRef (s : String) : Except String Json :=
+  match Json.Parser.any s.mkIterator with
+  | .success _ res => .ok res
+  | .error it err => .error s!"offset {repr it.i.byteIdx}: {err}"
+
+def check (s : String) : IO Unit := do
+  match Json.parse s, parseRef s with
+  | .ok a, .ok b =>
+    unless a == b && a.compress == b.compress do
+      throw <| .userError s!"parse mismatch on {s}"
+    unless a.compress == Json.compressCore "" [.json a] do
+      throw <| .userError s!"compress mismatch on {s}"
+  | .error e, .error e' =>
+    unless e == e' do throw <| .userError s!"error mismatch on {s}: {e} vs {e'}"
+  | _, _ => throw <| .userError s!"result mismatch on {s}"
+
+#eval do
+  for s in [
+    "null", " true ", "false", "[]", "[ ]", "{}", "{ }", "0", "-0", "17", "-3.25", "0.001", "1e5", "1E+2", "-2.5e-3",
+    "123.456e2", "1e-30", "12345678901234567890123", "9223372036854775807", "-9223372036854775808", "1.000",
+    "\"\"", "\"abc\"", "\"with \\\"quote\\\" and \\\\ and \\/\"", "\"\\b\\f\\n\\r\\t\"", "\"\\u00e9\\u4e2d\\ud83d\"",
+    "\"π≈3.14159 and 中文 text and emoji 😀 in a string longer than sixteen bytes\"",
+    "\"control \\u0001\\u001f\"", "[1, [2, [3, []]], {\"a\": null}]",
+    "{\"b\": [1, {\"c\": null}], \"a\": \"x\", \"c\": {}}", "{\"a\": 1, \"a\": 2}",
+    -- invalid input
+    "", "nul", "[1,", "[1,]", "{\"a\":1,}", "{\"a\" 1}", "01", "-", "1.", ".5", "1e", "\"abc", "\"a\tb\"",
+    "\"\\x\"", "\"\\u12g4\"", "[1] x", "1e99999999999999999999999", "[true false]"] do
+    check s
+  check ("".pushn '[' 1000 ++ "".pushn ']' 1000)
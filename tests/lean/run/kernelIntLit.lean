@@ -0,0 +1,74 @@
+import Lean
+
+/-! Basic tests, including sign edge cases. The elaborator checks these by unfolding the
+definitions, and the kernel then checks them using its builtin `Int` support. -/
+example : (7 : Int) + -9 = -2 := rfl
+example : (-7 : Int) - -9 = 2 := rfl
+example : (-7 : Int) * -9 = 63 := rfl
+example : -(-7 : Int) = 7 := rfl
+example : -(0 : Int) = 0 := rfl
+example : Int.div 7 (-2) = -3 := rfl
+example : Int.div (-7) 2 = -3 := rfl
+example : Int.div (-7) 0 = 0 := rfl
+example : Int.mod (-7) 2 = -1 := rfl
+example : Int.mod 7 (-2) = 1 := rfl
+example : Int.mod (-7) 0 = -7 := rfl
+example : (-7 : Int) / 2 = -4 := rfl
+example : (-7 : Int) / -2 = 4 := rfl
+example : (7 : Int) / -2 = -3 := rfl
+example : (-7 : Int) / 0 = 0 := rfl
+example : (-7 : Int) % 2 = 1 := rfl
+example : (-7 : Int) % -2 = 1 := rfl
+example : (-7 : Int) % 0 = -7 := rfl
+example : (-2 : Int) ^ 3 = -8 := rfl
+example : (-2 : Int) ^ 4 = 16 := rfl
+example : (0 : Int) ^ 3 = 0 := rfl
+example : (-5 : Int) ^ 0 = 1 := rfl
+example : (-5 : Int).natAbs = 5 := rfl
+example : (-5 : Int).toNat = 0 := rfl
+example : (5 : Int).toNat = 5 := rfl
+
+/-!
+We check that large calculations are evaluated using bignum functions in the kernel.
+`Int.pow` is defined by recursion on the exponent, so these used to exceed the maximum
+recursion depth. We call the kernel directly since the elaborator does not have the
+same support.
+-/
+
+def pow₁ : Int := (-3) ^ 10001
+def pow₁' : Int := -((3 ^ 10001 : Nat) : Int)
+def big₁ : Int := ((-3) ^ 4001 * 7 - 5) / (-3) ^ 3999 % 1000000007
+def big₁' : Int := 64
+
+open Lean in
+def checkKernelDefEq (a b : Name) : CoreM Unit := do
+  let r ← ofExceptKernelException (Kernel.isDefEq (← getEnv) {} (mkConst a) (mkConst b))
+  unless r do throwError "{a} and {b} are not definitionally equal in the kernel"
+
+#eval checkKernelDefEq ``pow₁ ``pow₁'
+#eval checkKernelDefEq ``big₁ ``big₁'
+
+/-!
+`UInt64` and `BitVec` have no separate rules in the kernel: their operations are defined by `Nat`
+arithmetic on the underlying `Nat` literal, which the kernel's `Nat` support already evaluates.
+-/
+
+example : (0xFFFFFFFFFFFFFFFF : UInt64) + 2 = 1 := rfl
+example : (0xFFFFFFFFFFFFFFFF : UInt64) * 0xFFFFFFFFFFFFFFFF = 1 := by decide
+example : (0 : UInt64) - 1 = 0xFFFFFFFFFFFFFFFF := by decide
+example : (0x123456789ABCDEF0 : UInt64) / 0x10 % 0x1000 = 0xDEF := rfl
+example : (0x123456789ABCDEF0 : UInt64) >>> 32 = 0x12345678 := by decide
+example : (0x123456789ABCDEF0 : UInt64) &&& 0xFFFF ||| 1 = 0xDEF1 := by decide
+example : (0xFFFFFFFFFFFFFFFF : UInt64) ≠ 0 := by decide
+
+section
+open BitVec
+
+example : 5#64 * 3#64 = 15#64 := by decide
+example : 0#64 - 1#64 = 0xFFFFFFFFFFFFFFFF#64 := by decide
+example : 0xFFFFFFFFFFFFFFFF#64 + 2#64 = 1#64 := rfl
+example : 0x123456789ABCDEF0#64 >>> 32 = 0x12345678#64 := by decide
+example : 0x123456789ABCDEF0#128 * 0x10#128 = 0x123456789ABCDEF00#128 := rfl
+example : 1#256 <<< 255 = (2 ^ 255 : Nat)#256 := by decide
+example : ((2 ^ 255 : Nat)#256).getLsb 255 = true := by decide
+end
@@ -0,0 +1,58 @@
+import Lean
+/-!
+The per-declaration compiler passes process the declarations of large mutual groups in parallel.
+The generated IR must be the same as with sequential compilation.
+-/
+
+open Lean IR
+
+set_option compiler.parallel false in
+mutual
+partial def Serial.f₁ (xs : List Nat) : Nat := match xs with
+  | [] => 0
+  | x :: xs => x + Serial.f₂ (xs.map (· * 2))
+partial def Serial.f₂ (xs : List Nat) : Nat := match xs with
+  | [] => 1
+  | x :: xs => x * Serial.f₃ (xs.filter (· > 3))
+partial def Serial.f₃ (xs : List Nat) : Nat := match xs with
+  | [] => 2
+  | x :: xs => Serial.f₄ xs + (toString x).length
+partial def Serial.f₄ (xs : List Nat) : Nat := match xs with
+  | [] => 3
+  | x :: xs => Serial.f₁ (xs.reverse) + x
+partial def Serial.f₅ (xs : List Nat) : Nat := match xs with
+  | [] => 4
+  | _ :: xs => Serial.f₁ xs + (xs.foldl (· + ·) 0)
+end
+
+set_option compiler.parallel true in
+mutual
+partial def Parallel.f₁ (xs : List Nat) : Nat := match xs with
+  | [] => 0
+  | x :: xs => x + Parallel.f₂ (xs.map (· * 2))
+partial def Parallel.f₂ (xs : List Nat) : Nat := match xs with
+  | [] => 1
+  | x :: xs => x * Parallel.f₃ (xs.filter (· > 3))
+partial def Parallel.f₃ (xs : List Nat) : Nat := match xs with
+  | [] => 2
+  | x :: xs => Parallel.f₄ xs + (toString x).length
+partial def Parallel.f₄ (xs : List Nat) : Nat := match xs with
+  | [] => 3
+  | x :: xs => Parallel.f₁ (xs.reverse) + x
+partial def Parallel.f₅ (xs : List Nat) : Nat := match xs with
+  | [] => 4
+  | _ :: xs => Parallel.f₁ xs + (xs.foldl (· + ·) 0)
+end
+
+/-- The IR of all declarations in namespace `ns`, with `ns` erased from the names. -/
+def irOf (env : Environment) (ns : Name) : Array String :=
+  let decls := (getDecls env).filter fun d => ns.isPrefixOf d.name
+  let decls := decls.toArray.qsort (fun d₁ d₂ => Name.quickLt d₁.name d₂.name)
+  decls.map fun d => (toString (format d)).replace s!"{ns}." ""
+
+#eval show CoreM Unit from do
+  let env ← getEnv
+  let serial := irOf env `Serial
+  let parallel := irOf env `Parallel
+  unless serial.size ≥ 5 && serial == parallel do
+    throwError "IR differs between sequential and parallel compilation:\n{serial}\n{parallel}"
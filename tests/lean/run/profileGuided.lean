@@ -0,0 +1,124 @@
+import Lean
+/-!
+Collect a call profile by running the interpreter on a copy of the definitions below in a separate process,
+as an earlier build would, and use it to guide their compilation in this file.
+-/
+
+open Lean IR
+
+def defs := "
+def hotStep (acc x : Nat) : Nat :=
+  acc + x * x + 1
+
+def coldStep (acc x : Nat) : Nat :=
+  acc + x * x + 2
+
+def hotLoop : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => hotLoop n (hotStep acc n)
+
+def coldLoop : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => coldLoop n (coldStep acc n)
+
+def mapSum (f : Nat → Nat) : List Nat → Nat
+  | []      => 0
+  | x :: xs => f x + mapSum f xs
+
+def hotIter : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => hotIter n (acc + mapSum (· + n) [1, 2, 3])
+
+def coldIter : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => coldIter n (acc + mapSum (· * n) [1, 2, 3])
+
+def coldBranch (b : Bool) (xs : List Nat) : Nat :=
+  if b then xs.foldl (· + ·) 0 else xs.length
+
+def sumCubes (xs : List Nat) : Nat :=
+  xs.foldl (fun acc x => acc + x * x * x) 0
+"
+
+#eval show IO Unit from do
+  if ← System.FilePath.pathExists "profileGuided.profile.tmp" then
+    IO.FS.removeFile "profileGuided.profile.tmp"
+  IO.FS.writeFile "profileGuided.tmp.lean" <| defs ++ "
+set_option interpreter.profile \"profileGuided.profile.tmp\" in
+#eval (hotLoop 5000 0, coldLoop 10 0, hotIter 2000 0, coldIter 10 0, coldBranch false [1, 2, 3])
+"
+  let out ← IO.Process.output { cmd := "lean", args := #["profileGuided.tmp.lean"] }
+  unless out.exitCode == 0 do
+    throw <| IO.userError s!"profiling run failed: {out.stdout}{out.stderr}"
+  -- the counts are written once, when the process exits
+  let profile ← IO.FS.readFile "profileGuided.profile.tmp"
+  unless (profile.splitOn "\n").contains "call\t5000\thotLoop\thotStep" do
+    throw <| IO.userError s!"unexpected profile:\n{profile}"
+
+set_option compiler.profile "profileGuided.profile.tmp"
+
+-- the same definitions as in `defs`
+def hotStep (acc x : Nat) : Nat :=
+  acc + x * x + 1
+
+def coldStep (acc x : Nat) : Nat :=
+  acc + x * x + 2
+
+def hotLoop : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => hotLoop n (hotStep acc n)
+
+def coldLoop : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => coldLoop n (coldStep acc n)
+
+def mapSum (f : Nat → Nat) : List Nat → Nat
+  | []      => 0
+  | x :: xs => f x + mapSum f xs
+
+def hotIter : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => hotIter n (acc + mapSum (· + n) [1, 2, 3])
+
+def coldIter : Nat → Nat → Nat
+  | 0,     acc => acc
+  | n + 1, acc => coldIter n (acc + mapSum (· * n) [1, 2, 3])
+
+def coldBranch (b : Bool) (xs : List Nat) : Nat :=
+  if b then xs.foldl (· + ·) 0 else xs.length
+
+def sumCubes (xs : List Nat) : Nat :=
+  xs.foldl (fun acc x => acc + x * x * x) 0
+
+set_option compiler.profile ""
+
+def irCalls (fn callee : Name) : CoreM Bool := do
+  let some decl := findEnvDecl (← getEnv) fn | throwError "no IR for {fn}"
+  return (toString (format decl)).splitOn (toString callee) |>.length > 1
+
+def specializations (callee caller : Name) : CoreM (Array Name) := do
+  let pre := toString (callee ++ `_at ++ caller)
+  return getDecls (← getEnv) |>.map (·.name) |>.filter (toString · |>.startsWith pre)
+
+-- `hotLoop` called `hotStep` more often than `compiler.profile_hot_threshold`, and `hotStep` is small enough to be
+-- inlined; `coldLoop` called `coldStep` only a few times
+#eval show CoreM Unit from do
+  if (← irCalls `hotLoop `hotStep) then throwError "hot function was not inlined"
+  unless (← irCalls `coldLoop `coldStep) do throwError "cold function was inlined"
+
+-- `mapSum` has no `@[specialize]` attribute, but is specialized where it is called often
+#eval show CoreM Unit from do
+  if (← specializations `mapSum `hotIter).isEmpty then throwError "hot call was not specialized"
+  unless (← specializations `mapSum `coldIter).isEmpty do throwError "cold call was specialized"
+
+-- `coldBranch` ran without calling `List.foldl`, so that call is not specialized; `sumCubes` did not run at all, so
+-- its call is specialized as usual
+#eval show CoreM Unit from do
+  unless (← specializations `List.foldl `coldBranch).isEmpty do throwError "cold call was specialized"
+  if (← specializations `List.foldl `sumCubes).isEmpty then throwError "unprofiled call was not specialized"
+
+#eval (hotLoop 100 0, coldLoop 100 0, hotIter 10 0, coldIter 10 0, coldBranch true [1, 2, 3], sumCubes (List.range 10))
+
+#eval IO.FS.removeFile "profileGuided.tmp.lean"
+#eval IO.FS.removeFile "profileGuided.profile.tmp"
+#eval IO.FS.removeFile "profileGuided.profile.tmp.lock"
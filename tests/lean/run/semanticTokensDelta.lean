@@ -0,0 +1,40 @@
+import Lean.Server.FileWorker.RequestHandling
+open Lean Lsp Server.FileWorker
+
+def applyEdit (old : Array Nat) (e : SemanticTokensEdit) : Array Nat :=
+  old.extract 0 e.start ++ e.data?.getD #[] ++ old.extract (e.start + e.deleteCount) old.size
+
+def check (old new : Array Nat) : IO Unit := do
+  let e := computeSemanticTokensEdit old new
+  unless applyEdit old e == new do
+    throw <| .userError s!"{old} → {new}: wrong edit {toJson e}"
+
+#eval do
+  check #[] #[]
+  check #[] #[0, 1, 2, 3, 0]
+  check #[0, 1, 2, 3, 0] #[]
+  check #[0, 1, 2, 3, 0] #[0, 1, 2, 3, 0]
+  check #[0, 1, 2, 3, 0, 1, 4, 2, 3, 0] #[0, 1, 2, 3, 0, 2, 4, 2, 3, 0]
+  check #[0, 1, 2, 3, 0, 1, 4, 2, 3, 0] #[0, 1, 2, 3, 0, 0, 5, 1, 1, 0, 1, 4, 2, 3, 0]
+  check #[1, 1, 1, 1] #[1, 1, 1]
+  check #[1, 1, 1] #[1, 1, 1, 1]
+  check #[1, 2, 1] #[1, 1]
+
+/-- info: 5 -/
+#guard_msgs in
+#eval (computeSemanticTokensEdit #[0, 1, 2, 3, 0, 1, 4, 2, 3, 0] #[0, 1, 2, 3, 0, 2, 4, 2, 3, 0]).start
+
+def options : SemanticTokensOptions := { legend := ⟨#[], #[]⟩, range := true, full := true, delta := true }
+
+#guard toJson options == Json.mkObj [
+  ("legend", Json.mkObj [("tokenTypes", Json.arr #[]), ("tokenModifiers", Json.arr #[])]),
+  ("range", true),
+  ("full", Json.mkObj [("delta", true)])]
+#guard toJson { options with delta := false } == Json.mkObj [
+  ("legend", Json.mkObj [("tokenTypes", Json.arr #[]), ("tokenModifiers", Json.arr #[])]),
+  ("range", true),
+  ("full", true)]
+
+#guard (fromJson? (α := SemanticTokensOptions) (toJson options) |>.toOption |>.map (·.delta)) == some true
+#guard (fromJson? (α := SemanticTokensOptions) (toJson { options with delta := false })
+  |>.toOption |>.map (·.delta)) == some false
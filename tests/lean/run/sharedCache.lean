@@ -0,0 +1,37 @@
+import Lean
+open Lean Meta
+
+set_option meta.sharedCache true
+
+def listLength : MetaM Expr := do
+  mkAppM ``List.length #[← mkListLit (mkConst ``Nat) [mkNatLit 1, mkNatLit 2, mkNatLit 3]]
+
+-- fills the shared caches
+run_meta do
+  guard (← isDefEq (← listLength) (mkNatLit 3))
+  guard ((← whnf (← listLength)) == mkRawNatLit 3)
+
+-- the results are reused by another `MetaM` run
+run_meta do
+  let hits := (← sharedDefEqCache.getStats).hits + (← sharedWhnfCache.getStats).hits
+  guard (← isDefEq (← listLength) (mkNatLit 3))
+  guard ((← whnf (← listLength)) == mkRawNatLit 3)
+  guard ((← sharedDefEqCache.getStats).hits + (← sharedWhnfCache.getStats).hits > hits)
+
+-- results for terms containing constants of the current module are not shared
+def three := 3
+
+run_meta do
+  guard (← isDefEq (mkConst ``three) (mkNatLit 3))
+  guard !(isSharedCacheKey (← getEnv) (mkConst ``three))
+
+-- local reducibility changes are respected
+section
+attribute [local irreducible] List.length
+
+run_meta do
+  guard !(← isDefEq (← listLength) (mkNatLit 3))
+end
+
+run_meta do
+  guard (← isDefEq (← listLength) (mkNatLit 3))
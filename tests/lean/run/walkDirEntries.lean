@@ -0,0 +1,33 @@
+open System IO.FS
+
+def check (msg : String) (b : Bool) : IO Unit :=
+  unless b do throw <| IO.userError s!"check failed: {msg}"
+
+#eval show IO Unit from do
+  let root : FilePath := "walkDirEntries.tmp"
+  if ← root.pathExists then removeDirAll root
+  createDirAll (root / "a" / "b")
+  createDirAll (root / ".git")
+  writeFile (root / "x.lean") ""
+  writeFile (root / "a" / "y.lean") "hello"
+  writeFile (root / "a" / "b" / "z.olean") ""
+  writeFile (root / ".git" / "w.lean") ""
+
+  let es ← root.walkDirEntries
+  check "all entries" <| es.map (·.path) == #[root / ".git", root / ".git" / "w.lean", root / "a", root / "a" / "b",
+    root / "a" / "b" / "z.olean", root / "a" / "y.lean", root / "x.lean"]
+  check "types" <| es.map (·.type) == #[.dir, .file, .dir, .dir, .file, .file, .file]
+  check "no metadata" <| es.all (·.metadata.isNone)
+
+  let es ← root.walkDirEntries { extensions := #["lean"], skipDirs := #[".git"], includeDirs := false, metadata := true }
+  check "filtered entries" <| es.map (·.path) == #[root / "a" / "y.lean", root / "x.lean"]
+  check "metadata" <| es.map (·.metadata.map (·.byteSize)) == #[some 5, some 0]
+
+  let es ← root.walkDirEntries { pattern? := "*.?lean", includeDirs := false }
+  check "pattern" <| es.map (·.path) == #[root / "a" / "b" / "z.olean"]
+
+  -- same result as `walkDir`
+  let ps ← root.walkDir
+  check "walkDir" <| ps.qsort (·.toString < ·.toString) == (← root.walkDirEntries).map (·.path)
+
+  removeDirAll root
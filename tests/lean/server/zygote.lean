@@ -0,0 +1,51 @@
+import Lean.Data.Lsp
+open IO Lean Lsp
+
+/-! Runs the server with worker zygotes, so that the workers of documents with the same imports are forked from the
+zygote that imported their header; see `Lean.Server.Zygote`. -/
+
+def openDoc (uri : DocumentUri) (text : String) : Ipc.IpcM Unit :=
+  Ipc.writeNotification ⟨"textDocument/didOpen", {
+    textDocument := { uri, languageId := "lean", version := 1, text }
+    : DidOpenTextDocumentParams }⟩
+
+/-- Makes the worker report the zygote it was forked from, see `Lean.Server.Zygote.childEnvVar`. -/
+def zygotePidLine := "\n#eval IO.getEnv \"LEAN_WORKER_ZYGOTE_PID\"\n"
+
+/-- Checks the diagnostics of `uri` and returns the process id of the zygote its worker was forked from. -/
+def checkDiagnostics (id : Nat) (uri : DocumentUri) (expected : List String) : Ipc.IpcM String := do
+  let some diag ← Ipc.collectDiagnostics id uri 1
+    | throw <| userError s!"no diagnostics received for {uri}"
+  let msgs := diag.param.diagnostics.toList.map (·.message)
+  let some zygotePid := msgs.getLast? |>.bind (·.dropPrefix? "some ")
+    | throw <| userError s!"worker for {uri} was not forked from a zygote: {msgs}"
+  unless msgs.dropLast == expected do
+    throw <| userError s!"unexpected diagnostics for {uri}: {msgs}"
+  return zygotePid.toString
+
+def main : IO Unit := do
+  let proc ← Process.spawn {
+    toStdioConfig := Ipc.ipcStdioConfig
+    cmd  := (← IO.appPath).toString
+    args := #["--server", "-Dlinter.all=false"]
+    env  := #[("LEAN_SERVER_ZYGOTE", "1")]
+  }
+  ReaderT.run (r := proc) do
+    let hIn ← Ipc.stdin
+    hIn.write (← FS.readBinFile "init_vscode_1_47_2.log")
+    hIn.flush
+    discard <| Ipc.readResponseAs 0 InitializeResult
+    Ipc.writeNotification ⟨"initialized", InitializedParams.mk⟩
+
+    -- the first document starts the zygote, and the workers of all three documents are forked from it
+    openDoc "file:///a.lean" <| "import Init.System.IO\n\n#eval 1 + 1\n" ++ zygotePidLine
+    openDoc "file:///b.lean" <| "import Init.System.IO\n\ndef b : Nat := \"b\"\n" ++ zygotePidLine
+    openDoc "file:///c.lean" <| "import Init.System.IO\n\n#eval (IO.println \"c\" : IO Unit)\n" ++ zygotePidLine
+    let pidA ← checkDiagnostics 1 "file:///a.lean" ["2"]
+    let pidB ← checkDiagnostics 2 "file:///b.lean" ["type mismatch\n  \"b\"\nhas type\n  String : Type\nbut is expected to have type\n  Nat : Type"]
+    let pidC ← checkDiagnostics 3 "file:///c.lean" ["c\n"]
+    unless pidA == pidB && pidB == pidC do
+      throw <| userError s!"workers were forked from different zygotes: {pidA}, {pidB}, {pidC}"
+
+    Ipc.shutdown 4
+    discard <| Ipc.waitForExit
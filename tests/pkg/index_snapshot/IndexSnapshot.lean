@@ -0,0 +1,34 @@
+import IndexSnapshot.B
+import Lean
+
+open Lean Meta
+
+/-!
+`IndexSnapshot.A` is the first import after `Init`, so the instance and simp lemma indices are
+imported from its state snapshot. `IndexSnapshot.B` adds too few entries to store a snapshot of its
+own, so its entries are added on top of that snapshot.
+-/
+
+#eval show MetaM Unit from do
+  let env ← getEnv
+  let some modIdxA := env.getModuleIdx? `IndexSnapshot.A
+    | throwError "module not imported"
+  let some modIdxB := env.getModuleIdx? `IndexSnapshot.B
+    | throwError "module not imported"
+  unless (instanceExtension.ext.getModuleEntries env modIdxA).back? matches some (.snapshot _) do
+    throwError "no instance index snapshot"
+  if (instanceExtension.ext.getModuleEntries env modIdxB).back? matches some (.snapshot _) then
+    throwError "unexpected instance index snapshot in `IndexSnapshot.B`"
+  for inst in [``instFooNat, ``instFooBool] do
+    unless (instanceExtension.getState env).instanceNames.contains inst do
+      throwError "instance `{inst}` missing"
+
+example : (Foo.foo : Nat) = 1 := by simp
+example : bar 0 = 1 := by simp
+example : (Foo.foo : Nat) = 1 := by simp only [foo_nat]
+
+#eval show MetaM Unit from do
+  for (type, inst) in [(``Nat, ``instFooNat), (``Bool, ``instFooBool)] do
+    let e ← synthInstance (mkApp (mkConst ``Foo) (mkConst type))
+    unless e.isConstOf inst do
+      throwError "unexpected instance {e}"
@@ -0,0 +1,6 @@
+class Foo (α : Type) where
+  foo : α
+
+instance instFooNat : Foo Nat := ⟨1⟩
+
+@[simp] theorem foo_nat : (Foo.foo : Nat) = 1 := rfl
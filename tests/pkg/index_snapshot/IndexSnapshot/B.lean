@@ -0,0 +1,7 @@
+import IndexSnapshot.A
+
+instance instFooBool : Foo Bool := ⟨true⟩
+
+def bar (n : Nat) : Nat := n + Foo.foo
+
+@[simp] theorem bar_zero : bar 0 = 1 := rfl
@@ -0,0 +1,7 @@
+import Lake
+open System Lake DSL
+
+package index_snapshot where
+  moreLeanArgs := #["-Dolean.storeIndices=true"]
+
+@[default_target] lean_lib IndexSnapshot